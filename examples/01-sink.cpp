@@ -8,6 +8,17 @@ int main(int argc, const char* argv[])
 {
     AtollaSinkSpec spec;
     spec.lights_count = 1;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.shm_name = NULL;
+    spec.tcp_port = 0;
+    spec.unix_path = NULL;
+    spec.multicast_group = NULL;
+    spec.max_sources = 0;
+    spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    spec.max_buffer_length = 0;
+    spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    spec.connect_borrowers = false;
+    spec.socket_options = NULL;
     spec.port = 10042;
 
     sink = atolla_sink_make(&spec);
@@ -38,6 +38,13 @@ static void run_source(const char* sink_hostname, int port)
     spec.retry_timeout_ms = 0; // 0 means pick a default value
     spec.disconnect_timeout_ms = 0; // 0 means pick a default value
     spec.async_make = false;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.multicast_ttl = 0;
+    spec.priority = 0;
+    spec.opacity = 0;
+    spec.pacing_spin_us = 0;
+    spec.retransmit_frames = 0;
+    spec.socket_options = NULL;
 
     printf("Starting atolla source\n");
 
@@ -0,0 +1,106 @@
+#include <atolla/source.h>
+#include <show/file.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+const int frame_length_ms = 17;
+const int max_buffered_frames = 50;
+const int run_time_ms = 10000;
+const int lights_count = 16;
+const char* show_path = "example_show.atsh";
+
+static bool render_show(const char* path);
+static void run_source(const char* sink_hostname, int port);
+
+/**
+ * Pre-renders a sine wave running along the lights into a show file.
+ */
+static bool render_show(const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file) {
+        return false;
+    }
+
+    const size_t frame_count = run_time_ms / frame_length_ms;
+    const size_t frame_stride = lights_count * 3;
+
+    bool ok = show_file_write_header(file, lights_count, frame_length_ms, frame_count, frame_stride);
+
+    uint8_t frame[lights_count * 3];
+    for(size_t i = 0; ok && i < frame_count; ++i)
+    {
+        double t = i * frame_length_ms / 1000.0;
+        for(int light = 0; light < lights_count; ++light)
+        {
+            double poscos = (cos(t + light * 0.4) + 1.0) / 2.0;
+            uint8_t col = (uint8_t) (poscos * 255.0);
+            frame[light*3 + 0] = col;
+            frame[light*3 + 1] = 255 - col;
+            frame[light*3 + 2] = col / 2;
+        }
+        ok = fwrite(frame, 1, frame_stride, file) == frame_stride;
+    }
+
+    fclose(file);
+    return ok;
+}
+
+static void run_source(const char* sink_hostname, int port)
+{
+    AtollaSourceSpec spec;
+    spec.sink_hostname = sink_hostname;
+    spec.sink_port = port;
+    spec.frame_duration_ms = frame_length_ms;
+    spec.max_buffered_frames = max_buffered_frames;
+    spec.retry_timeout_ms = 0; // 0 means pick a default value
+    spec.disconnect_timeout_ms = 0; // 0 means pick a default value
+    spec.async_make = false;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.multicast_ttl = 0;
+    spec.priority = 0;
+    spec.opacity = 0;
+    spec.pacing_spin_us = 0;
+    spec.retransmit_frames = 0;
+    spec.socket_options = NULL;
+
+    printf("Rendering show to %s\n", show_path);
+    if(!render_show(show_path)) {
+        printf("Failed to render show\n");
+        return;
+    }
+
+    printf("Starting atolla source\n");
+
+    AtollaSource source = atolla_source_make(&spec);
+    AtollaSourceState state = atolla_source_state(source);
+
+    while((state = atolla_source_state(source)) == ATOLLA_SOURCE_STATE_WAITING) {}
+
+    if(state == ATOLLA_SOURCE_STATE_OPEN) {
+        printf("Atolla source received lent, playing show\n");
+        if(atolla_source_play_file(source, show_path)) {
+            printf("Show completed\n");
+        } else {
+            printf("Show could not be played to the end\n");
+        }
+    } else {
+        printf("Error occurred lending\n");
+    }
+
+    atolla_source_free(source);
+}
+
+int main(int argc, const char* argv[])
+{
+    if(argc < 3) {
+        run_source("localhost", 10042);
+    } else {
+        const char* sink_hostname = argv[1];
+        int port = atoi(argv[2]);
+        run_source(sink_hostname, port);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,473 @@
+/**
+ * Header-only C++ interface to atolla sinks and sources.
+ *
+ * atolla::Sink and atolla::Source own the underlying C objects and free them
+ * when destroyed. They can be moved but not copied, so a sink or source is
+ * never freed twice or leaked. All member functions are inline and forward
+ * directly to the C functions, no state is added on top of the C handle.
+ *
+ * atolla::StaticSink is the exception, it holds all memory of its sink
+ * inline, so nothing is allocated after construction.
+ *
+ * Frames can be passed as raw bytes or as arrays of pixel types like
+ * atolla::Rgb. With C++20, std::span overloads are available in addition to
+ * the pointer and count overloads.
+ */
+
+#ifndef ATOLLA_HPP
+#define ATOLLA_HPP
+
+#include "sink.h"
+#include "source.h"
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+    #if __has_include(<span>)
+        #include <span>
+    #endif
+#endif
+
+#if defined(__cpp_lib_span) && __cpp_lib_span >= 202002L
+    #define ATOLLA_HPP_SPAN
+#endif
+
+namespace atolla
+{
+    /**
+     * A light color with 8 bits for each of red, green and blue, in the
+     * layout used for frames on the wire.
+     */
+    struct Rgb
+    {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+    };
+    static_assert(sizeof(Rgb) == 3, "Rgb must not contain padding");
+
+    /**
+     * A light color with an additional white channel, 8 bits per channel.
+     */
+    struct Rgbw
+    {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t w;
+    };
+    static_assert(sizeof(Rgbw) == 4, "Rgbw must not contain padding");
+
+    /**
+     * A light color with 16 bits per channel. Channels are little-endian on
+     * the wire, so on big-endian machines they need to be byte-swapped.
+     */
+    struct Rgb16
+    {
+        uint16_t r;
+        uint16_t g;
+        uint16_t b;
+    };
+    static_assert(sizeof(Rgb16) == 6, "Rgb16 must not contain padding");
+
+    /**
+     * A light color packed into 16 bits, for transfer to RGB8 sinks with a
+     * third less bandwidth. Like the channels of Rgb16, bits is little-endian
+     * on the wire.
+     */
+    struct Rgb565
+    {
+        uint16_t bits;
+
+        static constexpr Rgb565 from_rgb(uint8_t r, uint8_t g, uint8_t b)
+        {
+            return Rgb565 { (uint16_t) (((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)) };
+        }
+    };
+    static_assert(sizeof(Rgb565) == 2, "Rgb565 must not contain padding");
+
+    /**
+     * Describes types that can be used as pixels in frames at compile time.
+     * Specialize for a type to allow passing arrays of it to put and get.
+     * Containers of Rgb convert to spans implicitly, other pixel types need
+     * to be passed as an explicitly typed std::span.
+     */
+    template<typename Pixel>
+    struct PixelFormat
+    {
+        static constexpr bool is_pixel = false;
+    };
+
+    template<>
+    struct PixelFormat<Rgb>
+    {
+        static constexpr bool is_pixel = true;
+        static constexpr AtollaPixelFormat format = ATOLLA_PIXEL_FORMAT_RGB8;
+        static constexpr std::size_t channels = 3;
+        static constexpr std::size_t bytes_per_pixel = sizeof(Rgb);
+    };
+
+    template<>
+    struct PixelFormat<Rgbw>
+    {
+        static constexpr bool is_pixel = true;
+        static constexpr AtollaPixelFormat format = ATOLLA_PIXEL_FORMAT_RGBW8;
+        static constexpr std::size_t channels = 4;
+        static constexpr std::size_t bytes_per_pixel = sizeof(Rgbw);
+    };
+
+    template<>
+    struct PixelFormat<Rgb16>
+    {
+        static constexpr bool is_pixel = true;
+        static constexpr AtollaPixelFormat format = ATOLLA_PIXEL_FORMAT_RGB16;
+        static constexpr std::size_t channels = 3;
+        static constexpr std::size_t bytes_per_pixel = sizeof(Rgb16);
+    };
+
+    template<>
+    struct PixelFormat<Rgb565>
+    {
+        static constexpr bool is_pixel = true;
+        static constexpr AtollaPixelFormat format = ATOLLA_PIXEL_FORMAT_RGB565;
+        static constexpr std::size_t channels = 3;
+        static constexpr std::size_t bytes_per_pixel = sizeof(Rgb565);
+    };
+
+    /**
+     * Owns an atolla sink, see sink.h for the underlying functions.
+     */
+    class Sink
+    {
+    public:
+        explicit Sink(const AtollaSinkSpec& spec) : sink(atolla_sink_make(&spec)) {}
+
+        Sink(int port, int lights_count, AtollaPixelFormat pixel_format = ATOLLA_PIXEL_FORMAT_RGB8)
+            : sink(make(port, lights_count, pixel_format)) {}
+
+        ~Sink()
+        {
+            if(sink.internal)
+            {
+                atolla_sink_free(sink);
+            }
+        }
+
+        Sink(const Sink&) = delete;
+        Sink& operator=(const Sink&) = delete;
+
+        Sink(Sink&& other) noexcept : sink(other.sink)
+        {
+            other.sink.internal = nullptr;
+        }
+
+        Sink& operator=(Sink&& other) noexcept
+        {
+            std::swap(sink, other.sink);
+            return *this;
+        }
+
+        /**
+         * Returns false if the sink was moved from or released.
+         */
+        explicit operator bool() const { return sink.internal != nullptr; }
+
+        AtollaSink handle() const { return sink; }
+
+        /**
+         * Gives up ownership of the C sink without freeing it.
+         */
+        AtollaSink release()
+        {
+            AtollaSink released = sink;
+            sink.internal = nullptr;
+            return released;
+        }
+
+        AtollaSinkState state() { return atolla_sink_state(sink); }
+
+        const char* error_msg() { return atolla_sink_error_msg(sink); }
+
+        int poll_fd() { return atolla_sink_poll_fd(sink); }
+
+        int poll_timeout() { return atolla_sink_poll_timeout(sink); }
+
+        AtollaSinkStats stats()
+        {
+            AtollaSinkStats stats;
+            atolla_sink_stats(sink, &stats);
+            return stats;
+        }
+
+        bool socket_options(AtollaSocketOptions& effective)
+        {
+            return atolla_sink_socket_options(sink, &effective);
+        }
+
+        bool get(void* frame, std::size_t frame_len)
+        {
+            return atolla_sink_get(sink, frame, frame_len);
+        }
+
+        template<typename Pixel, typename = typename std::enable_if<PixelFormat<Pixel>::is_pixel>::type>
+        bool get(Pixel* pixels, std::size_t pixel_count)
+        {
+            return atolla_sink_get(sink, pixels, pixel_count * sizeof(Pixel));
+        }
+
+#ifdef ATOLLA_HPP_SPAN
+        bool get(std::span<std::byte> frame)
+        {
+            return atolla_sink_get(sink, frame.data(), frame.size());
+        }
+
+        bool get(std::span<Rgb> pixels)
+        {
+            return get(pixels.data(), pixels.size());
+        }
+
+        template<typename Pixel, typename = typename std::enable_if<PixelFormat<Pixel>::is_pixel>::type>
+        bool get(std::span<Pixel> pixels)
+        {
+            return get(pixels.data(), pixels.size());
+        }
+#endif
+
+    private:
+        static AtollaSink make(int port, int lights_count, AtollaPixelFormat pixel_format)
+        {
+            AtollaSinkSpec spec;
+            spec.port = port;
+            spec.lights_count = lights_count;
+            spec.pixel_format = pixel_format;
+            spec.shm_name = nullptr;
+            spec.tcp_port = 0;
+            spec.unix_path = nullptr;
+            spec.multicast_group = nullptr;
+            spec.max_sources = 0;
+            spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+            spec.max_buffer_length = 0;
+            spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+            spec.connect_borrowers = false;
+            spec.socket_options = nullptr;
+            return atolla_sink_make(&spec);
+        }
+
+        AtollaSink sink;
+    };
+
+    /**
+     * Owns an atolla sink for Lights lights of the given pixel type, whose
+     * memory is part of the object, see atolla_sink_init_in. Nothing is
+     * allocated after construction, so a StaticSink in a global variable has
+     * its memory use known at compile time. Sources may buffer up to Frames
+     * frames, and only a single source borrows it at a time.
+     *
+     * The sink points into its own storage, so it can neither be copied nor
+     * moved.
+     */
+    template<std::size_t Lights, std::size_t Frames, typename Pixel = Rgb>
+    class StaticSink
+    {
+        static_assert(PixelFormat<Pixel>::is_pixel, "Pixel must be a pixel type");
+        static_assert(PixelFormat<Pixel>::format != ATOLLA_PIXEL_FORMAT_RGB565, "RGB565 is only used for transfer, sinks cannot output it");
+        static_assert(Lights >= 1, "Sinks need at least one light");
+        static_assert(Frames >= 1 && Frames < 256, "Buffer lengths range from 1 to 255 frames");
+
+    public:
+        static constexpr std::size_t frame_size = Lights * sizeof(Pixel);
+        static constexpr std::size_t storage_size = ATOLLA_SINK_LAYERED_STORAGE_SIZE(Lights, Frames, sizeof(Pixel), 1);
+
+        explicit StaticSink(int port) : StaticSink(make_spec(port)) {}
+
+        /**
+         * Makes the sink with the given spec, except for the lights, pixel
+         * format, sources and buffer length, which are given by the type.
+         * Stream connections are not available.
+         */
+        explicit StaticSink(AtollaSinkSpec spec)
+        {
+            spec.lights_count = (int) Lights;
+            spec.pixel_format = PixelFormat<Pixel>::format;
+            spec.max_sources = 1;
+            spec.max_buffer_length = (int) Frames;
+            spec.tcp_port = 0;
+            spec.unix_path = nullptr;
+            sink = atolla_sink_init_in(&spec, storage, sizeof(storage));
+        }
+
+        ~StaticSink()
+        {
+            atolla_sink_free(sink);
+        }
+
+        StaticSink(const StaticSink&) = delete;
+        StaticSink& operator=(const StaticSink&) = delete;
+
+        AtollaSink handle() const { return sink; }
+
+        AtollaSinkState state() { return atolla_sink_state(sink); }
+
+        const char* error_msg() { return atolla_sink_error_msg(sink); }
+
+        int poll_fd() { return atolla_sink_poll_fd(sink); }
+
+        int poll_timeout() { return atolla_sink_poll_timeout(sink); }
+
+        AtollaSinkStats stats()
+        {
+            AtollaSinkStats stats;
+            atolla_sink_stats(sink, &stats);
+            return stats;
+        }
+
+        bool socket_options(AtollaSocketOptions& effective)
+        {
+            return atolla_sink_socket_options(sink, &effective);
+        }
+
+        bool get(Pixel (&pixels)[Lights])
+        {
+            return atolla_sink_get(sink, pixels, frame_size);
+        }
+
+        bool get(std::array<Pixel, Lights>& pixels)
+        {
+            return atolla_sink_get(sink, pixels.data(), frame_size);
+        }
+
+    private:
+        static AtollaSinkSpec make_spec(int port)
+        {
+            AtollaSinkSpec spec;
+            spec.port = port;
+            spec.shm_name = nullptr;
+            spec.multicast_group = nullptr;
+            spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+            spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+            spec.connect_borrowers = false;
+            spec.socket_options = nullptr;
+            return spec;
+        }
+
+        AtollaSink sink;
+        alignas(16) unsigned char storage[storage_size];
+    };
+
+    /**
+     * Owns an atolla source, see source.h for the underlying functions.
+     */
+    class Source
+    {
+    public:
+        explicit Source(const AtollaSourceSpec& spec) : source(atolla_source_make(&spec)) {}
+
+        ~Source()
+        {
+            if(source.internal)
+            {
+                atolla_source_free(source);
+            }
+        }
+
+        Source(const Source&) = delete;
+        Source& operator=(const Source&) = delete;
+
+        Source(Source&& other) noexcept : source(other.source)
+        {
+            other.source.internal = nullptr;
+        }
+
+        Source& operator=(Source&& other) noexcept
+        {
+            std::swap(source, other.source);
+            return *this;
+        }
+
+        /**
+         * Returns false if the source was moved from or released.
+         */
+        explicit operator bool() const { return source.internal != nullptr; }
+
+        AtollaSource handle() const { return source; }
+
+        /**
+         * Gives up ownership of the C source without freeing it.
+         */
+        AtollaSource release()
+        {
+            AtollaSource released = source;
+            source.internal = nullptr;
+            return released;
+        }
+
+        AtollaSourceState state() { return atolla_source_state(source); }
+
+        const char* error_msg() { return atolla_source_error_msg(source); }
+
+        int put_ready_count() { return atolla_source_put_ready_count(source); }
+
+        int put_ready_timeout() { return atolla_source_put_ready_timeout(source); }
+
+        int poll_fd() { return atolla_source_poll_fd(source); }
+
+        int poll_timeout() { return atolla_source_poll_timeout(source); }
+
+        bool put(const void* frame, std::size_t frame_len)
+        {
+            return atolla_source_put(source, frame, frame_len);
+        }
+
+        template<typename Pixel, typename = typename std::enable_if<PixelFormat<Pixel>::is_pixel>::type>
+        bool put(const Pixel* pixels, std::size_t pixel_count)
+        {
+            return atolla_source_put(source, pixels, pixel_count * sizeof(Pixel));
+        }
+
+#ifdef ATOLLA_HPP_SPAN
+        bool put(std::span<const std::byte> frame)
+        {
+            return atolla_source_put(source, frame.data(), frame.size());
+        }
+
+        bool put(std::span<const Rgb> pixels)
+        {
+            return put(pixels.data(), pixels.size());
+        }
+
+        template<typename Pixel, typename = typename std::enable_if<PixelFormat<Pixel>::is_pixel>::type>
+        bool put(std::span<const Pixel> pixels)
+        {
+            return put(pixels.data(), pixels.size());
+        }
+#endif
+
+        bool play_file(const char* path) { return atolla_source_play_file(source, path); }
+
+        template<typename Pixel, typename = typename std::enable_if<PixelFormat<Pixel>::is_pixel>::type>
+        bool effect(AtollaEffect effect, const Pixel& from, const Pixel& to, int wavelength = 0, int period_ms = 0)
+        {
+            return atolla_source_effect(source, effect, &from, &to, wavelength, period_ms);
+        }
+
+        AtollaSourcePacing pacing()
+        {
+            AtollaSourcePacing stats;
+            atolla_source_pacing(source, &stats);
+            return stats;
+        }
+
+        bool socket_options(AtollaSocketOptions& effective)
+        {
+            return atolla_source_socket_options(source, &effective);
+        }
+
+    private:
+        AtollaSource source;
+    };
+}
+
+#endif // ATOLLA_HPP
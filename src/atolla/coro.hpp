@@ -0,0 +1,509 @@
+/**
+ * C++20 coroutine interface to atolla sinks and sources, driven by a minimal
+ * epoll executor.
+ *
+ * atolla::AsyncSource and atolla::AsyncSink wrap a source or sink together
+ * with the executor that runs it, and offer awaitable operations instead of
+ * polling:
+ *
+ *     atolla::Task<void> stream(atolla::Executor& executor, const AtollaSourceSpec& spec)
+ *     {
+ *         atolla::AsyncSource source(executor, spec);
+ *         if(!co_await source.connected()) co_return;
+ *         for(;;) {
+ *             if(!co_await source.put(render_next_frame())) co_return;
+ *         }
+ *     }
+ *
+ *     atolla::Executor executor;
+ *     executor.spawn(stream(executor, spec));
+ *     executor.run();
+ *
+ * While a coroutine waits, its thread serves the others, waiting with
+ * epoll_wait on the descriptors from atolla_source_poll_fd and
+ * atolla_sink_poll_fd, with the timeouts from atolla_source_poll_timeout and
+ * atolla_sink_poll_timeout. No operation blocks or sleeps. An executor and
+ * everything spawned on it belong to a single thread, for more cores run an
+ * executor on each of a few threads and spread the streams over them.
+ *
+ * Only available on Linux, with a compiler supporting C++20 coroutines.
+ */
+
+#ifndef ATOLLA_CORO_HPP
+#define ATOLLA_CORO_HPP
+
+#include "atolla.hpp"
+
+#if __cplusplus < 202002L || !defined(__has_include) || !__has_include(<coroutine>) || !defined(__linux__)
+    #error "atolla/coro.hpp needs C++20 coroutines and Linux"
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace atolla
+{
+    class Executor;
+
+    template<typename T>
+    class Task;
+
+    namespace detail
+    {
+        /**
+         * Parts of the promise that do not depend on the result type. Tasks
+         * start suspended and resume whoever awaited them when they are done.
+         * Tasks that were spawned on an executor are awaited by nobody and
+         * count themselves off instead.
+         */
+        struct TaskPromiseBase
+        {
+            std::coroutine_handle<> continuation;
+            std::size_t* running_count = nullptr;
+
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+
+                template<typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+                {
+                    TaskPromiseBase& promise = handle.promise();
+                    if(promise.continuation)
+                    {
+                        return promise.continuation;
+                    }
+
+                    if(promise.running_count)
+                    {
+                        --*promise.running_count;
+                    }
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            FinalAwaiter final_suspend() noexcept { return {}; }
+
+            // atolla does not use exceptions
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+
+        template<typename T>
+        struct TaskPromise : TaskPromiseBase
+        {
+            T value{};
+
+            Task<T> get_return_object() noexcept;
+
+            void return_value(T returned) noexcept { value = std::move(returned); }
+
+            T result() { return std::move(value); }
+        };
+
+        template<>
+        struct TaskPromise<void> : TaskPromiseBase
+        {
+            Task<void> get_return_object() noexcept;
+
+            void return_void() noexcept {}
+
+            void result() {}
+        };
+    }
+
+    /**
+     * A coroutine returning T that starts running when it is awaited, or when
+     * it is spawned on an executor. Tasks own their coroutine frame and can be
+     * moved but not copied.
+     */
+    template<typename T>
+    class Task
+    {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+
+        Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+        Task& operator=(Task&& other) noexcept
+        {
+            std::swap(handle, other.handle);
+            return *this;
+        }
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task()
+        {
+            if(handle)
+            {
+                handle.destroy();
+            }
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().result(); }
+
+    private:
+        friend class Executor;
+        friend struct detail::TaskPromise<T>;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    template<typename T>
+    Task<T> detail::TaskPromise<T>::get_return_object() noexcept
+    {
+        return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline Task<void> detail::TaskPromise<void>::get_return_object() noexcept
+    {
+        return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+
+    /**
+     * Runs tasks on the calling thread, resuming them when the descriptor they
+     * wait for becomes readable or their timeout passes.
+     */
+    class Executor
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * Awaitable returned by wait, resuming with true if the timeout passed
+         * and with false if the descriptor became readable first.
+         */
+        class Wait
+        {
+        public:
+            bool await_ready() noexcept
+            {
+                // Without a descriptor or a timeout there is nothing to wait for
+                timed_out = (timeout_ms == 0 || (fd < 0 && timeout_ms < 0));
+                return timed_out;
+            }
+
+            void await_suspend(std::coroutine_handle<> awaiting) { executor.suspend(this, awaiting); }
+
+            bool await_resume() noexcept { return timed_out; }
+
+        private:
+            friend class Executor;
+
+            Wait(Executor& executor, int fd, int timeout_ms) : executor(executor), fd(fd), timeout_ms(timeout_ms) {}
+
+            Executor& executor;
+            int fd;
+            int timeout_ms;
+            bool timed_out = false;
+            std::coroutine_handle<> handle;
+            bool has_timer = false;
+            std::multimap<Clock::time_point, Wait*>::iterator timer;
+        };
+
+        Executor() : epoll_fd(epoll_create1(EPOLL_CLOEXEC)) {}
+
+        Executor(const Executor&) = delete;
+        Executor& operator=(const Executor&) = delete;
+
+        ~Executor()
+        {
+            if(epoll_fd >= 0)
+            {
+                close(epoll_fd);
+            }
+        }
+
+        /**
+         * Returns false if the kernel refused to create the epoll instance.
+         */
+        explicit operator bool() const { return epoll_fd >= 0; }
+
+        /**
+         * Takes over the task and starts it on the next call to run.
+         */
+        void spawn(Task<void> task)
+        {
+            task.handle.promise().running_count = &running_count;
+            ++running_count;
+            ready.push_back(task.handle);
+            tasks.push_back(std::move(task));
+        }
+
+        /**
+         * Runs the spawned tasks and the tasks they spawn until all of them
+         * are done.
+         */
+        void run()
+        {
+            while(running_count > 0)
+            {
+                while(!ready.empty())
+                {
+                    std::vector<std::coroutine_handle<>> resumed;
+                    resumed.swap(ready);
+                    for(std::coroutine_handle<> handle : resumed)
+                    {
+                        handle.resume();
+                    }
+                }
+
+                if(running_count > 0)
+                {
+                    poll();
+                }
+            }
+
+            tasks.clear();
+        }
+
+        /**
+         * Suspends the awaiting coroutine until fd becomes readable or
+         * timeout_ms milliseconds have passed. An fd of -1 waits only for the
+         * timeout, a timeout of -1 only for the descriptor. Only one
+         * coroutine may wait for the same descriptor at a time.
+         */
+        Wait wait(int fd, int timeout_ms) { return Wait(*this, fd, timeout_ms); }
+
+    private:
+        void suspend(Wait* wait, std::coroutine_handle<> handle)
+        {
+            wait->handle = handle;
+
+            if(wait->fd >= 0)
+            {
+                // One-shot, so a descriptor that stays readable fires once per wait
+                epoll_event event = {};
+                event.events = EPOLLIN | EPOLLONESHOT;
+                event.data.ptr = wait;
+                if(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, wait->fd, &event) != 0 &&
+                   (errno != ENOENT || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wait->fd, &event) != 0))
+                {
+                    // Cannot be polled, fall back to the timeout
+                    wait->fd = -1;
+                }
+            }
+
+            if(wait->timeout_ms >= 0 || wait->fd < 0)
+            {
+                int timeout_ms = (wait->timeout_ms < 0) ? 0 : wait->timeout_ms;
+                wait->timer = timers.emplace(Clock::now() + std::chrono::milliseconds(timeout_ms), wait);
+                wait->has_timer = true;
+            }
+        }
+
+        void poll()
+        {
+            int timeout_ms = -1;
+            if(!timers.empty())
+            {
+                auto remaining = timers.begin()->first - Clock::now();
+                // Round up, waking up early would only mean waiting again
+                auto remaining_ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+                timeout_ms = (remaining_ms < 0) ? 0 : (int) remaining_ms;
+            }
+
+            epoll_event events[64];
+            int events_count = epoll_wait(epoll_fd, events, 64, timeout_ms);
+
+            for(int i = 0; i < events_count; ++i)
+            {
+                Wait* wait = (Wait*) events[i].data.ptr;
+                if(wait->has_timer)
+                {
+                    timers.erase(wait->timer);
+                    wait->has_timer = false;
+                }
+                wait->timed_out = false;
+                ready.push_back(wait->handle);
+            }
+
+            Clock::time_point now = Clock::now();
+            while(!timers.empty() && timers.begin()->first <= now)
+            {
+                Wait* wait = timers.begin()->second;
+                timers.erase(timers.begin());
+                wait->has_timer = false;
+                if(wait->fd >= 0)
+                {
+                    // Still armed, and the wait is about to go away
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, wait->fd, nullptr);
+                }
+                wait->timed_out = true;
+                ready.push_back(wait->handle);
+            }
+        }
+
+        int epoll_fd;
+        std::size_t running_count = 0;
+        std::vector<Task<void>> tasks;
+        std::vector<std::coroutine_handle<>> ready;
+        std::multimap<Clock::time_point, Wait*> timers;
+    };
+
+    /**
+     * A source with awaitable operations, running on an executor.
+     */
+    class AsyncSource
+    {
+    public:
+        AsyncSource(Executor& executor, Source source) : executor(executor), source(std::move(source)) {}
+
+        /**
+         * Makes a source that borrows the sink asynchronously, regardless of
+         * async_make in the spec.
+         */
+        AsyncSource(Executor& executor, const AtollaSourceSpec& spec) : executor(executor), source(async_spec(spec)) {}
+
+        Source& get() { return source; }
+
+        /**
+         * Completes once the sink was borrowed, with true, or once borrowing
+         * failed, with false.
+         */
+        Task<bool> connected()
+        {
+            for(;;)
+            {
+                int timeout_ms = source.poll_timeout();
+                AtollaSourceState state = source.state();
+                if(state != ATOLLA_SOURCE_STATE_WAITING)
+                {
+                    co_return state == ATOLLA_SOURCE_STATE_OPEN;
+                }
+
+                co_await executor.wait(source.poll_fd(), timeout_ms);
+            }
+        }
+
+        /**
+         * Puts the frame once the sink has room for it, waiting for the sink to
+         * be borrowed first if necessary. Completes with false if the source is
+         * or enters the error state. The frame must stay valid until then.
+         */
+        Task<bool> put(const void* frame, std::size_t frame_len)
+        {
+            for(;;)
+            {
+                int timeout_ms = source.poll_timeout();
+                AtollaSourceState state = source.state();
+                if(state == ATOLLA_SOURCE_STATE_ERROR)
+                {
+                    co_return false;
+                }
+                else if(state == ATOLLA_SOURCE_STATE_OPEN && source.put_ready_count() > 0)
+                {
+                    co_return source.put(frame, frame_len);
+                }
+
+                co_await executor.wait(source.poll_fd(), timeout_ms);
+            }
+        }
+
+        template<typename Pixel, typename = typename std::enable_if<PixelFormat<Pixel>::is_pixel>::type>
+        Task<bool> put(const Pixel* pixels, std::size_t pixel_count)
+        {
+            return put(static_cast<const void*>(pixels), pixel_count * sizeof(Pixel));
+        }
+
+        template<typename Pixel, std::size_t Lights, typename = typename std::enable_if<PixelFormat<Pixel>::is_pixel>::type>
+        Task<bool> put(const std::array<Pixel, Lights>& pixels)
+        {
+            return put(static_cast<const void*>(pixels.data()), sizeof(pixels));
+        }
+
+    private:
+        static AtollaSourceSpec async_spec(AtollaSourceSpec spec)
+        {
+            spec.async_make = true;
+            return spec;
+        }
+
+        Executor& executor;
+        Source source;
+    };
+
+    /**
+     * A sink with awaitable operations, running on an executor.
+     */
+    class AsyncSink
+    {
+    public:
+        AsyncSink(Executor& executor, Sink sink) : executor(executor), sink(std::move(sink)) {}
+
+        Sink& get() { return sink; }
+
+        /**
+         * Completes with true and the frame written once the next frame is due,
+         * or with false if the sink is or enters the error state. Now and then,
+         * e.g. while sources send nothing, the frame is the one already shown.
+         * The buffer must stay valid until then.
+         */
+        Task<bool> next_frame(void* frame, std::size_t frame_len)
+        {
+            for(;;)
+            {
+                int timeout_ms = sink.poll_timeout();
+                if(sink.state() == ATOLLA_SINK_STATE_ERROR)
+                {
+                    co_return false;
+                }
+
+                if(timeout_ms == 0 && sink.get(frame, frame_len))
+                {
+                    co_return true;
+                }
+
+                // Waits at least a millisecond, so a frame that is due but
+                // cannot be shown yet does not keep the thread busy
+                bool due = co_await executor.wait(sink.poll_fd(), (timeout_ms == 0) ? 1 : timeout_ms);
+                if(due && sink.get(frame, frame_len))
+                {
+                    co_return true;
+                }
+            }
+        }
+
+        template<typename Pixel, typename = typename std::enable_if<PixelFormat<Pixel>::is_pixel>::type>
+        Task<bool> next_frame(Pixel* pixels, std::size_t pixel_count)
+        {
+            return next_frame(static_cast<void*>(pixels), pixel_count * sizeof(Pixel));
+        }
+
+        template<typename Pixel, std::size_t Lights, typename = typename std::enable_if<PixelFormat<Pixel>::is_pixel>::type>
+        Task<bool> next_frame(std::array<Pixel, Lights>& pixels)
+        {
+            return next_frame(static_cast<void*>(pixels.data()), sizeof(pixels));
+        }
+
+    private:
+        Executor& executor;
+        Sink sink;
+    };
+}
+
+#endif // ATOLLA_CORO_HPP
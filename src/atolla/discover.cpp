@@ -0,0 +1,141 @@
+#include "discover.h"
+#include "../msg/builder.h"
+#include "../msg/iter.h"
+#include "../time/now.h"
+#include "../time/sleep.h"
+#include "../udp_socket/udp_socket.h"
+#include "../test/assert.h"
+
+#include <string.h>
+
+/** Limited broadcast address, used if no hostname is given */
+static const char broadcast_hostname[] = "255.255.255.255";
+/** Milliseconds after which DISCOVER is sent again, in case it got lost */
+static const unsigned int rediscover_interval_ms = 100;
+/** Announce messages are short, they only grow with the amount of pixel formats */
+static const size_t recv_buf_len = 256;
+
+static size_t discover_add_announces(void* packet, size_t packet_len, UdpEndpoint* sender, AtollaSinkInfo* sinks, size_t sinks_count, size_t sinks_capacity);
+static bool discover_is_known(AtollaSinkInfo* sinks, size_t sinks_count, const char* hostname, int port);
+
+size_t atolla_discover(const char* hostname, int port, unsigned int timeout_ms, AtollaSinkInfo* sinks, size_t sinks_capacity)
+{
+    assert(port >= 0 && port < 65536);
+
+    if(hostname == NULL)
+    {
+        hostname = broadcast_hostname;
+    }
+
+    UdpSocket sock;
+    if(udp_socket_init(&sock).code != UDP_SOCKET_OK)
+    {
+        return 0;
+    }
+
+    UdpEndpoint target;
+    if(udp_endpoint_resolve(&target, hostname, (unsigned short) port).code != UDP_SOCKET_OK)
+    {
+        udp_socket_free(&sock);
+        return 0;
+    }
+
+    // Whatever the target is, the socket must be allowed to reach it
+    udp_socket_set_broadcast(&sock, true);
+    udp_socket_set_multicast_loopback(&sock, true);
+
+    MsgBuilder builder;
+    msg_builder_init(&builder);
+
+    uint8_t recv_buf[recv_buf_len];
+    size_t sinks_count = 0;
+    const unsigned int start_time = time_now();
+    unsigned int last_discover_time = start_time;
+    bool discovered = false;
+
+    while((time_now() - start_time) < timeout_ms)
+    {
+        if(!discovered || (time_now() - last_discover_time) >= rediscover_interval_ms)
+        {
+            MemBlock* discover_msg = msg_builder_discover(&builder);
+            udp_socket_send_to(&sock, discover_msg->data, discover_msg->size, &target);
+            last_discover_time = time_now();
+            discovered = true;
+        }
+
+        size_t received_len;
+        UdpEndpoint sender;
+        UdpSocketResult result = udp_socket_receive_from(&sock, recv_buf, recv_buf_len, &received_len, &sender);
+
+        if(result.code == UDP_SOCKET_OK)
+        {
+            sinks_count = discover_add_announces(recv_buf, received_len, &sender, sinks, sinks_count, sinks_capacity);
+        }
+        else
+        {
+            time_sleep(1);
+        }
+    }
+
+    msg_builder_free(&builder);
+    udp_socket_free(&sock);
+
+    return sinks_count;
+}
+
+/**
+ * Adds sinks from the ANNOUNCE messages in the packet that are not known yet
+ * and returns the new amount of sinks.
+ */
+static size_t discover_add_announces(void* packet, size_t packet_len, UdpEndpoint* sender, AtollaSinkInfo* sinks, size_t sinks_count, size_t sinks_capacity)
+{
+    MsgIter iter = msg_iter_make(packet, packet_len);
+
+    for(; msg_iter_has_msg(&iter) && sinks_count < sinks_capacity; msg_iter_next(&iter))
+    {
+        // Sinks with older protocol versions may answer with FAIL, ignore those
+        if(msg_iter_type(&iter) != MSG_TYPE_ANNOUNCE || !msg_iter_announce_valid(&iter))
+        {
+            continue;
+        }
+
+        AtollaSinkInfo* sink = &sinks[sinks_count];
+        if(!udp_endpoint_address(sender, sink->hostname, sizeof(sink->hostname)))
+        {
+            continue;
+        }
+
+        sink->port = msg_iter_announce_port(&iter);
+        if(discover_is_known(sinks, sinks_count, sink->hostname, sink->port))
+        {
+            continue;
+        }
+
+        sink->lights_count = msg_iter_announce_lights_count(&iter);
+        sink->min_frame_duration_ms = msg_iter_announce_min_frame_length(&iter);
+
+        MemBlock pixel_formats = msg_iter_announce_pixel_formats(&iter);
+        sink->pixel_formats_count = 0;
+        for(size_t i = 0; i < pixel_formats.size && sink->pixel_formats_count < ATOLLA_SINK_INFO_PIXEL_FORMATS_CAPACITY; ++i)
+        {
+            sink->pixel_formats[sink->pixel_formats_count++] = (AtollaPixelFormat) ((uint8_t*) pixel_formats.data)[i];
+        }
+
+        ++sinks_count;
+    }
+
+    return sinks_count;
+}
+
+static bool discover_is_known(AtollaSinkInfo* sinks, size_t sinks_count, const char* hostname, int port)
+{
+    for(size_t i = 0; i < sinks_count; ++i)
+    {
+        if(sinks[i].port == port && strcmp(sinks[i].hostname, hostname) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,63 @@
+#ifndef ATOLLA_DISCOVER_H
+#define ATOLLA_DISCOVER_H
+
+#include "primitives.h"
+#include "pixel_format.h"
+
+/** Maximum length of a sink address in AtollaSinkInfo, including the terminating zero */
+#define ATOLLA_SINK_INFO_HOSTNAME_LEN 46
+/** Maximum amount of pixel formats remembered per sink in AtollaSinkInfo */
+#define ATOLLA_SINK_INFO_PIXEL_FORMATS_CAPACITY 8
+
+/**
+ * Describes a sink that answered atolla_discover.
+ */
+struct AtollaSinkInfo
+{
+    /**
+     * Numeric IP address of the sink, e.g. "192.168.1.20", which can be used as
+     * sink_hostname in an AtollaSourceSpec.
+     */
+    char hostname[ATOLLA_SINK_INFO_HOSTNAME_LEN];
+    /**
+     * UDP port that the sink listens on, to be used as sink_port.
+     */
+    int port;
+    /**
+     * Amount of lights that the sink was configured with.
+     */
+    int lights_count;
+    /**
+     * Shortest frame duration in milliseconds that the sink accepts when it
+     * is borrowed.
+     */
+    int min_frame_duration_ms;
+    /**
+     * Pixel formats that sources can borrow the sink with, the first
+     * pixel_formats_count entries are valid.
+     */
+    AtollaPixelFormat pixel_formats[ATOLLA_SINK_INFO_PIXEL_FORMATS_CAPACITY];
+    size_t pixel_formats_count;
+};
+typedef struct AtollaSinkInfo AtollaSinkInfo;
+
+/**
+ * Finds sinks in the network by sending a DISCOVER message to the given
+ * hostname and port and collecting the ANNOUNCE messages that come back
+ * within timeout_ms milliseconds.
+ *
+ * If hostname is NULL, DISCOVER is broadcast to 255.255.255.255, reaching all
+ * sinks on the given port in the local IPv4 network. A multicast group reaches
+ * all sinks that were made with that multicast_group, and a single host
+ * reaches just that sink. DISCOVER is repeated a few times during the timeout
+ * in case of packet loss, sinks answering more than once are only reported
+ * once.
+ *
+ * Up to sinks_capacity sinks are written into the given array, in the order
+ * that they answered. Returns the amount of sinks written. The call blocks
+ * for the whole timeout, since there is no telling whether more sinks are
+ * going to answer.
+ */
+size_t atolla_discover(const char* hostname, int port, unsigned int timeout_ms, AtollaSinkInfo* sinks, size_t sinks_capacity);
+
+#endif // ATOLLA_DISCOVER_H
@@ -0,0 +1,38 @@
+#ifndef ATOLLA_EFFECT_H
+#define ATOLLA_EFFECT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "primitives.h"
+
+/**
+ * Procedural effects that sinks render by themselves, so that sources only
+ * send a few bytes when the scene changes instead of a frame every frame
+ * duration.
+ *
+ * Every effect mixes two colors, from and to, with a weight per light. The
+ * numeric values are sent with EFFECT messages and must not change.
+ */
+enum AtollaEffect
+{
+    // Frames that are put are shown again
+    ATOLLA_EFFECT_NONE = 0,
+    // All lights show the from color
+    ATOLLA_EFFECT_SOLID = 1,
+    // Fades from the from color on the first light to the to color on the last
+    ATOLLA_EFFECT_GRADIENT = 2,
+    // A sine wave between both colors, wavelength lights long, that moves one
+    // wavelength towards the last light every period
+    ATOLLA_EFFECT_SINE = 3,
+    // Each light fades to a random mix of both colors every period
+    ATOLLA_EFFECT_NOISE = 4
+};
+typedef enum AtollaEffect AtollaEffect;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ATOLLA_EFFECT_H
@@ -7,5 +7,6 @@
 #define ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE 3
 #define ATOLLA_ERROR_CODE_BAD_MSG 4
 #define ATOLLA_ERROR_CODE_TIMEOUT 5
+#define ATOLLA_ERROR_CODE_UNSUPPORTED_PIXEL_FORMAT 6
 
 #endif // ATOLLA_ERROR_CODES
@@ -0,0 +1,33 @@
+#include "pixel_format.h"
+
+size_t atolla_pixel_format_size(AtollaPixelFormat format)
+{
+    switch(format)
+    {
+        case ATOLLA_PIXEL_FORMAT_RGB8:
+            return 3;
+
+        case ATOLLA_PIXEL_FORMAT_RGBW8:
+            return 4;
+
+        case ATOLLA_PIXEL_FORMAT_RGB16:
+            return 6;
+
+        case ATOLLA_PIXEL_FORMAT_RGB565:
+            return 2;
+
+        default:
+            return 0;
+    }
+}
+
+bool atolla_pixel_format_can_transfer(AtollaPixelFormat output_format, AtollaPixelFormat transfer_format)
+{
+    if(atolla_pixel_format_size(transfer_format) == 0)
+    {
+        return false;
+    }
+
+    return output_format == transfer_format ||
+           (output_format == ATOLLA_PIXEL_FORMAT_RGB8 && transfer_format == ATOLLA_PIXEL_FORMAT_RGB565);
+}
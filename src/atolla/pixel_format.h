@@ -0,0 +1,51 @@
+#ifndef ATOLLA_PIXEL_FORMAT_H
+#define ATOLLA_PIXEL_FORMAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "primitives.h"
+
+/**
+ * Memory layouts of single lights in a frame.
+ *
+ * Multi-byte channels are stored little-endian, like all integers in the
+ * protocol. The numeric values are sent with BORROW messages and must not
+ * change.
+ */
+enum AtollaPixelFormat
+{
+    // Three bytes per light in red, green, blue order, the default
+    ATOLLA_PIXEL_FORMAT_RGB8 = 0,
+    // Four bytes per light in red, green, blue, white order
+    ATOLLA_PIXEL_FORMAT_RGBW8 = 1,
+    // Six bytes per light, one uint16 each for red, green and blue
+    ATOLLA_PIXEL_FORMAT_RGB16 = 2,
+    // Two bytes per light, an uint16 with five bits red in the most significant
+    // bits, six bits green and five bits blue in the least significant bits.
+    // Only used for transfer, sinks expand it to ATOLLA_PIXEL_FORMAT_RGB8.
+    ATOLLA_PIXEL_FORMAT_RGB565 = 3
+};
+typedef enum AtollaPixelFormat AtollaPixelFormat;
+
+/**
+ * Gets the amount of bytes that a single light takes up in the given format,
+ * or zero if the format is unknown.
+ */
+size_t atolla_pixel_format_size(AtollaPixelFormat format);
+
+/**
+ * Checks whether a sink providing frames in the given output format can
+ * accept frames sent in the given transfer format.
+ *
+ * This is the case if both formats are the same or if RGB565 is used to
+ * transfer frames that are output as RGB8.
+ */
+bool atolla_pixel_format_can_transfer(AtollaPixelFormat output_format, AtollaPixelFormat transfer_format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ATOLLA_PIXEL_FORMAT_H
@@ -3,9 +3,15 @@
 
 #include "sink.h"
 #include "error_codes.h"
+#include "../mem/arena.h"
+#include "../mem/blend.h"
 #include "../mem/ring.h"
+#include "../effect/render.h"
 #include "../msg/builder.h"
 #include "../msg/iter.h"
+#include "../msg/reassembler.h"
+#include "../shm/channel.h"
+#include "../stream_socket/stream_socket.h"
 #include "../udp_socket/udp_socket.h"
 #include "../time/now.h"
 #include "../test/assert.h"
@@ -14,20 +20,10 @@
 #include <string.h>
 #include <stdint.h>
 
-#ifndef ATOLLA_SINK_RECV_BUF_LEN
-/**
- * Determines the maximum size of incoming packets.
- * This is enough for about 300 lights.
- *
- */
-#define ATOLLA_SINK_RECV_BUF_LEN 1024
-#endif
-
 static const size_t recv_buf_len = ATOLLA_SINK_RECV_BUF_LEN;
-static const size_t color_channel_count = 3;
-/** Size of the pending_frames ring buffer in frames */
-static const size_t pending_frames_capacity = 128;
-/** After drop_timeout milliseconds of not receiving anything, the source is assumed to have shut down the connection */
+/** Largest buffer length that sources may borrow with if the spec does not say otherwise */
+static const size_t max_buffer_length_default = 128;
+/** After drop_timeout milliseconds of not receiving anything from a source, it is assumed to have shut down the connection */
 static const unsigned int drop_timeout = 1500;
 /** Determines in milliseconds how often the LENT package will be repeatedly sent to the current borrower */
 static const unsigned int lent_send_interval = 500;
@@ -36,8 +32,171 @@ static const unsigned int lent_send_interval = 500;
  * report an unrecoverable error to the sink.
  */
 static const int frame_length_ms_min = 10;
+/** Maximum amount of simultaneous stream connections, further connections are closed right away */
+#define SINK_STREAM_CONNS_CAPACITY 4
+/** Sends to stream connections that cannot take more data right away close the connection */
+static const unsigned int stream_send_timeout_ms = 0;
+/**
+ * Longest poll timeout for sinks that also receive through shared memory or
+ * stream connections, which the descriptor of atolla_sink_poll_fd misses
+ */
+static const int poll_interval_ms = 5;
+/** Optional protocol features that this sink grants when a borrower offers them */
+static const uint8_t sink_capabilities = MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_NACK | MSG_CAPABILITY_PTS | MSG_CAPABILITY_EFFECT;
+/** CLOCK answers slower than this say nothing useful about the offset between the clocks */
+static const uint32_t clock_rtt_max_us = 1000000;
+/** Most frames asked for in one NACK, the most recent ones are asked for first */
+#define SINK_NACK_FRAME_SEQS_MAX 8
+/** Most datagrams handled per update, the rest waits so that floods cannot hold up atolla_sink_get */
+static const size_t recv_budget = 64;
+/**
+ * FAIL and ANNOUNCE replies to UDP senders are limited with token buckets,
+ * which both draw from, so that the sink cannot be used to amplify traffic
+ * towards a spoofed address. Each sender
+ * gets up to fail_burst replies in a row and then one every fail_refill_ms,
+ * all senders together get up to fail_burst_all and then one every
+ * fail_refill_all_ms, so that senders with spoofed addresses cannot make the
+ * sink answer at full speed either.
+ */
+static const unsigned int fail_burst = 4;
+static const unsigned int fail_refill_ms = 100;
+static const unsigned int fail_burst_all = 32;
+static const unsigned int fail_refill_all_ms = 10;
+/** Senders with their own bucket, the one refilled longest ago makes room for new senders */
+#define SINK_FAIL_BUCKETS_CAPACITY 8
+
+/** Most pixel formats listed in ANNOUNCE */
+#define SINK_ANNOUNCE_PIXEL_FORMATS_MAX 8
+/** Bytes for messages sent by sinks in caller storage, which the builder cannot grow */
+static const size_t builder_storage_len = 32;
+// LENT with a clock and FAIL are shorter than both of these
+static_assert(MSG_BUILDER_HEADER_LEN + 6 + SINK_ANNOUNCE_PIXEL_FORMATS_MAX <= builder_storage_len,
+              "builder_storage_len is too small for ANNOUNCE");
+static_assert(MSG_BUILDER_HEADER_LEN + 2 * SINK_NACK_FRAME_SEQS_MAX <= builder_storage_len,
+              "builder_storage_len is too small for NACK");
 
 static const unsigned int NULL_TIME = ~0;
+static const uint32_t NULL_TIME_US = ~0u;
+/** Bytes of the largest light in an output format, RGB16 */
+static const size_t effect_color_capacity = 6;
+
+enum SinkPeerTransport
+{
+    SINK_PEER_UDP,
+    // The source attached to the shared-memory channel
+    SINK_PEER_LOCAL,
+    SINK_PEER_STREAM
+};
+typedef enum SinkPeerTransport SinkPeerTransport;
+
+/**
+ * Identifies a source that sent a message, so responses go back the same way
+ * and the borrower can be recognized.
+ */
+struct SinkPeer
+{
+    SinkPeerTransport transport;
+    // Address of UDP peers, and its key for recognizing the borrower quickly
+    UdpEndpoint endpoint;
+    UdpEndpointKey endpoint_key;
+    // Connection of stream peers, the ID tells apart connections that reuse the slot
+    size_t stream_conn_idx;
+    uint32_t stream_conn_id;
+};
+typedef struct SinkPeer SinkPeer;
+
+struct SinkStreamConn
+{
+    bool open;
+    uint32_t id;
+    StreamSocket socket;
+    MsgReassembler reassembler;
+};
+typedef struct SinkStreamConn SinkStreamConn;
+
+/**
+ * Token bucket limiting the FAIL and ANNOUNCE replies to one UDP sender, or
+ * to all of them.
+ */
+struct SinkFailBucket
+{
+    bool used;
+    UdpEndpointKey sender;
+    unsigned int tokens;
+    // Milliseconds on time_now when tokens were last added
+    unsigned int refill_time;
+};
+typedef struct SinkFailBucket SinkFailBucket;
+
+/**
+ * A source that currently borrows the sink, with its own buffered frames and
+ * its own clock for playing them back.
+ */
+struct SinkLayer
+{
+    bool active;
+    SinkPeer borrower;
+
+    // Sent with BORROW, for merging with the other layers
+    uint8_t priority;
+    uint8_t opacity;
+    // Frames that the borrower buffers ahead, gaps beyond that are not filled in
+    uint8_t buffer_length;
+    // Grows with each new borrower, so later borrowers compare greater
+    uint32_t borrow_seq;
+
+    unsigned int frame_duration_ms;
+    // Format of incoming frames, negotiated when borrowing
+    AtollaPixelFormat transfer_format;
+
+    MemBlock current_frame;
+    // Sized for the buffer length of the borrower, empty while inactive
+    MemRing pending_frames;
+
+    // Microseconds when the current frame started showing, on the low bits of time_now_us
+    uint32_t time_origin_us;
+    int last_enqueued_frame_idx;
+    // Capabilities granted with LENT, with ENQUEUE16 frames count last_seq instead
+    uint8_t capabilities;
+    // Unset until the first ENQUEUE16 after BORROW, which sets the baseline
+    bool has_last_seq;
+    uint16_t last_seq;
+    // Bit for each sequence number modulo 256 whose frame in the ring is only a
+    // copy standing in for a lost one, so that a retransmission can replace it
+    uint8_t concealed[32];
+
+    // With MSG_CAPABILITY_PTS, the sink clock minus the source clock in
+    // microseconds, from the CLOCK answer with the shortest round trip
+    bool clock_valid;
+    uint32_t clock_offset_us;
+    uint32_t clock_rtt_us;
+    // Set once a frame with a presentation time arrived, the first frame is
+    // then held back until next_due_us instead of showing right away
+    bool stamped;
+    uint32_t next_due_us;
+
+    // With MSG_CAPABILITY_EFFECT, the effect rendered instead of the frames,
+    // until the borrower enqueues a frame again
+    AtollaEffect effect;
+    uint16_t effect_wavelength;
+    uint16_t effect_period_ms;
+    unsigned long long effect_start_us;
+    // Expanded to the output format
+    uint8_t effect_from[effect_color_capacity];
+    uint8_t effect_to[effect_color_capacity];
+
+    // With connect_borrowers, a socket connected to a UDP borrower on the
+    // port of the sink. Datagrams that arrived before it was connected may
+    // come from anyone, so senders are only taken for granted once it was
+    // empty for the first time.
+    bool has_socket;
+    bool socket_settled;
+    UdpSocket socket;
+
+    unsigned int last_recv_time;
+    unsigned int last_send_lent_time;
+};
+typedef struct SinkLayer SinkLayer;
 
 struct AtollaSinkPrivate
 {
@@ -45,70 +204,226 @@ struct AtollaSinkPrivate
     const char* error_msg;
 
     UdpSocket socket;
-    UdpEndpoint borrower_endpoint;
 
+    // One layer per source that may borrow the sink at the same time
+    SinkLayer* layers;
+    size_t layers_count;
+    uint32_t next_borrow_seq;
+    AtollaSinkBlendMode blend_mode;
+    AtollaSinkConcealment concealment;
+    // Give UDP borrowers sockets of their own, the socket of the sink shares its port then
+    bool connect_borrowers;
+    // Tuning for the socket of the sink and the sockets of borrowers, zero where not requested
+    UdpSocketOptions socket_options;
+    // Borrows asking for more frames than this are refused
+    size_t max_buffer_length;
+    // Memory is in storage of the caller, all buffers are allocated up front
+    // and nothing is freed
+    bool in_storage;
+
+    // Shared-memory channel for sources on the same host, if the spec named one
+    ShmChannel channel;
+    bool has_channel;
+
+    // Listeners for stream connections, if the spec asked for them, and the accepted connections
+    StreamSocket tcp_listener;
+    StreamSocket unix_listener;
+    SinkStreamConn stream_conns[SINK_STREAM_CONNS_CAPACITY];
+    uint32_t next_stream_conn_id;
+
+    // UDP port from the spec, announced to sources that discover sinks
+    unsigned short port;
     unsigned int lights_count;
-    unsigned int frame_duration_ms;
+    // Format of frames in the rings and returned by atolla_sink_get
+    AtollaPixelFormat pixel_format;
 
     MsgBuilder builder;
 
+    SinkFailBucket fail_buckets[SINK_FAIL_BUCKETS_CAPACITY];
+    SinkFailBucket fail_bucket_all;
+    AtollaSinkStats stats;
+    // Set when the last update left datagrams in the socket
+    bool recv_backlog;
+
     uint8_t recv_buf[ATOLLA_SINK_RECV_BUF_LEN];
-    MemBlock current_frame;
     // Holds preliminary data when assembling frame from msg
     MemBlock received_frame;
-    MemRing pending_frames;
-
-    unsigned int time_origin;
-    int last_enqueued_frame_idx;
-
-    unsigned int last_recv_time;
-    unsigned int last_send_lent_time;
+    // Holds the result of merging the current frames of several layers
+    MemBlock merged_frame;
 };
 typedef struct AtollaSinkPrivate AtollaSinkPrivate;
 
-static AtollaSinkPrivate* sink_private_make(const AtollaSinkSpec* spec);
-static void sink_iterate_recv_buf(AtollaSinkPrivate* sink, size_t received_bytes, UdpEndpoint* sender);
-static void sink_handle_borrow(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, size_t buffer_length, UdpEndpoint* sender);
-static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t frame_idx, MemBlock frame, UdpEndpoint* sender);
-static void sink_enqueue(AtollaSinkPrivate* sink, MemBlock frame);
-static void sink_send_lent(AtollaSinkPrivate* sink);
-static void sink_send_fail(AtollaSinkPrivate* sink, uint16_t offending_msg_id, uint8_t error_code);
-static void sink_send_fail_to(AtollaSinkPrivate* sink, uint16_t offending_msg_id, uint8_t error_code, UdpEndpoint* to);
+static_assert(MEM_ARENA_SIZE(sizeof(AtollaSinkPrivate)) + MEM_ARENA_SIZE(builder_storage_len) + MEM_ARENA_ALIGN <= ATOLLA_SINK_STORAGE_BASE_SIZE,
+              "ATOLLA_SINK_STORAGE_BASE_SIZE is too small for the sink");
+static_assert(MEM_ARENA_SIZE(sizeof(SinkLayer)) <= ATOLLA_SINK_STORAGE_LAYER_SIZE,
+              "ATOLLA_SINK_STORAGE_LAYER_SIZE is too small for a layer");
+static_assert(ATOLLA_SINK_STORAGE_ALIGNED(1) == MEM_ARENA_SIZE(1),
+              "Storage size macros must align like the arena");
+
+static AtollaSinkPrivate* sink_private_make(const AtollaSinkSpec* spec, MemArena* arena);
+static void* sink_alloc(MemArena* arena, size_t size);
+static void sink_open(AtollaSinkPrivate* sink, const AtollaSinkSpec* spec);
+static void sink_iterate_recv_buf(AtollaSinkPrivate* sink, void* packet, size_t packet_len, SinkPeer* sender);
+static void sink_handle_borrow(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, size_t buffer_length, AtollaPixelFormat transfer_format, uint8_t priority, uint8_t opacity, uint8_t capabilities, SinkPeer* sender);
+static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t frame_idx, MemBlock frame, SinkPeer* sender);
+static void sink_handle_enqueue16(AtollaSinkPrivate* sink, uint16_t msg_id, uint16_t frame_seq, MemBlock frame, const uint32_t* presentation_time_us, SinkPeer* sender);
+static void sink_handle_clock(AtollaSinkPrivate* sink, uint32_t sink_time_us, uint32_t source_time_us, SinkPeer* sender);
+static void sink_handle_effect(AtollaSinkPrivate* sink, uint16_t msg_id, AtollaEffect effect, uint16_t wavelength, uint16_t period_ms, MemBlock colors, SinkPeer* sender);
+static void sink_layer_schedule(AtollaSinkPrivate* sink, SinkLayer* layer, uint32_t presentation_time_us);
+static SinkLayer* sink_accept_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, MemBlock frame, SinkPeer* sender);
+static void sink_enqueue_after_gap(AtollaSinkPrivate* sink, SinkLayer* layer, size_t diff, size_t count);
+static void sink_expand_frame(AtollaSinkPrivate* sink, SinkLayer* layer, MemBlock frame);
+static void sink_replace_concealed(AtollaSinkPrivate* sink, SinkLayer* layer, uint16_t frame_seq, MemBlock frame);
+static void sink_send_nack(AtollaSinkPrivate* sink, SinkLayer* layer, uint16_t frame_seq, size_t missing_count);
+static bool sink_layer_concealed(SinkLayer* layer, uint16_t frame_seq);
+static void sink_layer_set_concealed(SinkLayer* layer, uint16_t frame_seq, bool concealed);
+static void sink_send_lent(AtollaSinkPrivate* sink, SinkLayer* layer);
+static void sink_send_announce_to(AtollaSinkPrivate* sink, SinkPeer* to);
+static void sink_send_fail_to(AtollaSinkPrivate* sink, uint16_t offending_msg_id, uint8_t error_code, SinkPeer* to);
+static void sink_send_bad_msg_to(AtollaSinkPrivate* sink, uint16_t offending_msg_id, SinkPeer* to);
+static bool sink_reply_allowed(AtollaSinkPrivate* sink, const UdpEndpointKey* to);
+static bool sink_fail_bucket_refill(SinkFailBucket* bucket, unsigned int now, unsigned int burst, unsigned int refill_ms);
+static void sink_send_to(AtollaSinkPrivate* sink, MemBlock* msg, SinkPeer* to);
+static bool sink_peer_equal(SinkPeer* a, SinkPeer* b);
+static SinkLayer* sink_find_layer(AtollaSinkPrivate* sink, SinkPeer* borrower);
+static SinkLayer* sink_find_free_layer(AtollaSinkPrivate* sink);
+static bool sink_layer_advance(AtollaSinkPrivate* sink, SinkLayer* layer);
+static int sink_layer_poll_timeout(SinkLayer* layer);
+static void sink_layer_render_effect(AtollaSinkPrivate* sink, SinkLayer* layer);
+static void sink_layer_end_effect(SinkLayer* layer);
+static bool sink_layer_reserve(AtollaSinkPrivate* sink, SinkLayer* layer, size_t capacity);
+static bool sink_layer_shown(SinkLayer* layer);
+static bool sink_layer_below(SinkLayer* a, SinkLayer* b);
+static void sink_merge(AtollaSinkPrivate* sink, SinkLayer* top);
 static void sink_update(AtollaSinkPrivate* sink);
 static void sink_receive(AtollaSinkPrivate* sink);
+static bool sink_receive_udp(AtollaSinkPrivate* sink, size_t budget);
+static bool sink_receive_udp_socket(AtollaSinkPrivate* sink, UdpSocket* socket, SinkLayer* layer, size_t budget);
+static void sink_layer_connect(AtollaSinkPrivate* sink, SinkLayer* layer);
+static bool sink_receive_local(AtollaSinkPrivate* sink);
+static bool sink_receive_stream(AtollaSinkPrivate* sink);
+static void sink_accept_stream_conn(AtollaSinkPrivate* sink, StreamSocket* listener);
+static void sink_close_stream_conn(AtollaSinkPrivate* sink, size_t conn_idx);
 static void sink_send(AtollaSinkPrivate* sink);
-static void sink_drop_borrow(AtollaSinkPrivate* sink);
+static void sink_drop_layer(AtollaSinkPrivate* sink, SinkLayer* layer);
 static void sink_panic(AtollaSinkPrivate* sink, const char* error_msg);
 
 static void fill_with_pattern(void* target, size_t target_len, void* pattern, size_t pattern_len);
+static void expand_rgb565(uint8_t* target, const uint8_t* source, size_t lights_count);
 static int bounded_diff(int from, int to, int cap);
 
 
 AtollaSink atolla_sink_make(const AtollaSinkSpec* spec)
 {
-    AtollaSinkPrivate* sink = sink_private_make(spec);
+    AtollaSinkPrivate* sink = sink_private_make(spec, NULL);
+    sink_open(sink, spec);
+
+    AtollaSink sink_handle = { sink };
+    return sink_handle;
+}
+
+AtollaSink atolla_sink_init_in(const AtollaSinkSpec* spec, void* storage, size_t storage_size)
+{
+    assert(spec->max_buffer_length > 0);
+    assert(spec->tcp_port == 0 && spec->unix_path == NULL);
+    assert(storage_size >= atolla_sink_storage_size(spec));
+
+    MemArena arena = mem_arena_make(storage, storage_size);
+    AtollaSinkPrivate* sink = sink_private_make(spec, &arena);
+    sink_open(sink, spec);
+
+    AtollaSink sink_handle = { sink };
+    return sink_handle;
+}
+
+size_t atolla_sink_storage_size(const AtollaSinkSpec* spec)
+{
+    const size_t sources = (spec->max_sources == 0) ? 1 : (size_t) spec->max_sources;
+    const size_t frames = (spec->max_buffer_length == 0) ? max_buffer_length_default : (size_t) spec->max_buffer_length;
+    const size_t pixel_size = atolla_pixel_format_size(spec->pixel_format);
+
+    return ATOLLA_SINK_LAYERED_STORAGE_SIZE((size_t) spec->lights_count, frames, pixel_size, sources);
+}
 
-    UdpSocketResult result = udp_socket_init_on_port(&sink->socket, (unsigned short) spec->port);
+/**
+ * Opens the sockets and channels requested in the spec, or enters the error
+ * state if that fails.
+ */
+static void sink_open(AtollaSinkPrivate* sink, const AtollaSinkSpec* spec)
+{
+    UdpSocketResult result;
+    if(sink->connect_borrowers)
+    {
+        result = udp_socket_init_shared(&sink->socket, (unsigned short) spec->port);
+        if(result.code == UDP_SOCKET_ERR_SHARE_PORT_FAILED)
+        {
+            // Works all the same, only without the help of the kernel
+            sink->connect_borrowers = false;
+            result = udp_socket_init_on_port(&sink->socket, (unsigned short) spec->port);
+        }
+    }
+    else
+    {
+        result = udp_socket_init_on_port(&sink->socket, (unsigned short) spec->port);
+    }
     if(result.code != UDP_SOCKET_OK)
     {
         sink_panic(sink, "Failed to bind source to port specified in spec.");
     }
+    else if(spec->multicast_group != NULL &&
+            udp_socket_join_multicast(&sink->socket, spec->multicast_group).code != UDP_SOCKET_OK)
+    {
+        sink_panic(sink, "Failed to join the multicast group specified in spec.");
+    }
+
+    if(result.code == UDP_SOCKET_OK)
+    {
+        // Best effort, atolla_sink_socket_options reports what was applied
+        udp_socket_set_options(&sink->socket, &sink->socket_options);
+    }
 
-    msg_builder_init(&sink->builder);
+    if(spec->shm_name != NULL)
+    {
+        sink->has_channel = shm_channel_create(&sink->channel, spec->shm_name);
+        if(!sink->has_channel)
+        {
+            sink_panic(sink, "Failed to create the shared-memory segment specified in spec, it might be in use by another sink.");
+        }
+    }
 
-    AtollaSink sink_handle = { sink };
-    return sink_handle;
+    if(spec->tcp_port != 0 && !stream_socket_listen_tcp(&sink->tcp_listener, (unsigned short) spec->tcp_port))
+    {
+        sink_panic(sink, "Failed to listen for TCP connections on the port specified in spec.");
+    }
+
+    if(spec->unix_path != NULL && !stream_socket_listen_unix(&sink->unix_listener, spec->unix_path))
+    {
+        sink_panic(sink, "Failed to listen for connections on the Unix socket path specified in spec.");
+    }
 }
 
-static AtollaSinkPrivate* sink_private_make(const AtollaSinkSpec* spec)
+/**
+ * Allocates the sink and its buffers from the arena, or from the heap if the
+ * arena is NULL.
+ */
+static AtollaSinkPrivate* sink_private_make(const AtollaSinkSpec* spec, MemArena* arena)
 {
     assert(spec->port >= 0 && spec->port < 65536);
+    assert(spec->tcp_port >= 0 && spec->tcp_port < 65536);
     assert(spec->lights_count >= 1);
+    // RGB565 is only used for transfer and expanded to RGB8 by the sink
+    assert(spec->pixel_format != ATOLLA_PIXEL_FORMAT_RGB565);
+    assert(spec->max_sources >= 0);
+
+    assert(spec->max_buffer_length >= 0 && spec->max_buffer_length < 256);
+
+    const size_t pixel_size = atolla_pixel_format_size(spec->pixel_format);
+    assert(pixel_size > 0);
     // The recv buffer must be large enough to hold messages that overwrite
     // all of the lights with new colors
-    assert((spec->lights_count * color_channel_count + 10) < recv_buf_len);
+    assert((spec->lights_count * pixel_size + 10) < recv_buf_len);
 
-    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) malloc(sizeof(AtollaSinkPrivate));
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_alloc(arena, sizeof(AtollaSinkPrivate));
     assert(sink != NULL);
 
     // Initialize everything to zero
@@ -116,29 +431,141 @@ static AtollaSinkPrivate* sink_private_make(const AtollaSinkSpec* spec)
 
     // Except these fields, which are pre-filled
     sink->state = ATOLLA_SINK_STATE_OPEN;
+    sink->port = (unsigned short) spec->port;
     sink->lights_count = spec->lights_count;
-    sink->current_frame = mem_block_alloc(spec->lights_count * color_channel_count);
-    sink->received_frame = mem_block_alloc(spec->lights_count * color_channel_count);
-    sink->pending_frames = mem_ring_alloc(spec->lights_count * color_channel_count * pending_frames_capacity);
+    sink->pixel_format = spec->pixel_format;
+    sink->blend_mode = spec->blend_mode;
+    sink->concealment = spec->concealment;
+    // Borrowers need the port of the sink to connect from, and joining a group is per socket
+    sink->connect_borrowers = spec->connect_borrowers && spec->port != 0 && spec->multicast_group == NULL;
+    sink->max_buffer_length = (spec->max_buffer_length == 0) ? max_buffer_length_default : (size_t) spec->max_buffer_length;
+    sink->in_storage = arena != NULL;
+    if(spec->socket_options != NULL)
+    {
+        sink->socket_options.recv_buf_len = spec->socket_options->recv_buf_len;
+        sink->socket_options.send_buf_len = spec->socket_options->send_buf_len;
+        sink->socket_options.busy_poll_us = spec->socket_options->busy_poll_us;
+        sink->socket_options.dscp = spec->socket_options->dscp;
+        sink->socket_options.priority = spec->socket_options->priority;
+    }
+
+    const size_t frame_size = spec->lights_count * pixel_size;
+    sink->received_frame = mem_block_make(sink_alloc(arena, frame_size), frame_size);
+    sink->merged_frame = mem_block_make(sink_alloc(arena, frame_size), frame_size);
+
+    sink->layers_count = (spec->max_sources == 0) ? 1 : (size_t) spec->max_sources;
+    sink->layers = (SinkLayer*) sink_alloc(arena, sink->layers_count * sizeof(SinkLayer));
+    memset(sink->layers, 0, sink->layers_count * sizeof(SinkLayer));
+    for(size_t i = 0; i < sink->layers_count; ++i)
+    {
+        sink->layers[i].current_frame = mem_block_make(sink_alloc(arena, frame_size), frame_size);
+
+        if(sink->in_storage)
+        {
+            // Rings for the longest buffer up front, so borrowing never allocates
+            const size_t ring_size = (sink->max_buffer_length + 1) * frame_size;
+            sink->layers[i].pending_frames = mem_ring_make(sink_alloc(arena, ring_size), ring_size);
+        }
+    }
+
+    if(sink->in_storage)
+    {
+        msg_builder_init_in(&sink->builder, sink_alloc(arena, builder_storage_len), builder_storage_len);
+    }
+    else
+    {
+        msg_builder_init(&sink->builder);
+    }
+    sink->tcp_listener.handle = -1;
+    sink->unix_listener.handle = -1;
 
     return sink;
 }
 
-void atolla_sink_free(AtollaSink sink_handle)
+void atolla_sink_stats(AtollaSink sink_handle, AtollaSinkStats* stats)
 {
     AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
+    *stats = sink->stats;
+}
 
-    msg_builder_free(&sink->builder);
+bool atolla_sink_socket_options(AtollaSink sink_handle, AtollaSocketOptions* effective)
+{
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
+    if(sink->state == ATOLLA_SINK_STATE_ERROR)
+    {
+        return false;
+    }
+
+    UdpSocketOptions options;
+    udp_socket_get_options(&sink->socket, &options);
+    effective->recv_buf_len = options.recv_buf_len;
+    effective->send_buf_len = options.send_buf_len;
+    effective->busy_poll_us = options.busy_poll_us;
+    effective->dscp = options.dscp;
+    effective->priority = options.priority;
+    return true;
+}
+
+void atolla_sink_free(AtollaSink sink_handle)
+{
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
 
     udp_socket_free(&sink->socket);
+    for(size_t i = 0; i < sink->layers_count; ++i)
+    {
+        if(sink->layers[i].has_socket)
+        {
+            udp_socket_free(&sink->layers[i].socket);
+        }
+    }
+
+    if(sink->has_channel)
+    {
+        shm_channel_close(&sink->channel);
+    }
+
+    for(size_t i = 0; i < SINK_STREAM_CONNS_CAPACITY; ++i)
+    {
+        if(sink->stream_conns[i].open)
+        {
+            sink_close_stream_conn(sink, i);
+        }
+        if(sink->stream_conns[i].reassembler.buf.data != NULL)
+        {
+            msg_reassembler_free(&sink->stream_conns[i].reassembler);
+        }
+    }
+    stream_socket_close(&sink->tcp_listener);
+    stream_socket_close(&sink->unix_listener);
+
+    if(sink->in_storage)
+    {
+        // Everything else is in the storage of the caller
+        return;
+    }
+
+    msg_builder_free(&sink->builder);
 
-    mem_block_free(&sink->current_frame);
+    for(size_t i = 0; i < sink->layers_count; ++i)
+    {
+        mem_block_free(&sink->layers[i].current_frame);
+        mem_ring_free(&sink->layers[i].pending_frames);
+    }
+    free(sink->layers);
     mem_block_free(&sink->received_frame);
-    mem_ring_free(&sink->pending_frames);
+    mem_block_free(&sink->merged_frame);
 
     free(sink);
 }
 
+static void* sink_alloc(MemArena* arena, size_t size)
+{
+    void* allocation = (arena == NULL) ? malloc(size) : mem_arena_alloc(arena, size);
+    // The storage size was checked beforehand, so only malloc can fail
+    assert(allocation != NULL);
+    return allocation;
+}
+
 AtollaSinkState atolla_sink_state(AtollaSink sink_handle)
 {
     AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
@@ -161,247 +588,1502 @@ bool atolla_sink_get(AtollaSink sink_handle, void* frame, size_t frame_len)
 {
     AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
 
-    bool lent = sink->state == ATOLLA_SINK_STATE_LENT;
+    if(sink->state != ATOLLA_SINK_STATE_LENT)
+    {
+        return false;
+    }
 
-    if(lent)
+    SinkLayer* top = NULL;
+    size_t shown_count = 0;
+    for(size_t i = 0; i < sink->layers_count; ++i)
     {
-        if(sink->time_origin == NULL_TIME)
-        {
-            // Set origin on first dequeue
-            bool ok = mem_ring_dequeue(&sink->pending_frames, sink->current_frame.data, sink->current_frame.capacity);
-            if(ok) {
-                sink->time_origin = time_now();
-            } else {
-                // nothing available yet
-                return false;
-            }
-        }
-        else
+        SinkLayer* layer = &sink->layers[i];
+        if(layer->active && sink_layer_advance(sink, layer))
         {
-            unsigned int now = time_now();
-            while((now - sink->time_origin) > sink->frame_duration_ms) {
-                bool ok = mem_ring_dequeue(&sink->pending_frames, sink->current_frame.data, sink->current_frame.capacity);
-                if(ok) {
-                    sink->time_origin += sink->frame_duration_ms;
-                } else {
-                    // TODO Experiencing lag, maybe disconnect at this point, not when trying to receive
-                    //      this way the unfinished buffer can finish showing
-                    break;
-                }
+            ++shown_count;
+            if(top == NULL || sink_layer_below(top, layer))
+            {
+                top = layer;
             }
         }
-
-        fill_with_pattern(frame, frame_len, sink->current_frame.data, sink->current_frame.capacity);
     }
 
-    return lent;
-}
+    if(shown_count == 0)
+    {
+        // nothing available yet
+        return false;
+    }
+    else if(shown_count == 1 || sink->blend_mode == ATOLLA_SINK_BLEND_LTP)
+    {
+        // Nothing to merge, the top layer is shown alone
+        fill_with_pattern(frame, frame_len, top->current_frame.data, top->current_frame.capacity);
+    }
+    else
+    {
+        sink_merge(sink, top);
+        fill_with_pattern(frame, frame_len, sink->merged_frame.data, sink->merged_frame.capacity);
+    }
 
-static void sink_update(AtollaSinkPrivate* sink)
-{
-    sink_receive(sink);
-    sink_send(sink);
+    return true;
 }
 
-static void sink_receive(AtollaSinkPrivate* sink)
+int atolla_sink_poll_fd(AtollaSink sink_handle)
 {
-    UdpSocketResult result;
-
-    const int max_receives = 1;
-
-    // Try receiving until would block or received max_receives times
-    for(int i = 0; i < max_receives; ++i) {
-        UdpEndpoint sender;
-        size_t received_bytes = 0;
-        result = udp_socket_receive_from(
-            &sink->socket,
-            sink->recv_buf, recv_buf_len,
-            &received_bytes,
-            &sender
-        );
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
 
-        if(result.code == UDP_SOCKET_OK)
-        {
-            // If another packet available, iterate contained messages
-            sink_iterate_recv_buf(sink, received_bytes, &sender);
-            sink->last_recv_time = time_now();
-        }
-        else
-        {
-            // drop connections if have not received packets in a while
-            if(sink->state == ATOLLA_SINK_STATE_LENT && (time_now() - sink->last_recv_time) > drop_timeout)
-            {
-                sink_send_fail(sink, 0, ATOLLA_ERROR_CODE_TIMEOUT);
-                sink_drop_borrow(sink);
-            }
-            return;
-        }
+    if(sink->state == ATOLLA_SINK_STATE_ERROR || sink->has_channel || sink->connect_borrowers ||
+       sink->tcp_listener.handle != -1 || sink->unix_listener.handle != -1)
+    {
+        return -1;
     }
+
+    return udp_socket_poll_handle(&sink->socket);
 }
 
-static void sink_iterate_recv_buf(AtollaSinkPrivate* sink, size_t received_bytes, UdpEndpoint* sender)
+int atolla_sink_poll_timeout(AtollaSink sink_handle)
 {
-    MsgIter iter = msg_iter_make(sink->recv_buf, received_bytes);
+    AtollaSinkPrivate* sink = (AtollaSinkPrivate*) sink_handle.internal;
 
-    for(; msg_iter_has_msg(&iter); msg_iter_next(&iter))
+    sink_update(sink);
+
+    if(sink->state == ATOLLA_SINK_STATE_ERROR)
     {
-        MsgType type = msg_iter_type(&iter);
-        uint16_t msg_id = msg_iter_msg_id(&iter);
+        return -1;
+    }
+    else if(sink->recv_backlog)
+    {
+        // The descriptor from atolla_sink_poll_fd is still readable, come
+        // back right after showing the next frame
+        return 0;
+    }
 
-        switch(type)
+    int timeout_ms = -1;
+    if(sink->state == ATOLLA_SINK_STATE_LENT)
+    {
+        unsigned int now = time_now();
+        for(size_t i = 0; i < sink->layers_count; ++i)
         {
-            case MSG_TYPE_BORROW:
+            SinkLayer* layer = &sink->layers[i];
+            if(!layer->active)
             {
-                uint8_t frame_len = msg_iter_borrow_frame_length(&iter);
-                uint8_t buffer_len = msg_iter_borrow_buffer_length(&iter);
-                sink_handle_borrow(sink, msg_id, frame_len, buffer_len, sender);
-                break;
+                continue;
             }
 
-            case MSG_TYPE_ENQUEUE:
-            {
-                uint8_t frame_idx = msg_iter_enqueue_frame_idx(&iter);
-                MemBlock frame = msg_iter_enqueue_frame(&iter);
-                sink_handle_enqueue(sink, msg_id, frame_idx, frame, sender);
-                break;
-            }
+            // LENT and the drop timeout are checked with a strictly greater comparison
+            int lent_ms = (int) (layer->last_send_lent_time + lent_send_interval + 1 - now);
+            int drop_ms = (int) (layer->last_recv_time + drop_timeout + 1 - now);
+            int frame_ms = sink_layer_poll_timeout(layer);
 
-            default:
-            {
-                sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_BAD_MSG, sender);
-                break;
-            }
+            int layer_ms = (lent_ms < drop_ms) ? lent_ms : drop_ms;
+            layer_ms = (frame_ms >= 0 && frame_ms < layer_ms) ? frame_ms : layer_ms;
+            layer_ms = (layer_ms < 0) ? 0 : layer_ms;
+            timeout_ms = (timeout_ms < 0 || layer_ms < timeout_ms) ? layer_ms : timeout_ms;
         }
     }
+
+    if(atolla_sink_poll_fd(sink_handle) == -1 && (timeout_ms < 0 || timeout_ms > poll_interval_ms))
+    {
+        timeout_ms = poll_interval_ms;
+    }
+
+    return timeout_ms;
 }
 
-static void sink_handle_borrow(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, size_t buffer_length, UdpEndpoint* sender)
+/**
+ * Milliseconds until atolla_sink_get shows something else for the layer, or
+ * -1 if that depends on frames that have not arrived yet.
+ */
+static int sink_layer_poll_timeout(SinkLayer* layer)
 {
-    if(sink->state == ATOLLA_SINK_STATE_OPEN ||
-       (sink->state == ATOLLA_SINK_STATE_LENT && udp_endpoint_equal(sender, &sink->borrower_endpoint))
-      )
+    uint32_t now = (uint32_t) time_now_us();
+    uint32_t frame_duration_us = layer->frame_duration_ms * 1000;
+
+    if(layer->effect != ATOLLA_EFFECT_NONE)
     {
-        size_t required_frame_buf_size = buffer_length * (sink->lights_count * color_channel_count);
+        // Effects are rendered anew at the frame rate of the borrower
+        uint32_t since_frame_us = (uint32_t) (time_now_us() - layer->effect_start_us) % frame_duration_us;
+        return (int) ((frame_duration_us - since_frame_us + 999) / 1000);
+    }
 
-        if(required_frame_buf_size > sink->pending_frames.buf.capacity)
-        {
-            sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_REQUESTED_BUFFER_TOO_LARGE, sender);
-            if(sink->state == ATOLLA_SINK_STATE_LENT) { sink_drop_borrow(sink); }
-        }
-        else if(frame_length_ms < frame_length_ms_min)
-        {
-            sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_REQUESTED_FRAME_DURATION_TOO_SHORT, sender);
-            if(sink->state == ATOLLA_SINK_STATE_LENT) { sink_drop_borrow(sink); }
-        }
-        else
-        {
-            sink->borrower_endpoint = *sender;
-            sink->frame_duration_ms = frame_length_ms;
-            sink->time_origin = NULL_TIME;
-            sink->last_enqueued_frame_idx = NULL_TIME;
-            sink->last_recv_time = NULL_TIME;
-            sink->state = ATOLLA_SINK_STATE_LENT;
+    if(mem_ring_is_empty(&layer->pending_frames))
+    {
+        return -1;
+    }
 
-            sink_send_lent(sink);
-        }
+    uint32_t due_us;
+    if(layer->time_origin_us != NULL_TIME_US)
+    {
+        due_us = layer->time_origin_us + frame_duration_us + 1;
     }
-    else if(sink->state == ATOLLA_SINK_STATE_LENT)
+    else if(layer->stamped)
     {
-        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE, sender);
+        due_us = layer->next_due_us;
     }
     else
     {
-        return; // In error state, do not bother to respond
+        return 0;
     }
+
+    int32_t wait_us = (int32_t) (due_us - now);
+    return (wait_us <= 0) ? 0 : (int) ((wait_us + 999) / 1000);
 }
 
-static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t frame_idx, MemBlock frame, UdpEndpoint* sender)
+/**
+ * Moves the current frame of the layer forward to the instant in time upon
+ * calling the function. Returns false if the layer has no frame to show yet.
+ */
+static bool sink_layer_advance(AtollaSinkPrivate* sink, SinkLayer* layer)
 {
-    if(sink->state == ATOLLA_SINK_STATE_ERROR)
+    uint32_t now = (uint32_t) time_now_us();
+    uint32_t frame_duration_us = layer->frame_duration_ms * 1000;
+
+    if(layer->effect != ATOLLA_EFFECT_NONE)
     {
-        return; // In error state, do not bother to respond
+        sink_layer_render_effect(sink, layer);
+        return true;
     }
-    else if(sink->state == ATOLLA_SINK_STATE_OPEN)
+
+    if(layer->time_origin_us == NULL_TIME_US)
     {
-        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_NOT_BORROWED, sender);
+        if(layer->stamped && (int32_t) (now - layer->next_due_us) < 0)
+        {
+            // Frames with presentation times wait for their time to come
+            return false;
+        }
+
+        // Set origin on first dequeue
+        bool ok = mem_ring_dequeue(&layer->pending_frames, layer->current_frame.data, layer->current_frame.capacity);
+        if(ok) {
+            layer->time_origin_us = layer->stamped ? layer->next_due_us : now;
+        } else {
+            // nothing available yet
+            return false;
+        }
     }
     else
     {
-        if(frame.size < 3)
-        {
-            // Minimum enqueue length is 3, drop connection after illegal message
-            sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_BAD_MSG, sender);
-            sink_drop_borrow(sink);
+        while((int32_t) (now - layer->time_origin_us) > (int32_t) frame_duration_us) {
+            bool ok = mem_ring_dequeue(&layer->pending_frames, layer->current_frame.data, layer->current_frame.capacity);
+            if(ok) {
+                layer->time_origin_us += frame_duration_us;
+            } else {
+                // TODO Experiencing lag, maybe disconnect at this point, not when trying to receive
+                //      this way the unfinished buffer can finish showing
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Stops rendering the effect of the layer, if any. Playback of frames starts
+ * over like after borrowing, with the next frame that is enqueued.
+ */
+static void sink_layer_end_effect(SinkLayer* layer)
+{
+    if(layer->effect != ATOLLA_EFFECT_NONE)
+    {
+        layer->effect = ATOLLA_EFFECT_NONE;
+        layer->time_origin_us = NULL_TIME_US;
+    }
+}
+
+/**
+ * Renders the effect of the layer for the current time into its current frame.
+ */
+static void sink_layer_render_effect(AtollaSinkPrivate* sink, SinkLayer* layer)
+{
+    uint32_t elapsed_ms = (uint32_t) ((time_now_us() - layer->effect_start_us) / 1000);
+
+    // No frame is being received while rendering, so its buffer holds the weights
+    uint8_t* weights = (uint8_t*) sink->received_frame.data;
+    effect_render_weights(layer->effect, weights, sink->lights_count, layer->effect_wavelength, layer->effect_period_ms, elapsed_ms);
+
+    uint8_t* frame = (uint8_t*) layer->current_frame.data;
+    if(sink->pixel_format == ATOLLA_PIXEL_FORMAT_RGB16)
+    {
+        effect_mix_u16le(frame, weights, sink->lights_count, layer->effect_from, layer->effect_to, 3);
+    }
+    else
+    {
+        size_t channels = atolla_pixel_format_size(sink->pixel_format);
+        effect_mix_u8(frame, weights, sink->lights_count, layer->effect_from, layer->effect_to, channels);
+    }
+}
+
+static bool sink_layer_concealed(SinkLayer* layer, uint16_t frame_seq)
+{
+    uint8_t bit = (uint8_t) frame_seq;
+    return (layer->concealed[bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+static void sink_layer_set_concealed(SinkLayer* layer, uint16_t frame_seq, bool concealed)
+{
+    uint8_t bit = (uint8_t) frame_seq;
+    if(concealed)
+    {
+        layer->concealed[bit / 8] |= (uint8_t) (1 << (bit % 8));
+    }
+    else
+    {
+        layer->concealed[bit / 8] &= (uint8_t) ~(1 << (bit % 8));
+    }
+}
+
+static bool sink_layer_shown(SinkLayer* layer)
+{
+    return layer->active && layer->time_origin_us != NULL_TIME_US;
+}
+
+/**
+ * Checks whether layer a is drawn below layer b, which is the case if it has a
+ * lower priority, or the same priority and borrowed the sink earlier.
+ */
+static bool sink_layer_below(SinkLayer* a, SinkLayer* b)
+{
+    return a->priority < b->priority ||
+           (a->priority == b->priority && a->borrow_seq < b->borrow_seq);
+}
+
+/**
+ * Merges the current frames of all shown layers into merged_frame, given the
+ * shown layer that is drawn on top of all others.
+ */
+static void sink_merge(AtollaSinkPrivate* sink, SinkLayer* top)
+{
+    uint8_t* merged = (uint8_t*) sink->merged_frame.data;
+    const size_t merged_len = sink->merged_frame.capacity;
+    const bool wide_channels = sink->pixel_format == ATOLLA_PIXEL_FORMAT_RGB16;
+
+    // Both modes start out black, so that merging is the same for every layer
+    memset(merged, 0, merged_len);
+
+    if(sink->blend_mode == ATOLLA_SINK_BLEND_ALPHA)
+    {
+        // Stack from the bottom up, there are only a handful of layers, so
+        // looking for the next one each time is fine
+        SinkLayer* below = NULL;
+        for(;;)
+        {
+            SinkLayer* next = NULL;
+            for(size_t i = 0; i < sink->layers_count; ++i)
+            {
+                SinkLayer* layer = &sink->layers[i];
+                if(sink_layer_shown(layer) &&
+                   (below == NULL || sink_layer_below(below, layer)) &&
+                   (next == NULL || sink_layer_below(layer, next)))
+                {
+                    next = layer;
+                }
+            }
+
+            if(next == NULL)
+            {
+                break;
+            }
+
+            const uint8_t* frame = (const uint8_t*) next->current_frame.data;
+            if(wide_channels)
+            {
+                mem_blend_alpha_u16le(merged, frame, merged_len, next->opacity);
+            }
+            else
+            {
+                mem_blend_alpha_u8(merged, frame, merged_len, next->opacity);
+            }
+            below = next;
+        }
+    }
+    else
+    {
+        // Only the layers with the highest priority take part, lower ones are
+        // only shown when all layers above them are gone
+        for(size_t i = 0; i < sink->layers_count; ++i)
+        {
+            SinkLayer* layer = &sink->layers[i];
+            if(sink_layer_shown(layer) && layer->priority == top->priority)
+            {
+                const uint8_t* frame = (const uint8_t*) layer->current_frame.data;
+                if(wide_channels)
+                {
+                    mem_blend_max_u16le(merged, frame, merged_len);
+                }
+                else
+                {
+                    mem_blend_max_u8(merged, frame, merged_len);
+                }
+            }
+        }
+    }
+}
+
+static void sink_update(AtollaSinkPrivate* sink)
+{
+    sink_receive(sink);
+    sink_send(sink);
+}
+
+static void sink_receive(AtollaSinkPrivate* sink)
+{
+    sink_receive_udp(sink, recv_budget);
+    if(sink->has_channel)
+    {
+        sink_receive_local(sink);
+    }
+    sink_receive_stream(sink);
+
+    // Check for timeouts on every update, other sources or strangers may keep
+    // sending all the time. Only while datagrams were left waiting, a silent
+    // looking source might still have some in the queue.
+    if(!sink->recv_backlog && sink->state == ATOLLA_SINK_STATE_LENT)
+    {
+        unsigned int now = time_now();
+        for(size_t i = 0; i < sink->layers_count; ++i)
+        {
+            SinkLayer* layer = &sink->layers[i];
+            if(layer->active && (now - layer->last_recv_time) > drop_timeout)
+            {
+                // drop sources we have not received packets from in a while, the others keep playing
+                sink_send_fail_to(sink, 0, ATOLLA_ERROR_CODE_TIMEOUT, &layer->borrower);
+                sink_drop_layer(sink, layer);
+            }
+        }
+    }
+}
+
+/**
+ * Handles up to budget datagrams from the socket of the sink and from each
+ * socket connected to a borrower, and returns whether there were any.
+ */
+static bool sink_receive_udp(AtollaSinkPrivate* sink, size_t budget)
+{
+    sink->recv_backlog = false;
+    bool received = sink_receive_udp_socket(sink, &sink->socket, NULL, budget);
+
+    for(size_t i = 0; i < sink->layers_count; ++i)
+    {
+        SinkLayer* layer = &sink->layers[i];
+        if(layer->has_socket && sink_receive_udp_socket(sink, &layer->socket, layer, budget))
+        {
+            received = true;
+        }
+    }
+
+    return received;
+}
+
+/**
+ * Handles up to budget datagrams from the given socket. Datagrams on the
+ * socket of a layer come from its borrower once the socket settled, so they
+ * are received without the address of the sender.
+ */
+static bool sink_receive_udp_socket(AtollaSinkPrivate* sink, UdpSocket* socket, SinkLayer* layer, size_t budget)
+{
+    // The layer may be dropped and borrowed by someone else while handling datagrams
+    const uint32_t borrow_seq = (layer == NULL) ? 0 : layer->borrow_seq;
+    size_t received_count = 0;
+
+    for(; received_count < budget && sink->state != ATOLLA_SINK_STATE_ERROR; ++received_count)
+    {
+        if(layer != NULL && (!layer->has_socket || layer->borrow_seq != borrow_seq))
+        {
+            return true;
+        }
+
+        SinkPeer sender;
+        bool known_sender = layer != NULL && layer->socket_settled;
+        if(known_sender)
+        {
+            sender = layer->borrower;
+        }
+        else
+        {
+            sender.transport = SINK_PEER_UDP;
+        }
+
+        size_t received_bytes = 0;
+        UdpSocketResult result = udp_socket_receive_from(
+            socket,
+            sink->recv_buf, recv_buf_len,
+            &received_bytes,
+            known_sender ? NULL : &sender.endpoint
+        );
+
+        if(result.code != UDP_SOCKET_OK)
+        {
+            if(layer != NULL)
+            {
+                layer->socket_settled = true;
+            }
+            return received_count > 0;
+        }
+
+        if(!known_sender)
+        {
+            // The key is computed once per datagram, messages in it compare the key with the borrowers
+            udp_endpoint_key(&sender.endpoint, &sender.endpoint_key);
+        }
+        sink_iterate_recv_buf(sink, sink->recv_buf, received_bytes, &sender);
+    }
+
+    if(received_count == budget)
+    {
+        // Possibly more waiting, only the next update finds out
+        sink->recv_backlog = true;
+        ++sink->stats.backlog_count;
+    }
+
+    return received_count > 0;
+}
+
+static bool sink_receive_local(AtollaSinkPrivate* sink)
+{
+    void* packet;
+    size_t packet_len;
+
+    if(shm_channel_peek(&sink->channel, &packet, &packet_len))
+    {
+        // Messages are read right from the shared ring
+        SinkPeer sender;
+        sender.transport = SINK_PEER_LOCAL;
+        sink_iterate_recv_buf(sink, packet, packet_len, &sender);
+        shm_channel_release(&sink->channel);
+        return true;
+    }
+
+    return false;
+}
+
+static bool sink_receive_stream(AtollaSinkPrivate* sink)
+{
+    sink_accept_stream_conn(sink, &sink->tcp_listener);
+    sink_accept_stream_conn(sink, &sink->unix_listener);
+
+    bool received = false;
+
+    for(size_t i = 0; i < SINK_STREAM_CONNS_CAPACITY; ++i)
+    {
+        SinkStreamConn* conn = &sink->stream_conns[i];
+        if(!conn->open)
+        {
+            continue;
+        }
+
+        size_t space_len;
+        void* space = msg_reassembler_space(&conn->reassembler, &space_len);
+        size_t received_len;
+        StreamSocketStatus status = stream_socket_receive(&conn->socket, space, space_len, &received_len);
+
+        if(status == STREAM_SOCKET_OK)
+        {
+            msg_reassembler_commit(&conn->reassembler, received_len);
+            received = true;
+
+            SinkPeer sender;
+            sender.transport = SINK_PEER_STREAM;
+            sender.stream_conn_idx = i;
+            sender.stream_conn_id = conn->id;
+
+            void* msgs;
+            size_t msgs_len = msg_reassembler_complete(&conn->reassembler, &msgs);
+            if(msgs_len > 0)
+            {
+                sink_iterate_recv_buf(sink, msgs, msgs_len, &sender);
+            }
+
+            // Handling the messages may have closed the connection after a failed send
+            if(conn->open && conn->id == sender.stream_conn_id)
+            {
+                msg_reassembler_consume(&conn->reassembler, msgs_len);
+
+                if(msg_reassembler_overflowed(&conn->reassembler))
+                {
+                    sink_close_stream_conn(sink, i);
+                }
+            }
+        }
+        else if(status != STREAM_SOCKET_WOULD_BLOCK)
+        {
+            sink_close_stream_conn(sink, i);
+        }
+    }
+
+    return received;
+}
+
+static void sink_accept_stream_conn(AtollaSinkPrivate* sink, StreamSocket* listener)
+{
+    if(listener->handle == -1)
+    {
+        return;
+    }
+
+    StreamSocket accepted;
+    if(!stream_socket_accept(listener, &accepted))
+    {
+        return;
+    }
+
+    for(size_t i = 0; i < SINK_STREAM_CONNS_CAPACITY; ++i)
+    {
+        SinkStreamConn* conn = &sink->stream_conns[i];
+        if(!conn->open)
+        {
+            conn->open = true;
+            conn->id = sink->next_stream_conn_id++;
+            conn->socket = accepted;
+
+            // Reassemblers stay allocated when connections close and are reused by later connections
+            if(conn->reassembler.buf.data == NULL)
+            {
+                msg_reassembler_init(&conn->reassembler, MSG_REASSEMBLER_MAX_MSG_LEN);
+            }
+            msg_reassembler_consume(&conn->reassembler, conn->reassembler.buf.size);
+            return;
+        }
+    }
+
+    // No free slot, refuse the connection
+    stream_socket_close(&accepted);
+}
+
+static void sink_close_stream_conn(AtollaSinkPrivate* sink, size_t conn_idx)
+{
+    SinkStreamConn* conn = &sink->stream_conns[conn_idx];
+
+    // The reassembler is kept, messages from it might still be iterated when closing after a failed send
+    stream_socket_close(&conn->socket);
+    conn->open = false;
+
+    // Unlike with UDP, the borrower is known to be gone, no need to wait for the timeout
+    for(size_t i = 0; i < sink->layers_count; ++i)
+    {
+        SinkLayer* layer = &sink->layers[i];
+        if(layer->active &&
+           layer->borrower.transport == SINK_PEER_STREAM &&
+           layer->borrower.stream_conn_idx == conn_idx &&
+           layer->borrower.stream_conn_id == conn->id)
+        {
+            sink_drop_layer(sink, layer);
+        }
+    }
+}
+
+static void sink_iterate_recv_buf(AtollaSinkPrivate* sink, void* packet, size_t packet_len, SinkPeer* sender)
+{
+    MsgIter iter = msg_iter_make(packet, packet_len);
+
+    for(; msg_iter_has_msg(&iter); msg_iter_next(&iter))
+    {
+        MsgType type = msg_iter_type(&iter);
+        uint16_t msg_id = msg_iter_msg_id(&iter);
+
+        switch(type)
+        {
+            case MSG_TYPE_BORROW:
+            {
+                uint8_t frame_len = msg_iter_borrow_frame_length(&iter);
+                uint8_t buffer_len = msg_iter_borrow_buffer_length(&iter);
+                AtollaPixelFormat pixel_format = (AtollaPixelFormat) msg_iter_borrow_pixel_format(&iter);
+                uint8_t priority = msg_iter_borrow_priority(&iter);
+                uint8_t opacity = msg_iter_borrow_opacity(&iter);
+                uint8_t capabilities = msg_iter_borrow_capabilities(&iter);
+                sink_handle_borrow(sink, msg_id, frame_len, buffer_len, pixel_format, priority, opacity, capabilities, sender);
+                break;
+            }
+
+            case MSG_TYPE_ENQUEUE:
+            {
+                uint8_t frame_idx = msg_iter_enqueue_frame_idx(&iter);
+                MemBlock frame = msg_iter_enqueue_frame(&iter);
+                sink_handle_enqueue(sink, msg_id, frame_idx, frame, sender);
+                break;
+            }
+
+            case MSG_TYPE_ENQUEUE16:
+            {
+                if(!msg_iter_enqueue16_valid(&iter))
+                {
+                    sink_send_bad_msg_to(sink, msg_id, sender);
+                    break;
+                }
+
+                uint16_t frame_seq = msg_iter_enqueue16_frame_seq(&iter);
+                MemBlock frame = msg_iter_enqueue16_frame(&iter);
+                sink_handle_enqueue16(sink, msg_id, frame_seq, frame, NULL, sender);
+                break;
+            }
+
+            case MSG_TYPE_ENQUEUE_PTS:
+            {
+                if(!msg_iter_enqueue_pts_valid(&iter))
+                {
+                    sink_send_bad_msg_to(sink, msg_id, sender);
+                    break;
+                }
+
+                uint16_t frame_seq = msg_iter_enqueue_pts_frame_seq(&iter);
+                uint32_t presentation_time_us = msg_iter_enqueue_pts_time(&iter);
+                MemBlock frame = msg_iter_enqueue_pts_frame(&iter);
+                sink_handle_enqueue16(sink, msg_id, frame_seq, frame, &presentation_time_us, sender);
+                break;
+            }
+
+            case MSG_TYPE_CLOCK:
+            {
+                if(!msg_iter_clock_valid(&iter))
+                {
+                    sink_send_bad_msg_to(sink, msg_id, sender);
+                    break;
+                }
+
+                sink_handle_clock(sink, msg_iter_clock_sink_time(&iter), msg_iter_clock_source_time(&iter), sender);
+                break;
+            }
+
+            case MSG_TYPE_EFFECT:
+            {
+                if(!msg_iter_effect_valid(&iter))
+                {
+                    sink_send_bad_msg_to(sink, msg_id, sender);
+                    break;
+                }
+
+                AtollaEffect effect = (AtollaEffect) msg_iter_effect(&iter);
+                uint16_t wavelength = msg_iter_effect_wavelength(&iter);
+                uint16_t period_ms = msg_iter_effect_period(&iter);
+                MemBlock colors = msg_iter_effect_colors(&iter);
+                sink_handle_effect(sink, msg_id, effect, wavelength, period_ms, colors, sender);
+                break;
+            }
+
+            case MSG_TYPE_DISCOVER:
+            {
+                // Answer regardless of whether lent, so sources see all sinks
+                if(sink->state != ATOLLA_SINK_STATE_ERROR)
+                {
+                    sink_send_announce_to(sink, sender);
+                }
+                break;
+            }
+
+            default:
+            {
+                sink_send_bad_msg_to(sink, msg_id, sender);
+                break;
+            }
+        }
+    }
+}
+
+static void sink_handle_borrow(AtollaSinkPrivate* sink, uint16_t msg_id, int frame_length_ms, size_t buffer_length, AtollaPixelFormat transfer_format, uint8_t priority, uint8_t opacity, uint8_t capabilities, SinkPeer* sender)
+{
+    if(sink->state == ATOLLA_SINK_STATE_ERROR)
+    {
+        return; // In error state, do not bother to respond
+    }
+
+    // Borrowers may borrow again, e.g. when they missed the LENT message
+    SinkLayer* layer = sink_find_layer(sink, sender);
+    if(layer == NULL)
+    {
+        layer = sink_find_free_layer(sink);
+    }
+
+    if(layer == NULL)
+    {
+        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE, sender);
+        return;
+    }
+
+    if(!atolla_pixel_format_can_transfer(sink->pixel_format, transfer_format))
+    {
+        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_UNSUPPORTED_PIXEL_FORMAT, sender);
+        if(layer->active) { sink_drop_layer(sink, layer); }
+    }
+    else if(buffer_length > sink->max_buffer_length)
+    {
+        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_REQUESTED_BUFFER_TOO_LARGE, sender);
+        if(layer->active) { sink_drop_layer(sink, layer); }
+    }
+    else if(frame_length_ms < frame_length_ms_min)
+    {
+        sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_REQUESTED_FRAME_DURATION_TOO_SHORT, sender);
+        if(layer->active) { sink_drop_layer(sink, layer); }
+    }
+    else
+    {
+        // Frames are expanded before entering the ring, so they are always stored
+        // in the output format. One frame more than the buffer length leaves room
+        // for a frame that arrives just before the sink gets to show the next one.
+        size_t required_frame_buf_size = (buffer_length + 1) * sink->received_frame.capacity;
+        if(!sink_layer_reserve(sink, layer, required_frame_buf_size))
+        {
+            sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_REQUESTED_BUFFER_TOO_LARGE, sender);
+            if(layer->active) { sink_drop_layer(sink, layer); }
+            return;
+        }
+
+        if(!layer->active)
+        {
+            // Frames left over from the previous borrower must not be shown
+            mem_ring_drop(&layer->pending_frames, layer->pending_frames.len);
+            layer->active = true;
+            layer->borrower = *sender;
+            layer->borrow_seq = sink->next_borrow_seq++;
+            // Borrowing again keeps the clock estimate, a new borrower has its own clock
+            layer->clock_valid = false;
+
+            if(sink->connect_borrowers && sender->transport == SINK_PEER_UDP)
+            {
+                sink_layer_connect(sink, layer);
+            }
+        }
+
+        layer->priority = priority;
+        layer->opacity = opacity;
+        layer->buffer_length = (uint8_t) buffer_length;
+        layer->frame_duration_ms = frame_length_ms;
+        layer->transfer_format = transfer_format;
+        layer->time_origin_us = NULL_TIME_US;
+        layer->last_enqueued_frame_idx = NULL_TIME;
+        // Whatever the borrower offered and this sink knows, old sources offer nothing
+        layer->capabilities = capabilities & sink_capabilities;
+        if(!(layer->capabilities & MSG_CAPABILITY_ENQUEUE16) || sender->transport != SINK_PEER_UDP)
+        {
+            // Only ENQUEUE16 frames can be asked for, and streams lose nothing
+            layer->capabilities &= ~MSG_CAPABILITY_NACK;
+        }
+        if(!(layer->capabilities & MSG_CAPABILITY_ENQUEUE16))
+        {
+            // ENQUEUE_PTS extends ENQUEUE16
+            layer->capabilities &= ~MSG_CAPABILITY_PTS;
+        }
+        layer->has_last_seq = false;
+        layer->last_seq = UINT16_MAX;
+        memset(layer->concealed, 0, sizeof(layer->concealed));
+        layer->stamped = false;
+        layer->effect = ATOLLA_EFFECT_NONE;
+        layer->last_recv_time = time_now();
+        sink->state = ATOLLA_SINK_STATE_LENT;
+
+        sink_send_lent(sink, layer);
+    }
+}
+
+static void sink_handle_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, size_t frame_idx, MemBlock frame, SinkPeer* sender)
+{
+    SinkLayer* layer = sink_accept_enqueue(sink, msg_id, frame, sender);
+    if(layer == NULL)
+    {
+        return;
+    }
+
+    // Frames take over from the effect
+    sink_layer_end_effect(layer);
+
+    if(layer->last_enqueued_frame_idx == (int) NULL_TIME)
+    {
+        // The first frame after borrowing sets the baseline, multicast sources
+        // keep counting for the sinks that joined before this one
+        layer->last_enqueued_frame_idx = (int) ((frame_idx + 255) % 256);
+    }
+
+    int diff = bounded_diff(layer->last_enqueued_frame_idx, frame_idx, 256);
+    if(diff > 128)
+    {
+        // If would have to skip more than 128, this is an out of order package.
+        // We just drop it.
+        return;
+    }
+
+    // Skipped frames are filled in, until the ring is full
+    size_t frame_size = sink->received_frame.capacity;
+    size_t free_frames = (layer->pending_frames.buf.capacity - layer->pending_frames.len) / frame_size;
+    size_t count = ((size_t) diff < free_frames) ? (size_t) diff : free_frames;
+    if(count == 0)
+    {
+        return;
+    }
+
+    sink_expand_frame(sink, layer, frame);
+    sink_enqueue_after_gap(sink, layer, (size_t) diff, count);
+    layer->last_enqueued_frame_idx = (int) ((layer->last_enqueued_frame_idx + count) % 256);
+}
+
+static void sink_handle_enqueue16(AtollaSinkPrivate* sink, uint16_t msg_id, uint16_t frame_seq, MemBlock frame, const uint32_t* presentation_time_us, SinkPeer* sender)
+{
+    SinkLayer* layer = sink_accept_enqueue(sink, msg_id, frame, sender);
+    if(layer == NULL)
+    {
+        return;
+    }
+
+    // Frames take over from the effect
+    sink_layer_end_effect(layer);
+
+    // Serial number arithmetic, half of the sequence space lies ahead and half
+    // behind, so reordered or duplicated frames are recognized even after a
+    // burst of loss that the 8-bit frame index could not tell apart
+    int16_t diff = (int16_t) (uint16_t) (frame_seq - layer->last_seq);
+    if(layer->has_last_seq && diff <= 0)
+    {
+        // Late frames still take the place of their stand-in, if not shown yet
+        sink_replace_concealed(sink, layer, frame_seq, frame);
+        return;
+    }
+
+    size_t frame_size = sink->received_frame.capacity;
+    size_t free_frames = (layer->pending_frames.buf.capacity - layer->pending_frames.len) / frame_size;
+    if(free_frames == 0)
+    {
+        // Dropped without advancing, so a retransmission still fits later
+        return;
+    }
+
+    // Lost frames in between are filled in, unless there are more of them than
+    // the buffer holds. Filling those in would keep the sink a full buffer
+    // behind, so the frame is taken as a new baseline instead, like the first
+    // frame after borrowing.
+    bool resync = !layer->has_last_seq || (size_t) diff > free_frames || (size_t) diff > layer->buffer_length;
+    size_t copies = resync ? 1 : (size_t) diff;
+    if(resync)
+    {
+        // Frames left out entirely break the mapping from sequence numbers
+        // to places in the ring, older stand-ins cannot be replaced anymore
+        memset(layer->concealed, 0, sizeof(layer->concealed));
+    }
+
+    sink_expand_frame(sink, layer, frame);
+    sink_enqueue_after_gap(sink, layer, copies, copies);
+    for(size_t i = 0; i < copies; ++i)
+    {
+        uint16_t seq = (uint16_t) (frame_seq - (copies - 1 - i));
+        sink_layer_set_concealed(layer, seq, seq != frame_seq);
+    }
+
+    layer->has_last_seq = true;
+    layer->last_seq = frame_seq;
+
+    if(presentation_time_us != NULL && layer->clock_valid)
+    {
+        sink_layer_schedule(sink, layer, *presentation_time_us);
+    }
+
+    if(copies > 1 && (layer->capabilities & MSG_CAPABILITY_NACK))
+    {
+        sink_send_nack(sink, layer, frame_seq, copies - 1);
+    }
+}
+
+/**
+ * Moves the playback clock of the layer so that the frame just enqueued at the
+ * back of the ring is shown at its presentation time, translated to the sink
+ * clock. Until the first frame is shown, this decides when that happens.
+ */
+static void sink_layer_schedule(AtollaSinkPrivate* sink, SinkLayer* layer, uint32_t presentation_time_us)
+{
+    uint32_t frame_duration_us = layer->frame_duration_ms * 1000;
+    uint32_t pending_frames = (uint32_t) (layer->pending_frames.len / sink->received_frame.capacity);
+    uint32_t due_us = presentation_time_us + layer->clock_offset_us;
+
+    if(sink_layer_shown(layer))
+    {
+        // The current frame ends after its duration, then each pending one follows
+        layer->time_origin_us = due_us - pending_frames * frame_duration_us;
+    }
+    else
+    {
+        layer->next_due_us = due_us - (pending_frames - 1) * frame_duration_us;
+        layer->stamped = true;
+    }
+}
+
+/**
+ * Starts rendering an effect on the layer of the sender instead of its frames.
+ * Sources repeat the effect to keep the layer alive, the same effect again
+ * keeps running where it is instead of starting over.
+ */
+static void sink_handle_effect(AtollaSinkPrivate* sink, uint16_t msg_id, AtollaEffect effect, uint16_t wavelength, uint16_t period_ms, MemBlock colors, SinkPeer* sender)
+{
+    // The colors are checked like a frame, the from color is its first light
+    SinkLayer* layer = sink_accept_enqueue(sink, msg_id, colors, sender);
+    if(layer == NULL)
+    {
+        return;
+    }
+
+    size_t pixel_size = atolla_pixel_format_size(layer->transfer_format);
+    if(!(layer->capabilities & MSG_CAPABILITY_EFFECT) || effect > ATOLLA_EFFECT_NOISE || colors.size != 2 * pixel_size)
+    {
+        sink_send_bad_msg_to(sink, msg_id, sender);
+        return;
+    }
+
+    if(effect == ATOLLA_EFFECT_NONE)
+    {
+        sink_layer_end_effect(layer);
+        return;
+    }
+
+    // Colors are expanded like frames, which repeat their single light everywhere
+    uint8_t from[effect_color_capacity];
+    uint8_t to[effect_color_capacity];
+    size_t output_pixel_size = atolla_pixel_format_size(sink->pixel_format);
+    sink_expand_frame(sink, layer, mem_block_slice(&colors, 0, pixel_size));
+    memcpy(from, sink->received_frame.data, output_pixel_size);
+    sink_expand_frame(sink, layer, mem_block_slice(&colors, pixel_size, pixel_size));
+    memcpy(to, sink->received_frame.data, output_pixel_size);
+
+    bool same = effect == layer->effect &&
+                wavelength == layer->effect_wavelength &&
+                period_ms == layer->effect_period_ms &&
+                memcmp(from, layer->effect_from, output_pixel_size) == 0 &&
+                memcmp(to, layer->effect_to, output_pixel_size) == 0;
+    if(same)
+    {
+        return;
+    }
+
+    // Frames that were waiting would be stale by the time the effect ends
+    mem_ring_drop(&layer->pending_frames, layer->pending_frames.len);
+    layer->effect = effect;
+    layer->effect_wavelength = wavelength;
+    layer->effect_period_ms = period_ms;
+    layer->effect_start_us = time_now_us();
+    memcpy(layer->effect_from, from, output_pixel_size);
+    memcpy(layer->effect_to, to, output_pixel_size);
+    // Shown from now on, so it takes part in merging
+    layer->time_origin_us = (uint32_t) layer->effect_start_us;
+}
+
+/**
+ * Estimates the offset between the sink clock and the clock of the borrower
+ * from a CLOCK message, which answers the sink time sent with LENT. Assuming
+ * the way there took as long as the way back, the source read its clock half
+ * a round trip after the sink did. Answers with the shortest round trip have
+ * the least room for asymmetry, so only those are taken, but the shortest
+ * round trip seen slowly ages so that the estimate follows drifting clocks.
+ */
+static void sink_handle_clock(AtollaSinkPrivate* sink, uint32_t sink_time_us, uint32_t source_time_us, SinkPeer* sender)
+{
+    SinkLayer* layer = sink_find_layer(sink, sender);
+    if(layer == NULL)
+    {
+        ++sink->stats.foreign_count;
+        return;
+    }
+    else if(!(layer->capabilities & MSG_CAPABILITY_PTS))
+    {
+        return;
+    }
+
+    uint32_t rtt_us = (uint32_t) time_now_us() - sink_time_us;
+    if(rtt_us > clock_rtt_max_us)
+    {
+        return;
+    }
+
+    layer->clock_rtt_us += layer->clock_rtt_us / 8;
+    if(!layer->clock_valid || rtt_us <= layer->clock_rtt_us)
+    {
+        layer->clock_rtt_us = rtt_us;
+        layer->clock_offset_us = sink_time_us + rtt_us / 2 - source_time_us;
+        layer->clock_valid = true;
+    }
+}
+
+/**
+ * Replaces the stand-in for an ENQUEUE16 frame that arrived late, e.g. after a
+ * NACK, if it is still waiting in the ring.
+ */
+static void sink_replace_concealed(AtollaSinkPrivate* sink, SinkLayer* layer, uint16_t frame_seq, MemBlock frame)
+{
+    size_t frame_size = sink->received_frame.capacity;
+    size_t pending_frames = layer->pending_frames.len / frame_size;
+    size_t frames_behind = (uint16_t) (layer->last_seq - frame_seq);
+
+    if(frames_behind >= pending_frames || !sink_layer_concealed(layer, frame_seq))
+    {
+        // Already shown, or a duplicate of a frame that was received
+        return;
+    }
+
+    sink_expand_frame(sink, layer, frame);
+    size_t offset = (pending_frames - 1 - frames_behind) * frame_size;
+    mem_ring_overwrite(&layer->pending_frames, offset, sink->received_frame.data, frame_size);
+    sink_layer_set_concealed(layer, frame_seq, false);
+}
+
+/**
+ * Asks the borrower to resend the missing_count frames before frame_seq. The
+ * frames due last are most likely to make it in time, so those are asked for
+ * if there are too many.
+ */
+static void sink_send_nack(AtollaSinkPrivate* sink, SinkLayer* layer, uint16_t frame_seq, size_t missing_count)
+{
+    if(missing_count > SINK_NACK_FRAME_SEQS_MAX)
+    {
+        missing_count = SINK_NACK_FRAME_SEQS_MAX;
+    }
+
+    uint16_t missing[SINK_NACK_FRAME_SEQS_MAX];
+    for(size_t i = 0; i < missing_count; ++i)
+    {
+        missing[i] = (uint16_t) (frame_seq - (missing_count - i));
+    }
+
+    MemBlock* nack_msg = msg_builder_nack(&sink->builder, missing, missing_count);
+    sink_send_to(sink, nack_msg, &layer->borrower);
+}
+
+/**
+ * Returns the layer of the sender if the enqueued frame can be taken, or NULL
+ * after answering with FAIL.
+ */
+static SinkLayer* sink_accept_enqueue(AtollaSinkPrivate* sink, uint16_t msg_id, MemBlock frame, SinkPeer* sender)
+{
+    if(sink->state == ATOLLA_SINK_STATE_ERROR)
+    {
+        return NULL; // In error state, do not bother to respond
+    }
+
+    SinkLayer* layer = sink_find_layer(sink, sender);
+    if(layer == NULL)
+    {
+        // Tell the sender to borrow first if it could, otherwise that it has to wait for others
+        uint8_t error_code = (sink_find_free_layer(sink) != NULL) ?
+            ATOLLA_ERROR_CODE_NOT_BORROWED :
+            ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE;
+        ++sink->stats.foreign_count;
+        sink_send_fail_to(sink, msg_id, error_code, sender);
+        return NULL;
+    }
+
+    layer->last_recv_time = time_now();
+
+    if(frame.size < atolla_pixel_format_size(layer->transfer_format))
+    {
+        // Frames need at least one light, drop connection after illegal message
+        sink_send_bad_msg_to(sink, msg_id, sender);
+        sink_drop_layer(sink, layer);
+        return NULL;
+    }
+
+    return layer;
+}
+
+/**
+ * Enqueues the received frame, which is diff frames after the last enqueued
+ * one, preceded by stand-ins for the frames lost in between. Only the last
+ * count of those diff frames are enqueued, which must fit into the ring.
+ *
+ * Stand-ins are copies of the received frame, or with interpolation, fade
+ * linearly from the frame before the gap to the received one. Interpolation
+ * needs a frame before the gap, either in the ring or on display.
+ */
+static void sink_enqueue_after_gap(AtollaSinkPrivate* sink, SinkLayer* layer, size_t diff, size_t count)
+{
+    const size_t frame_size = sink->received_frame.capacity;
+    const bool wide_channels = sink->pixel_format == ATOLLA_PIXEL_FORMAT_RGB16;
+
+    void* before_gap = NULL;
+    if(sink->concealment == ATOLLA_SINK_CONCEAL_INTERPOLATE && diff > 1)
+    {
+        if(!mem_ring_peek_back(&layer->pending_frames, &before_gap, frame_size) && sink_layer_shown(layer))
+        {
+            before_gap = layer->current_frame.data;
+        }
+    }
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        // Position within the gap, diff is the received frame itself
+        size_t step = diff - (count - 1 - i);
+
+        if(before_gap == NULL || step == diff)
+        {
+            mem_ring_enqueue(&layer->pending_frames, sink->received_frame.data, frame_size);
+            continue;
+        }
+
+        // The frame before the gap stays where it is, enqueuing only appends
+        mem_ring_enqueue(&layer->pending_frames, before_gap, frame_size);
+
+        void* stand_in;
+        mem_ring_peek_back(&layer->pending_frames, &stand_in, frame_size);
+        uint8_t alpha = (uint8_t) ((step * 255 + diff / 2) / diff);
+        if(wide_channels)
+        {
+            mem_blend_alpha_u16le((uint8_t*) stand_in, (const uint8_t*) sink->received_frame.data, frame_size, alpha);
         }
         else
         {
-            if(udp_endpoint_equal(sender, &sink->borrower_endpoint))
+            mem_blend_alpha_u8((uint8_t*) stand_in, (const uint8_t*) sink->received_frame.data, frame_size, alpha);
+        }
+    }
+}
+
+/**
+ * Converts the frame into the received frame, in the output format and with
+ * the pattern repeated over all lights.
+ */
+static void sink_expand_frame(AtollaSinkPrivate* sink, SinkLayer* layer, MemBlock frame)
+{
+    if(layer->transfer_format == ATOLLA_PIXEL_FORMAT_RGB565)
+    {
+        size_t transfer_lights_count = frame.size / atolla_pixel_format_size(ATOLLA_PIXEL_FORMAT_RGB565);
+        if(transfer_lights_count > sink->lights_count)
+        {
+            transfer_lights_count = sink->lights_count;
+        }
+
+        // Expand into the front of the received frame and repeat from there
+        uint8_t* expanded = (uint8_t*) sink->received_frame.data;
+        size_t expanded_len = transfer_lights_count * atolla_pixel_format_size(ATOLLA_PIXEL_FORMAT_RGB8);
+        expand_rgb565(expanded, (const uint8_t*) frame.data, transfer_lights_count);
+
+        fill_with_pattern(
+            expanded + expanded_len, sink->received_frame.capacity - expanded_len,
+            expanded, expanded_len
+        );
+    }
+    else
+    {
+        // Ignore trailing bytes of incomplete lights, so the pattern does not shift channels
+        size_t pixel_size = atolla_pixel_format_size(layer->transfer_format);
+        fill_with_pattern(
+            sink->received_frame.data, sink->received_frame.capacity,
+            frame.data, frame.size - (frame.size % pixel_size)
+        );
+    }
+}
+
+static void sink_send(AtollaSinkPrivate* sink)
+{
+    if(sink->state == ATOLLA_SINK_STATE_LENT)
+    {
+        for(size_t i = 0; i < sink->layers_count; ++i)
+        {
+            SinkLayer* layer = &sink->layers[i];
+            if(layer->active && (time_now() - layer->last_send_lent_time) > lent_send_interval)
             {
-                int diff = bounded_diff(sink->last_enqueued_frame_idx, frame_idx, 256);
-                if(diff > 128)
-                {
-                    // If would have to skip more than 128, this is an out of order package.
-                    // We just drop it.
-                    return;
-                }
+                sink_send_lent(sink, layer);
+            }
+        }
+    }
+}
 
-                while(diff > 0) {
-                    sink_enqueue(sink, frame);
-                    diff = bounded_diff(sink->last_enqueued_frame_idx, frame_idx, 256);
-                }
+static void sink_send_lent(AtollaSinkPrivate* sink, SinkLayer* layer)
+{
+    // Set before sending, a failed stream send drops the layer right away
+    layer->last_send_lent_time = time_now();
+    MemBlock* lent_msg = (layer->capabilities & MSG_CAPABILITY_PTS) ?
+        msg_builder_lent_clock(&sink->builder, layer->capabilities, (uint32_t) time_now_us()) :
+        msg_builder_lent(&sink->builder, layer->capabilities);
+    sink_send_to(sink, lent_msg, &layer->borrower);
+}
+
+static void sink_send_announce_to(AtollaSinkPrivate* sink, SinkPeer* to)
+{
+    // DISCOVER is short and ANNOUNCE is not, answering every one would amplify floods
+    if(to->transport == SINK_PEER_UDP && !sink_reply_allowed(sink, &to->endpoint_key))
+    {
+        ++sink->stats.announce_suppressed_count;
+        return;
+    }
+
+    // Every known format that can be transferred to the output format
+    uint8_t pixel_formats[SINK_ANNOUNCE_PIXEL_FORMATS_MAX];
+    size_t pixel_formats_len = 0;
+    for(int format = 0; atolla_pixel_format_size((AtollaPixelFormat) format) > 0; ++format)
+    {
+        if(atolla_pixel_format_can_transfer(sink->pixel_format, (AtollaPixelFormat) format) &&
+           pixel_formats_len < sizeof(pixel_formats))
+        {
+            pixel_formats[pixel_formats_len++] = (uint8_t) format;
+        }
+    }
+
+    MemBlock* announce_msg = msg_builder_announce(
+        &sink->builder,
+        sink->port,
+        (uint16_t) sink->lights_count,
+        (uint8_t) frame_length_ms_min,
+        pixel_formats, pixel_formats_len
+    );
+    sink_send_to(sink, announce_msg, to);
+}
+
+static void sink_send_fail_to(AtollaSinkPrivate* sink, uint16_t offending_msg_id, uint8_t error_code, SinkPeer* to)
+{
+    // Streams and the channel cannot be flooded from afar, only UDP is limited
+    if(to->transport == SINK_PEER_UDP && !sink_reply_allowed(sink, &to->endpoint_key))
+    {
+        ++sink->stats.fail_suppressed_count;
+        return;
+    }
+
+    MemBlock* lent_msg = msg_builder_fail(&sink->builder, offending_msg_id, error_code);
+    sink_send_to(sink, lent_msg, to);
+}
+
+static void sink_send_bad_msg_to(AtollaSinkPrivate* sink, uint16_t offending_msg_id, SinkPeer* to)
+{
+    ++sink->stats.bad_count;
+    sink_send_fail_to(sink, offending_msg_id, ATOLLA_ERROR_CODE_BAD_MSG, to);
+}
+
+/**
+ * Takes a token from the bucket of the sender and from the bucket of all
+ * senders, if both have one left. Otherwise, neither is charged.
+ */
+static bool sink_reply_allowed(AtollaSinkPrivate* sink, const UdpEndpointKey* to)
+{
+    unsigned int now = time_now();
+
+    SinkFailBucket* bucket = NULL;
+    for(size_t i = 0; i < SINK_FAIL_BUCKETS_CAPACITY && bucket == NULL; ++i)
+    {
+        SinkFailBucket* candidate = &sink->fail_buckets[i];
+        if(candidate->used && udp_endpoint_key_equal(&candidate->sender, to))
+        {
+            bucket = candidate;
+        }
+    }
+
+    if(bucket == NULL)
+    {
+        // Unused buckets first, otherwise the one that went without replies the longest
+        bucket = &sink->fail_buckets[0];
+        for(size_t i = 1; i < SINK_FAIL_BUCKETS_CAPACITY && bucket->used; ++i)
+        {
+            SinkFailBucket* candidate = &sink->fail_buckets[i];
+            if(!candidate->used || (now - candidate->refill_time) > (now - bucket->refill_time))
+            {
+                bucket = candidate;
+            }
+        }
+        bucket->used = false;
+        bucket->sender = *to;
+    }
+
+    // Both are refilled before either is charged, so that a FAIL suppressed
+    // by one limit does not count against the other
+    bool sender_allowed = sink_fail_bucket_refill(bucket, now, fail_burst, fail_refill_ms);
+    bool all_allowed = sink_fail_bucket_refill(&sink->fail_bucket_all, now, fail_burst_all, fail_refill_all_ms);
+    if(!sender_allowed || !all_allowed)
+    {
+        return false;
+    }
+
+    --bucket->tokens;
+    --sink->fail_bucket_all.tokens;
+    return true;
+}
+
+/**
+ * Adds the tokens that accrued since the last refill and returns whether at
+ * least one token is left.
+ */
+static bool sink_fail_bucket_refill(SinkFailBucket* bucket, unsigned int now, unsigned int burst, unsigned int refill_ms)
+{
+    if(!bucket->used)
+    {
+        bucket->used = true;
+        bucket->tokens = burst;
+        bucket->refill_time = now;
+    }
+
+    unsigned int refills = (now - bucket->refill_time) / refill_ms;
+    if(refills >= burst - bucket->tokens)
+    {
+        // Full again, time spent full does not count for later
+        bucket->tokens = burst;
+        bucket->refill_time = now;
+    }
+    else
+    {
+        bucket->tokens += refills;
+        bucket->refill_time += refills * refill_ms;
+    }
+
+    return bucket->tokens > 0;
+}
+
+/**
+ * Sends the message back the way that the given peer sent its messages.
+ */
+static void sink_send_to(AtollaSinkPrivate* sink, MemBlock* msg, SinkPeer* to)
+{
+    switch(to->transport)
+    {
+        case SINK_PEER_UDP:
+        {
+            // Borrowers with a socket of their own are answered through it, without an address
+            SinkLayer* layer = sink->connect_borrowers ? sink_find_layer(sink, to) : NULL;
+            if(layer != NULL && layer->has_socket)
+            {
+                udp_socket_send(&layer->socket, msg->data, msg->size);
             }
             else
             {
-                sink_send_fail_to(sink, msg_id, ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE, sender);
+                udp_socket_send_to(&sink->socket, msg->data, msg->size, &to->endpoint);
+            }
+            break;
+        }
+
+        case SINK_PEER_LOCAL:
+            if(sink->has_channel)
+            {
+                shm_channel_send(&sink->channel, msg->data, msg->size);
+            }
+            break;
+
+        case SINK_PEER_STREAM:
+        {
+            SinkStreamConn* conn = &sink->stream_conns[to->stream_conn_idx];
+            if(conn->open && conn->id == to->stream_conn_id)
+            {
+                StreamSocketStatus status = stream_socket_send(&conn->socket, msg->data, msg->size, stream_send_timeout_ms);
+                if(status != STREAM_SOCKET_OK)
+                {
+                    // Either broken or cut in the middle of a message, the stream cannot be used anymore
+                    sink_close_stream_conn(sink, to->stream_conn_idx);
+                }
             }
+            break;
         }
     }
 }
 
-static void sink_enqueue(AtollaSinkPrivate* sink, MemBlock frame)
+static bool sink_peer_equal(SinkPeer* a, SinkPeer* b)
 {
-    fill_with_pattern(
-        sink->received_frame.data, sink->received_frame.capacity,
-        frame.data, frame.size
-    );
+    if(a->transport != b->transport)
+    {
+        return false;
+    }
+
+    switch(a->transport)
+    {
+        case SINK_PEER_UDP:
+            return udp_endpoint_key_equal(&a->endpoint_key, &b->endpoint_key);
 
-    if(mem_ring_enqueue(&sink->pending_frames, sink->received_frame.data, sink->received_frame.capacity)) {
-        sink->last_enqueued_frame_idx = (sink->last_enqueued_frame_idx + 1) % 256;
+        case SINK_PEER_STREAM:
+            return a->stream_conn_idx == b->stream_conn_idx && a->stream_conn_id == b->stream_conn_id;
+
+        default:
+            return true;
     }
 }
 
-static void sink_send(AtollaSinkPrivate* sink)
+static SinkLayer* sink_find_layer(AtollaSinkPrivate* sink, SinkPeer* borrower)
 {
-    if(sink->state == ATOLLA_SINK_STATE_LENT)
+    for(size_t i = 0; i < sink->layers_count; ++i)
     {
-        if((time_now() - sink->last_send_lent_time) > lent_send_interval)
+        SinkLayer* layer = &sink->layers[i];
+        if(layer->active && sink_peer_equal(borrower, &layer->borrower))
         {
-            sink_send_lent(sink);
+            return layer;
         }
     }
+
+    return NULL;
 }
 
-static void sink_send_lent(AtollaSinkPrivate* sink)
+static SinkLayer* sink_find_free_layer(AtollaSinkPrivate* sink)
 {
-    MemBlock* lent_msg = msg_builder_lent(&sink->builder);
-    udp_socket_send_to(&sink->socket, lent_msg->data, lent_msg->size, &sink->borrower_endpoint);
-    sink->last_send_lent_time = time_now();
+    for(size_t i = 0; i < sink->layers_count; ++i)
+    {
+        if(!sink->layers[i].active)
+        {
+            return &sink->layers[i];
+        }
+    }
+
+    return NULL;
 }
 
-static void sink_send_fail(AtollaSinkPrivate* sink, uint16_t offending_msg_id, uint8_t error_code)
+/**
+ * Makes sure the pending frames of the layer have exactly the given capacity
+ * in bytes. Keeps the frames if it already has, otherwise the frames are lost.
+ * Returns false if the memory could not be allocated.
+ */
+static bool sink_layer_reserve(AtollaSinkPrivate* sink, SinkLayer* layer, size_t capacity)
 {
-    sink_send_fail_to(sink, offending_msg_id, error_code, &sink->borrower_endpoint);
+    if(layer->pending_frames.buf.capacity == capacity)
+    {
+        return true;
+    }
+    else if(sink->in_storage)
+    {
+        // The ring fits the longest buffer and is kept, it just holds a few more frames
+        return capacity <= layer->pending_frames.buf.capacity;
+    }
+
+    mem_ring_free(&layer->pending_frames);
+
+    void* data = malloc(capacity);
+    if(data == NULL)
+    {
+        return false;
+    }
+
+    layer->pending_frames = mem_ring_make(data, capacity);
+    return true;
 }
 
-static void sink_send_fail_to(AtollaSinkPrivate* sink, uint16_t offending_msg_id, uint8_t error_code, UdpEndpoint* to)
+/**
+ * Opens a socket for the borrower of the layer that the kernel passes its
+ * datagrams to, or keeps receiving them on the socket of the sink if that
+ * fails.
+ */
+static void sink_layer_connect(AtollaSinkPrivate* sink, SinkLayer* layer)
 {
-    MemBlock* lent_msg = msg_builder_fail(&sink->builder, offending_msg_id, error_code);
-    udp_socket_send_to(&sink->socket, lent_msg->data, lent_msg->size, to);
+    if(udp_socket_init_shared(&layer->socket, sink->port).code != UDP_SOCKET_OK)
+    {
+        return;
+    }
+
+    if(udp_socket_set_endpoint(&layer->socket, &layer->borrower.endpoint).code != UDP_SOCKET_OK)
+    {
+        udp_socket_free(&layer->socket);
+        return;
+    }
+    udp_socket_set_options(&layer->socket, &sink->socket_options);
+
+    layer->has_socket = true;
+    layer->socket_settled = false;
 }
 
-static void sink_drop_borrow(AtollaSinkPrivate* sink)
+static void sink_drop_layer(AtollaSinkPrivate* sink, SinkLayer* layer)
 {
-    sink->state = ATOLLA_SINK_STATE_OPEN;
+    layer->active = false;
+    if(layer->has_socket)
+    {
+        udp_socket_free(&layer->socket);
+        layer->has_socket = false;
+    }
+    // Idle layers take up no memory for frames, the next borrower gets a ring of its own size
+    if(!sink->in_storage)
+    {
+        mem_ring_free(&layer->pending_frames);
+    }
+
+    for(size_t i = 0; i < sink->layers_count; ++i)
+    {
+        if(sink->layers[i].active)
+        {
+            return; // Other sources still borrow the sink
+        }
+    }
+
+    if(sink->state == ATOLLA_SINK_STATE_LENT)
+    {
+        sink->state = ATOLLA_SINK_STATE_OPEN;
+    }
 }
 
 static void sink_panic(AtollaSinkPrivate* sink, const char* error_msg) {
@@ -433,6 +2115,25 @@ static void fill_with_pattern(void* target, size_t target_len, void* pattern, si
     }
 }
 
+static void expand_rgb565(uint8_t* target, const uint8_t* source, size_t lights_count)
+{
+    for(size_t i = 0; i < lights_count; ++i)
+    {
+        uint16_t packed = (uint16_t) (source[0] | (source[1] << 8));
+        uint8_t r = (uint8_t) (packed >> 11);
+        uint8_t g = (uint8_t) ((packed >> 5) & 0x3F);
+        uint8_t b = (uint8_t) (packed & 0x1F);
+
+        // Replicate the high bits into the low bits, so that full intensity maps to 255
+        target[0] = (uint8_t) ((r << 3) | (r >> 2));
+        target[1] = (uint8_t) ((g << 2) | (g >> 4));
+        target[2] = (uint8_t) ((b << 3) | (b >> 2));
+
+        source += 2;
+        target += 3;
+    }
+}
+
 static int bounded_diff(int from, int to, int cap)
 {
     if(to < from)
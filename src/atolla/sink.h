@@ -2,6 +2,50 @@
 #define ATOLLA_SINK_H
 
 #include "primitives.h"
+#include "pixel_format.h"
+#include "socket_options.h"
+
+#ifndef ATOLLA_SINK_RECV_BUF_LEN
+/**
+ * Determines the maximum size of incoming packets.
+ * This is enough for about 300 lights.
+ *
+ */
+#define ATOLLA_SINK_RECV_BUF_LEN 1024
+#endif
+
+/**
+ * Bytes of storage for atolla_sink_init_in that a sink needs regardless of
+ * its amount of lights and frames, including alignment.
+ */
+#define ATOLLA_SINK_STORAGE_BASE_SIZE (ATOLLA_SINK_RECV_BUF_LEN + 2048)
+/**
+ * Bytes of storage for atolla_sink_init_in that a sink needs for each source
+ * that may borrow it, not counting its frames.
+ */
+#define ATOLLA_SINK_STORAGE_LAYER_SIZE 416
+/** Rounds up storage sizes to the alignment of the parts of a sink */
+#define ATOLLA_SINK_STORAGE_ALIGNED(size) ((((size) + 15) / 16) * 16)
+
+/**
+ * Bytes of storage for atolla_sink_init_in that a sink with the given amount
+ * of lights needs, if it accepts up to the given amount of sources with the
+ * given buffer length in frames and has pixels of the given size in bytes.
+ */
+#define ATOLLA_SINK_LAYERED_STORAGE_SIZE(lights, frames, bytes_per_light, sources) \
+    (ATOLLA_SINK_STORAGE_BASE_SIZE + \
+     2 * ATOLLA_SINK_STORAGE_ALIGNED((lights) * (bytes_per_light)) + \
+     (sources) * (ATOLLA_SINK_STORAGE_LAYER_SIZE + \
+                  ATOLLA_SINK_STORAGE_ALIGNED((lights) * (bytes_per_light)) + \
+                  ATOLLA_SINK_STORAGE_ALIGNED(((frames) + 1) * (lights) * (bytes_per_light))))
+
+/**
+ * Bytes of storage for atolla_sink_init_in that a sink with the given amount
+ * of RGB8 lights and a single source with the given buffer length needs,
+ * e.g. for a static array on a microcontroller.
+ */
+#define ATOLLA_SINK_STORAGE_SIZE(lights, frames) \
+    ATOLLA_SINK_LAYERED_STORAGE_SIZE(lights, frames, 3, 1)
 
 enum AtollaSinkState
 {
@@ -9,11 +53,41 @@ enum AtollaSinkState
     ATOLLA_SINK_STATE_ERROR,
     // Sink is ready for a source to connect to it
     ATOLLA_SINK_STATE_OPEN,
-    // Sink is currently connected to a source
+    // Sink is currently connected to a source, or to at least one source if
+    // it accepts several
     ATOLLA_SINK_STATE_LENT
 };
 typedef enum AtollaSinkState AtollaSinkState;
 
+/**
+ * Determines how sinks with several sources merge their frames into the one
+ * returned by atolla_sink_get.
+ */
+enum AtollaSinkBlendMode
+{
+    // Highest takes precedence, every channel shows the brightest value of
+    // all sources with the highest priority
+    ATOLLA_SINK_BLEND_HTP,
+    // Latest takes precedence, the source with the highest priority that
+    // borrowed the sink last is shown alone
+    ATOLLA_SINK_BLEND_LTP,
+    // Sources are stacked in the order of their priority and each is blended
+    // over the ones below with the opacity it sent when borrowing
+    ATOLLA_SINK_BLEND_ALPHA
+};
+typedef enum AtollaSinkBlendMode AtollaSinkBlendMode;
+
+enum AtollaSinkConcealment
+{
+    // Lost frames are filled in with copies of the next frame that arrives,
+    // so the lights hold still for the duration of the loss
+    ATOLLA_SINK_CONCEAL_REPEAT,
+    // Lost frames fade linearly from the last frame before the loss to the
+    // next frame that arrives, which hides short losses in smooth fades
+    ATOLLA_SINK_CONCEAL_INTERPOLATE
+};
+typedef enum AtollaSinkConcealment AtollaSinkConcealment;
+
 /**
  * Represents an endpoint for atolla sources to connect to.
  */
@@ -42,14 +116,164 @@ struct AtollaSinkSpec
      * received pattern is truncated to fit.
      */
     int lights_count;
+    /**
+     * Layout of the lights in frames returned by atolla_sink_get. Sources
+     * must transfer frames in the same format, except for RGB565, which sinks
+     * with format RGB8 accept and expand to 8 bits per channel. Borrow
+     * requests with other pixel formats are refused.
+     *
+     * ATOLLA_PIXEL_FORMAT_RGB565 itself is a transfer format and cannot be
+     * used here. Zero-initialized specs use ATOLLA_PIXEL_FORMAT_RGB8.
+     */
+    AtollaPixelFormat pixel_format;
+    /**
+     * If not NULL, the sink additionally creates a shared-memory segment with
+     * this name, e.g. "leds". Sources on the same host connect to it with a
+     * sink_hostname of "shm://leds", which bypasses the network stack.
+     *
+     * Shared memory is only available on Linux. If the segment cannot be
+     * created, e.g. because another sink uses the name, the sink enters the
+     * error state. Zero-initialized specs only listen on the UDP port.
+     */
+    const char* shm_name;
+    /**
+     * If not zero, the sink additionally accepts TCP connections on this port.
+     * Sources connect with a sink_hostname of "tcp://HOST" and the port in
+     * sink_port. Over TCP, messages arrive reliably and in order, and frames
+     * may be larger than a UDP packet.
+     */
+    int tcp_port;
+    /**
+     * If not NULL, the sink additionally accepts connections on a Unix domain
+     * socket at this path. Sources connect with a sink_hostname of
+     * "unix://" followed by the path.
+     */
+    const char* unix_path;
+    /**
+     * If not NULL, the sink additionally receives datagrams sent to this
+     * numeric multicast group address on its UDP port, e.g. "239.255.42.1".
+     * A source with the group as sink_hostname then drives all sinks in the
+     * group with a single copy of each frame. Replies to the source are still
+     * sent by unicast.
+     */
+    const char* multicast_group;
+    /**
+     * Amount of sources that may borrow the sink at the same time, e.g. two
+     * for an ambient show with an interactive overlay on top. Each source gets
+     * its own frame buffer and its own timeout, so when one source goes away,
+     * the others keep playing. Sources beyond this amount are refused.
+     *
+     * Zero-initialized specs accept a single source, like sinks always did.
+     */
+    int max_sources;
+    /**
+     * How frames of several sources are merged, see AtollaSinkBlendMode.
+     * Irrelevant if only one source is shown. Zero-initialized specs use
+     * ATOLLA_SINK_BLEND_HTP.
+     */
+    AtollaSinkBlendMode blend_mode;
+    /**
+     * Largest buffer length in frames that sources may borrow the sink with,
+     * at most 255. Each source gets a frame buffer of the size it asked for
+     * when it borrows, which is freed again when it goes away, so this only
+     * caps the memory that a single source can take up. Sources asking for
+     * more are refused.
+     *
+     * Zero-initialized specs accept up to 128 frames.
+     */
+    int max_buffer_length;
+    /**
+     * How frames that were lost on the way and not sent again in time are
+     * filled in, see AtollaSinkConcealment. Concealment happens entirely in
+     * the sink and adds nothing to the messages. Zero-initialized specs use
+     * ATOLLA_SINK_CONCEAL_REPEAT.
+     */
+    AtollaSinkConcealment concealment;
+    /**
+     * If true, each source borrowing over UDP gets a socket of its own for as
+     * long as it borrows, connected to the source and sharing the port of the
+     * sink through SO_REUSEPORT. The kernel then passes the packets of the
+     * borrower to that socket and the packets of everyone else to the socket
+     * of the sink, so strangers never get in the way of the frames.
+     *
+     * Sharing the port also lets other sinks of the same user bind to it
+     * without being refused. Multicast sinks and platforms that cannot share
+     * ports go without, and atolla_sink_poll_fd has no descriptor to offer
+     * for such sinks. Zero-initialized specs use the socket of the sink only.
+     */
+    bool connect_borrowers;
+    /**
+     * If not NULL, tunes the UDP socket of the sink and the sockets connected
+     * to borrowers, e.g. with a larger receive buffer so that bursts of frames
+     * are not dropped before the sink gets to them. The options are copied,
+     * so they need not outlive the call. NULL keeps the defaults of the
+     * operating system.
+     */
+    const AtollaSocketOptions* socket_options;
 };
 typedef struct AtollaSinkSpec AtollaSinkSpec;
 
+/**
+ * Counts what the sink dropped or left unanswered since it was made, e.g.
+ * because a misconfigured source or a flood of packets kept sending.
+ */
+struct AtollaSinkStats
+{
+    /**
+     * Messages that only borrowers may send, e.g. frames, that came from
+     * sources not borrowing the sink.
+     */
+    unsigned int foreign_count;
+    /**
+     * Messages that were malformed or of an unknown type.
+     */
+    unsigned int bad_count;
+    /**
+     * FAIL replies that were not sent, because the sender or all senders
+     * together already got as many as the sink sends in a while.
+     */
+    unsigned int fail_suppressed_count;
+    /**
+     * Calls that left datagrams waiting for later calls, because handling
+     * all of them at once would have held up atolla_sink_get.
+     */
+    unsigned int backlog_count;
+    /**
+     * ANNOUNCE replies to DISCOVER that were not sent, because the sender or
+     * all senders together already got as many replies as the sink sends in
+     * a while. They share the limits of FAIL replies.
+     */
+    unsigned int announce_suppressed_count;
+};
+typedef struct AtollaSinkStats AtollaSinkStats;
+
 /**
  * Intializes and creates a new sink.
  */
 AtollaSink atolla_sink_make(const AtollaSinkSpec* spec);
 
+/**
+ * Intializes a new sink in storage provided by the calling code, instead of
+ * allocating memory. No memory is allocated by the sink after this call, not
+ * even when sources borrow it, so memory use is fixed at compile time.
+ *
+ * All sources get a frame buffer of max_buffer_length frames, which must not
+ * be zero. Stream connections need dynamic memory, so tcp_port and unix_path
+ * must not be set.
+ *
+ * The storage must be at least atolla_sink_storage_size bytes large, which
+ * ATOLLA_SINK_STORAGE_SIZE and ATOLLA_SINK_LAYERED_STORAGE_SIZE are enough
+ * for. It must remain valid until atolla_sink_free is called, which releases
+ * everything but the storage itself.
+ */
+AtollaSink atolla_sink_init_in(const AtollaSinkSpec* spec, void* storage, size_t storage_size);
+
+/**
+ * Returns the amount of bytes of storage that atolla_sink_init_in needs for a
+ * sink with the given spec.
+ */
+size_t atolla_sink_storage_size(const AtollaSinkSpec* spec);
+
 /**
  * Frees data and resources associated with the sink. The sink
  * cannot be used anymore, unless it is re-initialized with an additional
@@ -59,6 +283,10 @@ void atolla_sink_free(AtollaSink sink);
 
 /**
  * Redetermines the state of the sink based on incoming packets.
+ *
+ * Each call handles a bounded amount of datagrams, so that a flood of
+ * packets cannot keep the caller from showing frames. The rest is handled by
+ * the next calls.
  */
 AtollaSinkState atolla_sink_state(AtollaSink sink);
 
@@ -79,6 +307,10 @@ const char* atolla_sink_error_msg(AtollaSink sink);
  *
  * If returns false, no frame available yet.
  *
+ * If several sources borrowed the sink, their current frames are merged
+ * according to the blend mode in the spec. Sources that have not sent their
+ * first frame yet are left out.
+ *
  * If atolla_sink_get is called with a buffer for more lights than
  * set in the spec, the stored frame is repeated as a pattern to fill
  * all of the given buffer. If atolla_sink_get is called with a buffer
@@ -86,4 +318,44 @@ const char* atolla_sink_error_msg(AtollaSink sink);
  */
 bool atolla_sink_get(AtollaSink sink, void* frame, size_t frame_len);
 
+/**
+ * Gets a descriptor that becomes readable when a source sent something to the
+ * sink, for use with poll, epoll, kqueue or the event loop of a library,
+ * together with atolla_sink_poll_timeout. The descriptor belongs to the sink
+ * and must not be read from or closed.
+ *
+ * Returns -1 in the error state and for sinks that also receive through
+ * shared memory, stream connections or sockets connected to borrowers, which
+ * one descriptor cannot cover.
+ * atolla_sink_poll_timeout then keeps the waits short instead.
+ */
+int atolla_sink_poll_fd(AtollaSink sink);
+
+/**
+ * Handles what sources sent and returns the amount of milliseconds after
+ * which the sink needs to be called again, even if the descriptor from
+ * atolla_sink_poll_fd did not become readable in the meantime. This is the
+ * time until atolla_sink_get returns the next frame, or until the sink has to
+ * send LENT again or drop a source that went silent, whichever comes first.
+ *
+ * Returns -1 if the sink only waits for sources to send something, and 0 if
+ * more datagrams arrived than one call handles.
+ */
+int atolla_sink_poll_timeout(AtollaSink sink);
+
+/**
+ * Gets counts of the traffic that the sink dropped or did not answer, since
+ * the sink was made.
+ */
+void atolla_sink_stats(AtollaSink sink, AtollaSinkStats* stats);
+
+/**
+ * Gets the values in effect for the options of the UDP socket of the sink,
+ * which may differ from the requested socket_options where the platform or
+ * the privileges of the process did not allow them, see AtollaSocketOptions.
+ *
+ * Returns false and leaves effective unchanged in the error state.
+ */
+bool atolla_sink_socket_options(AtollaSink sink, AtollaSocketOptions* effective);
+
 #endif // ATOLLA_SINK_H
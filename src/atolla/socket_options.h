@@ -0,0 +1,59 @@
+#ifndef ATOLLA_SOCKET_OPTIONS_H
+#define ATOLLA_SOCKET_OPTIONS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "primitives.h"
+
+/**
+ * Tuning for the UDP sockets of sinks and sources, for networks where the
+ * defaults of the operating system drop packets in bursts or treat frames
+ * like any other traffic.
+ *
+ * Fields that are zero keep the default of the operating system. Options
+ * that the platform does not know, or that need more privileges than the
+ * process has, are left out without an error. Sinks and sources report the
+ * values in effect afterwards, see atolla_sink_socket_options and
+ * atolla_source_socket_options.
+ */
+struct AtollaSocketOptions
+{
+    /**
+     * Bytes that the kernel buffers for received datagrams, SO_RCVBUF.
+     * Linux reports twice the requested amount, the other half holds its
+     * bookkeeping, and caps requests at net.core.rmem_max unless the process
+     * has CAP_NET_ADMIN.
+     */
+    int recv_buf_len;
+    /**
+     * Bytes that the kernel buffers for datagrams that wait to be sent,
+     * SO_SNDBUF, reported and capped like recv_buf_len.
+     */
+    int send_buf_len;
+    /**
+     * Microseconds that receiving polls the queue of the network device
+     * before sleeping, SO_BUSY_POLL on Linux. Trades CPU time for latency.
+     */
+    int busy_poll_us;
+    /**
+     * Differentiated services code point of sent packets from 1 to 63, set
+     * with IP_TOS and IPV6_TCLASS. E.g. 46 for expedited forwarding, which
+     * Wi-Fi usually maps to the voice access category, or 34 for the video
+     * access category.
+     */
+    int dscp;
+    /**
+     * Priority of sent packets in the queues of the network device, SO_PRIORITY
+     * on Linux. From 1 to 6 without CAP_NET_ADMIN.
+     */
+    int priority;
+};
+typedef struct AtollaSocketOptions AtollaSocketOptions;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ATOLLA_SOCKET_OPTIONS_H
@@ -2,12 +2,19 @@
 #include "error_codes.h"
 #include "../msg/builder.h"
 #include "../msg/iter.h"
+#include "../msg/reassembler.h"
+#include "../shm/channel.h"
+#include "../show/file.h"
+#include "../stream_socket/stream_socket.h"
 #include "../test/assert.h"
 #include "../time/now.h"
 #include "../time/sleep.h"
+#include "../time/sleep_until.h"
+#include "../udp_socket/udp_resolver.h"
 #include "../udp_socket/udp_socket.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef ATOLLA_SOURCE_RECV_BUF_LEN
 /**
@@ -22,30 +29,116 @@ static const size_t recv_buf_len = ATOLLA_SOURCE_RECV_BUF_LEN;
 static const unsigned int retry_timeout_ms_default = 100;
 static const unsigned int disconnect_timeout_ms_default = 750;
 static const int max_buffered_frames_default = 16;
+/** Amount of recently put frames kept for resending if the spec leaves it at zero */
+static const int retransmit_frames_default = 16;
+static const unsigned char multicast_ttl_default = 1;
+/** Opacity sent with borrow messages if the spec leaves it at zero, fully opaque */
+static const uint8_t opacity_default = 255;
 static const int blocking_make_refresh_interval = 5;
+/** Amount of show file bytes that are read ahead of playback and released behind it */
+static const size_t play_file_window_bytes = 4 * 1024 * 1024;
+/** Attempts to send a frame of a show file before playback fails */
+static const int play_file_put_attempts = 10;
+/**
+ * Largest show file frame that fits an ENQUEUE_PTS, the largest kind of
+ * ENQUEUE, with its 5 byte header and 8 byte payload fields in one UDP datagram
+ */
+static const size_t play_file_max_frame_len = 65507 - 5 - 8;
+/** Prefixes of sink hostnames that select a transport other than UDP */
+static const char shm_hostname_prefix[] = "shm://";
+static const char tcp_hostname_prefix[] = "tcp://";
+static const char unix_hostname_prefix[] = "unix://";
+/** Longest message expected from sinks over stream connections */
+static const size_t stream_max_msg_len = 256;
+/** Milliseconds between repetitions of a running effect, keeping the sink from timing out */
+static const unsigned int effect_refresh_interval_ms = 250;
+/**
+ * Longest poll timeout while no descriptor signals what the source is waiting
+ * for, that is while looking up the hostname or connected through shared memory
+ */
+static const int poll_interval_ms = 5;
 /** Special time value meant to represent no time set */
 // FIXME this is actually a valid point in time, maybe use unions with use flag?
 static const unsigned int NULL_TIME = ~0;
+static const unsigned long long NULL_TIME_US = ~0ULL;
+
+enum SourceTransport
+{
+    SOURCE_TRANSPORT_UDP,
+    // UDP to a multicast group, each sink in the group replies by unicast
+    SOURCE_TRANSPORT_MULTICAST,
+    // Shared memory with a sink on the same host
+    SOURCE_TRANSPORT_LOCAL,
+    // TCP or Unix domain stream socket
+    SOURCE_TRANSPORT_STREAM
+};
+typedef enum SourceTransport SourceTransport;
+
+/**
+ * An ENQUEUE16 message that was sent, kept in case the sink asks for it again.
+ */
+struct SourceSentFrame
+{
+    bool valid;
+    uint16_t frame_seq;
+    // When the sink is expected to show the frame, in microseconds on the
+    // monotonic clock, resending is pointless after that
+    unsigned long long due_time_us;
+    MemBlock msg;
+};
+typedef struct SourceSentFrame SourceSentFrame;
 
 struct AtollaSourcePrivate
 {
     AtollaSourceState state;
+    SourceTransport transport;
     UdpSocket sock;
+    // Group address for multicast, the socket is not connected in that case
+    // so that it receives the replies of all sinks
+    UdpEndpoint multicast_group;
+    // Sender of the last received packet, to answer single sinks of a group
+    UdpEndpoint last_sender;
+    // The sink hostname is being looked up, borrowing starts when it is done
+    bool resolving;
+    UdpResolve resolve;
+    unsigned char multicast_ttl;
+    ShmChannel channel;
+    StreamSocket stream;
+    MsgReassembler stream_reassembler;
     uint8_t recv_buf[ATOLLA_SOURCE_RECV_BUF_LEN];
     
     MsgBuilder builder;
 
+    // Counts with 16 bits, ENQUEUE only sends the lower 8 bits
     int next_frame_idx;
+    // Capabilities granted by the sink with LENT
+    uint8_t capabilities;
     unsigned int frame_duration_ms;
+    AtollaPixelFormat pixel_format;
+    uint8_t priority;
+    uint8_t opacity;
     int max_buffered_frames;
     unsigned int retry_timeout_ms;
     unsigned int disconnect_timeout_ms;
 
     unsigned int first_borrow_time;
     unsigned int last_borrow_time;
-    unsigned int last_frame_time;
+    // Time that the last put frame is due in the sink, in microseconds on the
+    // monotonic clock, so that pacing does not lose fractions of milliseconds
+    unsigned long long last_frame_time_us;
     unsigned int last_recv_lent_time;
 
+    unsigned int pacing_spin_us;
+    AtollaSourcePacing pacing;
+
+    // Indexed by sequence number modulo the length, empty if retransmission is off
+    SourceSentFrame* sent_frames;
+    size_t sent_frames_len;
+
+    // EFFECT message of the effect the sink is rendering, empty while frames are put
+    MemBlock effect_msg;
+    unsigned int last_effect_send_time;
+
     const char* error_msg;
 };
 typedef struct AtollaSourcePrivate AtollaSourcePrivate;
@@ -53,38 +146,47 @@ typedef struct AtollaSourcePrivate AtollaSourcePrivate;
 static AtollaSourcePrivate* source_private_make(const AtollaSourceSpec* spec);
 static void source_await_make_completion(AtollaSourcePrivate* source);
 static void source_send_borrow(AtollaSourcePrivate* source);
+static void source_send_borrow_to(AtollaSourcePrivate* source, UdpEndpoint* sink);
+static void source_multicast_fail(AtollaSourcePrivate* source, uint8_t error_code);
 static void source_update(AtollaSourcePrivate* source);
-static void source_iterate_recv_buf(AtollaSourcePrivate* sink, size_t received_bytes);
-static void source_lent(AtollaSourcePrivate* source);
+static void source_record_pacing(AtollaSourcePrivate* source, unsigned long long late_us);
+static void source_connect(AtollaSourcePrivate* source, const AtollaSourceSpec* spec);
+static void source_finish_resolving(AtollaSourcePrivate* source);
+static void source_start_borrowing(AtollaSourcePrivate* source);
+static bool source_send(AtollaSourcePrivate* source, MemBlock* msg);
+static void source_receive_stream(AtollaSourcePrivate* source);
+static bool has_prefix(const char* str, const char* prefix);
+static void source_iterate_recv_buf(AtollaSourcePrivate* source, void* packet, size_t packet_len);
+static void source_lent(AtollaSourcePrivate* source, MsgIter* lent);
+static unsigned long long source_first_frame_time_us(AtollaSourcePrivate* source);
+static uint8_t source_offered_capabilities(AtollaSourcePrivate* source);
+static void source_remember_sent(AtollaSourcePrivate* source, uint16_t frame_seq, MemBlock* msg);
+static void source_resend(AtollaSourcePrivate* source, MsgIter* nack);
 static void source_fail(AtollaSourcePrivate* source, const char* error_msg);
 static void source_receive(AtollaSourcePrivate* source);
 static void source_manage_borrow_packet_loss(AtollaSourcePrivate* source);
 static void source_ensure_lent_resent(AtollaSourcePrivate* source);
+static void source_refresh_effect(AtollaSourcePrivate* source);
+static int source_ms_until(unsigned int deadline);
 
 AtollaSource atolla_source_make(const AtollaSourceSpec* spec)
 {
     assert(spec->sink_port >= 0 && spec->sink_port < 65536);
+    assert(atolla_pixel_format_size(spec->pixel_format) > 0);
+    assert(spec->priority >= 0 && spec->priority < 256);
+    assert(spec->opacity >= 0 && spec->opacity < 256);
+    assert(spec->pacing_spin_us >= 0);
 
     AtollaSourcePrivate* source = source_private_make(spec);
 
     msg_builder_init(&source->builder);
 
-    UdpSocketResult result;
-    
-    result = udp_socket_init(&source->sock);
-    if(result.code == UDP_SOCKET_OK) {
-        result = udp_socket_set_receiver(&source->sock, spec->sink_hostname, (unsigned short) spec->sink_port);
-        if(result.code == UDP_SOCKET_OK) {
-            // If hostname could be resolved, send first borrow
-            source->first_borrow_time = time_now();
-            source_send_borrow(source);
-        } else {
-            // If resolving failed, immediately enter error state
-            source->state = ATOLLA_SOURCE_STATE_ERROR;
-            source_fail(source, "Sink hostname could not be resolved.");
-        }
-    } else {
-        source_fail(source, "Sink could not bind to port.");
+    source_connect(source, spec);
+
+    if(source->state == ATOLLA_SOURCE_STATE_WAITING && !source->resolving)
+    {
+        // If the sink could be reached, send first borrow
+        source_start_borrowing(source);
     }
 
     if(!spec->async_make)
@@ -96,20 +198,153 @@ AtollaSource atolla_source_make(const AtollaSourceSpec* spec)
     return source_handle;
 }
 
+/**
+ * Opens the transport selected by the sink hostname, or enters the error state
+ * if that fails.
+ */
+static void source_connect(AtollaSourcePrivate* source, const AtollaSourceSpec* spec)
+{
+    const char* hostname = spec->sink_hostname;
+
+    if(hostname != NULL && has_prefix(hostname, shm_hostname_prefix))
+    {
+        source->transport = SOURCE_TRANSPORT_LOCAL;
+        if(!shm_channel_attach(&source->channel, hostname + strlen(shm_hostname_prefix)))
+        {
+            source_fail(source, "Could not attach to the shared-memory segment of the sink. Either the sink is not running or another source is attached.");
+        }
+    }
+    else if(hostname != NULL && (has_prefix(hostname, tcp_hostname_prefix) || has_prefix(hostname, unix_hostname_prefix)))
+    {
+        source->transport = SOURCE_TRANSPORT_STREAM;
+        msg_reassembler_init(&source->stream_reassembler, stream_max_msg_len);
+
+        bool connected = has_prefix(hostname, tcp_hostname_prefix) ?
+            stream_socket_connect_tcp(&source->stream, hostname + strlen(tcp_hostname_prefix), (unsigned short) spec->sink_port) :
+            stream_socket_connect_unix(&source->stream, hostname + strlen(unix_hostname_prefix));
+
+        if(!connected)
+        {
+            source_fail(source, "Could not connect to the sink. Either the sink is not running or it does not accept stream connections.");
+        }
+    }
+    else
+    {
+        source->transport = SOURCE_TRANSPORT_UDP;
+
+        UdpSocketResult result = udp_socket_init(&source->sock);
+        if(result.code != UDP_SOCKET_OK) {
+            source_fail(source, "Sink could not bind to port.");
+            return;
+        }
+
+        if(spec->socket_options != NULL)
+        {
+            // Best effort, atolla_source_socket_options reports what was applied
+            UdpSocketOptions options;
+            options.recv_buf_len = spec->socket_options->recv_buf_len;
+            options.send_buf_len = spec->socket_options->send_buf_len;
+            options.busy_poll_us = spec->socket_options->busy_poll_us;
+            options.dscp = spec->socket_options->dscp;
+            options.priority = spec->socket_options->priority;
+            udp_socket_set_options(&source->sock, &options);
+        }
+
+        // Numeric and cached hostnames are done right away, others are looked
+        // up in the background and finished in source_update
+        source->multicast_ttl = (spec->multicast_ttl == 0) ? multicast_ttl_default : (unsigned char) spec->multicast_ttl;
+        source->resolving = true;
+        udp_resolve_start(&source->resolve, hostname, (unsigned short) spec->sink_port);
+        source_finish_resolving(source);
+    }
+}
+
+/**
+ * Checks whether the lookup of the sink hostname completed and if so, points
+ * the socket at the sink or the multicast group.
+ */
+static void source_finish_resolving(AtollaSourcePrivate* source)
+{
+    UdpEndpoint sink_endpoint;
+    UdpResolveStatus status = udp_resolve_poll(&source->resolve, &sink_endpoint);
+
+    if(status == UDP_RESOLVE_PENDING) {
+        return;
+    }
+
+    source->resolving = false;
+
+    if(status == UDP_RESOLVE_FAILED) {
+        // If resolving failed, immediately enter error state
+        source_fail(source, "Sink hostname could not be resolved.");
+    } else if(udp_endpoint_is_multicast(&sink_endpoint)) {
+        source->transport = SOURCE_TRANSPORT_MULTICAST;
+        source->multicast_group = sink_endpoint;
+
+        udp_socket_set_multicast_ttl(&source->sock, source->multicast_ttl);
+        // Sinks on the same host are members of the group too
+        udp_socket_set_multicast_loopback(&source->sock, true);
+    } else {
+        UdpSocketResult result = udp_socket_set_endpoint(&source->sock, &sink_endpoint);
+        if(result.code != UDP_SOCKET_OK) {
+            source_fail(source, "Sink hostname could not be resolved.");
+        }
+    }
+}
+
+/**
+ * Sends the first borrow. The disconnect timeout counts from here, so time
+ * spent looking up the hostname does not count against it.
+ */
+static void source_start_borrowing(AtollaSourcePrivate* source)
+{
+    source->first_borrow_time = time_now();
+    source_send_borrow(source);
+}
+
 static AtollaSourcePrivate* source_private_make(const AtollaSourceSpec* spec)
 {
     AtollaSourcePrivate* source = (AtollaSourcePrivate*) malloc(sizeof(AtollaSourcePrivate));
 
     source->state = ATOLLA_SOURCE_STATE_WAITING;
+    source->transport = SOURCE_TRANSPORT_UDP;
+    memset(&source->channel, 0, sizeof(ShmChannel));
+    memset(&source->stream_reassembler, 0, sizeof(MsgReassembler));
+    source->stream.handle = -1;
+    source->resolving = false;
+    memset(&source->resolve, 0, sizeof(UdpResolve));
+    source->multicast_ttl = multicast_ttl_default;
     source->next_frame_idx = 0;
+    source->capabilities = 0;
     source->frame_duration_ms = spec->frame_duration_ms;
+    source->pixel_format = spec->pixel_format;
+    source->priority = (uint8_t) spec->priority;
+    source->opacity = (spec->opacity == 0) ? opacity_default : (uint8_t) spec->opacity;
     source->max_buffered_frames = (spec->max_buffered_frames == 0) ? max_buffered_frames_default : spec->max_buffered_frames;
     source->retry_timeout_ms = (spec->retry_timeout_ms == 0) ? retry_timeout_ms_default : spec->retry_timeout_ms;
     source->disconnect_timeout_ms = (spec->disconnect_timeout_ms == 0) ? disconnect_timeout_ms_default : spec->disconnect_timeout_ms;
 
     source->first_borrow_time = 0;
     source->last_borrow_time = 0;
-    source->last_frame_time = 0;
+    source->last_frame_time_us = 0;
+    source->pacing_spin_us = (unsigned int) spec->pacing_spin_us;
+    memset(&source->pacing, 0, sizeof(AtollaSourcePacing));
+
+    int retransmit_frames = (spec->retransmit_frames == 0) ? retransmit_frames_default : spec->retransmit_frames;
+    source->sent_frames_len = (retransmit_frames > 0) ? (size_t) retransmit_frames : 0;
+    source->sent_frames = NULL;
+    if(source->sent_frames_len > 0)
+    {
+        source->sent_frames = (SourceSentFrame*) malloc(source->sent_frames_len * sizeof(SourceSentFrame));
+        for(size_t i = 0; i < source->sent_frames_len; ++i)
+        {
+            source->sent_frames[i].valid = false;
+            source->sent_frames[i].msg = mem_block_alloc(0);
+        }
+    }
+
+    source->effect_msg = mem_block_alloc(0);
+    source->last_effect_send_time = 0;
 
     return source;
 }
@@ -118,7 +353,12 @@ static void source_await_make_completion(AtollaSourcePrivate* source)
 {
     while(source->state == ATOLLA_SOURCE_STATE_WAITING)
     {
-        if(blocking_make_refresh_interval > 0)
+        if(source->transport == SOURCE_TRANSPORT_LOCAL)
+        {
+            // Wake up as soon as the sink responds instead of polling
+            shm_channel_wait(&source->channel, blocking_make_refresh_interval);
+        }
+        else if(blocking_make_refresh_interval > 0)
         {
             time_sleep(blocking_make_refresh_interval);
         }
@@ -130,7 +370,30 @@ void atolla_source_free(AtollaSource source_handle)
 {
     AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
 
-    udp_socket_free(&source->sock);
+    switch(source->transport)
+    {
+        case SOURCE_TRANSPORT_UDP:
+        case SOURCE_TRANSPORT_MULTICAST:
+            udp_resolve_free(&source->resolve);
+            udp_socket_free(&source->sock);
+            break;
+
+        case SOURCE_TRANSPORT_LOCAL:
+            shm_channel_close(&source->channel);
+            break;
+
+        case SOURCE_TRANSPORT_STREAM:
+            stream_socket_close(&source->stream);
+            msg_reassembler_free(&source->stream_reassembler);
+            break;
+    }
+
+    for(size_t i = 0; i < source->sent_frames_len; ++i)
+    {
+        mem_block_free(&source->sent_frames[i].msg);
+    }
+    free(source->sent_frames);
+    mem_block_free(&source->effect_msg);
 
     free(source);
 }
@@ -171,15 +434,17 @@ int atolla_source_put_ready_count(AtollaSource source_handle)
     {
         assert(source->state == ATOLLA_SOURCE_STATE_OPEN);
 
-        if(source->last_frame_time == NULL_TIME)
+        if(source->last_frame_time_us == NULL_TIME_US)
         {
             // If connected, but no frame was enqueued yet, report maximum lag
             return source->max_buffered_frames;
         }
         else
         {
-            // Otherwise, calculate lag based on the time of the last enqueued frame
-            return (time_now() - source->last_frame_time) / source->frame_duration_ms;
+            // Otherwise, calculate lag based on the time of the last enqueued frame,
+            // which lies ahead of now if the first frame was aligned to the clock
+            long long behind_us = (long long) (time_now_us() - source->last_frame_time_us);
+            return (behind_us <= 0) ? 0 : (int) (behind_us / (source->frame_duration_ms * 1000LL));
         }
     }
 }
@@ -197,23 +462,110 @@ int atolla_source_put_ready_timeout(AtollaSource source_handle)
         // report lagging behind 0 frames
         return -1;
     }
-    else if(source->last_frame_time == NULL_TIME)
+    else if(source->last_frame_time_us == NULL_TIME_US)
     {
         return 0;
     }
     else
     {
-        int readyCount = (time_now() - source->last_frame_time) / source->frame_duration_ms;
+        unsigned long long ready_time_us = source->last_frame_time_us + source->frame_duration_ms * 1000ULL;
+        long long wait_us = (long long) (ready_time_us - time_now_us());
 
-        if(readyCount > 0) {
+        if(wait_us <= 0) {
             return 0;
         } else {
-            return (source->last_frame_time + source->frame_duration_ms) - time_now();
+            // Round up, so waiting for the returned time is always enough
+            return (int) ((wait_us + 999) / 1000);
         }
     }    
 }
 
-bool atolla_source_put(AtollaSource source_handle, void* frame, size_t frame_len)
+int atolla_source_poll_fd(AtollaSource source_handle)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    if(source->state == ATOLLA_SOURCE_STATE_ERROR)
+    {
+        return -1;
+    }
+
+    switch(source->transport)
+    {
+        case SOURCE_TRANSPORT_UDP:
+        case SOURCE_TRANSPORT_MULTICAST:
+            return udp_socket_poll_handle(&source->sock);
+
+        case SOURCE_TRANSPORT_STREAM:
+            return source->stream.handle;
+
+        default:
+            // Shared memory wakes up with a futex, which cannot be polled
+            return -1;
+    }
+}
+
+int atolla_source_poll_timeout(AtollaSource source_handle)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    source_update(source);
+
+    if(source->state == ATOLLA_SOURCE_STATE_ERROR)
+    {
+        return -1;
+    }
+
+    if(source->resolving)
+    {
+        return poll_interval_ms;
+    }
+
+    int timeout_ms;
+
+    if(source->state == ATOLLA_SOURCE_STATE_WAITING)
+    {
+        // Both are checked with a strictly greater comparison, hence the + 1
+        int retry_ms = source_ms_until(source->last_borrow_time + source->retry_timeout_ms + 1);
+        int fail_ms = source_ms_until(source->first_borrow_time + source->disconnect_timeout_ms + 1);
+        timeout_ms = (retry_ms < fail_ms) ? retry_ms : fail_ms;
+    }
+    else
+    {
+        timeout_ms = source_ms_until(source->last_recv_lent_time + source->disconnect_timeout_ms);
+
+        if(source->effect_msg.size > 0)
+        {
+            int refresh_ms = source_ms_until(source->last_effect_send_time + effect_refresh_interval_ms);
+            timeout_ms = (refresh_ms < timeout_ms) ? refresh_ms : timeout_ms;
+        }
+
+        // Only a put that is not ready yet is worth waking up for, otherwise
+        // sources that have nothing to put would never sleep
+        int ready_ms = atolla_source_put_ready_timeout(source_handle);
+        if(ready_ms > 0 && ready_ms < timeout_ms)
+        {
+            timeout_ms = ready_ms;
+        }
+    }
+
+    if(source->transport == SOURCE_TRANSPORT_LOCAL && timeout_ms > poll_interval_ms)
+    {
+        timeout_ms = poll_interval_ms;
+    }
+
+    return timeout_ms;
+}
+
+/**
+ * Milliseconds from now until the given time, or 0 if it has passed.
+ */
+static int source_ms_until(unsigned int deadline)
+{
+    int remaining_ms = (int) (deadline - time_now());
+    return (remaining_ms < 0) ? 0 : remaining_ms;
+}
+
+bool atolla_source_put(AtollaSource source_handle, const void* frame, size_t frame_len)
 {
     AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
 
@@ -225,67 +577,328 @@ bool atolla_source_put(AtollaSource source_handle, void* frame, size_t frame_len
     }
 
     // If the receiving device has no space in the buffer to hold new frames,
-    // wait until the next frame was dequeued in the sink
-    int timeout = atolla_source_put_ready_timeout(source_handle);
-    if(timeout > 0)
+    // wait until the next frame was dequeued in the sink. The deadline is
+    // absolute, so oversleeping once does not delay all later frames.
+    if(source->last_frame_time_us != NULL_TIME_US)
+    {
+        unsigned long long ready_time_us = source->last_frame_time_us + source->frame_duration_ms * 1000ULL;
+        if((long long) (ready_time_us - time_now_us()) > 0)
+        {
+            unsigned long long late_us = time_sleep_until_us(ready_time_us, source->pacing_spin_us);
+            source_record_pacing(source, late_us);
+        }
+    }
+
+    // Advance the last frame time with each frame, so we get closer to the point where no more
+    // frame can be enqueued
+    unsigned long long frame_time_us = (source->last_frame_time_us == NULL_TIME_US) ?
+        source_first_frame_time_us(source) :
+        source->last_frame_time_us + source->frame_duration_ms * 1000ULL;
+
+    MemBlock* enqueue_msg;
+    if(source->capabilities & MSG_CAPABILITY_PTS)
+    {
+        // The frame is shown after the frames buffered ahead of it
+        unsigned long long due_time_us = frame_time_us + (source->max_buffered_frames - 1) * source->frame_duration_ms * 1000ULL;
+        enqueue_msg = msg_builder_enqueue_pts(&source->builder, (uint16_t) source->next_frame_idx, (uint32_t) due_time_us, frame, frame_len);
+    }
+    else if(source->capabilities & MSG_CAPABILITY_ENQUEUE16)
+    {
+        enqueue_msg = msg_builder_enqueue16(&source->builder, (uint16_t) source->next_frame_idx, frame, frame_len);
+    }
+    else
     {
-        time_sleep(timeout);
+        enqueue_msg = msg_builder_enqueue(&source->builder, (uint8_t) source->next_frame_idx, frame, frame_len);
     }
 
-    MemBlock* enqueue_msg = msg_builder_enqueue(&source->builder, source->next_frame_idx, frame, frame_len);
-    UdpSocketResult send_result = udp_socket_send(&source->sock, enqueue_msg->data, enqueue_msg->size);
-    if(send_result.code != UDP_SOCKET_OK)
+    if(!source_send(source, enqueue_msg))
     {
         return false;
     }
     else
     {
-        source->next_frame_idx = (source->next_frame_idx + 1) % 256;
-        
-        if(source->last_frame_time == NULL_TIME)
-        {
-            source->last_frame_time = time_now() - (source->max_buffered_frames - 1) * source->frame_duration_ms;
-        }
-        else
+        source->last_frame_time_us = frame_time_us;
+
+        if(source->capabilities & MSG_CAPABILITY_NACK)
         {
-            // Otherwise, advance the last frame time, so we get closer to the point where no more
-            // frame can be enqueued
-            source->last_frame_time += source->frame_duration_ms;
+            source_remember_sent(source, (uint16_t) source->next_frame_idx, enqueue_msg);
         }
+
+        source->next_frame_idx = (source->next_frame_idx + 1) % 65536;
+        // The sink stopped the effect when the frame arrived
+        mem_block_resize(&source->effect_msg, 0);
     
         return true;   
     }
 }
 
+bool atolla_source_effect(AtollaSource source_handle, AtollaEffect effect, const void* from_color, const void* to_color, int wavelength, int period_ms)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    assert(wavelength >= 0 && wavelength < 65536);
+    assert(period_ms >= 0 && period_ms < 65536);
+
+    source_update(source);
+
+    if(source->state != ATOLLA_SOURCE_STATE_OPEN || !(source->capabilities & MSG_CAPABILITY_EFFECT))
+    {
+        return false;
+    }
+
+    MemBlock* effect_msg = msg_builder_effect(
+        &source->builder,
+        (uint8_t) effect, (uint16_t) wavelength, (uint16_t) period_ms,
+        from_color, to_color, atolla_pixel_format_size(source->pixel_format)
+    );
+    if(!source_send(source, effect_msg))
+    {
+        return false;
+    }
+
+    // Kept for repeating, until frames are put again
+    mem_block_resize(&source->effect_msg, (effect == ATOLLA_EFFECT_NONE) ? 0 : effect_msg->size);
+    memcpy(source->effect_msg.data, effect_msg->data, source->effect_msg.size);
+    source->last_effect_send_time = time_now();
+
+    return true;
+}
+
+void atolla_source_pacing(AtollaSource source_handle, AtollaSourcePacing* pacing)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+    *pacing = source->pacing;
+}
+
+bool atolla_source_socket_options(AtollaSource source_handle, AtollaSocketOptions* effective)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+    if(source->state == ATOLLA_SOURCE_STATE_ERROR ||
+       (source->transport != SOURCE_TRANSPORT_UDP && source->transport != SOURCE_TRANSPORT_MULTICAST))
+    {
+        return false;
+    }
+
+    UdpSocketOptions options;
+    udp_socket_get_options(&source->sock, &options);
+    effective->recv_buf_len = options.recv_buf_len;
+    effective->send_buf_len = options.send_buf_len;
+    effective->busy_poll_us = options.busy_poll_us;
+    effective->dscp = options.dscp;
+    effective->priority = options.priority;
+    return true;
+}
+
+/**
+ * Adds how late a put that had to wait for its deadline woke up to the
+ * pacing statistics.
+ */
+static void source_record_pacing(AtollaSourcePrivate* source, unsigned long long late_us)
+{
+    // Bucket 0 counts sends within a microsecond, bucket i up to 2^i microseconds late
+    size_t bucket = 0;
+    while(bucket < (ATOLLA_SOURCE_PACING_BUCKETS - 1) && late_us >= (1ULL << bucket))
+    {
+        ++bucket;
+    }
+
+    ++source->pacing.histogram[bucket];
+    ++source->pacing.paced_count;
+    if(late_us > source->pacing.late_us_max)
+    {
+        source->pacing.late_us_max = (unsigned int) late_us;
+    }
+}
+
+bool atolla_source_play_file(AtollaSource source_handle, const char* path)
+{
+    AtollaSourcePrivate* source = (AtollaSourcePrivate*) source_handle.internal;
+
+    if(atolla_source_state(source_handle) != ATOLLA_SOURCE_STATE_OPEN)
+    {
+        return false;
+    }
+
+    ShowFile show;
+    if(!show_file_open(&show, path))
+    {
+        return false;
+    }
+
+    if(show.frame_duration_ms != source->frame_duration_ms || show.frame_stride > play_file_max_frame_len)
+    {
+        show_file_close(&show);
+        return false;
+    }
+
+    size_t window_frames = play_file_window_bytes / show.frame_stride;
+    if(window_frames == 0)
+    {
+        window_frames = 1;
+    }
+
+    show_file_advise(&show, 0, window_frames, 0);
+
+    bool completed = true;
+    for(size_t frame_idx = 0; frame_idx < show.frame_count; ++frame_idx)
+    {
+        if(frame_idx % window_frames == 0 && frame_idx > 0)
+        {
+            // Entering the next window, read ahead one more and let go of the one before the last
+            size_t release_before = (frame_idx > window_frames) ? (frame_idx - window_frames) : 0;
+            show_file_advise(&show, frame_idx + window_frames, window_frames, release_before);
+        }
+
+        const void* frame = show_file_frame(&show, frame_idx);
+
+        bool put = false;
+        for(int attempt = 0; !put && attempt < play_file_put_attempts; ++attempt)
+        {
+            put = atolla_source_put(source_handle, frame, show.frame_stride);
+            if(!put && source->state == ATOLLA_SOURCE_STATE_OPEN)
+            {
+                // Probably the send buffer is full, give it a moment
+                time_sleep(1);
+            }
+        }
+
+        if(!put || source->state != ATOLLA_SOURCE_STATE_OPEN)
+        {
+            completed = false;
+            break;
+        }
+    }
+
+    show_file_close(&show);
+
+    return completed;
+}
+
 static void source_send_borrow(AtollaSourcePrivate* source)
 {
     source->last_borrow_time = time_now();
-    MemBlock* borrow_msg = msg_builder_borrow(&source->builder, source->frame_duration_ms, source->max_buffered_frames);
-    udp_socket_send(&source->sock, borrow_msg->data, borrow_msg->size);
+    MemBlock* borrow_msg = msg_builder_borrow(&source->builder, source->frame_duration_ms, source->max_buffered_frames, source->pixel_format, source->priority, source->opacity, source_offered_capabilities(source));
+    source_send(source, borrow_msg);
+}
+
+static void source_send_borrow_to(AtollaSourcePrivate* source, UdpEndpoint* sink)
+{
+    MemBlock* borrow_msg = msg_builder_borrow(&source->builder, source->frame_duration_ms, source->max_buffered_frames, source->pixel_format, source->priority, source->opacity, source_offered_capabilities(source));
+    udp_socket_send_to(&source->sock, borrow_msg->data, borrow_msg->size, sink);
+}
+
+static bool source_send(AtollaSourcePrivate* source, MemBlock* msg)
+{
+    switch(source->transport)
+    {
+        case SOURCE_TRANSPORT_MULTICAST:
+            return udp_socket_send_to(&source->sock, msg->data, msg->size, &source->multicast_group).code == UDP_SOCKET_OK;
+
+        case SOURCE_TRANSPORT_LOCAL:
+            return shm_channel_send(&source->channel, msg->data, msg->size);
+
+        case SOURCE_TRANSPORT_STREAM:
+        {
+            // Wait for space in the send buffer rather than cutting a message in half
+            StreamSocketStatus status = stream_socket_send(&source->stream, msg->data, msg->size, source->disconnect_timeout_ms);
+            if(status != STREAM_SOCKET_OK)
+            {
+                source_fail(source, "The stream connection to the sink broke or the sink stopped reading from it.");
+            }
+            return status == STREAM_SOCKET_OK;
+        }
+
+        default:
+            return udp_socket_send(&source->sock, msg->data, msg->size).code == UDP_SOCKET_OK;
+    }
 }
 
 static void source_update(AtollaSourcePrivate* source)
 {
+    if(source->resolving)
+    {
+        source_finish_resolving(source);
+        if(source->resolving)
+        {
+            return;
+        }
+        else if(source->state == ATOLLA_SOURCE_STATE_WAITING)
+        {
+            source_start_borrowing(source);
+        }
+    }
+
     source_receive(source);
     source_manage_borrow_packet_loss(source);
     source_ensure_lent_resent(source);
+    source_refresh_effect(source);
 }
 
 static void source_receive(AtollaSourcePrivate* source)
 {
+    if(source->transport == SOURCE_TRANSPORT_STREAM)
+    {
+        source_receive_stream(source);
+        return;
+    }
+
+    if(source->transport == SOURCE_TRANSPORT_LOCAL)
+    {
+        void* packet;
+        size_t packet_len;
+        while(shm_channel_peek(&source->channel, &packet, &packet_len))
+        {
+            source_iterate_recv_buf(source, packet, packet_len);
+            shm_channel_release(&source->channel);
+        }
+        return;
+    }
+
+    // Everything that arrived is handled, so that a descriptor from
+    // atolla_source_poll_fd is not readable anymore afterwards
     size_t received_len;
-    UdpSocketResult result;
+    while(udp_socket_receive_from(&source->sock, source->recv_buf, recv_buf_len, &received_len, &source->last_sender).code == UDP_SOCKET_OK)
+    {
+        source_iterate_recv_buf(source, source->recv_buf, received_len);
+    }
+}
 
-    result = udp_socket_receive(
-        &source->sock,
-        source->recv_buf, recv_buf_len,
-        &received_len,
-        false
-    );
+static void source_receive_stream(AtollaSourcePrivate* source)
+{
+    if(source->state == ATOLLA_SOURCE_STATE_ERROR)
+    {
+        return;
+    }
+
+    size_t space_len;
+    void* space = msg_reassembler_space(&source->stream_reassembler, &space_len);
+    size_t received_len;
+    StreamSocketStatus status = stream_socket_receive(&source->stream, space, space_len, &received_len);
+
+    if(status == STREAM_SOCKET_OK)
+    {
+        msg_reassembler_commit(&source->stream_reassembler, received_len);
+
+        void* msgs;
+        size_t msgs_len = msg_reassembler_complete(&source->stream_reassembler, &msgs);
+        if(msgs_len > 0)
+        {
+            source_iterate_recv_buf(source, msgs, msgs_len);
+            msg_reassembler_consume(&source->stream_reassembler, msgs_len);
+        }
 
-    if(result.code == UDP_SOCKET_OK)
+        if(msg_reassembler_overflowed(&source->stream_reassembler))
+        {
+            source_fail(source, "Received a message from the sink that is too long. This might be due to incompatible versions of the atolla protocol.");
+        }
+    }
+    else if(status == STREAM_SOCKET_CLOSED)
     {
-        source_iterate_recv_buf(source, received_len);
+        source_fail(source, "The sink closed the connection.");
+    }
+    else if(status == STREAM_SOCKET_ERROR)
+    {
+        source_fail(source, "The stream connection to the sink broke.");
     }
 }
 
@@ -320,9 +933,9 @@ static void source_ensure_lent_resent(AtollaSourcePrivate* source)
     }
 }
 
-static void source_iterate_recv_buf(AtollaSourcePrivate* source, size_t received_bytes)
+static void source_iterate_recv_buf(AtollaSourcePrivate* source, void* packet, size_t packet_len)
 {
-    MsgIter iter = msg_iter_make(source->recv_buf, received_bytes);
+    MsgIter iter = msg_iter_make(packet, packet_len);
 
     for(; msg_iter_has_msg(&iter); msg_iter_next(&iter))
     {
@@ -332,12 +945,24 @@ static void source_iterate_recv_buf(AtollaSourcePrivate* source, size_t received
         {
             case MSG_TYPE_LENT:
             {
-                source_lent(source);
+                source_lent(source, &iter);
+                break;
+            }
+
+            case MSG_TYPE_NACK:
+            {
+                source_resend(source, &iter);
                 break;
             }
 
             case MSG_TYPE_FAIL:
             {
+                if(source->transport == SOURCE_TRANSPORT_MULTICAST)
+                {
+                    source_multicast_fail(source, msg_iter_fail_error_code(&iter));
+                    break;
+                }
+
                 switch(msg_iter_fail_error_code(&iter))
                 {
                     case ATOLLA_ERROR_CODE_NOT_BORROWED:
@@ -364,6 +989,10 @@ static void source_iterate_recv_buf(AtollaSourcePrivate* source, size_t received
                         source_fail(source, "The sink signalled that it did not receive packets for so long, it deems the connection no longer working. This might be due to bad signal quality or the source failing to enqueue frames for too long.");
                         break;
 
+                    case ATOLLA_ERROR_CODE_UNSUPPORTED_PIXEL_FORMAT:
+                        source_fail(source, "The sink cannot output frames in the pixel format of the source. Use the pixel format that the sink was configured with.");
+                        break;
+
                     default:
                         source_fail(source, "The sink signalled an unrecoverable error state.");
                         break;
@@ -382,18 +1011,145 @@ static void source_iterate_recv_buf(AtollaSourcePrivate* source, size_t received
     }
 }
 
-static void source_lent(AtollaSourcePrivate* source)
+static void source_lent(AtollaSourcePrivate* source, MsgIter* lent)
 {
     if(source->state == ATOLLA_SOURCE_STATE_WAITING)
     {
+        // Only what was offered, in case the sink grants more
+        source->capabilities = msg_iter_lent_capabilities(lent) & source_offered_capabilities(source);
         source->state = ATOLLA_SOURCE_STATE_OPEN;
-        source->last_frame_time = NULL_TIME;
+        source->last_frame_time_us = NULL_TIME_US;
         source->last_recv_lent_time = time_now();
     }
     else if(source->state == ATOLLA_SOURCE_STATE_OPEN)
     {
         source->last_recv_lent_time = time_now();
     }
+    else
+    {
+        return;
+    }
+
+    if((source->capabilities & MSG_CAPABILITY_PTS) && msg_iter_lent_has_clock(lent))
+    {
+        // Answer right away, any delay here counts as network delay for the sink
+        MemBlock* clock_msg = msg_builder_clock(&source->builder, msg_iter_lent_clock(lent), (uint32_t) time_now_us());
+        source_send(source, clock_msg);
+    }
+}
+
+/**
+ * The last frame time for the first frame after borrowing. Without
+ * presentation times, the first frame is shown as soon as it arrives.
+ *
+ * With presentation times, the first frame is due one frame duration from now
+ * at the earliest, leaving time for the trip to the sink, and rounded up to
+ * a multiple of the frame duration on the monotonic clock. Sources on the same
+ * host with the same frame duration then show their frames at the same times,
+ * even if they started at different times.
+ */
+static unsigned long long source_first_frame_time_us(AtollaSourcePrivate* source)
+{
+    unsigned long long frame_duration_us = source->frame_duration_ms * 1000ULL;
+    unsigned long long buffered_us = (source->max_buffered_frames - 1) * frame_duration_us;
+    unsigned long long now_us = time_now_us();
+
+    if(!(source->capabilities & MSG_CAPABILITY_PTS))
+    {
+        return now_us - buffered_us;
+    }
+
+    unsigned long long earliest_due_us = now_us + frame_duration_us;
+    unsigned long long due_us = (earliest_due_us + frame_duration_us - 1) / frame_duration_us * frame_duration_us;
+    return due_us - buffered_us;
+}
+
+/**
+ * Sends a running effect again, both to keep the sink from dropping the
+ * source for not sending anything and in case the first one got lost.
+ */
+static void source_refresh_effect(AtollaSourcePrivate* source)
+{
+    if(source->state == ATOLLA_SOURCE_STATE_OPEN && source->effect_msg.size > 0 &&
+       (time_now() - source->last_effect_send_time) >= effect_refresh_interval_ms)
+    {
+        source->last_effect_send_time = time_now();
+        source_send(source, &source->effect_msg);
+    }
+}
+
+/**
+ * Capabilities to offer with BORROW. A multicast group may contain sinks that
+ * do not know ENQUEUE16, and all of them receive the same frames, so groups
+ * stay with the 8-bit frame index.
+ */
+static uint8_t source_offered_capabilities(AtollaSourcePrivate* source)
+{
+    if(source->transport == SOURCE_TRANSPORT_MULTICAST)
+    {
+        return 0;
+    }
+
+    // Only datagrams get lost, so only those are worth keeping
+    bool retransmit = source->transport == SOURCE_TRANSPORT_UDP && source->sent_frames_len > 0;
+    return MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_PTS | MSG_CAPABILITY_EFFECT | (retransmit ? MSG_CAPABILITY_NACK : 0);
+}
+
+/**
+ * Keeps a copy of the ENQUEUE16 message of the frame that was just put, along
+ * with when the sink will show it.
+ */
+static void source_remember_sent(AtollaSourcePrivate* source, uint16_t frame_seq, MemBlock* msg)
+{
+    SourceSentFrame* sent = &source->sent_frames[frame_seq % source->sent_frames_len];
+    sent->valid = true;
+    sent->frame_seq = frame_seq;
+    // The last frame time trails the time the frame is shown by the frames buffered ahead of it
+    sent->due_time_us = source->last_frame_time_us + (source->max_buffered_frames - 1) * source->frame_duration_ms * 1000ULL;
+    mem_block_resize(&sent->msg, msg->size);
+    memcpy(sent->msg.data, msg->data, msg->size);
+}
+
+/**
+ * Sends the frames that the sink reported missing once more, as far as they
+ * are still kept and there is still time for them to arrive before they are
+ * shown.
+ */
+static void source_resend(AtollaSourcePrivate* source, MsgIter* nack)
+{
+    if(source->state != ATOLLA_SOURCE_STATE_OPEN || source->sent_frames_len == 0)
+    {
+        return;
+    }
+
+    // Allow one frame duration for the trip to the sink
+    unsigned long long min_time_left_us = source->frame_duration_ms * 1000ULL;
+    size_t frame_seqs_count = msg_iter_nack_frame_seqs_count(nack);
+    for(size_t i = 0; i < frame_seqs_count; ++i)
+    {
+        uint16_t frame_seq = msg_iter_nack_frame_seq(nack, i);
+        SourceSentFrame* sent = &source->sent_frames[frame_seq % source->sent_frames_len];
+
+        if(sent->valid && sent->frame_seq == frame_seq &&
+           (long long) (sent->due_time_us - time_now_us()) > (long long) min_time_left_us)
+        {
+            source_send(source, &sent->msg);
+        }
+    }
+}
+
+/**
+ * Handles a FAIL from a single sink of a multicast group. The other sinks may
+ * well be lent, so this does not fail the whole source.
+ */
+static void source_multicast_fail(AtollaSourcePrivate* source, uint8_t error_code)
+{
+    if(error_code == ATOLLA_ERROR_CODE_NOT_BORROWED && source->state == ATOLLA_SOURCE_STATE_OPEN)
+    {
+        // The sink joined the group after the borrow or dropped the borrow,
+        // borrow just this one again instead of resetting the whole group
+        source_send_borrow_to(source, &source->last_sender);
+    }
 }
 
 static void source_fail(AtollaSourcePrivate* source, const char* error_msg)
@@ -401,3 +1157,8 @@ static void source_fail(AtollaSourcePrivate* source, const char* error_msg)
     source->state = ATOLLA_SOURCE_STATE_ERROR;
     source->error_msg = error_msg;
 }
+
+static bool has_prefix(const char* str, const char* prefix)
+{
+    return strncmp(str, prefix, strlen(prefix)) == 0;
+}
@@ -2,6 +2,9 @@
 #define ATOLLA_SOURCE_H
 
 #include "primitives.h"
+#include "pixel_format.h"
+#include "effect.h"
+#include "socket_options.h"
 
 enum AtollaSourceState
 {
@@ -49,6 +52,23 @@ struct AtollaSourceSpec
 {
     /**
      * IP address or hostname of the sink to connect the source to.
+     *
+     * For a sink on the same host that was made with a shm_name, use
+     * "shm://" followed by that name to connect through shared memory
+     * instead of UDP. sink_port is ignored in that case.
+     *
+     * For a sink with a tcp_port, "tcp://" followed by the IP address or
+     * hostname connects over TCP to sink_port. For a sink with a unix_path,
+     * "unix://" followed by the path connects over a Unix domain socket.
+     *
+     * A multicast group address borrows every sink in the group that was made
+     * with that multicast_group and a port of sink_port. The source opens with
+     * the first sink that lends itself, sinks that refuse are ignored.
+     *
+     * Hostnames that need a DNS lookup are resolved in the background on
+     * POSIX systems and remembered for a minute, so with async_make a slow
+     * name server does not block atolla_source_make. The disconnect timeout
+     * only starts once the hostname is resolved.
      */
     const char* sink_hostname;
     /**
@@ -101,9 +121,94 @@ struct AtollaSourceSpec
      * or ATOLLA_SOURCE_STATE_ERROR.
      */
     bool async_make;
+    /**
+     * Layout of the lights in frames passed to atolla_source_put. The pixel
+     * format is sent to the sink when borrowing and the sink refuses to lend
+     * itself if it cannot output frames in that format.
+     *
+     * Use ATOLLA_PIXEL_FORMAT_RGB565 to cut the bandwidth of RGB8 sinks by a
+     * third, if the lights cannot show more than 5 or 6 bits per channel
+     * anyway. Zero-initialized specs use ATOLLA_PIXEL_FORMAT_RGB8.
+     */
+    AtollaPixelFormat pixel_format;
+    /**
+     * If sink_hostname is a multicast group address, e.g. "239.255.42.1", the
+     * source streams to all sinks that joined the group, sending each frame
+     * only once, and this sets how many routers the frames may pass. Zero
+     * lets the implementation pick a default of 1, which keeps them in the
+     * local network.
+     */
+    int multicast_ttl;
+    /**
+     * Sinks that were made with a max_sources above one show several sources
+     * at once. Only the sources with the highest priority, from 0 to 255, are
+     * merged with HTP or LTP, while blending stacks sources with higher
+     * priority on top. Other sinks ignore it. Zero-initialized specs have the
+     * lowest priority.
+     */
+    int priority;
+    /**
+     * Opacity from 1 to 255 that sinks with ATOLLA_SINK_BLEND_ALPHA apply to
+     * the frames of this source when blending them over the sources below.
+     * Zero lets the implementation pick a default of 255, which is fully
+     * opaque.
+     */
+    int opacity;
+    /**
+     * When atolla_source_put has to wait for the sink, it sleeps until the
+     * instant that the frame is due. If not zero, it wakes up this many
+     * microseconds early and busy-waits for the rest, which costs CPU time
+     * but makes the frames leave closer to their deadline. Zero-initialized
+     * specs never busy-wait.
+     */
+    int pacing_spin_us;
+    /**
+     * Amount of the most recently put frames that are kept to send them again
+     * if a sink reports them missing with NACK, as long as there is time for
+     * them to arrive before they are due. Only used with UDP to a single sink.
+     * Zero lets the implementation pick a default of 16, a negative value
+     * turns retransmission off.
+     */
+    int retransmit_frames;
+    /**
+     * If not NULL, tunes the UDP socket of the source, e.g. with a DSCP that
+     * lets Wi-Fi send frames in the voice or video access category. The
+     * options are copied, so they need not outlive the call. NULL keeps the
+     * defaults of the operating system. Irrelevant for shared memory and
+     * stream sockets.
+     */
+    const AtollaSocketOptions* socket_options;
 };
 typedef struct AtollaSourceSpec AtollaSourceSpec;
 
+/** Amount of buckets in the pacing histogram of AtollaSourcePacing */
+#define ATOLLA_SOURCE_PACING_BUCKETS 16
+
+/**
+ * Statistics on how precisely atolla_source_put sent frames at their
+ * deadlines, counting only the puts that had to wait.
+ */
+struct AtollaSourcePacing
+{
+    /**
+     * Amount of puts that waited for their deadline.
+     */
+    unsigned int paced_count;
+    /**
+     * Largest amount of microseconds that a put was sent after its deadline.
+     */
+    unsigned int late_us_max;
+    /**
+     * Counts puts by how many microseconds after their deadline they were
+     * sent. The first bucket counts puts that were on time to the
+     * microsecond, bucket i counts puts that were at least 2^(i-1) and less
+     * than 2^i microseconds late. The last bucket also counts all puts that
+     * were even later.
+     */
+    unsigned int histogram[ATOLLA_SOURCE_PACING_BUCKETS];
+};
+typedef struct AtollaSourcePacing AtollaSourcePacing;
+
 /**
  * Creates a new atolla source using the parameters in the given spec struct.
  *
@@ -167,6 +272,36 @@ int atolla_source_put_ready_count(AtollaSource source);
  */
 int atolla_source_put_ready_timeout(AtollaSource source);
 
+/**
+ * Gets a descriptor that becomes readable when the sink sent something to the
+ * source, for use with poll, epoll, kqueue or the event loop of a library,
+ * together with atolla_source_poll_timeout. The descriptor belongs to the
+ * source and must not be read from or closed.
+ *
+ * Returns -1 in the error state and for sources connected through shared
+ * memory, which cannot be polled. atolla_source_poll_timeout then keeps the
+ * waits short instead.
+ */
+int atolla_source_poll_fd(AtollaSource source);
+
+/**
+ * Handles everything the sink sent and returns the amount of milliseconds
+ * after which the source needs to be called again, even if the descriptor
+ * from atolla_source_poll_fd did not become readable in the meantime, e.g.
+ * to borrow again or to notice that the sink is gone. If frames are put, this
+ * includes the time until atolla_source_put_ready_timeout becomes zero, but
+ * not if a frame could already be put, so that sources with nothing to put
+ * do not keep waking up.
+ *
+ * A single thread can drive many sources by waiting for any of their
+ * descriptors with the smallest of their timeouts and calling this function
+ * of each source after waking up, then putting the frames of the sources with
+ * a non-zero atolla_source_put_ready_count.
+ *
+ * Returns -1 in the error state, where there is nothing left to wait for.
+ */
+int atolla_source_poll_timeout(AtollaSource source);
+
 /**
  * Tries to enqueue the given frame in the connected sink.
  *
@@ -184,6 +319,64 @@ int atolla_source_put_ready_timeout(AtollaSource source);
  * to the borrow request from the source yet, this function will return false
  * and not try to enqueue the frame.
  */
-bool atolla_source_put(AtollaSource source, void* frame, size_t frame_len);
+bool atolla_source_put(AtollaSource source, const void* frame, size_t frame_len);
+
+/**
+ * Makes the connected sink render the given effect by itself, instead of
+ * showing frames that are put, until the next frame is put or the effect is
+ * set to ATOLLA_EFFECT_NONE.
+ *
+ * Effects mix the from color and the to color, each a single light in the
+ * pixel format of the source, with a weight per light. wavelength is the
+ * length of a wave in lights for ATOLLA_EFFECT_SINE, with 0 meaning all
+ * lights of the sink. period_ms is how long one cycle of moving effects takes,
+ * with 0 meaning the effect stands still. Both must be below 65536.
+ *
+ * Setting the same effect again leaves it running undisturbed. The source
+ * repeats the effect on its own so the sink keeps it, as long as any of the
+ * atolla_source functions is called at least every few hundred milliseconds,
+ * e.g. atolla_source_state.
+ *
+ * Returns false if the source is not open or the sink does not render
+ * effects, as is the case for sinks of older versions and for multicast
+ * groups. Frames have to be put instead then.
+ */
+bool atolla_source_effect(AtollaSource source, AtollaEffect effect, const void* from_color, const void* to_color, int wavelength, int period_ms);
+
+/**
+ * Gets statistics on how late atolla_source_put sent frames that had to wait
+ * for the sink, since the source was made.
+ */
+void atolla_source_pacing(AtollaSource source, AtollaSourcePacing* pacing);
+
+/**
+ * Gets the values in effect for the options of the UDP socket of the source,
+ * which may differ from the requested socket_options where the platform or
+ * the privileges of the process did not allow them, see AtollaSocketOptions.
+ *
+ * Returns false and leaves effective unchanged for sources that do not send
+ * over UDP, and in the error state.
+ */
+bool atolla_source_socket_options(AtollaSource source, AtollaSocketOptions* effective);
+
+/**
+ * Streams the frames of a pre-rendered show file to the connected sink,
+ * blocking until all of the frames have been put or the source entered the
+ * error state.
+ *
+ * The file is mapped into memory and the frames are passed to the sink
+ * straight from the mapping. Pages that have been played are released again,
+ * so even multi-gigabyte shows are played with constant memory use. Show files
+ * are described in show/file.h and can be written with show_file_write_header
+ * followed by the frames.
+ *
+ * Returns false without playing anything if the source is not open, if the
+ * file could not be mapped, if the frame duration stored in the file differs
+ * from the frame duration of the source or if its frames are too large to
+ * send in a single message. Also returns false, and stops playing, if the
+ * source entered the error state or a frame could still not be put after a
+ * few attempts. Returns true if all frames were handed to the sink.
+ */
+bool atolla_source_play_file(AtollaSource source, const char* path);
 
 #endif // ATOLLA_SOURCE_H
@@ -0,0 +1,145 @@
+#include "render.h"
+
+#include <string.h>
+
+/** One period of a sine wave from 0 to 255, starting in the middle */
+static const uint8_t sine_table[256] = {
+    128, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
+    176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+    218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
+    245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+    255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+    245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+    218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
+    176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+    128, 124, 121, 118, 115, 112, 109, 106, 103, 100,  97,  93,  90,  88,  85,  82,
+     79,  76,  73,  70,  67,  65,  62,  59,  57,  54,  52,  49,  47,  44,  42,  40,
+     37,  35,  33,  31,  29,  27,  25,  23,  21,  20,  18,  17,  15,  14,  12,  11,
+     10,   9,   7,   6,   5,   5,   4,   3,   2,   2,   1,   1,   1,   0,   0,   0,
+      0,   0,   0,   0,   1,   1,   1,   2,   2,   3,   4,   5,   5,   6,   7,   9,
+     10,  11,  12,  14,  15,  17,  18,  20,  21,  23,  25,  27,  29,  31,  33,  35,
+     37,  40,  42,  44,  47,  49,  52,  54,  57,  59,  62,  65,  67,  70,  73,  76,
+     79,  82,  85,  88,  90,  93,  97, 100, 103, 106, 109, 112, 115, 118, 121, 124
+};
+
+static void render_gradient(uint8_t* weights, size_t lights_count);
+static void render_sine(uint8_t* weights, size_t lights_count, uint16_t wavelength, uint16_t period_ms, uint32_t time_ms);
+static void render_noise(uint8_t* weights, size_t lights_count, uint16_t period_ms, uint32_t time_ms);
+static uint8_t noise_hash(uint32_t light, uint32_t cycle);
+
+void effect_render_weights(AtollaEffect effect, uint8_t* weights, size_t lights_count, uint16_t wavelength, uint16_t period_ms, uint32_t time_ms)
+{
+    switch(effect)
+    {
+        case ATOLLA_EFFECT_GRADIENT:
+            render_gradient(weights, lights_count);
+            break;
+
+        case ATOLLA_EFFECT_SINE:
+            render_sine(weights, lights_count, wavelength, period_ms, time_ms);
+            break;
+
+        case ATOLLA_EFFECT_NOISE:
+            render_noise(weights, lights_count, period_ms, time_ms);
+            break;
+
+        default:
+            memset(weights, 0, lights_count);
+            break;
+    }
+}
+
+void effect_mix_u8(uint8_t* target, const uint8_t* weights, size_t lights_count, const uint8_t* from, const uint8_t* to, size_t channels)
+{
+    for(size_t i = 0; i < lights_count; ++i)
+    {
+        const uint16_t to_weight = weights[i];
+        const uint16_t from_weight = (uint16_t) (255 - to_weight);
+
+        for(size_t c = 0; c < channels; ++c)
+        {
+            // Exact rounded division by 255 without a division, like mem_blend_alpha_u8
+            uint16_t sum = (uint16_t) (to[c] * to_weight + from[c] * from_weight + 128);
+            target[i * channels + c] = (uint8_t) ((sum + (sum >> 8)) >> 8);
+        }
+    }
+}
+
+void effect_mix_u16le(uint8_t* target, const uint8_t* weights, size_t lights_count, const uint8_t* from, const uint8_t* to, size_t channels)
+{
+    for(size_t i = 0; i < lights_count; ++i)
+    {
+        const uint32_t to_weight = weights[i];
+        const uint32_t from_weight = 255u - to_weight;
+
+        for(size_t c = 0; c < channels; ++c)
+        {
+            uint32_t f = (uint32_t) (from[2*c] | (from[2*c + 1] << 8));
+            uint32_t t = (uint32_t) (to[2*c] | (to[2*c + 1] << 8));
+            uint32_t mixed = (t * to_weight + f * from_weight + 127) / 255;
+
+            uint8_t* channel = &target[2 * (i * channels + c)];
+            channel[0] = (uint8_t) mixed;
+            channel[1] = (uint8_t) (mixed >> 8);
+        }
+    }
+}
+
+static void render_gradient(uint8_t* weights, size_t lights_count)
+{
+    // A single light has nowhere to fade to and stays at the from color
+    const uint32_t last = (lights_count > 1) ? (uint32_t) (lights_count - 1) : 1;
+
+    for(size_t i = 0; i < lights_count; ++i)
+    {
+        weights[i] = (uint8_t) ((i * 255 + last / 2) / last);
+    }
+}
+
+static void render_sine(uint8_t* weights, size_t lights_count, uint16_t wavelength, uint16_t period_ms, uint32_t time_ms)
+{
+    // Phases are fractions of a wave in 24 bit fixed point, the top eight bits
+    // of which index the table
+    const uint32_t phase_bits = 24;
+    const uint32_t lights_per_wave = (wavelength != 0) ? wavelength : (uint32_t) (lights_count > 0 ? lights_count : 1);
+    const uint32_t phase_step = (1u << phase_bits) / lights_per_wave;
+    const uint32_t time_phase = (period_ms != 0) ?
+        (uint32_t) (((uint64_t) (time_ms % period_ms) << phase_bits) / period_ms) :
+        0;
+
+    for(size_t i = 0; i < lights_count; ++i)
+    {
+        // Moving towards the last light, so later lights see the same phase later
+        uint32_t phase = ((uint32_t) i * phase_step - time_phase) & ((1u << phase_bits) - 1);
+        weights[i] = sine_table[phase >> (phase_bits - 8)];
+    }
+}
+
+static void render_noise(uint8_t* weights, size_t lights_count, uint16_t period_ms, uint32_t time_ms)
+{
+    const uint32_t cycle = (period_ms != 0) ? time_ms / period_ms : 0;
+    const uint32_t progress = (period_ms != 0) ? (time_ms % period_ms) * 256 / period_ms : 0;
+
+    for(size_t i = 0; i < lights_count; ++i)
+    {
+        // Fade from the random weight of this cycle to that of the next one
+        uint32_t current = noise_hash((uint32_t) i, cycle);
+        uint32_t next = noise_hash((uint32_t) i, cycle + 1);
+        weights[i] = (uint8_t) ((current * (256 - progress) + next * progress) >> 8);
+    }
+}
+
+/**
+ * Integer hash of a light and a cycle, so noise needs no state and every sink
+ * renders the same noise for the same time.
+ */
+static uint8_t noise_hash(uint32_t light, uint32_t cycle)
+{
+    uint32_t x = light * 0x9E3779B1u ^ cycle * 0x85EBCA77u;
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return (uint8_t) x;
+}
@@ -0,0 +1,46 @@
+#ifndef EFFECT_RENDER_H
+#define EFFECT_RENDER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+#include "../atolla/effect.h"
+
+/**
+ * Kernels for rendering procedural effects into frames.
+ *
+ * Effects are rendered in two passes: first a weight from 0 to 255 is
+ * computed for each light, then each light is mixed from two colors with its
+ * weight. The mixing pass only depends on the pixel format and the weight
+ * pass only on the effect, and the loops in both have no branches, so
+ * compilers turn them into SIMD code.
+ */
+
+/**
+ * Writes lights_count weights for the given effect at time_ms milliseconds
+ * after it was started, where 0 selects the from color and 255 the to color.
+ *
+ * A wavelength of 0 stands for lights_count lights, a period of 0 stops the
+ * effect from moving. Unknown effects render all lights with weight 0.
+ */
+void effect_render_weights(AtollaEffect effect, uint8_t* weights, size_t lights_count, uint16_t wavelength, uint16_t period_ms, uint32_t time_ms);
+
+/**
+ * Mixes each light in target from the colors from and to, with channels 8 bit
+ * channels per light, by the weight of the light.
+ */
+void effect_mix_u8(uint8_t* target, const uint8_t* weights, size_t lights_count, const uint8_t* from, const uint8_t* to, size_t channels);
+
+/**
+ * Mixes each light in target from the colors from and to, with channels
+ * little-endian 16 bit channels per light, by the weight of the light.
+ */
+void effect_mix_u16le(uint8_t* target, const uint8_t* weights, size_t lights_count, const uint8_t* from, const uint8_t* to, size_t channels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_RENDER_H
@@ -0,0 +1,23 @@
+#include "arena.h"
+
+MemArena mem_arena_make(void* data, size_t capacity)
+{
+    MemArena arena = { (uint8_t*) data, capacity, 0 };
+    return arena;
+}
+
+void* mem_arena_alloc(MemArena* arena, size_t size)
+{
+    const uintptr_t address = (uintptr_t) (arena->data + arena->used);
+    const size_t padding = (size_t) ((MEM_ARENA_ALIGN - (address % MEM_ARENA_ALIGN)) % MEM_ARENA_ALIGN);
+
+    if(arena->used + padding > arena->capacity ||
+       size > arena->capacity - arena->used - padding)
+    {
+        return NULL;
+    }
+
+    void* allocation = arena->data + arena->used + padding;
+    arena->used += padding + size;
+    return allocation;
+}
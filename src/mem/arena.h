@@ -0,0 +1,51 @@
+#ifndef MEM_ARENA_H
+#define MEM_ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+
+/**
+ * Alignment of all memory handed out by an arena, enough for any primitive
+ * type on the supported platforms.
+ */
+#define MEM_ARENA_ALIGN 16
+
+/**
+ * Bytes that an allocation of the given size takes up in an arena, not
+ * counting the padding at the very start of the arena.
+ */
+#define MEM_ARENA_SIZE(size) ((((size) + MEM_ARENA_ALIGN - 1) / MEM_ARENA_ALIGN) * MEM_ARENA_ALIGN)
+
+/**
+ * Hands out consecutive parts of a buffer provided by the caller. Memory is
+ * never given back on its own, the whole buffer is released at once by the
+ * code that owns it.
+ */
+struct MemArena
+{
+    uint8_t* data;
+    size_t capacity;
+    size_t used;
+};
+typedef struct MemArena MemArena;
+
+/**
+ * Makes an arena that hands out the given buffer. No dynamic allocation is
+ * performed by this function or by the arena.
+ */
+MemArena mem_arena_make(void* data, size_t capacity);
+
+/**
+ * Takes the given amount of bytes from the arena, aligned to MEM_ARENA_ALIGN.
+ * Returns NULL if the arena does not have enough space left.
+ */
+void* mem_arena_alloc(MemArena* arena, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEM_ARENA_H
@@ -0,0 +1,50 @@
+#include "blend.h"
+
+void mem_blend_max_u8(uint8_t* target, const uint8_t* source, size_t len)
+{
+    for(size_t i = 0; i < len; ++i)
+    {
+        target[i] = (source[i] > target[i]) ? source[i] : target[i];
+    }
+}
+
+void mem_blend_max_u16le(uint8_t* target, const uint8_t* source, size_t len)
+{
+    // Assembled from bytes, so the same code works on big-endian hosts
+    for(size_t i = 0; i < len / 2; ++i)
+    {
+        uint16_t t = (uint16_t) (target[2*i] | (target[2*i + 1] << 8));
+        uint16_t s = (uint16_t) (source[2*i] | (source[2*i + 1] << 8));
+        uint16_t max = (s > t) ? s : t;
+        target[2*i] = (uint8_t) max;
+        target[2*i + 1] = (uint8_t) (max >> 8);
+    }
+}
+
+void mem_blend_alpha_u8(uint8_t* target, const uint8_t* source, size_t len, uint8_t alpha)
+{
+    const uint16_t source_weight = alpha;
+    const uint16_t target_weight = (uint16_t) (255 - alpha);
+
+    for(size_t i = 0; i < len; ++i)
+    {
+        // Exact rounded division by 255 without a division, the sum is at most 255 * 255
+        uint16_t sum = (uint16_t) (source[i] * source_weight + target[i] * target_weight + 128);
+        target[i] = (uint8_t) ((sum + (sum >> 8)) >> 8);
+    }
+}
+
+void mem_blend_alpha_u16le(uint8_t* target, const uint8_t* source, size_t len, uint8_t alpha)
+{
+    const uint32_t source_weight = alpha;
+    const uint32_t target_weight = 255u - alpha;
+
+    for(size_t i = 0; i < len / 2; ++i)
+    {
+        uint32_t t = (uint32_t) (target[2*i] | (target[2*i + 1] << 8));
+        uint32_t s = (uint32_t) (source[2*i] | (source[2*i + 1] << 8));
+        uint32_t blended = (s * source_weight + t * target_weight + 127) / 255;
+        target[2*i] = (uint8_t) blended;
+        target[2*i + 1] = (uint8_t) (blended >> 8);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef MEM_BLEND_H
+#define MEM_BLEND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+
+/**
+ * Merge kernels for compositing frames of several sources.
+ *
+ * All kernels work channel by channel on whole frames and have no branches in
+ * their loops, so compilers turn them into SIMD code. Frames with 16 bit
+ * channels are stored little-endian, like everywhere in the protocol.
+ */
+
+/**
+ * Overwrites each 8 bit channel in target with the maximum of itself and the
+ * corresponding channel in source.
+ */
+void mem_blend_max_u8(uint8_t* target, const uint8_t* source, size_t len);
+
+/**
+ * Overwrites each little-endian 16 bit channel in target with the maximum of
+ * itself and the corresponding channel in source. The length is in bytes and
+ * must be even.
+ */
+void mem_blend_max_u16le(uint8_t* target, const uint8_t* source, size_t len);
+
+/**
+ * Blends source over target with the given opacity for source, where 255 is
+ * fully opaque and replaces target and 0 leaves target as it was.
+ */
+void mem_blend_alpha_u8(uint8_t* target, const uint8_t* source, size_t len, uint8_t alpha);
+
+/**
+ * Blends 16 bit little-endian channels in source over target with the given
+ * 8 bit opacity. The length is in bytes and must be even.
+ */
+void mem_blend_alpha_u16le(uint8_t* target, const uint8_t* source, size_t len, uint8_t alpha);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEM_BLEND_H
@@ -9,6 +9,7 @@ MemBlock mem_block_make(void* data, size_t size)
     block.data = data;
     block.size = size;
     block.capacity = size;
+    block.fixed = true;
 
     return block;
 }
@@ -20,6 +21,7 @@ MemBlock mem_block_alloc(size_t initial_capacity)
     block.data = (initial_capacity > 0) ? malloc(initial_capacity) : NULL;
     block.size = 0;
     block.capacity = initial_capacity;
+    block.fixed = false;
 
     assert(initial_capacity == 0 || block.data != NULL);
 
@@ -39,6 +41,7 @@ MemBlock mem_block_slice(
     slice.data = bytes + slice_byte_offset;
     slice.size = slice_byte_length;
     slice.capacity = slice_byte_length;
+    slice.fixed = true;
     return slice;
 }
 
@@ -46,6 +49,9 @@ void mem_block_resize(MemBlock* block, size_t new_size)
 {
     if(block->capacity < new_size)
     {
+        // The memory may belong to an arena or the stack, it must not be freed
+        assert(!block->fixed);
+
         if(block->capacity > 0) {
             free(block->data);
         }
@@ -15,15 +15,18 @@ struct MemBlock
     void* data;
     size_t size;
     size_t capacity;
+    /** Set for blocks over memory that was not allocated by this module, which are never reallocated */
+    bool fixed;
 };
 typedef struct MemBlock MemBlock;
 
 /**
  * Creates a new memory block with the given data. Size and capacity are both
  * set to the given size. No dynamic allocation is performed by this function.
- * Note that memory blocks created with this function can only be resized if the
- * given pointer was allocated by malloc and ownership is effectively
- * transferred to the memory block from the user code.
+ * Note that memory blocks created with this function can never grow beyond the
+ * given size, they can only be freed if the given pointer was allocated by
+ * malloc and ownership is effectively transferred to the memory block from the
+ * user code.
  */
 MemBlock mem_block_make(void* data, size_t size);
 
@@ -49,7 +52,8 @@ MemBlock mem_block_slice(
  * lower than the desired size, frees the memory currently referenced by the
  * memory block and replaces it with newly allocated memory with a capacity
  * equal to the given size. Does not reallocate if the memory block is already
- * large enough.
+ * large enough. Blocks created with mem_block_make or mem_block_slice must
+ * already be large enough, growing them is an assertion failure.
  */
 void mem_block_resize(MemBlock* block, size_t new_size);
 
@@ -9,6 +9,12 @@
     return ring;
  }
  
+ MemRing mem_ring_make(void* data, size_t capacity)
+ {
+    MemRing ring = { mem_block_make(data, capacity), 0, 0 };
+    return ring;
+ }
+
  void mem_ring_free(MemRing* ring)
  {
     mem_block_free(&ring->buf);
@@ -18,7 +24,7 @@
 
  bool mem_ring_is_empty(MemRing* ring)
  {
-     return ring->len > 0;
+     return ring->len == 0;
  }
  
  bool mem_ring_peek(MemRing* ring, void** peek_addr, size_t peek_len)
@@ -33,6 +39,20 @@
     return true;
  }
  
+ bool mem_ring_peek_back(MemRing* ring, void** peek_addr, size_t peek_len)
+ {
+    if(ring->len < peek_len) {
+        return false;
+    }
+
+    size_t start = (ring->front + ring->len - peek_len) % ring->buf.size;
+
+    MemBlock back_block = mem_block_slice(&ring->buf, start, peek_len);
+    *peek_addr = back_block.data;
+
+    return true;
+ }
+
  bool mem_ring_dequeue(MemRing* ring, void* out_buf, size_t out_buf_len)
  {
     if(ring->len < out_buf_len) return false;
@@ -70,4 +90,19 @@
 
     return true;
  }
- 
\ No newline at end of file
+ 
+
+ bool mem_ring_overwrite(MemRing* ring, size_t offset, const void* in_buf, size_t in_buf_len)
+ {
+    if(ring->len < (offset + in_buf_len)) {
+        return false;
+    }
+
+    size_t start = (ring->front + offset) % ring->buf.size;
+
+    MemBlock target_block = mem_block_slice(&ring->buf, start, in_buf_len);
+
+    memcpy(target_block.data, in_buf, in_buf_len);
+
+    return true;
+ }
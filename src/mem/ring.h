@@ -19,6 +19,13 @@ typedef struct MemRing MemRing;
  */
 MemRing mem_ring_alloc(size_t capacity);
 
+/**
+ * Makes a memory ring over the given buffer of the given capacity in bytes.
+ * No dynamic allocation is performed by this function, see mem_block_make for
+ * the ownership of the buffer.
+ */
+MemRing mem_ring_make(void* data, size_t capacity);
+
 /**
  * Frees the memory ring.
  */
@@ -40,6 +47,12 @@ bool mem_ring_is_empty(MemRing* ring);
  */
 bool mem_ring_peek(MemRing* ring, void** peek_addr, size_t peek_len);
 
+/**
+ * Like mem_ring_peek, but obtains a reference to the newest peek_len bytes,
+ * which were enqueued last.
+ */
+bool mem_ring_peek_back(MemRing* ring, void** peek_addr, size_t peek_len);
+
 /**
  * Copies the oldest buf_len bytes into the given buffer and discards the data in
  * the queue after copying, making room for enqueuing.
@@ -64,6 +77,17 @@ bool mem_ring_drop(MemRing* ring, size_t drop_len);
  */
 bool mem_ring_enqueue(MemRing* ring, void* buf, size_t buf_len);
 
+/**
+ * Copies the given buffer over queued data, starting offset bytes after the
+ * oldest byte, without changing what is queued.
+ *
+ * Like with peeking, the capacity has to be a multiple of buf_len and the
+ * offset a multiple of buf_len, so that the data does not wrap around.
+ *
+ * Returns false and copies nothing if the range is not completely queued.
+ */
+bool mem_ring_overwrite(MemRing* ring, size_t offset, const void* buf, size_t buf_len);
+
 #ifdef __cplusplus
 }
 #endif
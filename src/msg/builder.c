@@ -4,9 +4,7 @@
 #include "../test/assert.h"
 #include <string.h>
 
-static const size_t header_len = sizeof(uint8_t)  + // message type
-                                 sizeof(uint16_t) + // message ID
-                                 sizeof(uint16_t);  // payload size
+static const size_t header_len = MSG_BUILDER_HEADER_LEN;
 
 static const size_t max_payload_len = 65535;
 
@@ -19,6 +17,12 @@ static MemBlock* build(
     size_t payload_len
 );
 
+static uint8_t* begin(
+    MsgBuilder* builder,
+    MsgType type,
+    size_t payload_len
+);
+
 static void set_uint8(
     MemBlock* msg_buf,
     size_t byte_offset,
@@ -31,11 +35,9 @@ static void set_uint16(
     uint16_t value
 );
 
-static void set_data(
-    MemBlock* msg_buf,
-    size_t byte_offset,
-    void* data,
-    size_t data_len
+static void put_uint32(
+    uint8_t* bytes,
+    uint32_t value
 );
 
 void msg_builder_init(
@@ -46,6 +48,16 @@ void msg_builder_init(
     builder->next_msg_id = 0;
 }
 
+void msg_builder_init_in(
+    MsgBuilder* builder,
+    void* buf,
+    size_t buf_capacity
+)
+{
+    builder->msg_buf = mem_block_make(buf, buf_capacity);
+    builder->next_msg_id = 0;
+}
+
 void msg_builder_free(
     MsgBuilder* builder
 )
@@ -59,6 +71,26 @@ static MemBlock* build(
     void* payload,
     size_t payload_len
 )
+{
+    uint8_t* payload_start = begin(builder, type, payload_len);
+
+    if(payload_len > 0) {
+        memcpy(payload_start, payload, payload_len);
+    }
+
+    return &builder->msg_buf;
+}
+
+/**
+ * Sizes the message buffer for a message with the given payload length and
+ * writes everything but the payload itself. Returns the address where the
+ * payload should be written to, so large payloads can be assembled in place.
+ */
+static uint8_t* begin(
+    MsgBuilder* builder,
+    MsgType type,
+    size_t payload_len
+)
 {
     assert(payload_len <= max_payload_len);
 
@@ -69,48 +101,172 @@ static MemBlock* build(
 
     set_uint8(block, 0, (uint8_t) type);
     set_uint16(block, 1, builder->next_msg_id++);
-    set_data(block, 3, payload, payload_len);
+    set_uint16(block, 3, (uint16_t) payload_len);
 
-    return block;
+    return ((uint8_t*) block->data) + header_len;
 }
 
 MemBlock* msg_builder_borrow(
     MsgBuilder* builder,
     uint8_t frame_length,
-    uint8_t buffer_length
+    uint8_t buffer_length,
+    uint8_t pixel_format,
+    uint8_t priority,
+    uint8_t opacity,
+    uint8_t capabilities
 )
 {
-    uint8_t payload[] = { frame_length, buffer_length };
+    uint8_t payload[] = { frame_length, buffer_length, pixel_format, priority, opacity, capabilities };
     size_t payload_len = sizeof(payload) / sizeof(uint8_t);
     return build(builder, MSG_TYPE_BORROW, payload, payload_len);
 }
 
 MemBlock* msg_builder_lent(
-    MsgBuilder* builder
+    MsgBuilder* builder,
+    uint8_t capabilities
+)
+{
+    return build(builder, MSG_TYPE_LENT, &capabilities, (capabilities == 0) ? 0 : 1);
+}
+
+MemBlock* msg_builder_lent_clock(
+    MsgBuilder* builder,
+    uint8_t capabilities,
+    uint32_t sink_time_us
 )
 {
-    return build(builder, MSG_TYPE_LENT, NULL, 0);
+    uint8_t payload[5];
+    payload[0] = capabilities;
+    put_uint32(&payload[1], sink_time_us);
+    return build(builder, MSG_TYPE_LENT, payload, sizeof(payload));
 }
 
 MemBlock* msg_builder_enqueue(
     MsgBuilder* builder,
     uint8_t frame_idx,
-    void* frame,
+    const void* frame,
     size_t frame_len
 )
 {
     const size_t frame_idx_len = sizeof(uint8_t);
     const size_t frame_len_len = sizeof(uint16_t);
     const size_t payload_len = frame_idx_len + frame_len_len + frame_len;
-    uint8_t payload[payload_len];
+
+    // Copy the frame straight into the message, it may be large
+    uint8_t* payload = begin(builder, MSG_TYPE_ENQUEUE, payload_len);
     payload[0] = frame_idx;
     payload[1] = mem_uint16_byte_low(frame_len);
     payload[2] = mem_uint16_byte_high(frame_len);
-    
-    void* payload_frame = (void*) &payload[3];
-    memcpy(payload_frame, frame, frame_len);    
 
-    return build(builder, MSG_TYPE_ENQUEUE, payload, payload_len);
+    if(frame_len > 0) {
+        memcpy(&payload[3], frame, frame_len);
+    }
+
+    return &builder->msg_buf;
+}
+
+MemBlock* msg_builder_enqueue16(
+    MsgBuilder* builder,
+    uint16_t frame_seq,
+    const void* frame,
+    size_t frame_len
+)
+{
+    const size_t frame_seq_len = sizeof(uint16_t);
+    const size_t frame_len_len = sizeof(uint16_t);
+    const size_t payload_len = frame_seq_len + frame_len_len + frame_len;
+
+    uint8_t* payload = begin(builder, MSG_TYPE_ENQUEUE16, payload_len);
+    payload[0] = mem_uint16_byte_low(frame_seq);
+    payload[1] = mem_uint16_byte_high(frame_seq);
+    payload[2] = mem_uint16_byte_low(frame_len);
+    payload[3] = mem_uint16_byte_high(frame_len);
+
+    if(frame_len > 0) {
+        memcpy(&payload[4], frame, frame_len);
+    }
+
+    return &builder->msg_buf;
+}
+
+MemBlock* msg_builder_enqueue_pts(
+    MsgBuilder* builder,
+    uint16_t frame_seq,
+    uint32_t presentation_time_us,
+    const void* frame,
+    size_t frame_len
+)
+{
+    const size_t frame_seq_len = sizeof(uint16_t);
+    const size_t time_len = sizeof(uint32_t);
+    const size_t frame_len_len = sizeof(uint16_t);
+    const size_t payload_len = frame_seq_len + time_len + frame_len_len + frame_len;
+
+    uint8_t* payload = begin(builder, MSG_TYPE_ENQUEUE_PTS, payload_len);
+    payload[0] = mem_uint16_byte_low(frame_seq);
+    payload[1] = mem_uint16_byte_high(frame_seq);
+    put_uint32(&payload[2], presentation_time_us);
+    payload[6] = mem_uint16_byte_low(frame_len);
+    payload[7] = mem_uint16_byte_high(frame_len);
+
+    if(frame_len > 0) {
+        memcpy(&payload[8], frame, frame_len);
+    }
+
+    return &builder->msg_buf;
+}
+
+MemBlock* msg_builder_clock(
+    MsgBuilder* builder,
+    uint32_t sink_time_us,
+    uint32_t source_time_us
+)
+{
+    uint8_t payload[8];
+    put_uint32(&payload[0], sink_time_us);
+    put_uint32(&payload[4], source_time_us);
+    return build(builder, MSG_TYPE_CLOCK, payload, sizeof(payload));
+}
+
+MemBlock* msg_builder_effect(
+    MsgBuilder* builder,
+    uint8_t effect,
+    uint16_t wavelength,
+    uint16_t period_ms,
+    const void* from_color,
+    const void* to_color,
+    size_t color_len
+)
+{
+    const size_t params_len = sizeof(uint8_t) + 2 * sizeof(uint16_t);
+    uint8_t* payload = begin(builder, MSG_TYPE_EFFECT, params_len + 2 * color_len);
+    payload[0] = effect;
+    payload[1] = mem_uint16_byte_low(wavelength);
+    payload[2] = mem_uint16_byte_high(wavelength);
+    payload[3] = mem_uint16_byte_low(period_ms);
+    payload[4] = mem_uint16_byte_high(period_ms);
+
+    if(color_len > 0) {
+        memcpy(&payload[params_len], from_color, color_len);
+        memcpy(&payload[params_len + color_len], to_color, color_len);
+    }
+
+    return &builder->msg_buf;
+}
+
+MemBlock* msg_builder_nack(
+    MsgBuilder* builder,
+    const uint16_t* frame_seqs,
+    size_t frame_seqs_len
+)
+{
+    uint8_t* payload = begin(builder, MSG_TYPE_NACK, frame_seqs_len * sizeof(uint16_t));
+    for(size_t i = 0; i < frame_seqs_len; ++i) {
+        payload[2*i] = mem_uint16_byte_low(frame_seqs[i]);
+        payload[2*i + 1] = mem_uint16_byte_high(frame_seqs[i]);
+    }
+
+    return &builder->msg_buf;
 }
 
 MemBlock* msg_builder_fail(
@@ -128,6 +284,40 @@ MemBlock* msg_builder_fail(
     return build(builder, MSG_TYPE_FAIL, payload, payload_len);
 }
 
+MemBlock* msg_builder_discover(
+    MsgBuilder* builder
+)
+{
+    return build(builder, MSG_TYPE_DISCOVER, NULL, 0);
+}
+
+MemBlock* msg_builder_announce(
+    MsgBuilder* builder,
+    uint16_t port,
+    uint16_t lights_count,
+    uint8_t min_frame_length,
+    const uint8_t* pixel_formats,
+    size_t pixel_formats_len
+)
+{
+    assert(pixel_formats_len <= 255);
+
+    const size_t payload_len = 6 + pixel_formats_len;
+    uint8_t* payload = begin(builder, MSG_TYPE_ANNOUNCE, payload_len);
+    payload[0] = mem_uint16_byte_low(port);
+    payload[1] = mem_uint16_byte_high(port);
+    payload[2] = mem_uint16_byte_low(lights_count);
+    payload[3] = mem_uint16_byte_high(lights_count);
+    payload[4] = min_frame_length;
+    payload[5] = (uint8_t) pixel_formats_len;
+
+    if(pixel_formats_len > 0) {
+        memcpy(&payload[6], pixel_formats, pixel_formats_len);
+    }
+
+    return &builder->msg_buf;
+}
+
 static void set_uint8(
     MemBlock* block,
     size_t byte_offset,
@@ -151,21 +341,14 @@ static void set_uint16(
     target[1] = mem_uint16_byte_high(value);
 }
 
-static void set_data(
-    MemBlock* block,
-    size_t byte_offset,
-    void* data,
-    size_t data_len
+static void put_uint32(
+    uint8_t* bytes,
+    uint32_t value
 )
 {
-    assert(block->size >= (byte_offset + sizeof(uint16_t) + data_len));
-
-    uint8_t* data_header_ptr = ((uint8_t*) block->data) + byte_offset;
-    data_header_ptr[0] = mem_uint16_byte_low(data_len);
-    data_header_ptr[1] = mem_uint16_byte_high(data_len);
-
-    if(data_len > 0) {
-        void* data_payload_ptr = data_header_ptr + 2;
-        memcpy(data_payload_ptr, data, data_len);
-    }
+    // Little-endian like all integers in the protocol, regardless of the host
+    bytes[0] = (uint8_t) value;
+    bytes[1] = (uint8_t) (value >> 8);
+    bytes[2] = (uint8_t) (value >> 16);
+    bytes[3] = (uint8_t) (value >> 24);
 }
@@ -8,6 +8,9 @@ extern "C" {
 #include "../atolla/primitives.h"
 #include "../mem/block.h"
 
+/** Bytes before the payload of every message: type, message ID and payload length */
+#define MSG_BUILDER_HEADER_LEN 5
+
 /**
  * Assembles atolla messages in an internal memory block that is managed by the
  * builder.
@@ -38,6 +41,19 @@ void msg_builder_init(
     MsgBuilder* builder
 );
 
+/**
+ * Initializes the message builder to assemble messages in the given buffer.
+ * As long as all generated messages fit into the buffer, the builder never
+ * allocates, messages that do not fit are an assertion failure. The buffer is
+ * owned by the calling code, do not call msg_builder_free on builders
+ * initialized with this function.
+ */
+void msg_builder_init_in(
+    MsgBuilder* builder,
+    void* buf,
+    size_t buf_capacity
+);
+
 /**
  * Frees resources associated with the message builder. The message builder
  * structure itself is managed by the calling code. Be sure to call this
@@ -48,8 +64,10 @@ void msg_builder_free(
 );
 
 /**
- * Generates and returns a borrow message containing the given frame length and
- * buffer size.
+ * Generates and returns a borrow message containing the given frame length,
+ * buffer size and pixel format used for transferring frames, as well as the
+ * priority and opacity that sinks compositing several sources apply to them.
+ * Capabilities are the MsgCapability bits that the source supports.
  *
  * The returned memory block references internal memory of the message builder
  * and is only valid until the next message generation function is called with
@@ -58,18 +76,40 @@ void msg_builder_free(
 MemBlock* msg_builder_borrow(
     MsgBuilder* builder,
     uint8_t frame_length,
-    uint8_t buffer_length
+    uint8_t buffer_length,
+    uint8_t pixel_format,
+    uint8_t priority,
+    uint8_t opacity,
+    uint8_t capabilities
 );
 
 /**
- * Generates and returns a lent message.
+ * Generates and returns a lent message, confirming the given MsgCapability
+ * bits to the borrower. Without capabilities, the payload is empty, like it
+ * was before capabilities existed.
  *
  * The returned memory block references internal memory of the message builder
  * and is only valid until the next message generation function is called with
  * the same builder.
  */
 MemBlock* msg_builder_lent(
-    MsgBuilder* builder
+    MsgBuilder* builder,
+    uint8_t capabilities
+);
+
+/**
+ * Generates and returns a lent message like msg_builder_lent, that also
+ * carries the current time of the sink in microseconds, for sources that were
+ * granted MSG_CAPABILITY_PTS to answer with CLOCK.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_lent_clock(
+    MsgBuilder* builder,
+    uint8_t capabilities,
+    uint32_t sink_time_us
 );
 
 /**
@@ -84,10 +124,93 @@ MemBlock* msg_builder_lent(
 MemBlock* msg_builder_enqueue(
     MsgBuilder* builder,
     uint8_t frame_idx,
-    void* frame,
+    const void* frame,
     size_t frame_len
 );
 
+/**
+ * Generates and returns an ENQUEUE16 message containing the given frame with
+ * a 16 bit sequence number. Only send it to sinks that confirmed
+ * MSG_CAPABILITY_ENQUEUE16.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_enqueue16(
+    MsgBuilder* builder,
+    uint16_t frame_seq,
+    const void* frame,
+    size_t frame_len
+);
+
+/**
+ * Generates and returns an ENQUEUE_PTS message, which is an ENQUEUE16 message
+ * that also carries the time in microseconds on the clock of the source at
+ * which the sink should show the frame. Only send it to sinks that confirmed
+ * MSG_CAPABILITY_PTS.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_enqueue_pts(
+    MsgBuilder* builder,
+    uint16_t frame_seq,
+    uint32_t presentation_time_us,
+    const void* frame,
+    size_t frame_len
+);
+
+/**
+ * Generates and returns a CLOCK message, answering the sink time from a LENT
+ * message with the current time of the source, both in microseconds.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_clock(
+    MsgBuilder* builder,
+    uint32_t sink_time_us,
+    uint32_t source_time_us
+);
+
+/**
+ * Generates and returns an EFFECT message that makes the sink render the
+ * given AtollaEffect instead of showing enqueued frames. Both colors are a
+ * single light of color_len bytes in the pixel format of the source. Only
+ * send it to sinks that confirmed MSG_CAPABILITY_EFFECT.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_effect(
+    MsgBuilder* builder,
+    uint8_t effect,
+    uint16_t wavelength,
+    uint16_t period_ms,
+    const void* from_color,
+    const void* to_color,
+    size_t color_len
+);
+
+/**
+ * Generates and returns a NACK message asking for the ENQUEUE16 frames with the
+ * given sequence numbers to be sent again. Only send it to sources that were
+ * granted MSG_CAPABILITY_NACK.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_nack(
+    MsgBuilder* builder,
+    const uint16_t* frame_seqs,
+    size_t frame_seqs_len
+);
+
 
 /**
  * Generates and returns a fail message with the given causing message ID and
@@ -103,6 +226,36 @@ MemBlock* msg_builder_fail(
     uint8_t error_code
 );
 
+/**
+ * Generates and returns a discover message, asking all sinks that receive it
+ * to announce themselves.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_discover(
+    MsgBuilder* builder
+);
+
+/**
+ * Generates and returns an announce message describing a sink with the given
+ * UDP port, amount of lights and minimum frame duration in milliseconds, that
+ * accepts the given transfer pixel formats.
+ *
+ * The returned memory block references internal memory of the message builder
+ * and is only valid until the next message generation function is called with
+ * the same builder.
+ */
+MemBlock* msg_builder_announce(
+    MsgBuilder* builder,
+    uint16_t port,
+    uint16_t lights_count,
+    uint8_t min_frame_length,
+    const uint8_t* pixel_formats,
+    size_t pixel_formats_len
+);
+
 #ifdef __cplusplus
 }
 #endif
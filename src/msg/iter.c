@@ -5,6 +5,7 @@
 
 static MemBlock msg_iter_payload(MsgIter* iter);
 static uint16_t msg_iter_payload_length(MsgIter* iter);
+static uint32_t get_uint32(const uint8_t* bytes);
 
 MsgIter msg_iter_make(
     void* msg_buffer,
@@ -37,7 +38,7 @@ MsgType msg_iter_type(MsgIter* iter)
     assert(msg_iter_has_msg(iter));
 
     uint8_t msg_type_byte = iter->msg_buf_start[0];
-    assert((msg_type_byte >= 0 && msg_type_byte <= 2) || msg_type_byte == 255);
+    assert((msg_type_byte >= 0 && msg_type_byte <= 9) || msg_type_byte == 255);
     return (MsgType) msg_type_byte;
 }
 
@@ -88,6 +89,55 @@ uint8_t msg_iter_borrow_buffer_length(MsgIter* iter)
     return ((uint8_t*) payload.data)[1];
 }
 
+uint8_t msg_iter_borrow_pixel_format(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_BORROW);
+    MemBlock payload = msg_iter_payload(iter);
+    return (payload.size > 2) ? ((uint8_t*) payload.data)[2] : 0;
+}
+
+uint8_t msg_iter_borrow_priority(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_BORROW);
+    MemBlock payload = msg_iter_payload(iter);
+    return (payload.size > 3) ? ((uint8_t*) payload.data)[3] : 0;
+}
+
+uint8_t msg_iter_borrow_opacity(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_BORROW);
+    MemBlock payload = msg_iter_payload(iter);
+    return (payload.size > 4) ? ((uint8_t*) payload.data)[4] : 255;
+}
+
+uint8_t msg_iter_borrow_capabilities(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_BORROW);
+    MemBlock payload = msg_iter_payload(iter);
+    return (payload.size > 5) ? ((uint8_t*) payload.data)[5] : 0;
+}
+
+uint8_t msg_iter_lent_capabilities(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_LENT);
+    MemBlock payload = msg_iter_payload(iter);
+    return (payload.size > 0) ? ((uint8_t*) payload.data)[0] : 0;
+}
+
+bool msg_iter_lent_has_clock(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_LENT);
+    MemBlock payload = msg_iter_payload(iter);
+    return payload.size >= 5;
+}
+
+uint32_t msg_iter_lent_clock(MsgIter* iter)
+{
+    assert(msg_iter_lent_has_clock(iter));
+    MemBlock payload = msg_iter_payload(iter);
+    return get_uint32(((uint8_t*) payload.data) + 1);
+}
+
 uint8_t msg_iter_enqueue_frame_idx(MsgIter* iter)
 {
     assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE);
@@ -102,6 +152,140 @@ MemBlock msg_iter_enqueue_frame(MsgIter* iter)
     return mem_block_slice(&payload, 3, payload.size-3);
 }
 
+bool msg_iter_enqueue16_valid(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE16);
+    MemBlock payload = msg_iter_payload(iter);
+    return payload.size >= 4;
+}
+
+uint16_t msg_iter_enqueue16_frame_seq(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE16);
+    MemBlock payload = msg_iter_payload(iter);
+
+    uint16_t frame_seq;
+    memcpy(&frame_seq, payload.data, 2);
+    return mem_uint16le_from(frame_seq);
+}
+
+MemBlock msg_iter_enqueue16_frame(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE16);
+    MemBlock payload = msg_iter_payload(iter);
+    return mem_block_slice(&payload, 4, payload.size-4);
+}
+
+bool msg_iter_enqueue_pts_valid(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE_PTS);
+    MemBlock payload = msg_iter_payload(iter);
+    return payload.size >= 8;
+}
+
+uint16_t msg_iter_enqueue_pts_frame_seq(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE_PTS);
+    MemBlock payload = msg_iter_payload(iter);
+
+    uint16_t frame_seq;
+    memcpy(&frame_seq, payload.data, 2);
+    return mem_uint16le_from(frame_seq);
+}
+
+uint32_t msg_iter_enqueue_pts_time(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE_PTS);
+    MemBlock payload = msg_iter_payload(iter);
+    return get_uint32(((uint8_t*) payload.data) + 2);
+}
+
+MemBlock msg_iter_enqueue_pts_frame(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ENQUEUE_PTS);
+    MemBlock payload = msg_iter_payload(iter);
+    return mem_block_slice(&payload, 8, payload.size-8);
+}
+
+bool msg_iter_clock_valid(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_CLOCK);
+    MemBlock payload = msg_iter_payload(iter);
+    return payload.size >= 8;
+}
+
+uint32_t msg_iter_clock_sink_time(MsgIter* iter)
+{
+    assert(msg_iter_clock_valid(iter));
+    MemBlock payload = msg_iter_payload(iter);
+    return get_uint32((uint8_t*) payload.data);
+}
+
+uint32_t msg_iter_clock_source_time(MsgIter* iter)
+{
+    assert(msg_iter_clock_valid(iter));
+    MemBlock payload = msg_iter_payload(iter);
+    return get_uint32(((uint8_t*) payload.data) + 4);
+}
+
+bool msg_iter_effect_valid(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_EFFECT);
+    MemBlock payload = msg_iter_payload(iter);
+    return payload.size >= 5;
+}
+
+uint8_t msg_iter_effect(MsgIter* iter)
+{
+    assert(msg_iter_effect_valid(iter));
+    MemBlock payload = msg_iter_payload(iter);
+    return ((uint8_t*) payload.data)[0];
+}
+
+uint16_t msg_iter_effect_wavelength(MsgIter* iter)
+{
+    assert(msg_iter_effect_valid(iter));
+    MemBlock payload = msg_iter_payload(iter);
+
+    uint16_t wavelength;
+    memcpy(&wavelength, ((uint8_t*) payload.data) + 1, 2);
+    return mem_uint16le_from(wavelength);
+}
+
+uint16_t msg_iter_effect_period(MsgIter* iter)
+{
+    assert(msg_iter_effect_valid(iter));
+    MemBlock payload = msg_iter_payload(iter);
+
+    uint16_t period_ms;
+    memcpy(&period_ms, ((uint8_t*) payload.data) + 3, 2);
+    return mem_uint16le_from(period_ms);
+}
+
+MemBlock msg_iter_effect_colors(MsgIter* iter)
+{
+    assert(msg_iter_effect_valid(iter));
+    MemBlock payload = msg_iter_payload(iter);
+    return mem_block_slice(&payload, 5, payload.size-5);
+}
+
+size_t msg_iter_nack_frame_seqs_count(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_NACK);
+    MemBlock payload = msg_iter_payload(iter);
+    return payload.size / 2;
+}
+
+uint16_t msg_iter_nack_frame_seq(MsgIter* iter, size_t idx)
+{
+    assert(idx < msg_iter_nack_frame_seqs_count(iter));
+    MemBlock payload = msg_iter_payload(iter);
+
+    uint16_t frame_seq;
+    memcpy(&frame_seq, ((uint8_t*) payload.data) + 2*idx, 2);
+    return mem_uint16le_from(frame_seq);
+}
+
 uint16_t msg_iter_fail_offending_msg_id(MsgIter* iter)
 {
     assert(msg_iter_type(iter) == MSG_TYPE_FAIL);
@@ -114,6 +298,49 @@ uint16_t msg_iter_fail_offending_msg_id(MsgIter* iter)
     return offending_msg_id;
 }
 
+bool msg_iter_announce_valid(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ANNOUNCE);
+    MemBlock payload = msg_iter_payload(iter);
+    return payload.size >= 6 &&
+           payload.size >= (size_t) (6 + ((uint8_t*) payload.data)[5]);
+}
+
+uint16_t msg_iter_announce_port(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ANNOUNCE);
+    MemBlock payload = msg_iter_payload(iter);
+
+    uint16_t port;
+    memcpy(&port, payload.data, 2);
+    return mem_uint16le_from(port);
+}
+
+uint16_t msg_iter_announce_lights_count(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ANNOUNCE);
+    MemBlock payload = msg_iter_payload(iter);
+
+    uint16_t lights_count;
+    memcpy(&lights_count, ((uint8_t*) payload.data) + 2, 2);
+    return mem_uint16le_from(lights_count);
+}
+
+uint8_t msg_iter_announce_min_frame_length(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ANNOUNCE);
+    MemBlock payload = msg_iter_payload(iter);
+    return ((uint8_t*) payload.data)[4];
+}
+
+MemBlock msg_iter_announce_pixel_formats(MsgIter* iter)
+{
+    assert(msg_iter_type(iter) == MSG_TYPE_ANNOUNCE);
+    MemBlock payload = msg_iter_payload(iter);
+    uint8_t pixel_formats_len = ((uint8_t*) payload.data)[5];
+    return mem_block_slice(&payload, 6, pixel_formats_len);
+}
+
 uint8_t msg_iter_fail_error_code(MsgIter* iter)
 {
     assert(msg_iter_type(iter) == MSG_TYPE_FAIL);
@@ -122,3 +349,11 @@ uint8_t msg_iter_fail_error_code(MsgIter* iter)
     uint8_t* error_code_ptr = (uint8_t*) (offending_msg_id_ptr + 1);
     return *error_code_ptr;
 }
+
+static uint32_t get_uint32(const uint8_t* bytes)
+{
+    return ((uint32_t) bytes[0]) |
+           (((uint32_t) bytes[1]) << 8) |
+           (((uint32_t) bytes[2]) << 16) |
+           (((uint32_t) bytes[3]) << 24);
+}
@@ -92,6 +92,85 @@ uint8_t msg_iter_borrow_frame_length(MsgIter* iter);
  */
 uint8_t msg_iter_borrow_buffer_length(MsgIter* iter);
 
+/**
+ * Get the pixel format of frames that will be sent after a currently selected
+ * BORROW message. BORROW messages sent with protocol versions before 1.2 do not
+ * carry a pixel format, in which case zero is returned, which corresponds to
+ * ATOLLA_PIXEL_FORMAT_RGB8.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_BORROW, the behavior of
+ * this function is undefined. Do not call it with an iterator if
+ * msg_iter_has_msg returns false or if msg_iter_type returns a type different
+ * from MSG_TYPE_BORROW.
+ */
+uint8_t msg_iter_borrow_pixel_format(MsgIter* iter);
+
+/**
+ * Get the priority of the source that sent a currently selected BORROW
+ * message, which sinks with several sources use to order them. BORROW messages
+ * sent with protocol versions before 1.4 do not carry a priority, in which
+ * case zero is returned, the lowest priority.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_BORROW, the behavior of
+ * this function is undefined. Do not call it with an iterator if
+ * msg_iter_has_msg returns false or if msg_iter_type returns a type different
+ * from MSG_TYPE_BORROW.
+ */
+uint8_t msg_iter_borrow_priority(MsgIter* iter);
+
+/**
+ * Get the opacity that sinks blending several sources apply to frames of the
+ * source that sent a currently selected BORROW message, with 255 being fully
+ * opaque. BORROW messages sent with protocol versions before 1.4 do not carry
+ * an opacity, in which case 255 is returned.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_BORROW, the behavior of
+ * this function is undefined. Do not call it with an iterator if
+ * msg_iter_has_msg returns false or if msg_iter_type returns a type different
+ * from MSG_TYPE_BORROW.
+ */
+uint8_t msg_iter_borrow_opacity(MsgIter* iter);
+
+/**
+ * Get the MsgCapability bits that the source sending a currently selected
+ * BORROW message supports. BORROW messages sent with protocol versions before
+ * 1.5 do not carry capabilities, in which case 0 is returned.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_BORROW, the behavior of
+ * this function is undefined.
+ */
+uint8_t msg_iter_borrow_capabilities(MsgIter* iter);
+
+/**
+ * Get the MsgCapability bits that the sink sending a currently selected LENT
+ * message confirmed, or 0 if the LENT message carries none.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_LENT, the behavior of
+ * this function is undefined.
+ */
+uint8_t msg_iter_lent_capabilities(MsgIter* iter);
+
+/**
+ * Checks whether a currently selected LENT message carries the time of the
+ * sink, which sinks send to sources that were granted MSG_CAPABILITY_PTS.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_LENT, the behavior of
+ * this function is undefined.
+ */
+bool msg_iter_lent_has_clock(MsgIter* iter);
+
+/**
+ * Get the sink time in microseconds of a currently selected LENT message.
+ * Call it only if msg_iter_lent_has_clock returns true.
+ */
+uint32_t msg_iter_lent_clock(MsgIter* iter);
+
 /**
  * Get the contained frame index of a currently selected ENQUEUE message.
  *
@@ -114,6 +193,137 @@ uint8_t msg_iter_enqueue_frame_idx(MsgIter* iter);
  */
 MemBlock msg_iter_enqueue_frame(MsgIter* iter);
 
+/**
+ * Checks whether a currently selected ENQUEUE16 message is long enough to hold
+ * its sequence number and frame length. Use the other msg_iter_enqueue16
+ * functions only if this returns true.
+ */
+bool msg_iter_enqueue16_valid(MsgIter* iter);
+
+/**
+ * Get the 16 bit sequence number of a currently selected ENQUEUE16 message.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_ENQUEUE16, the behavior
+ * of this function is undefined.
+ */
+uint16_t msg_iter_enqueue16_frame_seq(MsgIter* iter);
+
+/**
+ * Get the contained frame of a currently selected ENQUEUE16 message.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_ENQUEUE16, the behavior
+ * of this function is undefined.
+ */
+MemBlock msg_iter_enqueue16_frame(MsgIter* iter);
+
+/**
+ * Checks whether a currently selected ENQUEUE_PTS message is long enough to
+ * hold its sequence number, presentation time and frame length. Use the other
+ * msg_iter_enqueue_pts functions only if this returns true.
+ */
+bool msg_iter_enqueue_pts_valid(MsgIter* iter);
+
+/**
+ * Get the 16 bit sequence number of a currently selected ENQUEUE_PTS message.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_ENQUEUE_PTS, the
+ * behavior of this function is undefined.
+ */
+uint16_t msg_iter_enqueue_pts_frame_seq(MsgIter* iter);
+
+/**
+ * Get the presentation time in microseconds on the clock of the source of a
+ * currently selected ENQUEUE_PTS message.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_ENQUEUE_PTS, the
+ * behavior of this function is undefined.
+ */
+uint32_t msg_iter_enqueue_pts_time(MsgIter* iter);
+
+/**
+ * Get the contained frame of a currently selected ENQUEUE_PTS message.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_ENQUEUE_PTS, the
+ * behavior of this function is undefined.
+ */
+MemBlock msg_iter_enqueue_pts_frame(MsgIter* iter);
+
+/**
+ * Checks whether a currently selected CLOCK message is long enough to hold
+ * both times. Use the other msg_iter_clock functions only if this returns
+ * true.
+ */
+bool msg_iter_clock_valid(MsgIter* iter);
+
+/**
+ * Get the sink time in microseconds from the LENT message that a currently
+ * selected CLOCK message answers.
+ */
+uint32_t msg_iter_clock_sink_time(MsgIter* iter);
+
+/**
+ * Get the time of the source in microseconds at which it sent a currently
+ * selected CLOCK message.
+ */
+uint32_t msg_iter_clock_source_time(MsgIter* iter);
+
+/**
+ * Checks whether a currently selected EFFECT message is long enough to hold
+ * its parameters. Use the other msg_iter_effect functions only if this
+ * returns true.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_EFFECT, the behavior
+ * of this function is undefined.
+ */
+bool msg_iter_effect_valid(MsgIter* iter);
+
+/**
+ * Get the AtollaEffect of a currently selected EFFECT message.
+ */
+uint8_t msg_iter_effect(MsgIter* iter);
+
+/**
+ * Get the wavelength in lights of a currently selected EFFECT message.
+ */
+uint16_t msg_iter_effect_wavelength(MsgIter* iter);
+
+/**
+ * Get the period in milliseconds of a currently selected EFFECT message.
+ */
+uint16_t msg_iter_effect_period(MsgIter* iter);
+
+/**
+ * Get the from color followed by the to color of a currently selected EFFECT
+ * message. Both take up half of the block, if the message is well-formed.
+ */
+MemBlock msg_iter_effect_colors(MsgIter* iter);
+
+/**
+ * Get the amount of sequence numbers of missing frames in a currently selected
+ * NACK message. Odd trailing bytes are ignored.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_NACK, the behavior
+ * of this function is undefined.
+ */
+size_t msg_iter_nack_frame_seqs_count(MsgIter* iter);
+
+/**
+ * Get the sequence number at the given index, which must be lower than
+ * msg_iter_nack_frame_seqs_count, of a currently selected NACK message.
+ *
+ * If the iterator is already at the end of the buffer, or if the currently
+ * selected message has a type different from MSG_TYPE_NACK, the behavior
+ * of this function is undefined.
+ */
+uint16_t msg_iter_nack_frame_seq(MsgIter* iter, size_t idx);
+
 /**
  * Get a previously sent message ID that a currently selected FAIL message
  * refers to.
@@ -138,6 +348,37 @@ uint16_t msg_iter_fail_offending_msg_id(MsgIter* iter);
  */
 uint8_t msg_iter_fail_error_code(MsgIter* iter);
 
+/**
+ * Checks whether a currently selected ANNOUNCE message is long enough to hold
+ * all of its fields and the announced amount of pixel formats. Use the other
+ * msg_iter_announce functions only if this returns true.
+ */
+bool msg_iter_announce_valid(MsgIter* iter);
+
+/**
+ * Get the UDP port that the sink sending a currently selected ANNOUNCE message
+ * listens on.
+ */
+uint16_t msg_iter_announce_port(MsgIter* iter);
+
+/**
+ * Get the amount of lights of the sink sending a currently selected ANNOUNCE
+ * message.
+ */
+uint16_t msg_iter_announce_lights_count(MsgIter* iter);
+
+/**
+ * Get the shortest frame duration in milliseconds that the sink sending a
+ * currently selected ANNOUNCE message accepts in BORROW messages.
+ */
+uint8_t msg_iter_announce_min_frame_length(MsgIter* iter);
+
+/**
+ * Get the pixel formats that the sink sending a currently selected ANNOUNCE
+ * message accepts, one byte per pixel format.
+ */
+MemBlock msg_iter_announce_pixel_formats(MsgIter* iter);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,80 @@
+#include "reassembler.h"
+#include "../mem/uint16le.h"
+#include "../test/assert.h"
+
+#include <string.h>
+
+static const size_t header_len = sizeof(uint8_t)  + // message type
+                                 sizeof(uint16_t) + // message ID
+                                 sizeof(uint16_t);  // payload size
+
+static size_t msg_len_at(const uint8_t* msg);
+
+void msg_reassembler_init(MsgReassembler* reassembler, size_t max_msg_len)
+{
+    assert(max_msg_len >= header_len);
+    reassembler->buf = mem_block_alloc(max_msg_len);
+    reassembler->buf.size = 0;
+}
+
+void msg_reassembler_free(MsgReassembler* reassembler)
+{
+    mem_block_free(&reassembler->buf);
+}
+
+void* msg_reassembler_space(MsgReassembler* reassembler, size_t* space_len)
+{
+    MemBlock* buf = &reassembler->buf;
+    *space_len = buf->capacity - buf->size;
+    return ((uint8_t*) buf->data) + buf->size;
+}
+
+void msg_reassembler_commit(MsgReassembler* reassembler, size_t received_len)
+{
+    MemBlock* buf = &reassembler->buf;
+    assert(received_len <= buf->capacity - buf->size);
+    buf->size += received_len;
+}
+
+size_t msg_reassembler_complete(MsgReassembler* reassembler, void** msgs)
+{
+    const uint8_t* start = (const uint8_t*) reassembler->buf.data;
+    const size_t received_len = reassembler->buf.size;
+
+    size_t complete_len = 0;
+    while(received_len - complete_len >= header_len)
+    {
+        size_t msg_len = msg_len_at(start + complete_len);
+        if(msg_len > received_len - complete_len)
+        {
+            break;
+        }
+        complete_len += msg_len;
+    }
+
+    *msgs = reassembler->buf.data;
+    return complete_len;
+}
+
+void msg_reassembler_consume(MsgReassembler* reassembler, size_t msgs_len)
+{
+    MemBlock* buf = &reassembler->buf;
+    assert(msgs_len <= buf->size);
+
+    // The rest is at most one incomplete message, so this usually moves little
+    memmove(buf->data, ((uint8_t*) buf->data) + msgs_len, buf->size - msgs_len);
+    buf->size -= msgs_len;
+}
+
+bool msg_reassembler_overflowed(MsgReassembler* reassembler)
+{
+    return reassembler->buf.size >= header_len &&
+           msg_len_at((const uint8_t*) reassembler->buf.data) > reassembler->buf.capacity;
+}
+
+static size_t msg_len_at(const uint8_t* msg)
+{
+    uint16_t payload_len;
+    memcpy(&payload_len, msg + 3, sizeof(uint16_t));
+    return header_len + mem_uint16le_from(payload_len);
+}
@@ -0,0 +1,81 @@
+#ifndef MSG_REASSEMBLER_H
+#define MSG_REASSEMBLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+#include "../mem/block.h"
+
+/**
+ * Length of the largest possible message, a header followed by the largest
+ * payload that fits the 16-bit payload length.
+ */
+#define MSG_REASSEMBLER_MAX_MSG_LEN (5 + 65535)
+
+/**
+ * Reassembles messages from a byte stream, e.g. a TCP connection, where reads
+ * return arbitrary slices of the stream instead of whole packets.
+ *
+ * Received bytes are written directly into the reassembler, which then hands
+ * out the longest run of complete messages at the front, ready to be passed
+ * to msg_iter_make. Incomplete messages at the end are kept for the next
+ * read.
+ */
+struct MsgReassembler
+{
+    MemBlock buf;
+};
+typedef struct MsgReassembler MsgReassembler;
+
+/**
+ * Allocates a buffer that can hold at least one message of the given maximum
+ * length. Use MSG_REASSEMBLER_MAX_MSG_LEN to accept any valid message.
+ */
+void msg_reassembler_init(MsgReassembler* reassembler, size_t max_msg_len);
+
+void msg_reassembler_free(MsgReassembler* reassembler);
+
+/**
+ * Gets the free space after the received bytes, for reading from the stream
+ * right into the reassembler. The amount of free bytes is written into
+ * space_len. Call msg_reassembler_commit after writing.
+ */
+void* msg_reassembler_space(MsgReassembler* reassembler, size_t* space_len);
+
+/**
+ * Marks the given amount of bytes at the start of the space returned by
+ * msg_reassembler_space as received.
+ */
+void msg_reassembler_commit(MsgReassembler* reassembler, size_t received_len);
+
+/**
+ * Gets the complete messages at the front of the received bytes. Returns the
+ * length of all complete messages together, or zero if the first message is
+ * not complete yet.
+ *
+ * The messages remain in the reassembler until msg_reassembler_consume is
+ * called.
+ */
+size_t msg_reassembler_complete(MsgReassembler* reassembler, void** msgs);
+
+/**
+ * Removes the given amount of bytes, usually the length returned by
+ * msg_reassembler_complete, from the front and moves the incomplete rest to
+ * the start of the buffer.
+ */
+void msg_reassembler_consume(MsgReassembler* reassembler, size_t msgs_len);
+
+/**
+ * Returns true if the first message is longer than the maximum message length
+ * that the reassembler was initialized with. Such a message can never be
+ * completed, so the stream cannot be read any further.
+ */
+bool msg_reassembler_overflowed(MsgReassembler* reassembler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MSG_REASSEMBLER_H
@@ -6,8 +6,33 @@ enum MsgType
     MSG_TYPE_BORROW = 0,
     MSG_TYPE_LENT = 1,
     MSG_TYPE_ENQUEUE = 2,
+    MSG_TYPE_DISCOVER = 3,
+    MSG_TYPE_ANNOUNCE = 4,
+    MSG_TYPE_ENQUEUE16 = 5,
+    MSG_TYPE_NACK = 6,
+    MSG_TYPE_ENQUEUE_PTS = 7,
+    MSG_TYPE_CLOCK = 8,
+    MSG_TYPE_EFFECT = 9,
     MSG_TYPE_FAIL = 255
 };
 typedef enum MsgType MsgType;
 
+/**
+ * Optional protocol features, offered by sources in BORROW and confirmed by
+ * sinks in LENT. Each is a bit in the capabilities byte.
+ */
+enum MsgCapability
+{
+    // The source may send ENQUEUE16 with 16 bit sequence numbers instead of ENQUEUE
+    MSG_CAPABILITY_ENQUEUE16 = 1,
+    // The sink may send NACK for ENQUEUE16 frames it missed, requires ENQUEUE16
+    MSG_CAPABILITY_NACK = 2,
+    // The source sends ENQUEUE_PTS with presentation times and answers the
+    // sink clock in LENT with CLOCK, requires ENQUEUE16
+    MSG_CAPABILITY_PTS = 4,
+    // The sink renders effects sent with EFFECT by itself
+    MSG_CAPABILITY_EFFECT = 8
+};
+typedef enum MsgCapability MsgCapability;
+
 #endif // MSG_TYPE_H
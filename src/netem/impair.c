@@ -0,0 +1,240 @@
+#include "impair.h"
+#include "../test/assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t queue_capacity_default = 1024;
+static const uint32_t seed_default = 0x2545F491;
+
+static uint32_t impair_random(NetemImpair* impair);
+static bool impair_chance(NetemImpair* impair, double probability);
+static unsigned int impair_delay(NetemImpair* impair);
+static unsigned int impair_serialize(NetemImpair* impair, size_t data_len, unsigned int now);
+static NetemImpairSlot* impair_free_slot(NetemImpair* impair);
+static NetemImpairSlot* impair_next_slot(NetemImpair* impair);
+static int time_diff(unsigned int from, unsigned int to);
+
+void netem_impair_init(NetemImpair* impair, const NetemImpairSpec* spec)
+{
+    assert(spec->loss >= 0.0 && spec->loss <= 1.0);
+    assert(spec->duplicate >= 0.0 && spec->duplicate <= 1.0);
+    assert(spec->reorder >= 0.0 && spec->reorder <= 1.0);
+
+    memset(impair, 0, sizeof(NetemImpair));
+
+    impair->spec = *spec;
+    if(impair->spec.queue_capacity == 0)
+    {
+        impair->spec.queue_capacity = queue_capacity_default;
+    }
+
+    // xorshift gets stuck on zero, so replace it with an arbitrary other seed
+    impair->rng_state = (spec->seed == 0) ? seed_default : spec->seed;
+
+    impair->slots_len = impair->spec.queue_capacity;
+    impair->slots = (NetemImpairSlot*) calloc(impair->slots_len, sizeof(NetemImpairSlot));
+    assert(impair->slots != NULL);
+}
+
+void netem_impair_free(NetemImpair* impair)
+{
+    for(size_t i = 0; i < impair->slots_len; ++i)
+    {
+        mem_block_free(&impair->slots[i].data);
+    }
+
+    free(impair->slots);
+    impair->slots = NULL;
+    impair->slots_len = 0;
+}
+
+void netem_impair_submit(NetemImpair* impair, const void* data, size_t data_len, unsigned int now)
+{
+    ++impair->stats.submitted;
+
+    if(impair_chance(impair, impair->spec.loss))
+    {
+        ++impair->stats.lost;
+        return;
+    }
+
+    int copies = 1;
+    if(impair_chance(impair, impair->spec.duplicate))
+    {
+        ++impair->stats.duplicated;
+        copies = 2;
+    }
+
+    for(int i = 0; i < copies; ++i)
+    {
+        NetemImpairSlot* slot = impair_free_slot(impair);
+        if(slot == NULL)
+        {
+            ++impair->stats.queue_dropped;
+            continue;
+        }
+
+        // First wait for the bottleneck link, then travel with jittered delay
+        unsigned int departure_time = impair_serialize(impair, data_len, now);
+        unsigned int delay = impair_delay(impair);
+
+        if(impair_chance(impair, impair->spec.reorder))
+        {
+            ++impair->stats.reordered;
+            delay += impair->spec.reorder_delay_ms;
+        }
+
+        mem_block_resize(&slot->data, data_len);
+        if(data_len > 0)
+        {
+            memcpy(slot->data.data, data, data_len);
+        }
+        slot->release_time = departure_time + delay;
+        slot->order = impair->next_order++;
+        slot->used = true;
+    }
+}
+
+bool netem_impair_poll(NetemImpair* impair, unsigned int now, void* buf, size_t buf_capacity, size_t* data_len)
+{
+    NetemImpairSlot* slot = impair_next_slot(impair);
+
+    if(slot == NULL || time_diff(now, slot->release_time) > 0)
+    {
+        return false;
+    }
+
+    size_t copy_len = (slot->data.size < buf_capacity) ? slot->data.size : buf_capacity;
+    if(copy_len > 0)
+    {
+        memcpy(buf, slot->data.data, copy_len);
+    }
+    if(data_len)
+    {
+        *data_len = copy_len;
+    }
+
+    // Keep the memory of the slot around for the next datagram
+    slot->used = false;
+    ++impair->stats.delivered;
+
+    return true;
+}
+
+int netem_impair_next_timeout(NetemImpair* impair, unsigned int now)
+{
+    NetemImpairSlot* slot = impair_next_slot(impair);
+
+    if(slot == NULL)
+    {
+        return -1;
+    }
+
+    int timeout = time_diff(now, slot->release_time);
+    return (timeout > 0) ? timeout : 0;
+}
+
+static uint32_t impair_random(NetemImpair* impair)
+{
+    // xorshift32, small and reproducible across platforms
+    uint32_t x = impair->rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    impair->rng_state = x;
+    return x;
+}
+
+static bool impair_chance(NetemImpair* impair, double probability)
+{
+    // Always draw, so that decisions do not shift when a probability is zero
+    double roll = impair_random(impair) / 4294967296.0;
+    return roll < probability;
+}
+
+static unsigned int impair_delay(NetemImpair* impair)
+{
+    unsigned int jitter = impair->spec.jitter_ms;
+    uint32_t roll = impair_random(impair);
+
+    if(jitter == 0)
+    {
+        return impair->spec.delay_ms;
+    }
+
+    int offset = (int) (roll % (2 * jitter + 1)) - (int) jitter;
+    int delay = ((int) impair->spec.delay_ms) + offset;
+    return (delay > 0) ? (unsigned int) delay : 0;
+}
+
+static unsigned int impair_serialize(NetemImpair* impair, size_t data_len, unsigned int now)
+{
+    unsigned int rate = impair->spec.rate_bytes_per_sec;
+
+    if(rate == 0)
+    {
+        return now;
+    }
+
+    unsigned int start = now;
+    if(impair->link_busy && time_diff(now, impair->link_free_time) > 0)
+    {
+        start = impair->link_free_time;
+    }
+
+    // Round up so that a stream of small datagrams cannot sneak past the cap
+    unsigned int transmit_ms = (unsigned int) ((data_len * 1000 + rate - 1) / rate);
+
+    impair->link_free_time = start + transmit_ms;
+    impair->link_busy = true;
+
+    return impair->link_free_time;
+}
+
+static NetemImpairSlot* impair_free_slot(NetemImpair* impair)
+{
+    for(size_t i = 0; i < impair->slots_len; ++i)
+    {
+        if(!impair->slots[i].used)
+        {
+            return &impair->slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+static NetemImpairSlot* impair_next_slot(NetemImpair* impair)
+{
+    NetemImpairSlot* next = NULL;
+
+    for(size_t i = 0; i < impair->slots_len; ++i)
+    {
+        NetemImpairSlot* slot = &impair->slots[i];
+        if(!slot->used)
+        {
+            continue;
+        }
+
+        if(next == NULL)
+        {
+            next = slot;
+        }
+        else
+        {
+            int release_diff = time_diff(next->release_time, slot->release_time);
+            if(release_diff < 0 || (release_diff == 0 && time_diff(next->order, slot->order) < 0))
+            {
+                next = slot;
+            }
+        }
+    }
+
+    return next;
+}
+
+static int time_diff(unsigned int from, unsigned int to)
+{
+    return (int) (to - from);
+}
@@ -0,0 +1,150 @@
+#ifndef NETEM_IMPAIR_H
+#define NETEM_IMPAIR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+#include "../mem/block.h"
+
+/**
+ * Configures the kind and amount of damage that a NetemImpair inflicts on the
+ * datagrams passing through it.
+ *
+ * Probabilities are given in the range from 0.0 (never) to 1.0 (always).
+ */
+struct NetemImpairSpec
+{
+    /**
+     * Seed for the pseudo-random number generator. Feeding the same sequence
+     * of datagrams through two impairments with the same spec and seed yields
+     * the same sequence of decisions.
+     */
+    uint32_t seed;
+    /** Probability that a datagram is silently dropped */
+    double loss;
+    /** Probability that a datagram is delivered twice */
+    double duplicate;
+    /**
+     * Probability that a datagram is held back for an extra reorder_delay_ms
+     * so that datagrams submitted after it overtake it.
+     */
+    double reorder;
+    /** Extra delay for datagrams selected for reordering, in milliseconds */
+    unsigned int reorder_delay_ms;
+    /** Constant delay that is applied to every datagram, in milliseconds */
+    unsigned int delay_ms;
+    /**
+     * Maximum deviation from delay_ms in milliseconds. The actual delay of
+     * each datagram is picked uniformly from delay_ms +/- jitter_ms.
+     */
+    unsigned int jitter_ms;
+    /**
+     * Bandwidth cap in bytes per second. Datagrams are serialized onto a
+     * virtual link of this rate and queue up if the link is busy. A value of
+     * zero disables the cap.
+     */
+    unsigned int rate_bytes_per_sec;
+    /**
+     * Maximum amount of datagrams held back at once. Datagrams that arrive
+     * while the queue is full are dropped, like on a congested router.
+     *
+     * A value of zero lets the implementation pick a default value.
+     */
+    size_t queue_capacity;
+};
+typedef struct NetemImpairSpec NetemImpairSpec;
+
+/**
+ * Counts what happened to the datagrams submitted to an impairment.
+ */
+struct NetemImpairStats
+{
+    unsigned int submitted;
+    unsigned int delivered;
+    unsigned int lost;
+    unsigned int queue_dropped;
+    unsigned int duplicated;
+    unsigned int reordered;
+};
+typedef struct NetemImpairStats NetemImpairStats;
+
+/**
+ * A datagram held back by the impairment until its release time.
+ */
+struct NetemImpairSlot
+{
+    MemBlock data;
+    unsigned int release_time;
+    /** Increases with each held datagram, breaks ties between equal release times */
+    unsigned int order;
+    bool used;
+};
+typedef struct NetemImpairSlot NetemImpairSlot;
+
+/**
+ * Holds back datagrams and releases them later, possibly reordered,
+ * duplicated or not at all, to emulate a lossy network in user space.
+ *
+ * The impairment does not know about sockets. Datagrams are fed in with
+ * netem_impair_submit and taken out with netem_impair_poll once they are
+ * due. One instance models one direction of a link.
+ */
+struct NetemImpair
+{
+    NetemImpairSpec spec;
+    NetemImpairStats stats;
+
+    uint32_t rng_state;
+    unsigned int next_order;
+    /** Point in time when the virtual link has finished sending the last queued datagram */
+    unsigned int link_free_time;
+    bool link_busy;
+
+    NetemImpairSlot* slots;
+    size_t slots_len;
+};
+typedef struct NetemImpair NetemImpair;
+
+/**
+ * Initializes the given impairment with the given spec and allocates memory
+ * for the held back datagrams.
+ */
+void netem_impair_init(NetemImpair* impair, const NetemImpairSpec* spec);
+
+/**
+ * Frees the memory held by the impairment. The NetemImpair structure itself
+ * is managed by the calling code.
+ */
+void netem_impair_free(NetemImpair* impair);
+
+/**
+ * Submits a datagram at the given point in time in milliseconds.
+ *
+ * The data is copied, so the given buffer may be re-used after the call.
+ * Depending on the spec, the datagram might be dropped, delayed or scheduled
+ * to be released twice.
+ */
+void netem_impair_submit(NetemImpair* impair, const void* data, size_t data_len, unsigned int now);
+
+/**
+ * Copies the next datagram that is due at the given point in time in
+ * milliseconds into the given buffer and stores its length in data_len.
+ *
+ * Datagrams larger than the buffer are truncated. Returns false if no datagram
+ * is due yet.
+ */
+bool netem_impair_poll(NetemImpair* impair, unsigned int now, void* buf, size_t buf_capacity, size_t* data_len);
+
+/**
+ * Returns the amount of milliseconds from now until the next datagram is due,
+ * zero if a datagram is already due or -1 if nothing is held back.
+ */
+int netem_impair_next_timeout(NetemImpair* impair, unsigned int now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NETEM_IMPAIR_H
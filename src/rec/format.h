@@ -0,0 +1,78 @@
+#ifndef REC_FORMAT_H
+#define REC_FORMAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+
+/**
+ * Recordings are append-only files of datagrams with timestamps.
+ *
+ * A recording starts with an eight byte header made up of the four magic
+ * bytes "ATRC", followed by an uint16 format version and two reserved bytes.
+ *
+ * After the header, records follow until the end of the file. Each record
+ * starts with one tag byte:
+ *
+ * - REC_TAG_SENDER defines a sender ID. It is followed by an uint8 sender ID,
+ *   an uint8 address family (4 or 6), four or sixteen address bytes and an
+ *   uint16 port.
+ * - REC_TAG_TO_SINK and REC_TAG_FROM_SINK hold a datagram. The tag is followed
+ *   by a varint with the microseconds passed since the previous datagram, an
+ *   uint8 sender ID that has previously been defined, a varint holding the
+ *   datagram length and then the datagram bytes.
+ *
+ * Multi-byte integers are little-endian, like in the protocol. Varints use
+ * seven bits per byte, least significant group first, with the highest bit
+ * set on all bytes but the last.
+ *
+ * Since records are only ever appended, a recording that was cut short by a
+ * crash is still readable up to the last complete record.
+ */
+
+#define REC_MAGIC "ATRC"
+#define REC_MAGIC_LEN 4
+#define REC_HEADER_LEN 8
+#define REC_VERSION 1
+
+/** Maximum amount of distinct senders in one recording */
+#define REC_MAX_SENDERS 256
+
+enum RecTag
+{
+    REC_TAG_SENDER = 1,
+    REC_TAG_TO_SINK = 2,
+    REC_TAG_FROM_SINK = 3
+};
+typedef enum RecTag RecTag;
+
+enum RecDirection
+{
+    /** The datagram was sent by a source to the sink */
+    REC_DIRECTION_TO_SINK,
+    /** The datagram was sent by the sink to a source */
+    REC_DIRECTION_FROM_SINK
+};
+typedef enum RecDirection RecDirection;
+
+/**
+ * The network address of a peer that sent datagrams in a recording, in a
+ * platform-independent representation.
+ */
+struct RecSender
+{
+    /** 4 for IPv4 or 6 for IPv6 */
+    uint8_t family;
+    /** Address in network byte order, IPv4 addresses use the first four bytes */
+    uint8_t address[16];
+    uint16_t port;
+};
+typedef struct RecSender RecSender;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REC_FORMAT_H
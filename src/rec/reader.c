@@ -0,0 +1,184 @@
+#include "reader.h"
+#include "../test/assert.h"
+
+#include <string.h>
+
+/** Upper bound for datagram lengths, anything larger is treated as corruption */
+static const unsigned long long max_datagram_len = 65536;
+
+static bool read_sender(RecReader* reader);
+static bool read_varint(FILE* file, unsigned long long* value);
+static bool read_uint8(FILE* file, uint8_t* value);
+static bool read_uint16(FILE* file, uint16_t* value);
+
+bool rec_reader_open(RecReader* reader, const char* path)
+{
+    memset(reader, 0, sizeof(RecReader));
+
+    reader->file = fopen(path, "rb");
+    if(reader->file == NULL)
+    {
+        return false;
+    }
+
+    char magic[REC_MAGIC_LEN];
+    uint16_t version;
+    uint16_t reserved;
+
+    bool ok = fread(magic, 1, REC_MAGIC_LEN, reader->file) == REC_MAGIC_LEN &&
+              memcmp(magic, REC_MAGIC, REC_MAGIC_LEN) == 0 &&
+              read_uint16(reader->file, &version) &&
+              version == REC_VERSION &&
+              read_uint16(reader->file, &reserved);
+
+    if(!ok)
+    {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+
+    return ok;
+}
+
+bool rec_reader_next(RecReader* reader, RecDatagram* datagram)
+{
+    assert(reader->file != NULL);
+
+    uint8_t tag;
+    while(read_uint8(reader->file, &tag))
+    {
+        if(tag == REC_TAG_SENDER)
+        {
+            if(!read_sender(reader))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if(tag != REC_TAG_TO_SINK && tag != REC_TAG_FROM_SINK)
+        {
+            return false;
+        }
+
+        unsigned long long delta;
+        uint8_t sender_id;
+        unsigned long long data_len;
+
+        bool ok = read_varint(reader->file, &delta) &&
+                  read_uint8(reader->file, &sender_id) &&
+                  reader->senders_defined[sender_id] &&
+                  read_varint(reader->file, &data_len) &&
+                  data_len <= max_datagram_len;
+
+        if(!ok)
+        {
+            return false;
+        }
+
+        mem_block_resize(&reader->buf, (size_t) data_len);
+        if(data_len > 0 && fread(reader->buf.data, 1, (size_t) data_len, reader->file) != data_len)
+        {
+            return false;
+        }
+
+        reader->time_us += delta;
+
+        datagram->time_us = reader->time_us;
+        datagram->direction = (tag == REC_TAG_TO_SINK) ? REC_DIRECTION_TO_SINK : REC_DIRECTION_FROM_SINK;
+        datagram->sender_id = sender_id;
+        datagram->data = mem_block_make(reader->buf.data, (size_t) data_len);
+
+        return true;
+    }
+
+    return false;
+}
+
+const RecSender* rec_reader_sender(RecReader* reader, uint8_t sender_id)
+{
+    return reader->senders_defined[sender_id] ? &reader->senders[sender_id] : NULL;
+}
+
+void rec_reader_close(RecReader* reader)
+{
+    if(reader->file)
+    {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+
+    mem_block_free(&reader->buf);
+}
+
+static bool read_sender(RecReader* reader)
+{
+    uint8_t sender_id;
+    RecSender sender;
+    memset(&sender, 0, sizeof(RecSender));
+
+    if(!read_uint8(reader->file, &sender_id) ||
+       !read_uint8(reader->file, &sender.family) ||
+       (sender.family != 4 && sender.family != 6))
+    {
+        return false;
+    }
+
+    size_t address_len = (sender.family == 4) ? 4 : 16;
+    if(fread(sender.address, 1, address_len, reader->file) != address_len ||
+       !read_uint16(reader->file, &sender.port))
+    {
+        return false;
+    }
+
+    reader->senders[sender_id] = sender;
+    reader->senders_defined[sender_id] = true;
+
+    return true;
+}
+
+static bool read_varint(FILE* file, unsigned long long* value)
+{
+    unsigned long long result = 0;
+    unsigned int shift = 0;
+    uint8_t group;
+
+    do
+    {
+        if(shift >= 64 || !read_uint8(file, &group))
+        {
+            return false;
+        }
+
+        result |= ((unsigned long long) (group & 0x7F)) << shift;
+        shift += 7;
+    }
+    while(group & 0x80);
+
+    *value = result;
+    return true;
+}
+
+static bool read_uint8(FILE* file, uint8_t* value)
+{
+    int c = fgetc(file);
+    if(c == EOF)
+    {
+        return false;
+    }
+
+    *value = (uint8_t) c;
+    return true;
+}
+
+static bool read_uint16(FILE* file, uint16_t* value)
+{
+    uint8_t bytes[2];
+    if(fread(bytes, 1, 2, file) != 2)
+    {
+        return false;
+    }
+
+    *value = (uint16_t) (bytes[0] | (bytes[1] << 8));
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef REC_READER_H
+#define REC_READER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "format.h"
+#include "../mem/block.h"
+
+#include <stdio.h>
+
+/**
+ * A datagram read from a recording.
+ */
+struct RecDatagram
+{
+    /** Microseconds since the first datagram of the recording */
+    unsigned long long time_us;
+    RecDirection direction;
+    uint8_t sender_id;
+    /** Datagram bytes, only valid until the next call to rec_reader_next */
+    MemBlock data;
+};
+typedef struct RecDatagram RecDatagram;
+
+/**
+ * Reads datagrams from a recording file in the order they were written.
+ */
+struct RecReader
+{
+    FILE* file;
+    unsigned long long time_us;
+    RecSender senders[REC_MAX_SENDERS];
+    bool senders_defined[REC_MAX_SENDERS];
+    MemBlock buf;
+};
+typedef struct RecReader RecReader;
+
+/**
+ * Opens the recording at the given path and checks its header.
+ *
+ * Returns false if the file could not be opened or is not a recording of a
+ * supported version.
+ */
+bool rec_reader_open(RecReader* reader, const char* path);
+
+/**
+ * Reads the next datagram into the given structure. Sender definitions are
+ * processed on the way and can then be queried with rec_reader_sender.
+ *
+ * Returns false at the end of the recording. An incomplete or malformed
+ * record at the end of the file is treated like the end of the recording.
+ */
+bool rec_reader_next(RecReader* reader, RecDatagram* datagram);
+
+/**
+ * Gets the address of the sender with the given ID, or NULL if no sender with
+ * the ID has been read yet.
+ */
+const RecSender* rec_reader_sender(RecReader* reader, uint8_t sender_id);
+
+/**
+ * Closes the recording and frees the read buffer. The RecReader structure
+ * itself is managed by the calling code.
+ */
+void rec_reader_close(RecReader* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REC_READER_H
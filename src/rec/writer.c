@@ -0,0 +1,168 @@
+#include "writer.h"
+#include "../mem/uint16_byte.h"
+#include "../test/assert.h"
+
+#include <string.h>
+
+static int writer_sender_id(RecWriter* writer, const RecSender* sender, bool* ok);
+static bool write_sender(RecWriter* writer, uint8_t sender_id, const RecSender* sender);
+static bool write_varint(FILE* file, unsigned long long value);
+static bool write_uint8(FILE* file, uint8_t value);
+static bool write_uint16(FILE* file, uint16_t value);
+
+bool rec_writer_open(RecWriter* writer, const char* path)
+{
+    memset(writer, 0, sizeof(RecWriter));
+
+    writer->file = fopen(path, "wb");
+    if(writer->file == NULL)
+    {
+        return false;
+    }
+
+    bool ok = fwrite(REC_MAGIC, 1, REC_MAGIC_LEN, writer->file) == REC_MAGIC_LEN &&
+              write_uint16(writer->file, REC_VERSION) &&
+              write_uint16(writer->file, 0);
+
+    if(!ok)
+    {
+        fclose(writer->file);
+        writer->file = NULL;
+    }
+
+    return ok;
+}
+
+bool rec_writer_datagram(
+    RecWriter* writer,
+    unsigned long long time_us,
+    RecDirection direction,
+    const RecSender* sender,
+    const void* data,
+    size_t data_len
+)
+{
+    assert(writer->file != NULL);
+
+    bool ok = true;
+    int sender_id = writer_sender_id(writer, sender, &ok);
+    if(sender_id < 0 || !ok)
+    {
+        return false;
+    }
+
+    unsigned long long delta = 0;
+    if(writer->has_time && time_us > writer->last_time_us)
+    {
+        delta = time_us - writer->last_time_us;
+    }
+    // Never let the clock run backwards in the file, even if the caller's does
+    if(!writer->has_time || time_us > writer->last_time_us)
+    {
+        writer->last_time_us = time_us;
+    }
+    writer->has_time = true;
+
+    uint8_t tag = (direction == REC_DIRECTION_TO_SINK) ? REC_TAG_TO_SINK : REC_TAG_FROM_SINK;
+
+    return write_uint8(writer->file, tag) &&
+           write_varint(writer->file, delta) &&
+           write_uint8(writer->file, (uint8_t) sender_id) &&
+           write_varint(writer->file, data_len) &&
+           (data_len == 0 || fwrite(data, 1, data_len, writer->file) == data_len);
+}
+
+void rec_writer_flush(RecWriter* writer)
+{
+    if(writer->file)
+    {
+        fflush(writer->file);
+    }
+}
+
+void rec_writer_close(RecWriter* writer)
+{
+    if(writer->file)
+    {
+        fclose(writer->file);
+        writer->file = NULL;
+    }
+}
+
+/**
+ * Looks up the ID of the given sender and defines a new ID if the sender was
+ * not seen before. Returns -1 if all IDs are used up.
+ */
+static int writer_sender_id(RecWriter* writer, const RecSender* sender, bool* ok)
+{
+    // Copy field by field so that padding and unused address bytes are zero
+    // and the same sender always compares equal
+    RecSender normalized;
+    memset(&normalized, 0, sizeof(RecSender));
+    normalized.family = sender->family;
+    normalized.port = sender->port;
+    memcpy(normalized.address, sender->address, (sender->family == 4) ? 4 : 16);
+
+    for(size_t i = 0; i < writer->senders_len; ++i)
+    {
+        if(memcmp(&writer->senders[i], &normalized, sizeof(RecSender)) == 0)
+        {
+            return (int) i;
+        }
+    }
+
+    if(writer->senders_len == REC_MAX_SENDERS)
+    {
+        return -1;
+    }
+
+    uint8_t sender_id = (uint8_t) writer->senders_len;
+    writer->senders[writer->senders_len++] = normalized;
+
+    *ok = write_sender(writer, sender_id, &normalized);
+    return sender_id;
+}
+
+static bool write_sender(RecWriter* writer, uint8_t sender_id, const RecSender* sender)
+{
+    assert(sender->family == 4 || sender->family == 6);
+    size_t address_len = (sender->family == 4) ? 4 : 16;
+
+    return write_uint8(writer->file, REC_TAG_SENDER) &&
+           write_uint8(writer->file, sender_id) &&
+           write_uint8(writer->file, sender->family) &&
+           fwrite(sender->address, 1, address_len, writer->file) == address_len &&
+           write_uint16(writer->file, sender->port);
+}
+
+static bool write_varint(FILE* file, unsigned long long value)
+{
+    do
+    {
+        uint8_t group = (uint8_t) (value & 0x7F);
+        value >>= 7;
+        if(value != 0)
+        {
+            group |= 0x80;
+        }
+
+        if(!write_uint8(file, group))
+        {
+            return false;
+        }
+    }
+    while(value != 0);
+
+    return true;
+}
+
+static bool write_uint8(FILE* file, uint8_t value)
+{
+    return fputc(value, file) != EOF;
+}
+
+static bool write_uint16(FILE* file, uint16_t value)
+{
+    uint8_t bytes[2] = { mem_uint16_byte_low(value), mem_uint16_byte_high(value) };
+    return fwrite(bytes, 1, 2, file) == 2;
+}
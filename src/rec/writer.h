@@ -0,0 +1,68 @@
+#ifndef REC_WRITER_H
+#define REC_WRITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "format.h"
+
+#include <stdio.h>
+
+/**
+ * Appends datagrams to a recording file in the format described in format.h.
+ *
+ * The writer assigns sender IDs on its own. Pass the sender of each datagram
+ * and a definition record is written the first time a sender shows up.
+ */
+struct RecWriter
+{
+    FILE* file;
+    unsigned long long last_time_us;
+    bool has_time;
+    RecSender senders[REC_MAX_SENDERS];
+    size_t senders_len;
+};
+typedef struct RecWriter RecWriter;
+
+/**
+ * Creates or truncates the file at the given path and writes the recording
+ * header.
+ *
+ * Returns false if the file could not be opened for writing.
+ */
+bool rec_writer_open(RecWriter* writer, const char* path);
+
+/**
+ * Appends a datagram that was sent or received at the given point in time in
+ * microseconds. Timestamps are stored relative to the first datagram, so the
+ * origin of the clock does not matter as long as it is the same for all calls.
+ *
+ * Returns false if writing failed or if the recording already has the
+ * maximum amount of senders.
+ */
+bool rec_writer_datagram(
+    RecWriter* writer,
+    unsigned long long time_us,
+    RecDirection direction,
+    const RecSender* sender,
+    const void* data,
+    size_t data_len
+);
+
+/**
+ * Writes buffered records to disk without closing the file.
+ */
+void rec_writer_flush(RecWriter* writer);
+
+/**
+ * Flushes and closes the recording. The RecWriter structure itself is
+ * managed by the calling code.
+ */
+void rec_writer_close(RecWriter* writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REC_WRITER_H
@@ -0,0 +1,417 @@
+#include "channel.h"
+#include "../test/assert.h"
+
+#include <string.h>
+
+#if defined(__linux__)
+    #define SHM_CHANNEL_SUPPORTED
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <linux/futex.h>
+    #include <signal.h>
+    #include <stdio.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+#define SHM_CHANNEL_CACHE_LINE 64
+
+struct ShmChannelHeader
+{
+    char magic[SHM_CHANNEL_MAGIC_LEN];
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t sink_pid;
+    uint32_t source_pid;
+};
+
+/**
+ * Positions are free-running and only taken modulo the capacity when
+ * accessing data, so a full ring can be told apart from an empty one.
+ */
+struct ShmChannelRing
+{
+    uint32_t write_pos;
+    uint8_t write_pad[SHM_CHANNEL_CACHE_LINE - sizeof(uint32_t)];
+    uint32_t read_pos;
+    uint8_t read_pad[SHM_CHANNEL_CACHE_LINE - sizeof(uint32_t)];
+    // Incremented after each write, the consumer waits on it with a futex
+    uint32_t wakeups;
+    uint32_t waiting;
+    uint8_t wakeups_pad[SHM_CHANNEL_CACHE_LINE - 2 * sizeof(uint32_t)];
+    uint8_t data[];
+};
+typedef struct ShmChannelRing ShmChannelRing;
+
+#ifdef SHM_CHANNEL_SUPPORTED
+static bool channel_map(ShmChannel* channel, int fd, size_t mapping_len);
+static void channel_segment_name(char* segment_name, size_t segment_name_capacity, const char* name);
+static bool segment_sink_alive(const char* segment_name);
+static bool process_alive(uint32_t pid);
+static size_t ring_len(size_t capacity);
+static size_t segment_len(size_t capacity);
+static uint32_t datagram_space(size_t data_len);
+#endif
+
+bool shm_channel_create(ShmChannel* channel, const char* name)
+{
+    memset(channel, 0, sizeof(ShmChannel));
+
+#ifdef SHM_CHANNEL_SUPPORTED
+    // The capacity must be a power of two, so that free-running positions wrap consistently
+    assert((SHM_CHANNEL_CAPACITY & (SHM_CHANNEL_CAPACITY - 1)) == 0);
+
+    channel_segment_name(channel->name, sizeof(channel->name), name);
+
+    int fd = shm_open(channel->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd == -1 && errno == EEXIST)
+    {
+        // Take over the name if the sink that created the segment is gone
+        if(segment_sink_alive(channel->name))
+        {
+            return false;
+        }
+
+        shm_unlink(channel->name);
+        fd = shm_open(channel->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+
+    if(fd == -1)
+    {
+        return false;
+    }
+
+    size_t mapping_len = segment_len(SHM_CHANNEL_CAPACITY);
+    if(ftruncate(fd, (off_t) mapping_len) != 0 || !channel_map(channel, fd, mapping_len))
+    {
+        close(fd);
+        shm_unlink(channel->name);
+        return false;
+    }
+
+    close(fd);
+
+    // The new segment is zero-filled, so both rings start out empty
+    struct ShmChannelHeader* header = (struct ShmChannelHeader*) channel->mapping;
+    header->version = SHM_CHANNEL_VERSION;
+    header->capacity = SHM_CHANNEL_CAPACITY;
+    header->sink_pid = (uint32_t) getpid();
+
+    // Publish the magic last, sources refuse to attach before
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header->magic, SHM_CHANNEL_MAGIC, SHM_CHANNEL_MAGIC_LEN);
+
+    channel->is_sink = true;
+    channel->capacity = SHM_CHANNEL_CAPACITY;
+    channel->rx = (ShmChannelRing*) (((uint8_t*) channel->mapping) + SHM_CHANNEL_HEADER_LEN);
+    channel->tx = (ShmChannelRing*) (((uint8_t*) channel->rx) + ring_len(SHM_CHANNEL_CAPACITY));
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool shm_channel_attach(ShmChannel* channel, const char* name)
+{
+    memset(channel, 0, sizeof(ShmChannel));
+
+#ifdef SHM_CHANNEL_SUPPORTED
+    channel_segment_name(channel->name, sizeof(channel->name), name);
+
+    int fd = shm_open(channel->name, O_RDWR, 0);
+    if(fd == -1)
+    {
+        return false;
+    }
+
+    struct stat segment_stat;
+    if(fstat(fd, &segment_stat) != 0 ||
+       (size_t) segment_stat.st_size < SHM_CHANNEL_HEADER_LEN ||
+       !channel_map(channel, fd, (size_t) segment_stat.st_size))
+    {
+        close(fd);
+        return false;
+    }
+
+    close(fd);
+
+    struct ShmChannelHeader* header = (struct ShmChannelHeader*) channel->mapping;
+    size_t capacity = header->capacity;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    bool valid = memcmp(header->magic, SHM_CHANNEL_MAGIC, SHM_CHANNEL_MAGIC_LEN) == 0 &&
+                 header->version == SHM_CHANNEL_VERSION &&
+                 capacity > 0 && (capacity & (capacity - 1)) == 0 &&
+                 segment_len(capacity) <= channel->mapping_len;
+
+    if(!valid)
+    {
+        munmap(channel->mapping, channel->mapping_len);
+        memset(channel, 0, sizeof(ShmChannel));
+        return false;
+    }
+
+    channel->is_sink = false;
+    channel->capacity = capacity;
+    channel->tx = (ShmChannelRing*) (((uint8_t*) channel->mapping) + SHM_CHANNEL_HEADER_LEN);
+    channel->rx = (ShmChannelRing*) (((uint8_t*) channel->tx) + ring_len(capacity));
+
+    // Claim the source end, or take it over from a source that exited without detaching
+    uint32_t own_pid = (uint32_t) getpid();
+    uint32_t attached_pid = __atomic_load_n(&header->source_pid, __ATOMIC_ACQUIRE);
+    bool claimed = false;
+    while(!claimed && (attached_pid == 0 || !process_alive(attached_pid)))
+    {
+        claimed = __atomic_compare_exchange_n(
+            &header->source_pid, &attached_pid, own_pid,
+            false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE
+        );
+    }
+
+    if(!claimed)
+    {
+        munmap(channel->mapping, channel->mapping_len);
+        memset(channel, 0, sizeof(ShmChannel));
+        return false;
+    }
+
+    // Skip whatever the sink sent to a previous source
+    uint32_t write_pos = __atomic_load_n(&channel->rx->write_pos, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&channel->rx->read_pos, write_pos, __ATOMIC_RELEASE);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void shm_channel_close(ShmChannel* channel)
+{
+#ifdef SHM_CHANNEL_SUPPORTED
+    if(channel->mapping)
+    {
+        struct ShmChannelHeader* header = (struct ShmChannelHeader*) channel->mapping;
+
+        if(channel->is_sink)
+        {
+            shm_unlink(channel->name);
+        }
+        else if(channel->rx != NULL)
+        {
+            __atomic_store_n(&header->source_pid, 0, __ATOMIC_RELEASE);
+        }
+
+        munmap(channel->mapping, channel->mapping_len);
+    }
+#endif
+
+    memset(channel, 0, sizeof(ShmChannel));
+}
+
+bool shm_channel_send(ShmChannel* channel, const void* data, size_t data_len)
+{
+#ifdef SHM_CHANNEL_SUPPORTED
+    ShmChannelRing* ring = channel->tx;
+    const uint32_t capacity = (uint32_t) channel->capacity;
+    const uint32_t space = datagram_space(data_len);
+
+    if(ring == NULL || space > capacity)
+    {
+        return false;
+    }
+
+    uint32_t write_pos = ring->write_pos;
+    uint32_t read_pos = __atomic_load_n(&ring->read_pos, __ATOMIC_ACQUIRE);
+    uint32_t offset = write_pos & (capacity - 1);
+
+    // Skip the rest of the ring if the datagram does not fit before the end
+    uint32_t skip = (capacity - offset < space) ? (capacity - offset) : 0;
+
+    if(capacity - (write_pos - read_pos) < skip + space)
+    {
+        return false;
+    }
+
+    if(skip > 0)
+    {
+        uint32_t wrap = SHM_CHANNEL_WRAP;
+        memcpy(ring->data + offset, &wrap, sizeof(uint32_t));
+        offset = 0;
+    }
+
+    uint32_t len = (uint32_t) data_len;
+    memcpy(ring->data + offset, &len, sizeof(uint32_t));
+    memcpy(ring->data + offset + sizeof(uint32_t), data, data_len);
+
+    __atomic_store_n(&ring->write_pos, write_pos + skip + space, __ATOMIC_RELEASE);
+
+    __atomic_add_fetch(&ring->wakeups, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&ring->waiting, __ATOMIC_SEQ_CST) > 0)
+    {
+        syscall(SYS_futex, &ring->wakeups, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool shm_channel_peek(ShmChannel* channel, void** data, size_t* data_len)
+{
+#ifdef SHM_CHANNEL_SUPPORTED
+    ShmChannelRing* ring = channel->rx;
+    const uint32_t capacity = (uint32_t) channel->capacity;
+
+    if(ring == NULL)
+    {
+        return false;
+    }
+
+    uint32_t read_pos = ring->read_pos;
+    uint32_t write_pos = __atomic_load_n(&ring->write_pos, __ATOMIC_ACQUIRE);
+
+    while(read_pos != write_pos)
+    {
+        uint32_t offset = read_pos & (capacity - 1);
+        uint32_t len;
+        memcpy(&len, ring->data + offset, sizeof(uint32_t));
+
+        if(len == SHM_CHANNEL_WRAP)
+        {
+            read_pos += capacity - offset;
+            __atomic_store_n(&ring->read_pos, read_pos, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        uint32_t space = datagram_space(len);
+        if(space > capacity - offset || space > write_pos - read_pos)
+        {
+            // The other end wrote garbage, drop everything
+            __atomic_store_n(&ring->read_pos, write_pos, __ATOMIC_RELEASE);
+            return false;
+        }
+
+        *data = ring->data + offset + sizeof(uint32_t);
+        *data_len = len;
+        channel->peeked_len = space;
+        return true;
+    }
+
+    return false;
+#else
+    return false;
+#endif
+}
+
+void shm_channel_release(ShmChannel* channel)
+{
+#ifdef SHM_CHANNEL_SUPPORTED
+    if(channel->peeked_len > 0)
+    {
+        ShmChannelRing* ring = channel->rx;
+        __atomic_store_n(&ring->read_pos, ring->read_pos + channel->peeked_len, __ATOMIC_RELEASE);
+        channel->peeked_len = 0;
+    }
+#endif
+}
+
+bool shm_channel_wait(ShmChannel* channel, unsigned int timeout_ms)
+{
+#ifdef SHM_CHANNEL_SUPPORTED
+    ShmChannelRing* ring = channel->rx;
+    if(ring == NULL)
+    {
+        return false;
+    }
+
+    uint32_t wakeups = __atomic_load_n(&ring->wakeups, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&ring->waiting, 1, __ATOMIC_SEQ_CST);
+
+    // Check after announcing the wait, so a send in between is not missed
+    if(__atomic_load_n(&ring->write_pos, __ATOMIC_ACQUIRE) == ring->read_pos)
+    {
+        struct timespec timeout;
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (long) (timeout_ms % 1000) * 1000000L;
+
+        // Returns immediately if wakeups changed since it was loaded
+        syscall(SYS_futex, &ring->wakeups, FUTEX_WAIT, wakeups, &timeout, NULL, 0);
+    }
+
+    __atomic_sub_fetch(&ring->waiting, 1, __ATOMIC_SEQ_CST);
+
+    return __atomic_load_n(&ring->write_pos, __ATOMIC_ACQUIRE) != ring->read_pos;
+#else
+    return false;
+#endif
+}
+
+#ifdef SHM_CHANNEL_SUPPORTED
+static bool channel_map(ShmChannel* channel, int fd, size_t mapping_len)
+{
+    void* mapping = mmap(NULL, mapping_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    channel->mapping = mapping;
+    channel->mapping_len = mapping_len;
+    return true;
+}
+
+static void channel_segment_name(char* segment_name, size_t segment_name_capacity, const char* name)
+{
+    snprintf(segment_name, segment_name_capacity, "/atolla.%s", name);
+}
+
+static bool segment_sink_alive(const char* segment_name)
+{
+    int fd = shm_open(segment_name, O_RDONLY, 0);
+    if(fd == -1)
+    {
+        return false;
+    }
+
+    void* mapping = mmap(NULL, SHM_CHANNEL_HEADER_LEN, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(mapping == MAP_FAILED)
+    {
+        // Too short to hold a header, probably the creating sink crashed right away
+        return false;
+    }
+
+    const struct ShmChannelHeader* header = (const struct ShmChannelHeader*) mapping;
+    bool alive = header->sink_pid != 0 && process_alive(header->sink_pid);
+    munmap(mapping, SHM_CHANNEL_HEADER_LEN);
+
+    return alive;
+}
+
+static bool process_alive(uint32_t pid)
+{
+    return kill((pid_t) pid, 0) == 0 || errno != ESRCH;
+}
+
+static size_t ring_len(size_t capacity)
+{
+    return sizeof(ShmChannelRing) + capacity;
+}
+
+static size_t segment_len(size_t capacity)
+{
+    return SHM_CHANNEL_HEADER_LEN + 2 * ring_len(capacity);
+}
+
+static uint32_t datagram_space(size_t data_len)
+{
+    // Length in front, padded so the next length is aligned
+    return (uint32_t) ((sizeof(uint32_t) + data_len + 3) & ~((size_t) 3));
+}
+#endif
@@ -0,0 +1,136 @@
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+
+/**
+ * Shared-memory channels carry atolla packets between a sink and a source on
+ * the same host without going through the network stack.
+ *
+ * The sink creates a named segment that holds two single-producer,
+ * single-consumer rings of datagrams, one towards the sink and one towards
+ * the source. A source attaches to the segment by name. Datagrams hold the
+ * same messages as UDP packets, and the receiving side iterates them right
+ * inside the ring, without copying them out first.
+ *
+ * The segment starts with a header of SHM_CHANNEL_HEADER_LEN bytes, followed
+ * by the ring towards the sink and then the ring towards the source:
+ *
+ * | Byte ranges, 0-based | Data type | Purpose                                  |
+ * |----------------------|-----------|------------------------------------------|
+ * | 0 – 3                | char[4]   | Magic bytes "ATSM"                       |
+ * | 4 – 7                | uint32    | Layout version, currently 1              |
+ * | 8 – 11               | uint32    | Capacity of each ring in bytes           |
+ * | 12 – 15              | uint32    | Process ID of the sink                   |
+ * | 16 – 19              | uint32    | Process ID of the attached source or 0   |
+ *
+ * Both ends run on the same host, so integers use the native byte order.
+ *
+ * Each ring has a cache line each for the write position, the read position
+ * and the wakeup counter, followed by the data. Datagrams are stored with a
+ * 32-bit length in front and padded to four bytes. A datagram never wraps
+ * around the end of the ring, the producer writes a length of
+ * SHM_CHANNEL_WRAP instead and continues at the start.
+ *
+ * Waiting for datagrams uses a futex on the wakeup counter, producers only
+ * make the system call to wake the other side if it is actually waiting.
+ *
+ * Channels are available on Linux, elsewhere creating and attaching fail.
+ */
+
+#define SHM_CHANNEL_MAGIC "ATSM"
+#define SHM_CHANNEL_MAGIC_LEN 4
+#define SHM_CHANNEL_VERSION 1
+#define SHM_CHANNEL_HEADER_LEN 64
+#define SHM_CHANNEL_WRAP 0xFFFFFFFFu
+
+#ifndef SHM_CHANNEL_CAPACITY
+/**
+ * Capacity of each of the two rings in bytes, must be a power of two.
+ */
+#define SHM_CHANNEL_CAPACITY 65536
+#endif
+
+struct ShmChannelRing;
+
+/**
+ * One end of a shared-memory channel, either the sink that created it or the
+ * source that attached to it.
+ */
+struct ShmChannel
+{
+    bool is_sink;
+    char name[64];
+
+    void* mapping;
+    size_t mapping_len;
+
+    // Ring that this end reads from and ring that it writes to
+    struct ShmChannelRing* rx;
+    struct ShmChannelRing* tx;
+    size_t capacity;
+
+    // Space taken up in rx by the datagram returned by the last shm_channel_peek
+    uint32_t peeked_len;
+};
+typedef struct ShmChannel ShmChannel;
+
+/**
+ * Creates the segment with the given name and initializes the rings, for use
+ * by a sink. The name is a short identifier without slashes, e.g. "leds".
+ *
+ * If a segment of the same name exists but its sink process has exited, it is
+ * replaced. Returns false if another running sink uses the name or if the
+ * segment could not be created.
+ */
+bool shm_channel_create(ShmChannel* channel, const char* name);
+
+/**
+ * Attaches to the segment with the given name that a sink has created.
+ *
+ * Only one source can be attached at a time. Returns false if there is no
+ * segment with that name or if another running source is already attached.
+ */
+bool shm_channel_attach(ShmChannel* channel, const char* name);
+
+/**
+ * Detaches from the segment. If this end is the sink, the segment is removed,
+ * already attached sources keep their mapping until they close it.
+ */
+void shm_channel_close(ShmChannel* channel);
+
+/**
+ * Copies a datagram into the ring towards the other end and wakes it up if it
+ * is waiting. Returns false without sending anything if the ring is full.
+ */
+bool shm_channel_send(ShmChannel* channel, const void* data, size_t data_len);
+
+/**
+ * Gets the oldest datagram that was not released yet, without copying it.
+ *
+ * The returned memory stays valid until shm_channel_release is called.
+ * Returns false if no datagram is available.
+ */
+bool shm_channel_peek(ShmChannel* channel, void** data, size_t* data_len);
+
+/**
+ * Gives the space of the datagram returned by the last successful call to
+ * shm_channel_peek back to the producer.
+ */
+void shm_channel_release(ShmChannel* channel);
+
+/**
+ * Blocks until a datagram is available or the given amount of milliseconds
+ * has passed. Returns true if a datagram is available.
+ */
+bool shm_channel_wait(ShmChannel* channel, unsigned int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHM_CHANNEL_H
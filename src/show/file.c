@@ -0,0 +1,189 @@
+#include "file.h"
+#include "../test/assert.h"
+
+#include <string.h>
+
+#if !defined(ARDUINO_ARCH_ESP8266) && !defined(_WIN32) && !defined(WIN32)
+    #define SHOW_FILE_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+static uint32_t read_uint32(const uint8_t* bytes);
+static uint16_t read_uint16(const uint8_t* bytes);
+static void write_uint32(uint8_t* bytes, uint32_t value);
+static void write_uint16(uint8_t* bytes, uint16_t value);
+
+bool show_file_open(ShowFile* show, const char* path)
+{
+    memset(show, 0, sizeof(ShowFile));
+
+#ifdef SHOW_FILE_MMAP
+    int fd = open(path, O_RDONLY);
+    if(fd == -1)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || file_stat.st_size < SHOW_FILE_HEADER_LEN)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t mapping_len = (size_t) file_stat.st_size;
+    void* mapping = mmap(NULL, mapping_len, PROT_READ, MAP_SHARED, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if(mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const uint8_t* header = (const uint8_t*) mapping;
+    size_t header_len = read_uint16(header + 6);
+    size_t frame_count = read_uint32(header + 16);
+    size_t frame_stride = read_uint32(header + 20);
+
+    bool valid = memcmp(header, SHOW_FILE_MAGIC, SHOW_FILE_MAGIC_LEN) == 0 &&
+                 read_uint16(header + 4) == SHOW_FILE_VERSION &&
+                 header_len >= SHOW_FILE_HEADER_LEN &&
+                 frame_stride > 0 &&
+                 header_len <= mapping_len &&
+                 frame_count <= (mapping_len - header_len) / frame_stride;
+
+    if(!valid)
+    {
+        munmap(mapping, mapping_len);
+        return false;
+    }
+
+    // Shows are played front to back, let the kernel read ahead aggressively
+    madvise(mapping, mapping_len, MADV_SEQUENTIAL);
+
+    show->lights_count = read_uint32(header + 8);
+    show->frame_duration_ms = read_uint32(header + 12);
+    show->frame_count = frame_count;
+    show->frame_stride = frame_stride;
+    show->frames = header + header_len;
+    show->mapping = mapping;
+    show->mapping_len = mapping_len;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+const void* show_file_frame(ShowFile* show, size_t frame_idx)
+{
+    assert(frame_idx < show->frame_count);
+    return show->frames + frame_idx * show->frame_stride;
+}
+
+void show_file_advise(ShowFile* show, size_t will_need_idx, size_t will_need_count, size_t release_before_idx)
+{
+#ifdef SHOW_FILE_MMAP
+    const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    const uint8_t* mapping_start = (const uint8_t*) show->mapping;
+
+    if(will_need_idx < show->frame_count)
+    {
+        if(will_need_count > show->frame_count - will_need_idx)
+        {
+            will_need_count = show->frame_count - will_need_idx;
+        }
+
+        // madvise wants page-aligned addresses, round the start down
+        size_t start = (show->frames - mapping_start) + will_need_idx * show->frame_stride;
+        size_t end = start + will_need_count * show->frame_stride;
+        start -= start % page_size;
+
+        madvise((void*) (mapping_start + start), end - start, MADV_WILLNEED);
+    }
+
+    if(release_before_idx > 0)
+    {
+        if(release_before_idx > show->frame_count)
+        {
+            release_before_idx = show->frame_count;
+        }
+
+        // Round the end down, so the page holding the next frame stays mapped
+        size_t end = (show->frames - mapping_start) + release_before_idx * show->frame_stride;
+        end -= end % page_size;
+
+        if(end > 0)
+        {
+            // Pages of a read-only file mapping are just dropped and read again from disk if needed
+            madvise(show->mapping, end, MADV_DONTNEED);
+        }
+    }
+#endif
+}
+
+void show_file_close(ShowFile* show)
+{
+#ifdef SHOW_FILE_MMAP
+    if(show->mapping)
+    {
+        munmap(show->mapping, show->mapping_len);
+    }
+#endif
+
+    memset(show, 0, sizeof(ShowFile));
+}
+
+bool show_file_write_header(
+    FILE* file,
+    unsigned int lights_count,
+    unsigned int frame_duration_ms,
+    size_t frame_count,
+    size_t frame_stride
+)
+{
+    uint8_t header[SHOW_FILE_HEADER_LEN];
+    memset(header, 0, sizeof(header));
+
+    memcpy(header, SHOW_FILE_MAGIC, SHOW_FILE_MAGIC_LEN);
+    write_uint16(header + 4, SHOW_FILE_VERSION);
+    write_uint16(header + 6, SHOW_FILE_HEADER_LEN);
+    write_uint32(header + 8, lights_count);
+    write_uint32(header + 12, frame_duration_ms);
+    write_uint32(header + 16, (uint32_t) frame_count);
+    write_uint32(header + 20, (uint32_t) frame_stride);
+
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+static uint32_t read_uint32(const uint8_t* bytes)
+{
+    return ((uint32_t) bytes[0]) |
+           (((uint32_t) bytes[1]) << 8) |
+           (((uint32_t) bytes[2]) << 16) |
+           (((uint32_t) bytes[3]) << 24);
+}
+
+static uint16_t read_uint16(const uint8_t* bytes)
+{
+    return (uint16_t) (bytes[0] | (bytes[1] << 8));
+}
+
+static void write_uint32(uint8_t* bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t) value;
+    bytes[1] = (uint8_t) (value >> 8);
+    bytes[2] = (uint8_t) (value >> 16);
+    bytes[3] = (uint8_t) (value >> 24);
+}
+
+static void write_uint16(uint8_t* bytes, uint16_t value)
+{
+    bytes[0] = (uint8_t) value;
+    bytes[1] = (uint8_t) (value >> 8);
+}
@@ -0,0 +1,112 @@
+#ifndef SHOW_FILE_H
+#define SHOW_FILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+
+#include <stdio.h>
+
+/**
+ * Show files hold pre-rendered sequences of frames.
+ *
+ * A show file starts with a header of SHOW_FILE_HEADER_LEN bytes:
+ *
+ * | Byte ranges, 0-based | Data type | Purpose                                  |
+ * |----------------------|-----------|------------------------------------------|
+ * | 0 – 3                | char[4]   | Magic bytes "ATSH"                       |
+ * | 4 – 5                | uint16    | Format version, currently 1              |
+ * | 6 – 7                | uint16    | Header length, offset of the first frame |
+ * | 8 – 11               | uint32    | Lights count                             |
+ * | 12 – 15              | uint32    | Frame duration in milliseconds           |
+ * | 16 – 19              | uint32    | Frame count                              |
+ * | 20 – 23              | uint32    | Frame stride in bytes                    |
+ * | 24 – 31              |           | Reserved, zero                           |
+ *
+ * Frames follow the header back to back, each frame_stride bytes long and in
+ * the same layout that is passed to atolla_source_put. Integers are stored
+ * little-endian, like in the protocol.
+ *
+ * Readers use the header length from the file to find the first frame, so
+ * later versions can extend the header.
+ */
+
+#define SHOW_FILE_MAGIC "ATSH"
+#define SHOW_FILE_MAGIC_LEN 4
+#define SHOW_FILE_VERSION 1
+#define SHOW_FILE_HEADER_LEN 32
+
+/**
+ * A show file that is mapped into memory for reading.
+ *
+ * Frames are read straight from the mapping, so opening even a
+ * multi-gigabyte show takes no time and little memory. Use
+ * show_file_advise to keep the resident part of the mapping small while
+ * playing the show.
+ */
+struct ShowFile
+{
+    unsigned int lights_count;
+    unsigned int frame_duration_ms;
+    size_t frame_count;
+    size_t frame_stride;
+
+    const uint8_t* frames;
+
+    void* mapping;
+    size_t mapping_len;
+};
+typedef struct ShowFile ShowFile;
+
+/**
+ * Maps the show file at the given path into memory and reads its header.
+ *
+ * Returns false if the file cannot be opened or mapped, if it is not a show
+ * file, or if it is shorter than the header claims. Memory mapping is
+ * currently only supported on POSIX systems, elsewhere the function always
+ * returns false.
+ */
+bool show_file_open(ShowFile* show, const char* path);
+
+/**
+ * Gets the address of the frame with the given index inside the mapping.
+ * The frame is frame_stride bytes long and remains valid until the show is
+ * closed.
+ */
+const void* show_file_frame(ShowFile* show, size_t frame_idx);
+
+/**
+ * Hints the operating system about upcoming reads. The given range of frames
+ * will be read soon and should be read ahead, while all frames before
+ * release_before_idx will not be read again and may be dropped from memory.
+ */
+void show_file_advise(ShowFile* show, size_t will_need_idx, size_t will_need_count, size_t release_before_idx);
+
+/**
+ * Unmaps the show file. The ShowFile structure itself is managed by the
+ * calling code.
+ */
+void show_file_close(ShowFile* show);
+
+/**
+ * Writes a show file header to the given file, which should be positioned at
+ * its start. The caller then writes frame_count frames of frame_stride bytes
+ * each.
+ *
+ * Returns false if writing failed.
+ */
+bool show_file_write_header(
+    FILE* file,
+    unsigned int lights_count,
+    unsigned int frame_duration_ms,
+    size_t frame_count,
+    size_t frame_stride
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHOW_FILE_H
@@ -0,0 +1,370 @@
+#include "stream_socket.h"
+
+#include <string.h>
+
+#if !defined(ARDUINO_ARCH_ESP8266) && !defined(_WIN32) && !defined(WIN32)
+    #define STREAM_SOCKET_SUPPORTED
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <stdio.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+#ifdef STREAM_SOCKET_SUPPORTED
+#ifndef MSG_NOSIGNAL
+    // Mac OS X has no MSG_NOSIGNAL, SO_NOSIGPIPE is set on the socket instead
+    #define MSG_NOSIGNAL 0
+#endif
+
+/** Connections that may wait for accept before the kernel refuses more */
+static const int listen_backlog = 4;
+
+static bool stream_socket_configure(int handle, bool no_delay);
+static bool make_unix_address(struct sockaddr_un* address, const char* path);
+#endif
+
+bool stream_socket_listen_tcp(StreamSocket* listener, unsigned short port)
+{
+    memset(listener, 0, sizeof(StreamSocket));
+    listener->handle = -1;
+
+#ifdef STREAM_SOCKET_SUPPORTED
+    int handle = socket(PF_INET6, SOCK_STREAM, IPPROTO_TCP);
+    if(handle == -1)
+    {
+        return false;
+    }
+
+    // Accept IPv4 too, and allow listening again right after a restart
+    int off = 0;
+    int on = 1;
+    setsockopt(handle, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in6 address;
+    memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    address.sin6_port = htons(port);
+    address.sin6_addr = in6addr_any;
+
+    if(bind(handle, (struct sockaddr*) &address, sizeof(address)) != 0 ||
+       listen(handle, listen_backlog) != 0 ||
+       !stream_socket_configure(handle, false))
+    {
+        close(handle);
+        return false;
+    }
+
+    listener->handle = handle;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool stream_socket_listen_unix(StreamSocket* listener, const char* path)
+{
+    memset(listener, 0, sizeof(StreamSocket));
+    listener->handle = -1;
+
+#ifdef STREAM_SOCKET_SUPPORTED
+    struct sockaddr_un address;
+    if(!make_unix_address(&address, path))
+    {
+        return false;
+    }
+
+    int handle = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(handle == -1)
+    {
+        return false;
+    }
+
+    int bind_result = bind(handle, (struct sockaddr*) &address, sizeof(address));
+    if(bind_result != 0 && errno == EADDRINUSE)
+    {
+        // Replace the socket file if nobody is listening on it anymore
+        StreamSocket probe;
+        if(stream_socket_connect_unix(&probe, path))
+        {
+            stream_socket_close(&probe);
+        }
+        else
+        {
+            unlink(path);
+            bind_result = bind(handle, (struct sockaddr*) &address, sizeof(address));
+        }
+    }
+
+    if(bind_result != 0 ||
+       listen(handle, listen_backlog) != 0 ||
+       !stream_socket_configure(handle, false))
+    {
+        close(handle);
+        return false;
+    }
+
+    listener->handle = handle;
+    strncpy(listener->unix_path, path, sizeof(listener->unix_path) - 1);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool stream_socket_accept(StreamSocket* listener, StreamSocket* connection)
+{
+    memset(connection, 0, sizeof(StreamSocket));
+    connection->handle = -1;
+
+#ifdef STREAM_SOCKET_SUPPORTED
+    struct sockaddr_storage address;
+    socklen_t address_len = sizeof(address);
+    int handle = accept(listener->handle, (struct sockaddr*) &address, &address_len);
+    if(handle == -1)
+    {
+        return false;
+    }
+
+    if(!stream_socket_configure(handle, address.ss_family != AF_UNIX))
+    {
+        close(handle);
+        return false;
+    }
+
+    connection->handle = handle;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool stream_socket_connect_tcp(StreamSocket* connection, const char* hostname, unsigned short port)
+{
+    memset(connection, 0, sizeof(StreamSocket));
+    connection->handle = -1;
+
+#ifdef STREAM_SOCKET_SUPPORTED
+    char port_str[6];
+    snprintf(port_str, sizeof(port_str), "%hu", port);
+
+    struct addrinfo criteria;
+    memset(&criteria, 0, sizeof(criteria));
+    criteria.ai_family = AF_UNSPEC;
+    criteria.ai_socktype = SOCK_STREAM;
+    criteria.ai_protocol = IPPROTO_TCP;
+    criteria.ai_flags = AI_ADDRCONFIG;
+
+    struct addrinfo* first_result = NULL;
+    if(getaddrinfo(hostname, port_str, &criteria, &first_result) != 0)
+    {
+        return false;
+    }
+
+    // Try all addresses in turn, e.g. both ::1 and 127.0.0.1 for localhost
+    int handle = -1;
+    for(struct addrinfo* result = first_result; result != NULL && handle == -1; result = result->ai_next)
+    {
+        handle = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+        if(handle != -1 && connect(handle, result->ai_addr, result->ai_addrlen) != 0)
+        {
+            close(handle);
+            handle = -1;
+        }
+    }
+
+    freeaddrinfo(first_result);
+
+    if(handle == -1)
+    {
+        return false;
+    }
+
+    if(!stream_socket_configure(handle, true))
+    {
+        close(handle);
+        return false;
+    }
+
+    connection->handle = handle;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool stream_socket_connect_unix(StreamSocket* connection, const char* path)
+{
+    memset(connection, 0, sizeof(StreamSocket));
+    connection->handle = -1;
+
+#ifdef STREAM_SOCKET_SUPPORTED
+    struct sockaddr_un address;
+    if(!make_unix_address(&address, path))
+    {
+        return false;
+    }
+
+    int handle = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(handle == -1)
+    {
+        return false;
+    }
+
+    if(connect(handle, (struct sockaddr*) &address, sizeof(address)) != 0 ||
+       !stream_socket_configure(handle, false))
+    {
+        close(handle);
+        return false;
+    }
+
+    connection->handle = handle;
+    return true;
+#else
+    return false;
+#endif
+}
+
+StreamSocketStatus stream_socket_send(StreamSocket* connection, const void* data, size_t data_len, unsigned int timeout_ms)
+{
+#ifdef STREAM_SOCKET_SUPPORTED
+    const uint8_t* remaining = (const uint8_t*) data;
+    size_t remaining_len = data_len;
+
+    while(remaining_len > 0)
+    {
+        // MSG_NOSIGNAL, so a closed connection is reported as an error instead of killing the process
+        ssize_t sent = send(connection->handle, remaining, remaining_len, MSG_NOSIGNAL);
+
+        if(sent > 0)
+        {
+            remaining += sent;
+            remaining_len -= (size_t) sent;
+        }
+        else if(sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            struct pollfd writable;
+            writable.fd = connection->handle;
+            writable.events = POLLOUT;
+            writable.revents = 0;
+
+            if(poll(&writable, 1, (int) timeout_ms) <= 0)
+            {
+                return STREAM_SOCKET_WOULD_BLOCK;
+            }
+        }
+        else if(sent == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            return STREAM_SOCKET_ERROR;
+        }
+    }
+
+    return STREAM_SOCKET_OK;
+#else
+    return STREAM_SOCKET_ERROR;
+#endif
+}
+
+StreamSocketStatus stream_socket_receive(StreamSocket* connection, void* buf, size_t buf_capacity, size_t* received_len)
+{
+    *received_len = 0;
+
+#ifdef STREAM_SOCKET_SUPPORTED
+    if(buf_capacity == 0)
+    {
+        return STREAM_SOCKET_WOULD_BLOCK;
+    }
+
+    ssize_t received = recv(connection->handle, buf, buf_capacity, 0);
+
+    if(received > 0)
+    {
+        *received_len = (size_t) received;
+        return STREAM_SOCKET_OK;
+    }
+    else if(received == 0)
+    {
+        return STREAM_SOCKET_CLOSED;
+    }
+    else if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+    {
+        return STREAM_SOCKET_WOULD_BLOCK;
+    }
+    else
+    {
+        return STREAM_SOCKET_ERROR;
+    }
+#else
+    return STREAM_SOCKET_ERROR;
+#endif
+}
+
+void stream_socket_close(StreamSocket* socket)
+{
+#ifdef STREAM_SOCKET_SUPPORTED
+    if(socket->handle != -1)
+    {
+        close(socket->handle);
+
+        if(socket->unix_path[0] != '\0')
+        {
+            unlink(socket->unix_path);
+        }
+    }
+#endif
+
+    memset(socket, 0, sizeof(StreamSocket));
+    socket->handle = -1;
+}
+
+#ifdef STREAM_SOCKET_SUPPORTED
+static bool stream_socket_configure(int handle, bool no_delay)
+{
+    int flags = fcntl(handle, F_GETFL, 0);
+    if(flags == -1 || fcntl(handle, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        return false;
+    }
+
+#ifdef SO_NOSIGPIPE
+    int no_sigpipe = 1;
+    setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+    if(no_delay)
+    {
+        // Frames are sent as soon as they are put, do not wait to coalesce them
+        int on = 1;
+        if(setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool make_unix_address(struct sockaddr_un* address, const char* path)
+{
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+
+    if(strlen(path) >= sizeof(address->sun_path))
+    {
+        return false;
+    }
+
+    strcpy(address->sun_path, path);
+    return true;
+}
+#endif
@@ -0,0 +1,94 @@
+#ifndef STREAM_SOCKET_H
+#define STREAM_SOCKET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../atolla/primitives.h"
+
+/**
+ * Connection-oriented sockets over TCP or Unix domain stream sockets, for
+ * running the atolla protocol over reliable, ordered transports.
+ *
+ * All sockets are non-blocking. Connected TCP sockets have Nagle's algorithm
+ * disabled, so small messages like LENT are not held back waiting for more
+ * data.
+ *
+ * Stream sockets are available on POSIX systems, elsewhere listening and
+ * connecting fail.
+ */
+
+enum StreamSocketStatus
+{
+    STREAM_SOCKET_OK,
+    /** Nothing to receive right now, or the data could not be sent in time */
+    STREAM_SOCKET_WOULD_BLOCK,
+    /** The other end closed the connection in an orderly fashion */
+    STREAM_SOCKET_CLOSED,
+    /** The connection broke, e.g. because it was reset */
+    STREAM_SOCKET_ERROR
+};
+typedef enum StreamSocketStatus StreamSocketStatus;
+
+struct StreamSocket
+{
+    int handle;
+    /** For listening Unix sockets, the path to remove on close, otherwise empty */
+    char unix_path[108];
+};
+typedef struct StreamSocket StreamSocket;
+
+/**
+ * Listens for TCP connections on the given port, on IPv6 and IPv4.
+ */
+bool stream_socket_listen_tcp(StreamSocket* listener, unsigned short port);
+
+/**
+ * Listens for connections on a Unix domain socket at the given path. If a
+ * socket file from a process that has exited is in the way, it is replaced.
+ */
+bool stream_socket_listen_unix(StreamSocket* listener, const char* path);
+
+/**
+ * Accepts the next pending connection, if any. Returns false if no
+ * connection is waiting.
+ */
+bool stream_socket_accept(StreamSocket* listener, StreamSocket* connection);
+
+/**
+ * Connects to the given host and port over TCP. Resolving the hostname and
+ * establishing the connection block.
+ */
+bool stream_socket_connect_tcp(StreamSocket* connection, const char* hostname, unsigned short port);
+
+/**
+ * Connects to the Unix domain socket at the given path.
+ */
+bool stream_socket_connect_unix(StreamSocket* connection, const char* path);
+
+/**
+ * Sends all of the given bytes, waiting up to timeout_ms milliseconds for
+ * space in the send buffer if necessary.
+ *
+ * If only a part could be sent in time, the stream is cut in the middle of a
+ * message and STREAM_SOCKET_WOULD_BLOCK is returned. The connection should be
+ * closed in that case.
+ */
+StreamSocketStatus stream_socket_send(StreamSocket* connection, const void* data, size_t data_len, unsigned int timeout_ms);
+
+/**
+ * Receives whatever is available, up to the given capacity, without waiting.
+ */
+StreamSocketStatus stream_socket_receive(StreamSocket* connection, void* buf, size_t buf_capacity, size_t* received_len);
+
+/**
+ * Closes the socket. Listening Unix sockets also remove their socket file.
+ */
+void stream_socket_close(StreamSocket* socket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STREAM_SOCKET_H
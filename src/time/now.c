@@ -2,6 +2,11 @@
 
 #ifdef ARDUINO_ARCH_ESP8266
     #include <Arduino.h>
+
+    // micros() is 32 bits and wraps every 71 minutes, so wraps are counted
+    // to extend it to 64 bits
+    static unsigned long last_micros = 0;
+    static unsigned long long micros_wraps = 0;
 #else
     #include "gettime.h"
 #endif
@@ -17,4 +22,24 @@ unsigned int time_now()
     return ts.tv_sec * 1000 +
            ts.tv_nsec / 1000000;
 #endif
-}
\ No newline at end of file
+}
+
+unsigned long long time_now_us()
+{
+#ifdef ARDUINO_ARCH_ESP8266
+    unsigned long now = micros();
+    if(now < last_micros)
+    {
+        ++micros_wraps;
+    }
+    last_micros = now;
+
+    return (micros_wraps << 32) | now;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((unsigned long long) ts.tv_sec) * 1000000ULL +
+           ts.tv_nsec / 1000;
+#endif
+}
@@ -12,6 +12,17 @@ extern "C" {
  */
 unsigned int time_now();
 
+/**
+ * Gets the current time in microseconds relative to a fixed but arbitrary
+ * origin time. Unlike time_now, the clock is monotonic, so it is suitable for
+ * measuring short intervals, but it has no relation to wall clock time.
+ *
+ * On ESP8266, the 32 bit microsecond counter of the chip is extended to 64
+ * bits by counting its wraps, which only works if this is called at least once
+ * every 71 minutes.
+ */
+unsigned long long time_now_us();
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,83 @@
+#include "sleep_until.h"
+#include "now.h"
+
+#if defined(ARDUINO_ARCH_ESP8266)
+    #include <Arduino.h>
+#elif defined(_WIN32) || defined(WIN32)
+    #include <windows.h>
+#else
+    #include "gettime.h"
+    #include <errno.h>
+#endif
+
+#if defined(__linux__)
+    // CLOCK_MONOTONIC is the clock of time_now_us, so deadlines can be handed to the kernel as they are
+    #define TIME_SLEEP_UNTIL_ABSTIME
+#endif
+
+static void sleep_until_coarse(unsigned long long wake_us);
+
+unsigned long long time_sleep_until_us(unsigned long long deadline_us, unsigned int spin_us)
+{
+    unsigned long long now_us = time_now_us();
+    if(now_us >= deadline_us)
+    {
+        return 0;
+    }
+
+    if(deadline_us - now_us > spin_us)
+    {
+        sleep_until_coarse(deadline_us - spin_us);
+    }
+
+    do
+    {
+        now_us = time_now_us();
+    } while(now_us < deadline_us);
+
+    return now_us - deadline_us;
+}
+
+/**
+ * Sleeps until the wake time is reached or passed, without spinning.
+ */
+static void sleep_until_coarse(unsigned long long wake_us)
+{
+#if defined(TIME_SLEEP_UNTIL_ABSTIME)
+    struct timespec wake;
+    wake.tv_sec = (time_t) (wake_us / 1000000ULL);
+    wake.tv_nsec = (long) ((wake_us % 1000000ULL) * 1000ULL);
+
+    // Interrupted sleeps are resumed with the same absolute time, nothing to recompute
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR) {}
+#else
+    unsigned long long now_us = time_now_us();
+    while(now_us < wake_us)
+    {
+        unsigned long long remaining_us = wake_us - now_us;
+    #if defined(ARDUINO_ARCH_ESP8266)
+        if(remaining_us >= 1000)
+        {
+            delay((unsigned long) (remaining_us / 1000));
+        }
+        else
+        {
+            delayMicroseconds((unsigned int) remaining_us);
+        }
+    #elif defined(_WIN32) || defined(WIN32)
+        // Sleep has millisecond granularity, wake up early rather than late
+        if(remaining_us < 1000)
+        {
+            break;
+        }
+        Sleep((DWORD) (remaining_us / 1000));
+    #else
+        struct timespec remaining;
+        remaining.tv_sec = (time_t) (remaining_us / 1000000ULL);
+        remaining.tv_nsec = (long) ((remaining_us % 1000000ULL) * 1000ULL);
+        nanosleep(&remaining, NULL);
+    #endif
+        now_us = time_now_us();
+    }
+#endif
+}
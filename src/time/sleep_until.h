@@ -0,0 +1,29 @@
+#ifndef TIME_SLEEP_UNTIL_H
+#define TIME_SLEEP_UNTIL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sleeps until time_now_us reaches the given absolute deadline in
+ * microseconds, then returns how many microseconds after the deadline it
+ * returned, or zero if the deadline had already passed when called.
+ *
+ * Sleeping to an absolute deadline instead of for a duration means that
+ * preemption between computing the duration and going to sleep does not add
+ * up. On Linux, clock_nanosleep with TIMER_ABSTIME is used, elsewhere the
+ * remaining time is slept relative to now.
+ *
+ * The scheduler typically wakes sleepers up some ten to a hundred
+ * microseconds late. If spin_us is not zero, the sleep ends spin_us before the
+ * deadline and the rest of the time is busy-waited, which trades CPU time for
+ * precision.
+ */
+unsigned long long time_sleep_until_us(unsigned long long deadline_us, unsigned int spin_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIME_SLEEP_UNTIL_H
@@ -18,6 +18,7 @@
     // Everywhere else, use bsd sockets
     #include <sys/socket.h>
     #include <netinet/in.h>
+    #include <arpa/inet.h>
     #include <fcntl.h>
     #include <netdb.h>
 
@@ -0,0 +1,336 @@
+#include "udp_resolver.h"
+#include "../time/now.h"
+#include "../test/assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(ARDUINO_ARCH_ESP8266) && !defined(_WIN32) && !defined(WIN32)
+    #define UDP_RESOLVER_THREADED
+    #include <pthread.h>
+    #include <time.h>
+    #include "sockets_headers.h"
+#endif
+
+struct UdpResolverCacheEntry
+{
+    char hostname[UDP_RESOLVER_HOSTNAME_MAX_LEN];
+    UdpEndpoint endpoint;
+    unsigned int resolved_time;
+};
+typedef struct UdpResolverCacheEntry UdpResolverCacheEntry;
+
+static UdpResolverCacheEntry cache[UDP_RESOLVER_CACHE_CAPACITY];
+
+static bool cache_lookup(const char* hostname, UdpEndpoint* endpoint);
+static void cache_insert(const char* hostname, UdpEndpoint* endpoint);
+static bool resolve_now(const char* hostname, UdpEndpoint* endpoint);
+
+#ifdef UDP_RESOLVER_THREADED
+/**
+ * A lookup on a helper thread, referenced by the thread and by all
+ * UdpResolve structures waiting for it.
+ */
+struct UdpResolveJob
+{
+    char hostname[UDP_RESOLVER_HOSTNAME_MAX_LEN];
+    int refs;
+    bool done;
+    bool ok;
+    UdpEndpoint endpoint;
+    struct UdpResolveJob* next;
+};
+typedef struct UdpResolveJob UdpResolveJob;
+
+/** Guards the cache, the list of pending jobs and the jobs themselves */
+static pthread_mutex_t resolver_mutex = PTHREAD_MUTEX_INITIALIZER;
+/** Jobs that are still running, so that lookups of the same hostname can join them */
+static UdpResolveJob* pending_jobs = NULL;
+/** Signalled whenever a job is done */
+static pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+
+static void* resolve_job_run(void* job);
+static void resolve_job_release(UdpResolveJob* job);
+static void resolve_job_wait(UdpResolveJob* job, unsigned int timeout_ms);
+static bool is_numeric_host(const char* hostname);
+
+    #define resolver_lock() pthread_mutex_lock(&resolver_mutex)
+    #define resolver_unlock() pthread_mutex_unlock(&resolver_mutex)
+#else
+    #define resolver_lock()
+    #define resolver_unlock()
+#endif
+
+void udp_resolve_start(UdpResolve* resolve, const char* hostname, unsigned short port)
+{
+    memset(resolve, 0, sizeof(UdpResolve));
+    resolve->status = UDP_RESOLVE_PENDING;
+    resolve->port = port;
+
+    if(hostname == NULL || strlen(hostname) >= UDP_RESOLVER_HOSTNAME_MAX_LEN)
+    {
+        resolve->status = UDP_RESOLVE_FAILED;
+        return;
+    }
+
+    resolver_lock();
+    bool cached = cache_lookup(hostname, &resolve->endpoint);
+    resolver_unlock();
+
+    if(cached)
+    {
+        resolve->status = UDP_RESOLVE_DONE;
+        udp_endpoint_set_port(&resolve->endpoint, port);
+        return;
+    }
+
+#ifdef UDP_RESOLVER_THREADED
+    if(!is_numeric_host(hostname))
+    {
+        resolver_lock();
+
+        UdpResolveJob* job = pending_jobs;
+        while(job != NULL && strcmp(job->hostname, hostname) != 0)
+        {
+            job = job->next;
+        }
+
+        if(job == NULL)
+        {
+            job = (UdpResolveJob*) calloc(1, sizeof(UdpResolveJob));
+            assert(job != NULL);
+            strcpy(job->hostname, hostname);
+            // One reference for the thread, one for the caller below
+            job->refs = 1;
+
+            pthread_t thread;
+            if(pthread_create(&thread, NULL, resolve_job_run, job) == 0)
+            {
+                pthread_detach(thread);
+                job->next = pending_jobs;
+                pending_jobs = job;
+            }
+            else
+            {
+                // Resolve right here instead
+                free(job);
+                job = NULL;
+            }
+        }
+
+        if(job != NULL)
+        {
+            ++job->refs;
+            resolve->job = job;
+            resolve_job_wait(job, UDP_RESOLVER_START_WAIT_MS);
+        }
+
+        resolver_unlock();
+
+        if(job != NULL)
+        {
+            udp_resolve_poll(resolve, &resolve->endpoint);
+            return;
+        }
+    }
+#endif
+
+    bool ok = resolve_now(hostname, &resolve->endpoint);
+    if(ok)
+    {
+        resolver_lock();
+        cache_insert(hostname, &resolve->endpoint);
+        resolver_unlock();
+        udp_endpoint_set_port(&resolve->endpoint, port);
+    }
+    resolve->status = ok ? UDP_RESOLVE_DONE : UDP_RESOLVE_FAILED;
+}
+
+UdpResolveStatus udp_resolve_poll(UdpResolve* resolve, UdpEndpoint* endpoint)
+{
+#ifdef UDP_RESOLVER_THREADED
+    if(resolve->status == UDP_RESOLVE_PENDING && resolve->job != NULL)
+    {
+        UdpResolveJob* job = (UdpResolveJob*) resolve->job;
+
+        resolver_lock();
+        if(job->done)
+        {
+            resolve->status = job->ok ? UDP_RESOLVE_DONE : UDP_RESOLVE_FAILED;
+            resolve->endpoint = job->endpoint;
+            udp_endpoint_set_port(&resolve->endpoint, resolve->port);
+            resolve_job_release(job);
+            resolve->job = NULL;
+        }
+        resolver_unlock();
+    }
+#endif
+
+    if(resolve->status == UDP_RESOLVE_DONE)
+    {
+        *endpoint = resolve->endpoint;
+    }
+
+    return resolve->status;
+}
+
+void udp_resolve_free(UdpResolve* resolve)
+{
+#ifdef UDP_RESOLVER_THREADED
+    if(resolve->job != NULL)
+    {
+        resolver_lock();
+        resolve_job_release((UdpResolveJob*) resolve->job);
+        resolver_unlock();
+    }
+#endif
+
+    memset(resolve, 0, sizeof(UdpResolve));
+    resolve->status = UDP_RESOLVE_FAILED;
+}
+
+void udp_resolver_cache_clear()
+{
+    resolver_lock();
+    memset(cache, 0, sizeof(cache));
+    resolver_unlock();
+}
+
+/**
+ * Looks up a hostname that was resolved not too long ago, the caller holds
+ * the lock.
+ */
+static bool cache_lookup(const char* hostname, UdpEndpoint* endpoint)
+{
+    const unsigned int now = time_now();
+
+    for(size_t i = 0; i < UDP_RESOLVER_CACHE_CAPACITY; ++i)
+    {
+        UdpResolverCacheEntry* entry = &cache[i];
+        if(entry->hostname[0] != '\0' &&
+           strcmp(entry->hostname, hostname) == 0 &&
+           (now - entry->resolved_time) < UDP_RESOLVER_CACHE_TTL_MS)
+        {
+            *endpoint = entry->endpoint;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Remembers a resolved hostname, replacing the entry for the same hostname,
+ * an empty one or the oldest one, the caller holds the lock.
+ */
+static void cache_insert(const char* hostname, UdpEndpoint* endpoint)
+{
+    const unsigned int now = time_now();
+    UdpResolverCacheEntry* target = &cache[0];
+
+    for(size_t i = 0; i < UDP_RESOLVER_CACHE_CAPACITY; ++i)
+    {
+        UdpResolverCacheEntry* entry = &cache[i];
+        if(entry->hostname[0] == '\0' || strcmp(entry->hostname, hostname) == 0)
+        {
+            target = entry;
+            break;
+        }
+        else if((now - entry->resolved_time) > (now - target->resolved_time))
+        {
+            target = entry;
+        }
+    }
+
+    strcpy(target->hostname, hostname);
+    target->endpoint = *endpoint;
+    target->resolved_time = now;
+}
+
+/**
+ * Resolves the hostname, blocking until done, the port is set later.
+ */
+static bool resolve_now(const char* hostname, UdpEndpoint* endpoint)
+{
+    return udp_endpoint_resolve(endpoint, hostname, 0).code == UDP_SOCKET_OK;
+}
+
+#ifdef UDP_RESOLVER_THREADED
+static void* resolve_job_run(void* job_ptr)
+{
+    UdpResolveJob* job = (UdpResolveJob*) job_ptr;
+
+    // The hostname is not changed after the job was started, no lock needed
+    UdpEndpoint endpoint;
+    bool ok = resolve_now(job->hostname, &endpoint);
+
+    resolver_lock();
+
+    job->done = true;
+    job->ok = ok;
+    job->endpoint = endpoint;
+    pthread_cond_broadcast(&job_done);
+
+    if(ok)
+    {
+        cache_insert(job->hostname, &endpoint);
+    }
+
+    // Later lookups of the hostname go to the cache or start over
+    UdpResolveJob** link = &pending_jobs;
+    while(*link != job)
+    {
+        link = &(*link)->next;
+    }
+    *link = job->next;
+
+    resolve_job_release(job);
+
+    resolver_unlock();
+    return NULL;
+}
+
+/**
+ * Drops a reference to the job and frees it when it was the last one, the
+ * caller holds the lock.
+ */
+static void resolve_job_release(UdpResolveJob* job)
+{
+    if(--job->refs == 0)
+    {
+        free(job);
+    }
+}
+
+/**
+ * Waits until the job is done or the timeout expired, the caller holds the
+ * lock.
+ */
+static void resolve_job_wait(UdpResolveJob* job, unsigned int timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    while(!job->done)
+    {
+        if(pthread_cond_timedwait(&job_done, &resolver_mutex, &deadline) != 0)
+        {
+            break;
+        }
+    }
+}
+
+static bool is_numeric_host(const char* hostname)
+{
+    struct in6_addr address;
+    return inet_pton(AF_INET, hostname, &address) == 1 ||
+           inet_pton(AF_INET6, hostname, &address) == 1;
+}
+#endif
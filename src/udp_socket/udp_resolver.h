@@ -0,0 +1,84 @@
+#ifndef UDP_RESOLVER_H
+#define UDP_RESOLVER_H
+
+#include "udp_socket.h"
+
+/**
+ * Resolves hostnames into endpoints without blocking the caller.
+ *
+ * On POSIX systems, lookups that are not answered from the cache run on a
+ * helper thread, so a slow or broken DNS server only delays the endpoints
+ * that need it. Concurrent lookups of the same hostname share a single
+ * helper thread. udp_resolve_start waits up to UDP_RESOLVER_START_WAIT_MS
+ * milliseconds for the helper, so that lookups answered from the hosts file
+ * complete right away. Elsewhere, udp_resolve_start resolves right away and
+ * blocks.
+ *
+ * Successful lookups are remembered by hostname for UDP_RESOLVER_CACHE_TTL_MS
+ * milliseconds, so starting many sockets towards the same host only asks DNS
+ * once. Numeric addresses are never looked up and do not need the cache.
+ */
+
+#ifndef UDP_RESOLVER_CACHE_CAPACITY
+/** Amount of hostnames remembered, the least recently resolved one is replaced first */
+#define UDP_RESOLVER_CACHE_CAPACITY 16
+#endif
+
+#ifndef UDP_RESOLVER_CACHE_TTL_MS
+/** Milliseconds after which hostnames in the cache are looked up again */
+#define UDP_RESOLVER_CACHE_TTL_MS 60000
+#endif
+
+#ifndef UDP_RESOLVER_START_WAIT_MS
+/** Milliseconds that udp_resolve_start waits for a lookup before leaving it to the helper thread */
+#define UDP_RESOLVER_START_WAIT_MS 10
+#endif
+
+/** Longest hostname that can be resolved, including the terminating zero */
+#define UDP_RESOLVER_HOSTNAME_MAX_LEN 256
+
+enum UdpResolveStatus
+{
+    UDP_RESOLVE_PENDING,
+    UDP_RESOLVE_DONE,
+    UDP_RESOLVE_FAILED
+};
+typedef enum UdpResolveStatus UdpResolveStatus;
+
+/**
+ * A lookup that was started with udp_resolve_start.
+ */
+struct UdpResolve
+{
+    UdpResolveStatus status;
+    unsigned short port;
+    UdpEndpoint endpoint;
+    // Lookup running on a helper thread while pending, shared with the thread
+    void* job;
+};
+typedef struct UdpResolve UdpResolve;
+
+/**
+ * Starts resolving the given hostname and port. If the hostname is numeric,
+ * in the cache or resolved quickly, the lookup completes before returning.
+ */
+void udp_resolve_start(UdpResolve* resolve, const char* hostname, unsigned short port);
+
+/**
+ * Checks whether the lookup completed, without blocking. If it returns
+ * UDP_RESOLVE_DONE, the resolved endpoint is written to the given endpoint.
+ */
+UdpResolveStatus udp_resolve_poll(UdpResolve* resolve, UdpEndpoint* endpoint);
+
+/**
+ * Frees resources associated with the lookup. Pending lookups are abandoned,
+ * their helper thread cleans up after itself.
+ */
+void udp_resolve_free(UdpResolve* resolve);
+
+/**
+ * Forgets all remembered hostnames, e.g. after the network changed.
+ */
+void udp_resolver_cache_clear();
+
+#endif // UDP_RESOLVER_H
@@ -9,6 +9,7 @@
 
 #include <stdbool.h>
 #include <stddef.h> // for size_t
+#include <stdint.h>
 
 /**
  * Represents a reference to a native socket.
@@ -22,9 +23,29 @@
 struct UdpSocket
 {
     int socket_handle;
+#ifdef UDP_SOCKET_URING
+    /** Submission and completion rings if the io_uring backend is used, otherwise NULL */
+    struct UdpSocketUring* uring;
+#endif
 };
 typedef struct UdpSocket UdpSocket;
 
+/**
+ * Implementations of sending and receiving that sockets can use.
+ *
+ * UDP_SOCKET_BACKEND_BSD makes one system call per sent or received packet and
+ * is available everywhere. UDP_SOCKET_BACKEND_IO_URING is only available on
+ * Linux if compiled with UDP_SOCKET_URING. It receives into buffers registered
+ * with the kernel without any system calls and can submit many sends with a
+ * single system call, see <code>udp_socket_set_batching</code>.
+ */
+enum UdpSocketBackend
+{
+    UDP_SOCKET_BACKEND_BSD = 0,
+    UDP_SOCKET_BACKEND_IO_URING = 1
+};
+typedef enum UdpSocketBackend UdpSocketBackend;
+
 /**
  * Defines possible outcomes of calls to functions in this module.
  *
@@ -51,7 +72,11 @@ enum UdpSocketResultCode
     UDP_SOCKET_ERR_SEND_FAILED = -12,
     UDP_SOCKET_ERR_FREE_FAILED = -13,
     UDP_SOCKET_ERR_NOTHING_RECEIVED = -14,
-    UDP_SOCKET_ERR_RECEIVE_FAILED = -15
+    UDP_SOCKET_ERR_RECEIVE_FAILED = -15,
+    UDP_SOCKET_ERR_NOT_MULTICAST = -16,
+    UDP_SOCKET_ERR_MULTICAST_FAILED = -17,
+    UDP_SOCKET_ERR_SHARE_PORT_FAILED = -18,
+    UDP_SOCKET_ERR_OPTIONS_FAILED = -19
 };
 typedef enum UdpSocketResultCode UdpSocketResultCode;
 
@@ -95,6 +120,23 @@ typedef struct UdpSocketResult UdpSocketResult;
 #endif
 typedef struct UdpEndpoint UdpEndpoint;
 
+/**
+ * Address family, port and address of an endpoint in fixed-size words, so
+ * that senders can be told apart without comparing whole socket addresses.
+ *
+ * IPv4 addresses occupy the first word and leave the others zero. Keys are
+ * filled with <code>udp_endpoint_key</code> and only meaningful for
+ * comparing with <code>udp_endpoint_key_equal</code>.
+ */
+struct UdpEndpointKey
+{
+    uint32_t addr[4];
+    uint32_t scope_id;
+    uint16_t port;
+    uint16_t family;
+};
+typedef struct UdpEndpointKey UdpEndpointKey;
+
 /**
  * Initializes the given UdpSocket data structure to reference a UDP socket on
  * a free port selected by the operating system.
@@ -162,6 +204,24 @@ UdpSocketResult udp_socket_init(UdpSocket* socket);
  */
 UdpSocketResult udp_socket_init_on_port(UdpSocket* socket, unsigned short port);
 
+/**
+ * Initializes the given UdpSocket data structure to reference a UDP socket on
+ * the given port that shares the port with other sockets initialized with
+ * this function, using <code>SO_REUSEPORT</code>.
+ *
+ * Sockets sharing a port that are connected with
+ * <code>udp_socket_set_endpoint</code> receive the datagrams from their
+ * endpoint, the kernel passes all other datagrams to the ones that are not
+ * connected. Datagrams that arrived before connecting may come from anyone.
+ *
+ * Sockets initialized with <code>udp_socket_init_on_port</code> do not share
+ * their port and are refused with <code>UDP_SOCKET_ERR_PORT_IN_USE</code>. If
+ * the platform cannot share ports, <code>code</code> is set to
+ * <code>UDP_SOCKET_ERR_SHARE_PORT_FAILED</code>. Otherwise, results are like
+ * with <code>udp_socket_init_on_port</code>.
+ */
+UdpSocketResult udp_socket_init_shared(UdpSocket* socket, unsigned short port);
+
 /**
  * Close the socket and free associated resources but not the passed UdpSocket
  * data structure.
@@ -269,4 +329,178 @@ UdpSocketResult udp_socket_receive(UdpSocket* socket, void* packet_buffer, size_
 
 bool udp_endpoint_equal(UdpEndpoint* a, UdpEndpoint* b);
 
+/**
+ * Fills the key of the given endpoint, which compares equal to the key of
+ * another endpoint exactly if both have the same address family, address,
+ * scope and port.
+ */
+void udp_endpoint_key(UdpEndpoint* endpoint, UdpEndpointKey* key);
+
+/**
+ * Compares two keys filled by <code>udp_endpoint_key</code> word by word.
+ */
+bool udp_endpoint_key_equal(const UdpEndpointKey* a, const UdpEndpointKey* b);
+
+/**
+ * Resolves the given hostname and port into an endpoint that can be passed to
+ * <code>udp_socket_send_to</code> or <code>udp_socket_set_endpoint</code>.
+ *
+ * The result of the operation will be signalled with the returned UdpSocketResult
+ * structure. If the hostname cannot be resolved, <code>code</code> is set to
+ * <code>UDP_SOCKET_ERR_RESOLVE_HOSTNAME_FAILED</code>.
+ */
+UdpSocketResult udp_endpoint_resolve(UdpEndpoint* endpoint, const char* hostname, unsigned short port);
+
+/**
+ * Changes the port of an endpoint that was resolved before, keeping the
+ * address.
+ */
+void udp_endpoint_set_port(UdpEndpoint* endpoint, unsigned short port);
+
+/**
+ * Writes the address of the endpoint into the given buffer in numeric form,
+ * e.g. "192.168.1.20" or "fe80::1", without the port. IPv4 addresses mapped
+ * into IPv6 are written in IPv4 notation.
+ *
+ * Returns false if the buffer is too small, UDP_ENDPOINT_ADDRESS_MAX_LEN
+ * bytes are always enough.
+ */
+bool udp_endpoint_address(UdpEndpoint* endpoint, char* buf, size_t buf_capacity);
+
+/** Buffer size for udp_endpoint_address that fits any address */
+#define UDP_ENDPOINT_ADDRESS_MAX_LEN 46
+
+/**
+ * Checks whether the address of the endpoint is an IPv4 or IPv6 multicast
+ * group address, e.g. in 239.0.0.0/8 or ff00::/8.
+ */
+bool udp_endpoint_is_multicast(UdpEndpoint* endpoint);
+
+/**
+ * Subscribes the socket to datagrams sent to the given multicast group on the
+ * port of the socket, in addition to datagrams sent to the socket directly.
+ * The group is a numeric IPv4 or IPv6 multicast address, the default interface
+ * is used.
+ *
+ * If the group is not a multicast address, <code>code</code> is set to
+ * <code>UDP_SOCKET_ERR_NOT_MULTICAST</code>. If the operating system refuses
+ * to join, it is set to <code>UDP_SOCKET_ERR_MULTICAST_FAILED</code>.
+ */
+UdpSocketResult udp_socket_join_multicast(UdpSocket* socket, const char* group);
+
+/**
+ * Unsubscribes the socket from a multicast group joined with
+ * <code>udp_socket_join_multicast</code>. Freeing the socket leaves all groups
+ * implicitly.
+ */
+UdpSocketResult udp_socket_leave_multicast(UdpSocket* socket, const char* group);
+
+/**
+ * Allows or forbids sending to broadcast addresses such as 255.255.255.255.
+ * Sending to a broadcast address without allowing it first fails with
+ * <code>UDP_SOCKET_ERR_BAD_BROADCAST</code>.
+ */
+UdpSocketResult udp_socket_set_broadcast(UdpSocket* socket, bool broadcast);
+
+/**
+ * Sets how many routers multicast datagrams sent from this socket may pass.
+ * The default of 1 keeps them in the local network.
+ */
+UdpSocketResult udp_socket_set_multicast_ttl(UdpSocket* socket, unsigned char ttl);
+
+/**
+ * Sets whether multicast datagrams sent from this socket are also delivered to
+ * members of the group on the sending host. Enabled by default.
+ */
+UdpSocketResult udp_socket_set_multicast_loopback(UdpSocket* socket, bool loopback);
+
+/**
+ * Buffer sizes, busy polling and packet priorities of a socket, where zero
+ * stands for the default of the operating system.
+ */
+struct UdpSocketOptions
+{
+    /** Bytes buffered for received datagrams, SO_RCVBUF */
+    int recv_buf_len;
+    /** Bytes buffered for datagrams waiting to be sent, SO_SNDBUF */
+    int send_buf_len;
+    /** Microseconds to busy poll the device queue when receiving, SO_BUSY_POLL */
+    int busy_poll_us;
+    /** Differentiated services code point of sent packets, IP_TOS and IPV6_TCLASS */
+    int dscp;
+    /** Priority of sent packets in the device queues, SO_PRIORITY */
+    int priority;
+};
+typedef struct UdpSocketOptions UdpSocketOptions;
+
+/**
+ * Applies the non-zero fields of the given options, as far as the platform
+ * and the privileges of the process allow. Buffer sizes beyond the limits of
+ * the system are tried again with the privileged variants of the options on
+ * Linux, and are capped by the kernel otherwise.
+ *
+ * All options are attempted even if some fail. If an option was refused, the
+ * result is <code>UDP_SOCKET_ERR_OPTIONS_FAILED</code> with the reason of the
+ * last refusal, use <code>udp_socket_get_options</code> to find out which
+ * values are in effect.
+ */
+UdpSocketResult udp_socket_set_options(UdpSocket* socket, const UdpSocketOptions* options);
+
+/**
+ * Reads the values in effect for the options of the given socket. Options
+ * that the platform does not know are reported as zero. Linux reports buffer
+ * sizes twice as large as requested, including its bookkeeping.
+ */
+void udp_socket_get_options(UdpSocket* socket, UdpSocketOptions* effective);
+
+/**
+ * Selects the backend for sockets initialized after the call.
+ *
+ * If never called, the backend is taken from the <code>ATOLLA_UDP_BACKEND</code>
+ * environment variable, which may be set to <code>bsd</code> or
+ * <code>io_uring</code>, and is <code>UDP_SOCKET_BACKEND_BSD</code> otherwise.
+ *
+ * Returns false and leaves the selection unchanged if the backend was not
+ * compiled in. If io_uring is compiled in but not permitted by the running
+ * kernel, sockets silently fall back to the BSD backend on initialization, use
+ * <code>udp_socket_backend</code> to find out which backend a socket uses.
+ */
+bool udp_socket_select_backend(UdpSocketBackend backend);
+
+/**
+ * Gets the backend that the given initialized socket uses.
+ */
+UdpSocketBackend udp_socket_backend(UdpSocket* socket);
+
+/**
+ * Enables or disables batching of sends. While enabled, sends are queued and
+ * submitted together on the next call to <code>udp_socket_flush</code>, or when
+ * the queue is full. Errors of queued sends are not reported. Disabling
+ * batching flushes the queue.
+ *
+ * Batching is only supported by the io_uring backend, for other backends
+ * packets are always sent immediately.
+ */
+void udp_socket_set_batching(UdpSocket* socket, bool batching);
+
+/**
+ * Gets a descriptor that becomes readable when a packet can be received, for
+ * waiting with poll or epoll. This is the socket handle for the BSD backend
+ * and the completion ring for the io_uring backend. Packets that arrived
+ * earlier only count if every packet was received since the last wait, so
+ * receive until <code>UDP_SOCKET_ERR_NOTHING_RECEIVED</code> before waiting.
+ *
+ * Returns -1 on platforms without descriptors.
+ */
+int udp_socket_poll_handle(UdpSocket* socket);
+
+/**
+ * Submits all sends queued while batching.
+ *
+ * The result of the operation will be signalled with the returned UdpSocketResult
+ * structure. A successful completion will be signalled with the <code>code</code>
+ * property being set to <code>UDP_SOCKET_OK</code>.
+ */
+UdpSocketResult udp_socket_flush(UdpSocket* socket);
+
 #endif /* _udp_socket_h_ */
@@ -11,18 +11,43 @@
 #include "udp_socket_messages.h"
 #include "udp_socket.h"
 #include "udp_socket_results_internal.h"
+#include "udp_socket_uring.h"
+
+#include <stdlib.h> // for getenv
 
 /** Free resources associated with the socket allocated by the operating system */
 static UdpSocketResult udp_socket_close(UdpSocket* socket);
 static UdpSocketResult udp_socket_initialize_socket_support(UdpSocket* socket);
-static UdpSocketResult udp_socket_create_socket(UdpSocket* sock, unsigned short port);
+static UdpSocketResult udp_socket_init_on_port_sharing(UdpSocket* socket, unsigned short port, bool shared);
+static UdpSocketResult udp_socket_create_socket(UdpSocket* sock, unsigned short port, bool shared);
 static UdpSocketResult udp_socket_set_socket_nonblocking(UdpSocket* socket);
+static UdpSocketBackend udp_socket_selected_backend();
+static UdpSocketResult udp_socket_change_multicast_membership(UdpSocket* socket, const char* group, bool join);
+
+/** Backend for new sockets, negative until selected explicitly or through the environment */
+static int selected_backend = -1;
 
 #if defined(_WIN32) || defined(WIN32)
     WSADATA WsaData;
 #endif
 
+#ifndef IPV6_JOIN_GROUP
+    // Older name for the same option, e.g. on Windows
+    #define IPV6_JOIN_GROUP IPV6_ADD_MEMBERSHIP
+    #define IPV6_LEAVE_GROUP IPV6_DROP_MEMBERSHIP
+#endif
+
 UdpSocketResult udp_socket_init_on_port(UdpSocket* socket, unsigned short port)
+{
+    return udp_socket_init_on_port_sharing(socket, port, false);
+}
+
+UdpSocketResult udp_socket_init_shared(UdpSocket* socket, unsigned short port)
+{
+    return udp_socket_init_on_port_sharing(socket, port, true);
+}
+
+static UdpSocketResult udp_socket_init_on_port_sharing(UdpSocket* socket, unsigned short port, bool shared)
 {
     if(socket == NULL)
     {
@@ -44,7 +69,7 @@ UdpSocketResult udp_socket_init_on_port(UdpSocket* socket, unsigned short port)
         return result;
     }
 
-    result = udp_socket_create_socket(socket, port);
+    result = udp_socket_create_socket(socket, port, shared);
     if(result.code != UDP_SOCKET_OK)
     {
         return result;
@@ -58,10 +83,93 @@ UdpSocketResult udp_socket_init_on_port(UdpSocket* socket, unsigned short port)
         return result;
     }
 
+#ifdef UDP_SOCKET_URING
+    if(udp_socket_selected_backend() == UDP_SOCKET_BACKEND_IO_URING)
+    {
+        // If the kernel refuses, the socket just keeps using the BSD functions
+        udp_socket_uring_attach(socket);
+    }
+#endif
+
     return make_success_result();
 }
 
-static UdpSocketResult udp_socket_create_socket(UdpSocket* sock, unsigned short port)
+bool udp_socket_select_backend(UdpSocketBackend backend)
+{
+#ifndef UDP_SOCKET_URING
+    if(backend == UDP_SOCKET_BACKEND_IO_URING)
+    {
+        return false;
+    }
+#endif
+
+    selected_backend = backend;
+    return true;
+}
+
+UdpSocketBackend udp_socket_backend(UdpSocket* socket)
+{
+#ifdef UDP_SOCKET_URING
+    if(socket->uring)
+    {
+        return UDP_SOCKET_BACKEND_IO_URING;
+    }
+#endif
+
+    return UDP_SOCKET_BACKEND_BSD;
+}
+
+void udp_socket_set_batching(UdpSocket* socket, bool batching)
+{
+#ifdef UDP_SOCKET_URING
+    if(socket->uring)
+    {
+        udp_socket_uring_set_batching(socket, batching);
+    }
+#endif
+}
+
+int udp_socket_poll_handle(UdpSocket* socket)
+{
+#ifdef UDP_SOCKET_URING
+    if(socket->uring)
+    {
+        return udp_socket_uring_poll_handle(socket);
+    }
+#endif
+
+    return socket->socket_handle;
+}
+
+UdpSocketResult udp_socket_flush(UdpSocket* socket)
+{
+#ifdef UDP_SOCKET_URING
+    if(socket->uring)
+    {
+        return udp_socket_uring_flush(socket);
+    }
+#endif
+
+    return make_success_result();
+}
+
+static UdpSocketBackend udp_socket_selected_backend()
+{
+    if(selected_backend < 0)
+    {
+        const char* backend_name = getenv("ATOLLA_UDP_BACKEND");
+        bool want_uring = backend_name != NULL && strcmp(backend_name, "io_uring") == 0;
+
+        if(!want_uring || !udp_socket_select_backend(UDP_SOCKET_BACKEND_IO_URING))
+        {
+            udp_socket_select_backend(UDP_SOCKET_BACKEND_BSD);
+        }
+    }
+
+    return (UdpSocketBackend) selected_backend;
+}
+
+static UdpSocketResult udp_socket_create_socket(UdpSocket* sock, unsigned short port, bool shared)
 {
 #ifdef UDP_SOCKET_IPV4_ONLY
 
@@ -109,6 +217,25 @@ static UdpSocketResult udp_socket_create_socket(UdpSocket* sock, unsigned short
 
 #endif
 
+    if(shared)
+    {
+#ifdef SO_REUSEPORT
+        // Must be set on every socket sharing the port before it is bound
+        int reuse = 1;
+        int reuse_err = setsockopt(sock->socket_handle, SOL_SOCKET, SO_REUSEPORT, (const void*)&reuse, sizeof(reuse));
+#else
+        int reuse_err = -1;
+#endif
+        if(reuse_err != 0)
+        {
+            close(sock->socket_handle);
+            return make_err_result(
+                UDP_SOCKET_ERR_SHARE_PORT_FAILED,
+                msg_share_port_failed
+            );
+        }
+    }
+
     int bind_err = bind(sock->socket_handle,
                         (const struct sockaddr*) &address,
                         sizeof(address));
@@ -197,6 +324,10 @@ UdpSocketResult udp_socket_free(UdpSocket* socket)
         );
     }
 
+#ifdef UDP_SOCKET_URING
+    udp_socket_uring_detach(socket);
+#endif
+
     UdpSocketResult result = udp_socket_close(socket);
     if(result.code != UDP_SOCKET_OK)
     {
@@ -368,6 +499,13 @@ UdpSocketResult udp_socket_receive_from(UdpSocket* socket, void* packet_data, si
     assert(packet_data != NULL);
     assert(max_packet_size > 0);
 
+#ifdef UDP_SOCKET_URING
+    if(socket->uring)
+    {
+        return udp_socket_uring_receive_from(socket, packet_data, max_packet_size, received_byte_count, sender);
+    }
+#endif
+
     ssize_t received_bytes;
 
     if(sender) {
@@ -400,20 +538,7 @@ UdpSocketResult udp_socket_receive_from(UdpSocket* socket, void* packet_data, si
             *received_byte_count = 0;
         }
 
-        if(errno == EAGAIN || errno == EWOULDBLOCK)
-        {
-            return make_err_result(
-                UDP_SOCKET_ERR_NOTHING_RECEIVED,
-                msg_nothing_received
-            );
-        }
-        else
-        {
-            return make_err_result(
-                UDP_SOCKET_ERR_RECEIVE_FAILED,
-                strerror(errno)
-            );
-        }
+        return make_receive_err_result(errno);
     }
     else
     {
@@ -439,6 +564,19 @@ UdpSocketResult udp_socket_send_to(UdpSocket* socket, void* packet_data, size_t
         );
     }
 
+#ifdef UDP_SOCKET_URING
+    if(socket->uring)
+    {
+        if(packet_data_len <= UDP_SOCKET_URING_BUF_LEN)
+        {
+            return udp_socket_uring_send_to(socket, packet_data, packet_data_len, to);
+        }
+
+        // Too large for a send slot, send directly but keep the order of packets
+        udp_socket_uring_flush(socket);
+    }
+#endif
+
     ssize_t sent_bytes;
     if(to)
     {
@@ -459,41 +597,7 @@ UdpSocketResult udp_socket_send_to(UdpSocket* socket, void* packet_data, size_t
 
     if(sent_bytes == -1)
     {
-        if(errno == EACCES)
-        {
-            return make_err_result(
-                UDP_SOCKET_ERR_BAD_BROADCAST,
-                msg_bad_braodcast
-            );
-        }
-        else if(errno == EAGAIN || errno == EWOULDBLOCK)
-        {
-            return make_err_result(
-                UDP_SOCKET_ERR_WOULDBLOCK,
-                msg_wouldblock
-            );
-        }
-        else if(errno == EDESTADDRREQ)
-        {
-            return make_err_result(
-                UDP_SOCKET_ERR_NO_RECEIVER,
-                msg_no_receiver
-            );
-        }
-        else if(errno == EMSGSIZE)
-        {
-            return make_err_result(
-                UDP_SOCKET_ERR_PACKET_TOO_BIG,
-                msg_packet_too_big
-            );
-        }
-        else
-        {
-            return make_err_result(
-                UDP_SOCKET_ERR_SEND_FAILED,
-                strerror(errno)
-            );
-        }
+        return make_send_err_result(errno);
     }
 
     assert(((size_t) sent_bytes) == packet_data_len);
@@ -501,6 +605,63 @@ UdpSocketResult udp_socket_send_to(UdpSocket* socket, void* packet_data, size_t
     return make_success_result();
 }
 
+UdpSocketResult make_send_err_result(int error)
+{
+    if(error == EACCES)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_BAD_BROADCAST,
+            msg_bad_braodcast
+        );
+    }
+    else if(error == EAGAIN || error == EWOULDBLOCK)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_WOULDBLOCK,
+            msg_wouldblock
+        );
+    }
+    else if(error == EDESTADDRREQ)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_NO_RECEIVER,
+            msg_no_receiver
+        );
+    }
+    else if(error == EMSGSIZE)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_PACKET_TOO_BIG,
+            msg_packet_too_big
+        );
+    }
+    else
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SEND_FAILED,
+            strerror(error)
+        );
+    }
+}
+
+UdpSocketResult make_receive_err_result(int error)
+{
+    if(error == EAGAIN || error == EWOULDBLOCK)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_NOTHING_RECEIVED,
+            msg_nothing_received
+        );
+    }
+    else
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_RECEIVE_FAILED,
+            strerror(error)
+        );
+    }
+}
+
 bool udp_endpoint_equal(UdpEndpoint* a, UdpEndpoint* b)
 {
     if(a->addr_len != b->addr_len)
@@ -512,4 +673,461 @@ bool udp_endpoint_equal(UdpEndpoint* a, UdpEndpoint* b)
     return 0 == memcmp(&a->addr, &b->addr, len);
 }
 
+void udp_endpoint_key(UdpEndpoint* endpoint, UdpEndpointKey* key)
+{
+    memset(key, 0, sizeof(UdpEndpointKey));
+    key->family = (uint16_t) endpoint->addr.ss_family;
+
+    if(endpoint->addr.ss_family == AF_INET)
+    {
+        const struct sockaddr_in* addr = (const struct sockaddr_in*) &endpoint->addr;
+        memcpy(&key->addr[0], &addr->sin_addr, sizeof(addr->sin_addr));
+        key->port = addr->sin_port;
+    }
+#ifndef UDP_SOCKET_IPV4_ONLY
+    else if(endpoint->addr.ss_family == AF_INET6)
+    {
+        const struct sockaddr_in6* addr = (const struct sockaddr_in6*) &endpoint->addr;
+        memcpy(key->addr, &addr->sin6_addr, sizeof(addr->sin6_addr));
+        key->scope_id = addr->sin6_scope_id;
+        key->port = addr->sin6_port;
+    }
+#endif
+}
+
+bool udp_endpoint_key_equal(const UdpEndpointKey* a, const UdpEndpointKey* b)
+{
+    // Ports differ most often between sources on the same host, so they go first
+    return a->port == b->port &&
+           a->family == b->family &&
+           a->addr[3] == b->addr[3] &&
+           a->addr[0] == b->addr[0] &&
+           a->addr[1] == b->addr[1] &&
+           a->addr[2] == b->addr[2] &&
+           a->scope_id == b->scope_id;
+}
+
+UdpSocketResult udp_endpoint_resolve(UdpEndpoint* endpoint, const char* hostname, unsigned short port_short)
+{
+    char port[6];
+    sprintf(port, "%hu", port_short);
+
+    struct addrinfo criteria;
+    memset(&criteria, 0, sizeof criteria);
+    criteria.ai_family = AF_UNSPEC;
+    criteria.ai_socktype = SOCK_DGRAM;
+    criteria.ai_protocol = IPPROTO_UDP;
+    criteria.ai_flags = AI_V4MAPPED | AI_ADDRCONFIG;
+
+    struct addrinfo* first_result = NULL;
+    int error = getaddrinfo(hostname, port, &criteria, &first_result);
+
+    if(error != 0)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_RESOLVE_HOSTNAME_FAILED,
+            (error == EAI_SYSTEM) ? strerror(errno) : gai_strerror(error)
+        );
+    }
+
+    assert(first_result->ai_addrlen <= sizeof(endpoint->addr));
+    memset(&endpoint->addr, 0, sizeof(endpoint->addr));
+    memcpy(&endpoint->addr, first_result->ai_addr, first_result->ai_addrlen);
+    endpoint->addr_len = (socklen_t) first_result->ai_addrlen;
+
+    freeaddrinfo(first_result);
+
+    return make_success_result();
+}
+
+bool udp_endpoint_address(UdpEndpoint* endpoint, char* buf, size_t buf_capacity)
+{
+    const void* address;
+    int family = endpoint->addr.ss_family;
+
+    if(family == AF_INET)
+    {
+        address = &((const struct sockaddr_in*) &endpoint->addr)->sin_addr;
+    }
+#ifndef UDP_SOCKET_IPV4_ONLY
+    else if(family == AF_INET6)
+    {
+        const struct in6_addr* address6 = &((const struct sockaddr_in6*) &endpoint->addr)->sin6_addr;
+        if(IN6_IS_ADDR_V4MAPPED(address6))
+        {
+            // The last four bytes are the IPv4 address
+            family = AF_INET;
+            address = ((const uint8_t*) address6) + 12;
+        }
+        else
+        {
+            address = address6;
+        }
+    }
+#endif
+    else
+    {
+        return false;
+    }
+
+    return inet_ntop(family, address, buf, buf_capacity) != NULL;
+}
+
+void udp_endpoint_set_port(UdpEndpoint* endpoint, unsigned short port)
+{
+    if(endpoint->addr.ss_family == AF_INET)
+    {
+        ((struct sockaddr_in*) &endpoint->addr)->sin_port = htons(port);
+    }
+#ifndef UDP_SOCKET_IPV4_ONLY
+    else if(endpoint->addr.ss_family == AF_INET6)
+    {
+        ((struct sockaddr_in6*) &endpoint->addr)->sin6_port = htons(port);
+    }
+#endif
+}
+
+bool udp_endpoint_is_multicast(UdpEndpoint* endpoint)
+{
+    if(endpoint->addr.ss_family == AF_INET)
+    {
+        const struct sockaddr_in* addr = (const struct sockaddr_in*) &endpoint->addr;
+        return IN_MULTICAST(ntohl(addr->sin_addr.s_addr));
+    }
+#ifndef UDP_SOCKET_IPV4_ONLY
+    else if(endpoint->addr.ss_family == AF_INET6)
+    {
+        const struct sockaddr_in6* addr = (const struct sockaddr_in6*) &endpoint->addr;
+        const uint8_t* bytes = (const uint8_t*) &addr->sin6_addr;
+        // IPv4 groups may also come in mapped into IPv6, ::ffff:224.0.0.0/100
+        return IN6_IS_ADDR_MULTICAST(&addr->sin6_addr) ||
+               (IN6_IS_ADDR_V4MAPPED(&addr->sin6_addr) && (bytes[12] & 0xF0) == 0xE0);
+    }
+#endif
+    else
+    {
+        return false;
+    }
+}
+
+UdpSocketResult udp_socket_join_multicast(UdpSocket* socket, const char* group)
+{
+    return udp_socket_change_multicast_membership(socket, group, true);
+}
+
+UdpSocketResult udp_socket_leave_multicast(UdpSocket* socket, const char* group)
+{
+    return udp_socket_change_multicast_membership(socket, group, false);
+}
+
+UdpSocketResult udp_socket_set_broadcast(UdpSocket* socket, bool broadcast)
+{
+    if(socket == NULL)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SOCKET_IS_NULL,
+            msg_socket_is_null
+        );
+    }
+
+    int enabled = broadcast ? 1 : 0;
+    if(setsockopt(socket->socket_handle, SOL_SOCKET, SO_BROADCAST, (const char*) &enabled, sizeof(enabled)) != 0)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_BAD_BROADCAST,
+            strerror(errno)
+        );
+    }
+
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_set_multicast_ttl(UdpSocket* socket, unsigned char ttl)
+{
+    if(socket == NULL)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SOCKET_IS_NULL,
+            msg_socket_is_null
+        );
+    }
+
+    // Dual-stack sockets send to IPv4 groups with the IPv4 option and to IPv6
+    // groups with the IPv6 one, so set both and only fail if neither works
+    int error = setsockopt(socket->socket_handle, IPPROTO_IP, IP_MULTICAST_TTL, (const char*) &ttl, sizeof(ttl));
+#ifndef UDP_SOCKET_IPV4_ONLY
+    int hops = ttl;
+    int error6 = setsockopt(socket->socket_handle, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, (const char*) &hops, sizeof(hops));
+    error = (error == 0 || error6 == 0) ? 0 : error6;
+#endif
+
+    if(error != 0)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_MULTICAST_FAILED,
+            strerror(errno)
+        );
+    }
+
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_set_multicast_loopback(UdpSocket* socket, bool loopback)
+{
+    if(socket == NULL)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SOCKET_IS_NULL,
+            msg_socket_is_null
+        );
+    }
+
+    unsigned char loop = loopback ? 1 : 0;
+    int error = setsockopt(socket->socket_handle, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*) &loop, sizeof(loop));
+#ifndef UDP_SOCKET_IPV4_ONLY
+    unsigned int loop6 = loop;
+    int error6 = setsockopt(socket->socket_handle, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, (const char*) &loop6, sizeof(loop6));
+    error = (error == 0 || error6 == 0) ? 0 : error6;
+#endif
+
+    if(error != 0)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_MULTICAST_FAILED,
+            strerror(errno)
+        );
+    }
+
+    return make_success_result();
+}
+
+/**
+ * Sets an integer socket option, returning zero on success and otherwise the
+ * errno of the refusal.
+ */
+static int udp_socket_set_int_option(UdpSocket* socket, int level, int name, int value)
+{
+    if(setsockopt(socket->socket_handle, level, name, (const char*) &value, sizeof(value)) != 0)
+    {
+        return errno;
+    }
+    return 0;
+}
+
+/**
+ * Gets an integer socket option, or zero if the socket does not have it.
+ */
+static int udp_socket_get_int_option(UdpSocket* socket, int level, int name)
+{
+    int value = 0;
+    socklen_t len = sizeof(value);
+    if(getsockopt(socket->socket_handle, level, name, (char*) &value, &len) != 0)
+    {
+        return 0;
+    }
+    return value;
+}
+
+/**
+ * Sets a buffer size, retrying with the variant of the option that ignores
+ * the system limits if the kernel capped the size and the process may do so.
+ */
+static int udp_socket_set_buf_len(UdpSocket* socket, int name, int force_name, int len)
+{
+    int error = udp_socket_set_int_option(socket, SOL_SOCKET, name, len);
+    // Linux reports double the size and silently caps at rmem_max or wmem_max
+    if(error == 0 && force_name != 0 && udp_socket_get_int_option(socket, SOL_SOCKET, name) < len)
+    {
+        // Failing without CAP_NET_ADMIN leaves the capped size, which is no error
+        udp_socket_set_int_option(socket, SOL_SOCKET, force_name, len);
+    }
+    return error;
+}
+
+UdpSocketResult udp_socket_set_options(UdpSocket* socket, const UdpSocketOptions* options)
+{
+    if(socket == NULL)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SOCKET_IS_NULL,
+            msg_socket_is_null
+        );
+    }
+
+    int error = 0;
+    int result;
+
+    if(options->recv_buf_len > 0)
+    {
+#ifdef SO_RCVBUFFORCE
+        result = udp_socket_set_buf_len(socket, SO_RCVBUF, SO_RCVBUFFORCE, options->recv_buf_len);
+#else
+        result = udp_socket_set_buf_len(socket, SO_RCVBUF, 0, options->recv_buf_len);
+#endif
+        error = (result != 0) ? result : error;
+    }
+
+    if(options->send_buf_len > 0)
+    {
+#ifdef SO_SNDBUFFORCE
+        result = udp_socket_set_buf_len(socket, SO_SNDBUF, SO_SNDBUFFORCE, options->send_buf_len);
+#else
+        result = udp_socket_set_buf_len(socket, SO_SNDBUF, 0, options->send_buf_len);
+#endif
+        error = (result != 0) ? result : error;
+    }
+
+    if(options->busy_poll_us > 0)
+    {
+#ifdef SO_BUSY_POLL
+        result = udp_socket_set_int_option(socket, SOL_SOCKET, SO_BUSY_POLL, options->busy_poll_us);
+#else
+        result = ENOPROTOOPT;
+#endif
+        error = (result != 0) ? result : error;
+    }
+
+    if(options->dscp > 0)
+    {
+        // The two low bits of the traffic class are ECN, which is left to the kernel
+        int tclass = (options->dscp & 0x3F) << 2;
+        // Dual-stack sockets send to IPv4 peers with the IPv4 option and to
+        // IPv6 peers with the IPv6 one, so set both and only fail if neither works
+        result = udp_socket_set_int_option(socket, IPPROTO_IP, IP_TOS, tclass);
+#if !defined(UDP_SOCKET_IPV4_ONLY) && defined(IPV6_TCLASS)
+        int result6 = udp_socket_set_int_option(socket, IPPROTO_IPV6, IPV6_TCLASS, tclass);
+        result = (result == 0 || result6 == 0) ? 0 : result6;
+#endif
+        error = (result != 0) ? result : error;
+    }
+
+    if(options->priority > 0)
+    {
+#ifdef SO_PRIORITY
+        result = udp_socket_set_int_option(socket, SOL_SOCKET, SO_PRIORITY, options->priority);
+#else
+        result = ENOPROTOOPT;
+#endif
+        error = (result != 0) ? result : error;
+    }
+
+    if(error != 0)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_OPTIONS_FAILED,
+            strerror(error)
+        );
+    }
+
+    return make_success_result();
+}
+
+void udp_socket_get_options(UdpSocket* socket, UdpSocketOptions* effective)
+{
+    memset(effective, 0, sizeof(UdpSocketOptions));
+    if(socket == NULL)
+    {
+        return;
+    }
+
+    effective->recv_buf_len = udp_socket_get_int_option(socket, SOL_SOCKET, SO_RCVBUF);
+    effective->send_buf_len = udp_socket_get_int_option(socket, SOL_SOCKET, SO_SNDBUF);
+#ifdef SO_BUSY_POLL
+    effective->busy_poll_us = udp_socket_get_int_option(socket, SOL_SOCKET, SO_BUSY_POLL);
+#endif
+#if !defined(UDP_SOCKET_IPV4_ONLY) && defined(IPV6_TCLASS)
+    int tclass = udp_socket_get_int_option(socket, IPPROTO_IPV6, IPV6_TCLASS);
+    if(tclass == 0)
+    {
+        tclass = udp_socket_get_int_option(socket, IPPROTO_IP, IP_TOS);
+    }
+#else
+    int tclass = udp_socket_get_int_option(socket, IPPROTO_IP, IP_TOS);
+#endif
+    effective->dscp = (tclass >> 2) & 0x3F;
+#ifdef SO_PRIORITY
+    effective->priority = udp_socket_get_int_option(socket, SOL_SOCKET, SO_PRIORITY);
+#endif
+}
+
+static UdpSocketResult udp_socket_change_multicast_membership(UdpSocket* socket, const char* group, bool join)
+{
+    if(socket == NULL)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_SOCKET_IS_NULL,
+            msg_socket_is_null
+        );
+    }
+
+    // Groups are given as numeric addresses, never look them up
+    struct addrinfo criteria;
+    memset(&criteria, 0, sizeof criteria);
+    criteria.ai_family = AF_UNSPEC;
+    criteria.ai_socktype = SOCK_DGRAM;
+    criteria.ai_flags = AI_NUMERICHOST;
+
+    struct addrinfo* result = NULL;
+    if(getaddrinfo(group, NULL, &criteria, &result) != 0)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_NOT_MULTICAST,
+            msg_not_multicast
+        );
+    }
+
+    UdpEndpoint group_endpoint;
+    memset(&group_endpoint, 0, sizeof(group_endpoint));
+    memcpy(&group_endpoint.addr, result->ai_addr, result->ai_addrlen);
+    group_endpoint.addr_len = (socklen_t) result->ai_addrlen;
+    freeaddrinfo(result);
+
+    if(!udp_endpoint_is_multicast(&group_endpoint))
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_NOT_MULTICAST,
+            msg_not_multicast
+        );
+    }
+
+    int error;
+    if(group_endpoint.addr.ss_family == AF_INET)
+    {
+        struct ip_mreq request;
+        memset(&request, 0, sizeof(request));
+        request.imr_multiaddr = ((const struct sockaddr_in*) &group_endpoint.addr)->sin_addr;
+        request.imr_interface.s_addr = htonl(INADDR_ANY);
+
+        error = setsockopt(socket->socket_handle, IPPROTO_IP,
+                           join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP,
+                           (const char*) &request, sizeof(request));
+    }
+    else
+    {
+#ifdef UDP_SOCKET_IPV4_ONLY
+        error = -1;
+        errno = EAFNOSUPPORT;
+#else
+        struct ipv6_mreq request;
+        memset(&request, 0, sizeof(request));
+        request.ipv6mr_multiaddr = ((const struct sockaddr_in6*) &group_endpoint.addr)->sin6_addr;
+        request.ipv6mr_interface = 0;
+
+        error = setsockopt(socket->socket_handle, IPPROTO_IPV6,
+                           join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP,
+                           (const char*) &request, sizeof(request));
+#endif
+    }
+
+    if(error != 0)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_MULTICAST_FAILED,
+            strerror(errno)
+        );
+    }
+
+    return make_success_result();
+}
+
 #endif
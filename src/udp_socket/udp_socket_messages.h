@@ -10,3 +10,5 @@ static const char* msg_wouldblock = "The send call would block, but the socket i
 static const char* msg_no_receiver = "Tried to send data but no receiver is set";
 static const char* msg_packet_too_big = "The given message is too large to send it in one piece";
 static const char* msg_nothing_received = "No received data is available right now";
+static const char* msg_not_multicast = "The given group is not a numeric multicast address";
+static const char* msg_share_port_failed = "Sharing the port with other sockets is not supported";
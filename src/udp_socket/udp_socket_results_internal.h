@@ -7,4 +7,12 @@ UdpSocketResult make_success_result();
 
 UdpSocketResult make_err_result(UdpSocketResultCode code, const char* msg);
 
+#if !defined(ARDUINO_ARCH_ESP8266)
+/** Translates an errno value set by a failed send into a result */
+UdpSocketResult make_send_err_result(int error);
+
+/** Translates an errno value set by a failed receive into a result */
+UdpSocketResult make_receive_err_result(int error);
+#endif
+
 #endif
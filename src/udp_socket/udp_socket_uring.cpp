@@ -0,0 +1,622 @@
+#include "udp_socket_uring.h"
+
+#ifdef UDP_SOCKET_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../test/assert.h"
+#include "sockets_headers.h"
+#include "udp_socket_results_internal.h"
+
+/** Submission queue size, the completion queue is twice as large */
+#define URING_ENTRIES 64
+/** Registered receive buffers, must be a power of two */
+#define URING_RECV_BUF_COUNT 64
+/**
+ * Size of each registered receive buffer, which holds the recvmsg header and
+ * the sender address in front of the packet. Fits the largest UDP payload so
+ * that packets are never cut short. The pages of a buffer are only backed by
+ * memory once the kernel writes this far into it.
+ */
+#define URING_RECV_BUF_LEN (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_storage) + 65536)
+/** Preallocated send slots, which limits the amount of queued sends */
+#define URING_SEND_SLOT_COUNT 32
+/** Receive completions that arrived while reaping sends, waiting to be handed out */
+#define URING_STASH_CAPACITY (URING_RECV_BUF_COUNT + 1)
+
+/** ID of the single provided buffer group of each ring */
+static const uint16_t recv_buf_group = 0;
+/** user_data of the multishot receive, sends use their slot index */
+static const uint64_t recv_user_data = ~0ULL;
+static const uint64_t cancel_user_data = ~0ULL - 1;
+
+static const char* msg_send_queue_full = "All send slots are in flight, flush or receive to complete them";
+static const char* msg_uring_setup_failed = "Setting up io_uring failed, the kernel might not support it or forbid it";
+
+struct UdpSocketUringSlot
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct sockaddr_storage addr;
+    bool in_flight;
+    int result;
+    uint8_t data[UDP_SOCKET_URING_BUF_LEN];
+};
+typedef struct UdpSocketUringSlot UdpSocketUringSlot;
+
+struct UdpSocketUringCompletion
+{
+    int32_t res;
+    uint32_t flags;
+};
+typedef struct UdpSocketUringCompletion UdpSocketUringCompletion;
+
+struct UdpSocketUring
+{
+    int ring_fd;
+
+    void* rings;
+    size_t rings_len;
+    struct io_uring_sqe* sqes;
+    size_t sqes_len;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    // SQEs written but not yet passed to io_uring_enter
+    unsigned sq_unsubmitted;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_len;
+    uint8_t* recv_bufs;
+    uint16_t buf_ring_tail;
+    struct msghdr recv_msg;
+    bool recv_armed;
+
+    UdpSocketUringCompletion stash[URING_STASH_CAPACITY];
+    size_t stash_front;
+    size_t stash_len;
+
+    UdpSocketUringSlot slots[URING_SEND_SLOT_COUNT];
+    bool batching;
+};
+typedef struct UdpSocketUring UdpSocketUring;
+
+static int uring_setup(unsigned entries, struct io_uring_params* params);
+static int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags);
+static int uring_register(int ring_fd, unsigned opcode, void* arg, unsigned nr_args);
+static bool uring_map_rings(UdpSocketUring* uring, struct io_uring_params* params);
+static bool uring_register_recv_bufs(UdpSocketUring* uring);
+static void uring_unmap(UdpSocketUring* uring);
+static struct io_uring_sqe* uring_get_sqe(UdpSocketUring* uring);
+static int uring_submit(UdpSocketUring* uring, unsigned min_complete);
+static void uring_arm_recv(UdpSocketUring* uring, int socket_handle);
+static void uring_reap(UdpSocketUring* uring);
+static void uring_recycle_recv_buf(UdpSocketUring* uring, uint16_t bid);
+static UdpSocketUringSlot* uring_take_slot(UdpSocketUring* uring);
+
+UdpSocketResult udp_socket_uring_attach(UdpSocket* socket)
+{
+    socket->uring = NULL;
+
+    UdpSocketUring* uring = (UdpSocketUring*) calloc(1, sizeof(UdpSocketUring));
+    if(uring == NULL)
+    {
+        return make_err_result(UDP_SOCKET_ERR_PLATFORM_INIT_FAILED, msg_uring_setup_failed);
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    uring->ring_fd = uring_setup(URING_ENTRIES, &params);
+    if(uring->ring_fd < 0)
+    {
+        free(uring);
+        return make_err_result(UDP_SOCKET_ERR_PLATFORM_INIT_FAILED, msg_uring_setup_failed);
+    }
+
+    if(!uring_map_rings(uring, &params) || !uring_register_recv_bufs(uring))
+    {
+        uring_unmap(uring);
+        close(uring->ring_fd);
+        free(uring);
+        return make_err_result(UDP_SOCKET_ERR_PLATFORM_INIT_FAILED, msg_uring_setup_failed);
+    }
+
+    // The kernel writes the sender address in front of each packet
+    uring->recv_msg.msg_namelen = sizeof(struct sockaddr_storage);
+
+    uring_arm_recv(uring, socket->socket_handle);
+    if(uring_submit(uring, 0) < 0)
+    {
+        uring_unmap(uring);
+        close(uring->ring_fd);
+        free(uring);
+        return make_err_result(UDP_SOCKET_ERR_PLATFORM_INIT_FAILED, msg_uring_setup_failed);
+    }
+
+    socket->uring = uring;
+    return make_success_result();
+}
+
+void udp_socket_uring_detach(UdpSocket* socket)
+{
+    UdpSocketUring* uring = socket->uring;
+    if(uring == NULL)
+    {
+        return;
+    }
+
+    // Queued sends still go out, then the receive is cancelled, because the
+    // kernel may write into the buffers until it has acknowledged the cancellation
+    uring_submit(uring, 0);
+
+    if(uring->recv_armed)
+    {
+        struct io_uring_sqe* sqe = uring_get_sqe(uring);
+        if(sqe)
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = recv_user_data;
+            sqe->user_data = cancel_user_data;
+            uring_submit(uring, 0);
+        }
+    }
+
+    for(int attempt = 0; attempt < 100; ++attempt)
+    {
+        uring_reap(uring);
+
+        bool busy = uring->recv_armed;
+        for(size_t i = 0; !busy && i < URING_SEND_SLOT_COUNT; ++i)
+        {
+            busy = uring->slots[i].in_flight;
+        }
+
+        if(!busy || uring_enter(uring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+        {
+            break;
+        }
+    }
+
+    uring_unmap(uring);
+    close(uring->ring_fd);
+    free(uring);
+
+    socket->uring = NULL;
+}
+
+UdpSocketResult udp_socket_uring_send_to(UdpSocket* socket, void* packet_data, size_t packet_data_len, UdpEndpoint* to)
+{
+    UdpSocketUring* uring = socket->uring;
+    assert(uring != NULL);
+    assert(packet_data_len <= UDP_SOCKET_URING_BUF_LEN);
+
+    UdpSocketUringSlot* slot = uring_take_slot(uring);
+    if(slot == NULL)
+    {
+        return make_err_result(UDP_SOCKET_ERR_WOULDBLOCK, msg_send_queue_full);
+    }
+
+    struct io_uring_sqe* sqe = uring_get_sqe(uring);
+    if(sqe == NULL)
+    {
+        // Submission queue is full of batched sends, make room
+        uring_submit(uring, 0);
+        sqe = uring_get_sqe(uring);
+        assert(sqe != NULL);
+    }
+
+    memcpy(slot->data, packet_data, packet_data_len);
+    slot->iov.iov_base = slot->data;
+    slot->iov.iov_len = packet_data_len;
+
+    memset(&slot->msg, 0, sizeof(slot->msg));
+    slot->msg.msg_iov = &slot->iov;
+    slot->msg.msg_iovlen = 1;
+    if(to)
+    {
+        memcpy(&slot->addr, &to->addr, to->addr_len);
+        slot->msg.msg_name = &slot->addr;
+        slot->msg.msg_namelen = to->addr_len;
+    }
+
+    slot->in_flight = true;
+    slot->result = 0;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = socket->socket_handle;
+    sqe->addr = (uint64_t) (uintptr_t) &slot->msg;
+    sqe->len = 1;
+    // Fail with EAGAIN rather than waiting for space in the socket buffer, like send does
+    sqe->msg_flags = MSG_DONTWAIT;
+    sqe->user_data = (uint64_t) (slot - uring->slots);
+
+    if(uring->batching)
+    {
+        return make_success_result();
+    }
+
+    if(uring_submit(uring, 0) < 0)
+    {
+        return make_send_err_result(errno);
+    }
+
+    // UDP sends complete during submission, so errors can be reported right away
+    uring_reap(uring);
+    if(!slot->in_flight && slot->result < 0)
+    {
+        return make_send_err_result(-slot->result);
+    }
+
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_uring_receive_from(UdpSocket* socket, void* packet_buffer, size_t packet_buffer_capacity, size_t* received_byte_count, UdpEndpoint* sender)
+{
+    UdpSocketUring* uring = socket->uring;
+    assert(uring != NULL);
+
+    if(received_byte_count)
+    {
+        *received_byte_count = 0;
+    }
+
+    uring_reap(uring);
+
+    if(uring->stash_len == 0 && !uring->recv_armed)
+    {
+        // The multishot receive ended, e.g. after running out of buffers, restart it
+        uring_arm_recv(uring, socket->socket_handle);
+        uring_submit(uring, 0);
+        uring_reap(uring);
+    }
+
+    while(uring->stash_len > 0)
+    {
+        UdpSocketUringCompletion completion = uring->stash[uring->stash_front];
+        uring->stash_front = (uring->stash_front + 1) % URING_STASH_CAPACITY;
+        --uring->stash_len;
+
+        if(completion.res < 0 || !(completion.flags & IORING_CQE_F_BUFFER))
+        {
+            if(completion.res < 0 && completion.res != -ENOBUFS && completion.res != -ECANCELED)
+            {
+                return make_receive_err_result(-completion.res);
+            }
+            // Running out of buffers is not an error, the receive is re-armed on the next call
+            continue;
+        }
+
+        uint16_t bid = (uint16_t) (completion.flags >> IORING_CQE_BUFFER_SHIFT);
+        uint8_t* buf = uring->recv_bufs + ((size_t) bid) * URING_RECV_BUF_LEN;
+
+        struct io_uring_recvmsg_out* out = (struct io_uring_recvmsg_out*) buf;
+        uint8_t* name = buf + sizeof(struct io_uring_recvmsg_out);
+        uint8_t* payload = name + uring->recv_msg.msg_namelen + uring->recv_msg.msg_controllen;
+        size_t payload_len = ((size_t) completion.res) - (size_t) (payload - buf);
+
+        if(out->flags & MSG_TRUNC)
+        {
+            // Only possible with payloads beyond what UDP carries, drop rather than hand out a part
+            uring_recycle_recv_buf(uring, bid);
+            continue;
+        }
+
+        if(payload_len > packet_buffer_capacity)
+        {
+            payload_len = packet_buffer_capacity;
+        }
+
+        memcpy(packet_buffer, payload, payload_len);
+
+        if(sender)
+        {
+            socklen_t name_len = out->namelen;
+            if(name_len > sizeof(sender->addr))
+            {
+                name_len = sizeof(sender->addr);
+            }
+            memset(&sender->addr, 0, sizeof(sender->addr));
+            memcpy(&sender->addr, name, name_len);
+            sender->addr_len = name_len;
+        }
+
+        if(received_byte_count)
+        {
+            *received_byte_count = payload_len;
+        }
+
+        uring_recycle_recv_buf(uring, bid);
+
+        return make_success_result();
+    }
+
+    return make_receive_err_result(EAGAIN);
+}
+
+void udp_socket_uring_set_batching(UdpSocket* socket, bool batching)
+{
+    socket->uring->batching = batching;
+    if(!batching)
+    {
+        udp_socket_uring_flush(socket);
+    }
+}
+
+UdpSocketResult udp_socket_uring_flush(UdpSocket* socket)
+{
+    UdpSocketUring* uring = socket->uring;
+
+    if(uring->sq_unsubmitted > 0 && uring_submit(uring, 0) < 0)
+    {
+        return make_send_err_result(errno);
+    }
+
+    uring_reap(uring);
+
+    return make_success_result();
+}
+
+int udp_socket_uring_poll_handle(UdpSocket* socket)
+{
+    return socket->uring->ring_fd;
+}
+
+static int uring_setup(unsigned entries, struct io_uring_params* params)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int ring_fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+    return (int) syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static bool uring_map_rings(UdpSocketUring* uring, struct io_uring_params* params)
+{
+    // Multishot receive with provided buffers needs a kernel from the last few years
+    if(!(params->features & IORING_FEAT_SINGLE_MMAP) || !(params->features & IORING_FEAT_NODROP))
+    {
+        return false;
+    }
+
+    size_t sq_len = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    size_t cq_len = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    uring->rings_len = (sq_len > cq_len) ? sq_len : cq_len;
+
+    uring->rings = mmap(NULL, uring->rings_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING);
+    if(uring->rings == MAP_FAILED)
+    {
+        uring->rings = NULL;
+        return false;
+    }
+
+    uring->sqes_len = params->sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = (struct io_uring_sqe*) mmap(NULL, uring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQES);
+    if(uring->sqes == MAP_FAILED)
+    {
+        uring->sqes = NULL;
+        return false;
+    }
+
+    uint8_t* rings = (uint8_t*) uring->rings;
+    uring->sq_head = (unsigned*) (rings + params->sq_off.head);
+    uring->sq_tail = (unsigned*) (rings + params->sq_off.tail);
+    uring->sq_array = (unsigned*) (rings + params->sq_off.array);
+    uring->sq_mask = *(unsigned*) (rings + params->sq_off.ring_mask);
+    uring->sq_entries = params->sq_entries;
+
+    uring->cq_head = (unsigned*) (rings + params->cq_off.head);
+    uring->cq_tail = (unsigned*) (rings + params->cq_off.tail);
+    uring->cq_mask = *(unsigned*) (rings + params->cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe*) (rings + params->cq_off.cqes);
+
+    return true;
+}
+
+static bool uring_register_recv_bufs(UdpSocketUring* uring)
+{
+    // The buffer ring must be page-aligned, which anonymous mappings are
+    uring->buf_ring_len = URING_RECV_BUF_COUNT * sizeof(struct io_uring_buf);
+    void* buf_ring = mmap(NULL, uring->buf_ring_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(buf_ring == MAP_FAILED)
+    {
+        return false;
+    }
+    uring->buf_ring = (struct io_uring_buf_ring*) buf_ring;
+
+    uring->recv_bufs = (uint8_t*) malloc(URING_RECV_BUF_COUNT * URING_RECV_BUF_LEN);
+    if(uring->recv_bufs == NULL)
+    {
+        return false;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) buf_ring;
+    reg.ring_entries = URING_RECV_BUF_COUNT;
+    reg.bgid = recv_buf_group;
+
+    if(uring_register(uring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+    {
+        return false;
+    }
+
+    for(uint16_t bid = 0; bid < URING_RECV_BUF_COUNT; ++bid)
+    {
+        uring_recycle_recv_buf(uring, bid);
+    }
+
+    return true;
+}
+
+static void uring_unmap(UdpSocketUring* uring)
+{
+    if(uring->rings)
+    {
+        munmap(uring->rings, uring->rings_len);
+    }
+
+    if(uring->sqes)
+    {
+        munmap(uring->sqes, uring->sqes_len);
+    }
+
+    if(uring->buf_ring)
+    {
+        munmap(uring->buf_ring, uring->buf_ring_len);
+    }
+
+    free(uring->recv_bufs);
+}
+
+static struct io_uring_sqe* uring_get_sqe(UdpSocketUring* uring)
+{
+    unsigned head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *uring->sq_tail;
+
+    if(tail - head >= uring->sq_entries)
+    {
+        return NULL;
+    }
+
+    unsigned idx = tail & uring->sq_mask;
+    struct io_uring_sqe* sqe = &uring->sqes[idx];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+    uring->sq_array[idx] = idx;
+    __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++uring->sq_unsubmitted;
+
+    return sqe;
+}
+
+static int uring_submit(UdpSocketUring* uring, unsigned min_complete)
+{
+    unsigned flags = (min_complete > 0) ? IORING_ENTER_GETEVENTS : 0;
+    int submitted = uring_enter(uring->ring_fd, uring->sq_unsubmitted, min_complete, flags);
+    if(submitted >= 0)
+    {
+        uring->sq_unsubmitted -= (unsigned) submitted;
+    }
+    return submitted;
+}
+
+static void uring_arm_recv(UdpSocketUring* uring, int socket_handle)
+{
+    struct io_uring_sqe* sqe = uring_get_sqe(uring);
+    if(sqe == NULL)
+    {
+        return;
+    }
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socket_handle;
+    sqe->addr = (uint64_t) (uintptr_t) &uring->recv_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = recv_buf_group;
+    sqe->user_data = recv_user_data;
+
+    uring->recv_armed = true;
+}
+
+/**
+ * Consumes all available completions. Completed sends free their slot, received
+ * packets are stashed until receive_from hands them out.
+ */
+static void uring_reap(UdpSocketUring* uring)
+{
+    unsigned head = *uring->cq_head;
+    unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+    for(; head != tail; ++head)
+    {
+        struct io_uring_cqe* cqe = &uring->cqes[head & uring->cq_mask];
+
+        if(cqe->user_data == recv_user_data)
+        {
+            if(!(cqe->flags & IORING_CQE_F_MORE))
+            {
+                uring->recv_armed = false;
+            }
+
+            if(uring->stash_len < URING_STASH_CAPACITY)
+            {
+                size_t back = (uring->stash_front + uring->stash_len) % URING_STASH_CAPACITY;
+                uring->stash[back].res = cqe->res;
+                uring->stash[back].flags = cqe->flags;
+                ++uring->stash_len;
+            }
+            else if(cqe->flags & IORING_CQE_F_BUFFER)
+            {
+                // Cannot happen with one completion per buffer, but never leak a buffer
+                uring_recycle_recv_buf(uring, (uint16_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+        }
+        else if(cqe->user_data < URING_SEND_SLOT_COUNT)
+        {
+            UdpSocketUringSlot* slot = &uring->slots[cqe->user_data];
+            slot->in_flight = false;
+            slot->result = cqe->res;
+        }
+    }
+
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void uring_recycle_recv_buf(UdpSocketUring* uring, uint16_t bid)
+{
+    // Not using the bufs member, its flexible array is declared in a way that shifts it in C++
+    struct io_uring_buf* bufs = (struct io_uring_buf*) uring->buf_ring;
+    struct io_uring_buf* buf = &bufs[uring->buf_ring_tail & (URING_RECV_BUF_COUNT - 1)];
+    buf->addr = (uint64_t) (uintptr_t) (uring->recv_bufs + ((size_t) bid) * URING_RECV_BUF_LEN);
+    buf->len = URING_RECV_BUF_LEN;
+    buf->bid = bid;
+
+    ++uring->buf_ring_tail;
+    __atomic_store_n(&uring->buf_ring->tail, uring->buf_ring_tail, __ATOMIC_RELEASE);
+}
+
+static UdpSocketUringSlot* uring_take_slot(UdpSocketUring* uring)
+{
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(size_t i = 0; i < URING_SEND_SLOT_COUNT; ++i)
+        {
+            if(!uring->slots[i].in_flight)
+            {
+                return &uring->slots[i];
+            }
+        }
+
+        // All slots busy, push out what is queued and collect completions
+        uring_submit(uring, 0);
+        uring_reap(uring);
+    }
+
+    return NULL;
+}
+
+#endif // UDP_SOCKET_URING
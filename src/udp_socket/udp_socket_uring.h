@@ -0,0 +1,47 @@
+#ifndef UDP_SOCKET_URING_H
+#define UDP_SOCKET_URING_H
+
+#include "udp_socket.h"
+
+#ifdef UDP_SOCKET_URING
+
+#ifndef UDP_SOCKET_URING_BUF_LEN
+/**
+ * Size of each preallocated send slot. Larger packets are sent with the BSD
+ * functions instead.
+ */
+#define UDP_SOCKET_URING_BUF_LEN 2048
+#endif
+
+/**
+ * Sets up submission and completion rings for the already bound socket and
+ * starts a multishot receive into a ring of registered buffers.
+ *
+ * On failure, socket->uring is left NULL and the socket keeps working with the
+ * BSD backend.
+ */
+UdpSocketResult udp_socket_uring_attach(UdpSocket* socket);
+
+/**
+ * Cancels outstanding operations and frees the rings and buffers, but does not
+ * close the socket.
+ */
+void udp_socket_uring_detach(UdpSocket* socket);
+
+UdpSocketResult udp_socket_uring_send_to(UdpSocket* socket, void* packet_data, size_t packet_data_len, UdpEndpoint* to);
+
+UdpSocketResult udp_socket_uring_receive_from(UdpSocket* socket, void* packet_buffer, size_t packet_buffer_capacity, size_t* received_byte_count, UdpEndpoint* sender);
+
+void udp_socket_uring_set_batching(UdpSocket* socket, bool batching);
+
+UdpSocketResult udp_socket_uring_flush(UdpSocket* socket);
+
+/**
+ * Gets the descriptor of the rings, which is readable while completions are
+ * waiting to be reaped.
+ */
+int udp_socket_uring_poll_handle(UdpSocket* socket);
+
+#endif // UDP_SOCKET_URING
+
+#endif // UDP_SOCKET_URING_H
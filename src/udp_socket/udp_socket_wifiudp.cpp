@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include <WifiUdp.h>
+#include <ESP8266WiFi.h>
 #include "../test/assert.h"
 #include "udp_socket_results_internal.h"
 #include "udp_socket_messages.h"
@@ -10,6 +11,10 @@ static WiFiUDP Udp;
 static bool has_receiver;
 static uint16_t receiver_port;
 static IPAddress receiver;
+static uint16_t local_port;
+static int multicast_ttl = 1;
+
+static const char* msg_options_failed = "Socket options are not supported";
 
 UdpSocketResult udp_socket_init_on_port(UdpSocket* socket, unsigned short port)
 {
@@ -25,12 +30,22 @@ UdpSocketResult udp_socket_init_on_port(UdpSocket* socket, unsigned short port)
     memset(socket, 0, sizeof(UdpSocket));
 
     Udp.begin(port);
+    local_port = port;
     receiver_port = 0;
     has_receiver = false;
 
     return make_success_result();
 }
 
+UdpSocketResult udp_socket_init_shared(UdpSocket* socket, unsigned short port)
+{
+    // WiFiUDP has a single socket per port
+    return make_err_result(
+        UDP_SOCKET_ERR_SHARE_PORT_FAILED,
+        msg_share_port_failed
+    );
+}
+
 UdpSocketResult udp_socket_free(UdpSocket* socket)
 {
     if(socket == NULL)
@@ -106,7 +121,11 @@ UdpSocketResult udp_socket_send_to(UdpSocket* socket, void* packet_data, size_t
 
     if(to == NULL)
     {
-        if(has_receiver)
+        if(has_receiver && receiver[0] >= 224 && receiver[0] <= 239)
+        {
+            Udp.beginPacketMulticast(receiver, receiver_port, WiFi.localIP(), multicast_ttl);
+        }
+        else if(has_receiver)
         {
             Udp.beginPacket(receiver, receiver_port);
         }
@@ -118,6 +137,10 @@ UdpSocketResult udp_socket_send_to(UdpSocket* socket, void* packet_data, size_t
             );
         }
     }
+    else if(udp_endpoint_is_multicast(to))
+    {
+        Udp.beginPacketMulticast(to->address, to->port, WiFi.localIP(), multicast_ttl);
+    }
     else
     {
         Udp.beginPacket(to->address, to->port);
@@ -168,4 +191,147 @@ bool udp_endpoint_equal(UdpEndpoint* a, UdpEndpoint* b)
     return a->address == b->address && a->port == b->port;
 }
 
+void udp_endpoint_key(UdpEndpoint* endpoint, UdpEndpointKey* key)
+{
+    memset(key, 0, sizeof(UdpEndpointKey));
+    key->addr[0] = (uint32_t) endpoint->address;
+    key->port = (uint16_t) endpoint->port;
+}
+
+bool udp_endpoint_key_equal(const UdpEndpointKey* a, const UdpEndpointKey* b)
+{
+    return a->port == b->port && a->addr[0] == b->addr[0];
+}
+
+UdpSocketResult udp_endpoint_resolve(UdpEndpoint* endpoint, const char* hostname, unsigned short port)
+{
+    if(!WiFi.hostByName(hostname, endpoint->address))
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_RESOLVE_HOSTNAME_FAILED,
+            "The hostname could not be resolved"
+        );
+    }
+
+    endpoint->port = port;
+    return make_success_result();
+}
+
+void udp_endpoint_set_port(UdpEndpoint* endpoint, unsigned short port)
+{
+    endpoint->port = port;
+}
+
+bool udp_endpoint_address(UdpEndpoint* endpoint, char* buf, size_t buf_capacity)
+{
+    String address = endpoint->address.toString();
+    if(address.length() >= buf_capacity)
+    {
+        return false;
+    }
+
+    strcpy(buf, address.c_str());
+    return true;
+}
+
+bool udp_endpoint_is_multicast(UdpEndpoint* endpoint)
+{
+    return endpoint->address[0] >= 224 && endpoint->address[0] <= 239;
+}
+
+UdpSocketResult udp_socket_join_multicast(UdpSocket* socket, const char* group)
+{
+    IPAddress group_address;
+    if(!group_address.fromString(group) || group_address[0] < 224 || group_address[0] > 239)
+    {
+        return make_err_result(
+            UDP_SOCKET_ERR_NOT_MULTICAST,
+            msg_not_multicast
+        );
+    }
+
+    // WiFiUDP listens either on the port or on the group and port, restart it
+    Udp.stop();
+    if(!Udp.beginMulticast(WiFi.localIP(), group_address, local_port))
+    {
+        Udp.begin(local_port);
+        return make_err_result(
+            UDP_SOCKET_ERR_MULTICAST_FAILED,
+            "Joining the multicast group failed"
+        );
+    }
+
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_leave_multicast(UdpSocket* socket, const char* group)
+{
+    Udp.stop();
+    Udp.begin(local_port);
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_set_broadcast(UdpSocket* socket, bool broadcast)
+{
+    // lwIP sends to broadcast addresses without asking for permission
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_set_multicast_ttl(UdpSocket* socket, unsigned char ttl)
+{
+    multicast_ttl = ttl;
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_set_multicast_loopback(UdpSocket* socket, bool loopback)
+{
+    // There is only one socket, so there is nobody on this host to loop back to
+    return make_success_result();
+}
+
+UdpSocketResult udp_socket_set_options(UdpSocket* socket, const UdpSocketOptions* options)
+{
+    if(options->recv_buf_len == 0 && options->send_buf_len == 0 &&
+       options->busy_poll_us == 0 && options->dscp == 0 && options->priority == 0)
+    {
+        return make_success_result();
+    }
+
+    return make_err_result(
+        UDP_SOCKET_ERR_OPTIONS_FAILED,
+        msg_options_failed
+    );
+}
+
+void udp_socket_get_options(UdpSocket* socket, UdpSocketOptions* effective)
+{
+    memset(effective, 0, sizeof(UdpSocketOptions));
+}
+
+bool udp_socket_select_backend(UdpSocketBackend backend)
+{
+    return backend == UDP_SOCKET_BACKEND_BSD;
+}
+
+UdpSocketBackend udp_socket_backend(UdpSocket* socket)
+{
+    return UDP_SOCKET_BACKEND_BSD;
+}
+
+void udp_socket_set_batching(UdpSocket* socket, bool batching)
+{
+    // WiFiUDP sends immediately
+}
+
+int udp_socket_poll_handle(UdpSocket* socket)
+{
+    // WiFiUDP has no descriptors
+    return -1;
+}
+
+UdpSocketResult udp_socket_flush(UdpSocket* socket)
+{
+    return make_success_result();
+}
+
 #endif
@@ -0,0 +1,164 @@
+#include "atolla/atolla.hpp"
+#include "time/sleep.h"
+
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+static const int port = 10011;
+static const int frame_duration_ms = 30;
+static const int loopback_send_time_ms = 5;
+
+static_assert(!std::is_copy_constructible<atolla::Sink>::value, "Sinks must not be copyable");
+static_assert(!std::is_copy_assignable<atolla::Sink>::value, "Sinks must not be copyable");
+static_assert(std::is_nothrow_move_constructible<atolla::Sink>::value, "Sinks must be movable");
+static_assert(!std::is_copy_constructible<atolla::Source>::value, "Sources must not be copyable");
+static_assert(std::is_nothrow_move_assignable<atolla::Source>::value, "Sources must be movable");
+static_assert(sizeof(atolla::Sink) == sizeof(AtollaSink), "Wrapper must not add state");
+static_assert(sizeof(atolla::Source) == sizeof(AtollaSource), "Wrapper must not add state");
+static_assert(!std::is_move_constructible<atolla::StaticSink<2, 16>>::value, "Static sinks point into themselves");
+static_assert(atolla::StaticSink<2, 16>::frame_size == 6, "Frame size is known at compile time");
+static_assert(atolla::PixelFormat<atolla::Rgb>::is_pixel, "Rgb is a pixel format");
+static_assert(!atolla::PixelFormat<int>::is_pixel, "int is not a pixel format");
+
+static AtollaSourceSpec make_source_spec()
+{
+    AtollaSourceSpec spec;
+    spec.sink_hostname = "localhost";
+    spec.sink_port = port;
+    spec.frame_duration_ms = frame_duration_ms;
+    spec.max_buffered_frames = 0;
+    spec.retry_timeout_ms = 0;
+    spec.disconnect_timeout_ms = 0;
+    spec.async_make = true;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.multicast_ttl = 0;
+    spec.priority = 0;
+    spec.opacity = 0;
+    spec.pacing_spin_us = 0;
+    spec.retransmit_frames = 0;
+    spec.socket_options = NULL;
+    return spec;
+}
+
+/**
+ * Lets the sink handle requests until the source borrowed it, the source
+ * resolves the hostname of the sink in the background first.
+ */
+template<typename Sink>
+static AtollaSinkState await_lent(Sink& sink)
+{
+    AtollaSinkState state = sink.state();
+    for(int attempt = 0; state != ATOLLA_SINK_STATE_LENT && attempt < 20; ++attempt)
+    {
+        time_sleep(loopback_send_time_ms);
+        state = sink.state();
+    }
+    return state;
+}
+
+static void test_move(void **state)
+{
+    atolla::Sink sink(port, 1);
+    assert_true((bool) sink);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, sink.state());
+
+    void* internal = sink.handle().internal;
+    atolla::Sink moved(std::move(sink));
+    assert_false((bool) sink);
+    assert_true((bool) moved);
+    assert_ptr_equal(internal, moved.handle().internal);
+
+    sink = std::move(moved);
+    assert_ptr_equal(internal, sink.handle().internal);
+
+    AtollaSink released = sink.release();
+    assert_false((bool) sink);
+    atolla_sink_free(released);
+}
+
+static void test_stream_pixels(void **state)
+{
+    atolla::Sink sink(port, 2);
+    atolla::Source source(make_source_spec());
+
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, await_lent(sink));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, source.state());
+
+    const atolla::Rgb sent[2] = { { 1, 2, 3 }, { 4, 5, 6 } };
+#ifdef ATOLLA_HPP_SPAN
+    std::array<atolla::Rgb, 2> sent_array = { sent[0], sent[1] };
+    assert_true(source.put(sent_array));
+#else
+    assert_true(source.put(sent, 2));
+#endif
+    time_sleep(loopback_send_time_ms);
+
+    // With presentation times, the frame is due up to three frame durations after it was put
+    atolla::Rgb received[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+    bool got = false;
+    for(int attempt = 0; !got && attempt < 40; ++attempt)
+    {
+        sink.state();
+#ifdef ATOLLA_HPP_SPAN
+        got = sink.get(std::span<atolla::Rgb>(received));
+#else
+        got = sink.get(received, 2);
+#endif
+        if(!got) {
+            time_sleep(loopback_send_time_ms);
+        }
+    }
+
+    assert_true(got);
+    assert_memory_equal(sent, received, sizeof(sent));
+}
+
+static void test_static_sink(void **state)
+{
+    // Sources buffer 16 frames by default, which the sink has to allow
+    atolla::StaticSink<2, 16> sink(port);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, sink.state());
+
+    atolla::Source source(make_source_spec());
+
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, await_lent(sink));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, source.state());
+
+    const atolla::Rgb sent[2] = { { 7, 8, 9 }, { 10, 11, 12 } };
+    assert_true(source.put(sent, 2));
+    time_sleep(loopback_send_time_ms);
+
+    std::array<atolla::Rgb, 2> received = { { { 0, 0, 0 }, { 0, 0, 0 } } };
+    bool got = false;
+    for(int attempt = 0; !got && attempt < 40; ++attempt)
+    {
+        sink.state();
+        got = sink.get(received);
+        if(!got) {
+            time_sleep(loopback_send_time_ms);
+        }
+    }
+
+    assert_true(got);
+    assert_memory_equal(sent, received.data(), sizeof(sent));
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_move),
+        cmocka_unit_test(test_static_sink),
+        cmocka_unit_test(test_stream_pixels)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
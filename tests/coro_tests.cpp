@@ -0,0 +1,164 @@
+#include "atolla/coro.hpp"
+
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include <array>
+#include <chrono>
+
+#include <unistd.h>
+
+static const int port = 10021;
+static const int frame_duration_ms = 20;
+
+using Clock = std::chrono::steady_clock;
+
+static long long ms_since(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+static atolla::Task<int> add_later(atolla::Executor& executor, int a, int b)
+{
+    co_await executor.wait(-1, 5);
+    co_return a + b;
+}
+
+static atolla::Task<void> sum(atolla::Executor& executor, int* result)
+{
+    int first = co_await add_later(executor, 1, 2);
+    *result = co_await add_later(executor, first, 3);
+}
+
+static void test_nested_tasks(void **state)
+{
+    atolla::Executor executor;
+    assert_true((bool) executor);
+
+    int result = 0;
+    executor.spawn(sum(executor, &result));
+    executor.run();
+
+    assert_int_equal(6, result);
+}
+
+static atolla::Task<void> sleep_for(atolla::Executor& executor, int timeout_ms, bool* timed_out)
+{
+    *timed_out = co_await executor.wait(-1, timeout_ms);
+}
+
+static atolla::Task<void> read_pipe(atolla::Executor& executor, int fd, bool* timed_out)
+{
+    *timed_out = co_await executor.wait(fd, 1000);
+}
+
+static atolla::Task<void> write_pipe_later(atolla::Executor& executor, int fd)
+{
+    co_await executor.wait(-1, 10);
+    char byte = 42;
+    assert_int_equal(1, write(fd, &byte, 1));
+}
+
+static void test_wait(void **state)
+{
+    atolla::Executor executor;
+
+    // Timeouts of several tasks pass while the thread waits for all of them
+    bool short_timed_out = false;
+    bool long_timed_out = false;
+    Clock::time_point start = Clock::now();
+    executor.spawn(sleep_for(executor, 40, &long_timed_out));
+    executor.spawn(sleep_for(executor, 20, &short_timed_out));
+    executor.run();
+
+    assert_true(short_timed_out);
+    assert_true(long_timed_out);
+    assert_in_range(ms_since(start), 40, 200);
+
+    // Readable descriptors resume before the timeout
+    int fds[2];
+    assert_int_equal(0, pipe(fds));
+
+    bool pipe_timed_out = true;
+    start = Clock::now();
+    executor.spawn(read_pipe(executor, fds[0], &pipe_timed_out));
+    executor.spawn(write_pipe_later(executor, fds[1]));
+    executor.run();
+
+    assert_false(pipe_timed_out);
+    assert_in_range(ms_since(start), 10, 500);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static atolla::Task<void> stream_red(atolla::Executor& executor, const bool* received, bool* connected)
+{
+    AtollaSourceSpec spec;
+    spec.sink_hostname = "localhost";
+    spec.sink_port = port;
+    spec.frame_duration_ms = frame_duration_ms;
+    spec.max_buffered_frames = 2;
+    spec.retry_timeout_ms = 0;
+    spec.disconnect_timeout_ms = 0;
+    spec.async_make = false;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.multicast_ttl = 0;
+    spec.priority = 0;
+    spec.opacity = 0;
+    spec.pacing_spin_us = 0;
+    spec.retransmit_frames = 0;
+    spec.socket_options = NULL;
+
+    atolla::AsyncSource source(executor, spec);
+    *connected = co_await source.connected();
+
+    const std::array<atolla::Rgb, 2> frame = {{ { 255, 0, 0 }, { 255, 0, 0 } }};
+    while(!*received && co_await source.put(frame))
+    {
+    }
+}
+
+static atolla::Task<void> await_red(atolla::Executor& executor, atolla::AsyncSink& sink, bool* received, int* frames_count)
+{
+    std::array<atolla::Rgb, 2> frame;
+    while(!*received && co_await sink.next_frame(frame))
+    {
+        ++*frames_count;
+        *received = frame[0].r == 255 && frame[1].r == 255;
+    }
+}
+
+static void test_source_to_sink(void **state)
+{
+    atolla::Executor executor;
+    atolla::AsyncSink sink(executor, atolla::Sink(port, 2));
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, sink.get().state());
+
+    bool connected = false;
+    bool received = false;
+    int frames_count = 0;
+    Clock::time_point start = Clock::now();
+    executor.spawn(await_red(executor, sink, &received, &frames_count));
+    executor.spawn(stream_red(executor, &received, &connected));
+    executor.run();
+
+    assert_true(connected);
+    assert_true(received);
+    assert_in_range(frames_count, 1, 10);
+    assert_in_range(ms_since(start), 0, 1000);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_nested_tasks),
+        cmocka_unit_test(test_wait),
+        cmocka_unit_test(test_source_to_sink)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
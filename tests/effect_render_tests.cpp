@@ -0,0 +1,121 @@
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include "effect/render.h"
+
+#include <string.h>
+
+static void test_solid_and_gradient(void **state)
+{
+    uint8_t weights[5] = { 9, 9, 9, 9, 9 };
+
+    effect_render_weights(ATOLLA_EFFECT_SOLID, weights, 5, 0, 0, 1234);
+    const uint8_t expected_solid[] = { 0, 0, 0, 0, 0 };
+    assert_memory_equal(expected_solid, weights, sizeof(weights));
+
+    // From the first light to the last, regardless of time
+    effect_render_weights(ATOLLA_EFFECT_GRADIENT, weights, 5, 0, 1000, 1234);
+    const uint8_t expected_gradient[] = { 0, 64, 128, 191, 255 };
+    assert_memory_equal(expected_gradient, weights, sizeof(weights));
+
+    effect_render_weights(ATOLLA_EFFECT_GRADIENT, weights, 1, 0, 0, 0);
+    assert_int_equal(0, weights[0]);
+}
+
+static void test_sine(void **state)
+{
+    uint8_t weights[8];
+
+    // Four lights per wave, starting in the middle
+    effect_render_weights(ATOLLA_EFFECT_SINE, weights, 8, 4, 0, 0);
+    const uint8_t expected[] = { 128, 255, 128, 0, 128, 255, 128, 0 };
+    assert_memory_equal(expected, weights, sizeof(weights));
+
+    // A quarter period later, the wave moved one light towards the end
+    effect_render_weights(ATOLLA_EFFECT_SINE, weights, 8, 4, 1000, 250);
+    const uint8_t moved[] = { 0, 128, 255, 128, 0, 128, 255, 128 };
+    assert_memory_equal(moved, weights, sizeof(weights));
+
+    // A whole period later, it is back where it started
+    effect_render_weights(ATOLLA_EFFECT_SINE, weights, 8, 4, 1000, 3000);
+    assert_memory_equal(expected, weights, sizeof(weights));
+}
+
+static void test_noise(void **state)
+{
+    uint8_t start[64];
+    uint8_t again[64];
+    uint8_t next[64];
+
+    effect_render_weights(ATOLLA_EFFECT_NOISE, start, 64, 0, 100, 0);
+    effect_render_weights(ATOLLA_EFFECT_NOISE, again, 64, 0, 100, 0);
+    effect_render_weights(ATOLLA_EFFECT_NOISE, next, 64, 0, 100, 100);
+
+    // The same for the same time, different for the next period, and not flat
+    assert_memory_equal(start, again, sizeof(start));
+    assert_true(memcmp(start, next, sizeof(start)) != 0);
+
+    bool varies = false;
+    for(int i = 1; i < 64; ++i)
+    {
+        varies = varies || start[i] != start[0];
+    }
+    assert_true(varies);
+
+    // Halfway through a period, lights are between both periods
+    uint8_t half[64];
+    effect_render_weights(ATOLLA_EFFECT_NOISE, half, 64, 0, 100, 50);
+    for(int i = 0; i < 64; ++i)
+    {
+        int low = (start[i] < next[i]) ? start[i] : next[i];
+        int high = (start[i] < next[i]) ? next[i] : start[i];
+        assert_in_range(half[i], low, high);
+    }
+}
+
+static void test_mix_u8(void **state)
+{
+    const uint8_t weights[] = { 0, 255, 128 };
+    const uint8_t from[] = { 0, 100, 255 };
+    const uint8_t to[] = { 255, 200, 0 };
+    uint8_t target[9];
+
+    effect_mix_u8(target, weights, 3, from, to, 3);
+    const uint8_t expected[] = {
+        0, 100, 255,
+        255, 200, 0,
+        128, 150, 127
+    };
+    assert_memory_equal(expected, target, sizeof(expected));
+}
+
+static void test_mix_u16le(void **state)
+{
+    const uint8_t weights[] = { 0, 255 };
+    const uint8_t from[] = { 0x00, 0x00,  0xFF, 0xFF };
+    const uint8_t to[] = { 0x34, 0x12,  0x00, 0x00 };
+    uint8_t target[8];
+
+    effect_mix_u16le(target, weights, 2, from, to, 2);
+    const uint8_t expected[] = {
+        0x00, 0x00,  0xFF, 0xFF,
+        0x34, 0x12,  0x00, 0x00
+    };
+    assert_memory_equal(expected, target, sizeof(expected));
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_solid_and_gradient),
+        cmocka_unit_test(test_sine),
+        cmocka_unit_test(test_noise),
+        cmocka_unit_test(test_mix_u8),
+        cmocka_unit_test(test_mix_u16le)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,49 @@
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include "mem/arena.h"
+
+static void test_alloc_aligned(void **state)
+{
+    uint8_t buf[128];
+    // Start off an unaligned address, the arena has to pad
+    MemArena arena = mem_arena_make(buf + 1, sizeof(buf) - 1);
+
+    void* first = mem_arena_alloc(&arena, 3);
+    void* second = mem_arena_alloc(&arena, 5);
+    assert_non_null(first);
+    assert_non_null(second);
+    assert_true(((uintptr_t) first) % MEM_ARENA_ALIGN == 0);
+    assert_true(((uintptr_t) second) % MEM_ARENA_ALIGN == 0);
+    assert_true((uint8_t*) second >= ((uint8_t*) first) + 3);
+    assert_true(arena.used <= MEM_ARENA_ALIGN + MEM_ARENA_SIZE(3) + 5);
+}
+
+static void test_alloc_exhausted(void **state)
+{
+    uint8_t buf[64];
+    MemArena arena = mem_arena_make(buf, sizeof(buf));
+
+    // Whatever the alignment of buf, 16 bytes always fit twice
+    assert_non_null(mem_arena_alloc(&arena, 16));
+    assert_non_null(mem_arena_alloc(&arena, 16));
+    assert_null(mem_arena_alloc(&arena, 64));
+
+    // A failed allocation leaves the arena as it was
+    size_t used = arena.used;
+    assert_null(mem_arena_alloc(&arena, sizeof(buf)));
+    assert_int_equal(used, arena.used);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_alloc_aligned),
+        cmocka_unit_test(test_alloc_exhausted)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
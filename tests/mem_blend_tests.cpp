@@ -0,0 +1,90 @@
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include "mem/blend.h"
+
+static void test_max_u8(void **state)
+{
+    uint8_t target[] = { 0, 100, 255, 7, 42 };
+    const uint8_t source[] = { 10, 50, 0, 7, 43 };
+    const uint8_t expected[] = { 10, 100, 255, 7, 43 };
+
+    mem_blend_max_u8(target, source, sizeof(target));
+    assert_memory_equal(expected, target, sizeof(expected));
+}
+
+static void test_max_u16le(void **state)
+{
+    // 0x0100 is larger than 0x00FF, although its low byte is smaller
+    uint8_t target[] = { 0xFF, 0x00,  0x34, 0x12 };
+    const uint8_t source[] = { 0x00, 0x01,  0x33, 0x12 };
+    const uint8_t expected[] = { 0x00, 0x01,  0x34, 0x12 };
+
+    mem_blend_max_u16le(target, source, sizeof(target));
+    assert_memory_equal(expected, target, sizeof(expected));
+}
+
+static void test_alpha_u8(void **state)
+{
+    const uint8_t source[] = { 255, 0, 200, 13 };
+
+    // Fully opaque replaces, fully transparent keeps
+    uint8_t target[] = { 0, 255, 100, 13 };
+    mem_blend_alpha_u8(target, source, sizeof(target), 255);
+    assert_memory_equal(source, target, sizeof(target));
+
+    uint8_t kept[] = { 0, 255, 100, 13 };
+    const uint8_t original[] = { 0, 255, 100, 13 };
+    mem_blend_alpha_u8(kept, source, sizeof(kept), 0);
+    assert_memory_equal(original, kept, sizeof(kept));
+
+    // Half opacity lands in the middle, rounded to nearest
+    uint8_t half[] = { 0, 255, 100, 13 };
+    const uint8_t expected_half[] = { 128, 127, 150, 13 };
+    mem_blend_alpha_u8(half, source, sizeof(half), 128);
+    assert_memory_equal(expected_half, half, sizeof(half));
+
+    // Compare against the straightforward division for all combinations
+    for(int alpha = 0; alpha < 256; alpha += 5)
+    {
+        for(int t = 0; t < 256; ++t)
+        {
+            uint8_t target_channel = (uint8_t) t;
+            uint8_t source_channel = (uint8_t) (255 - t);
+            mem_blend_alpha_u8(&target_channel, &source_channel, 1, (uint8_t) alpha);
+
+            int expected = ((255 - t) * alpha + t * (255 - alpha) + 127) / 255;
+            assert_int_equal(expected, target_channel);
+        }
+    }
+}
+
+static void test_alpha_u16le(void **state)
+{
+    const uint8_t source[] = { 0xFF, 0xFF,  0x00, 0x00 };
+
+    uint8_t target[] = { 0x00, 0x00,  0xFF, 0xFF };
+    mem_blend_alpha_u16le(target, source, sizeof(target), 255);
+    assert_memory_equal(source, target, sizeof(target));
+
+    // 65535 * 51 / 255 = 13107 = 0x3333
+    uint8_t fifth[] = { 0x00, 0x00,  0xFF, 0xFF };
+    const uint8_t expected_fifth[] = { 0x33, 0x33,  0xCC, 0xCC };
+    mem_blend_alpha_u16le(fifth, source, sizeof(fifth), 51);
+    assert_memory_equal(expected_fifth, fifth, sizeof(fifth));
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_max_u8),
+        cmocka_unit_test(test_max_u16le),
+        cmocka_unit_test(test_alpha_u8),
+        cmocka_unit_test(test_alpha_u16le)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
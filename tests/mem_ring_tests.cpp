@@ -14,6 +14,8 @@ static void test_peek_and_enqueue(void **state)
 
     MemRing ring = mem_ring_alloc(sizeof(num) * 10);
 
+    assert_true(mem_ring_is_empty(&ring));
+
     // Test peeking without anything enqueued
     void* peek_addr = 0;
     bool ok = mem_ring_peek(&ring, &peek_addr, sizeof(num));
@@ -28,6 +30,7 @@ static void test_peek_and_enqueue(void **state)
 
     // Enqueue 10
     mem_ring_enqueue(&ring, &num, sizeof(num));
+    assert_false(mem_ring_is_empty(&ring));
 
     // Peeking 10 should work
     ok = mem_ring_peek(&ring, &peek_addr, sizeof(num));
@@ -42,6 +45,7 @@ static void test_peek_and_enqueue(void **state)
     assert_int_equal(num, dequeued);
 
     // But not on an empty ring
+    assert_true(mem_ring_is_empty(&ring));
     dequeued = 42;
     ok = mem_ring_dequeue(&ring, &dequeued, sizeof(dequeued));
     assert_false(ok);
@@ -136,12 +140,50 @@ static void test_wrapping(void **state)
     mem_ring_free(&ring);
 }
 
+static void test_overwrite(void **state)
+{
+    const int units = 4;
+    MemRing ring = mem_ring_alloc(sizeof(int) * units);
+
+    // Wrap the queued data over the highest index
+    for(int i = 0; i < 3; ++i) {
+        mem_ring_enqueue(&ring, &i, sizeof(int));
+    }
+    mem_ring_drop(&ring, 2 * sizeof(int));
+    for(int i = 3; i < 6; ++i) {
+        mem_ring_enqueue(&ring, &i, sizeof(int));
+    }
+
+    // Queued are 2, 3, 4 and 5, with 4 and 5 wrapped to the start
+    int replacement = 40;
+    assert_true(mem_ring_overwrite(&ring, 2 * sizeof(int), &replacement, sizeof(int)));
+
+    // Past the queued data, nothing is written
+    assert_false(mem_ring_overwrite(&ring, 4 * sizeof(int), &replacement, sizeof(int)));
+
+    // The newest number sits right after the wrapped 4
+    void* back_addr = NULL;
+    assert_true(mem_ring_peek_back(&ring, &back_addr, sizeof(int)));
+    assert_ptr_equal(((int*) ring.buf.data) + 1, back_addr);
+    assert_int_equal(5, *((int*) back_addr));
+
+    const int expected[] = { 2, 3, 40, 5 };
+    for(int i = 0; i < units; ++i) {
+        int num = -1;
+        assert_true(mem_ring_dequeue(&ring, &num, sizeof(int)));
+        assert_int_equal(expected[i], num);
+    }
+
+    mem_ring_free(&ring);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_peek_and_enqueue),
         cmocka_unit_test(test_overflow),
-        cmocka_unit_test(test_wrapping)
+        cmocka_unit_test(test_wrapping),
+        cmocka_unit_test(test_overwrite)
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -1,4 +1,5 @@
 #include "msg/builder.h"
+#include "msg/type.h"
 
 extern "C" {
     #include <stdarg.h>
@@ -13,19 +14,27 @@ static void test_borrow(void **state)
     MsgBuilder builder;
     uint8_t frame_length = 42;
     uint8_t buffer_length = 24;
+    uint8_t pixel_format = 3;
+    uint8_t priority = 5;
+    uint8_t opacity = 200;
+    uint8_t capabilities = MSG_CAPABILITY_ENQUEUE16;
 
     msg_builder_init(&builder);
-    MemBlock* msg = msg_builder_borrow(&builder, frame_length, buffer_length);
+    MemBlock* msg = msg_builder_borrow(&builder, frame_length, buffer_length, pixel_format, priority, opacity, capabilities);
 
     uint8_t* msg_data = (uint8_t*) msg->data;
-    assert_int_equal(msg->size, 7);
+    assert_int_equal(msg->size, 11);
     assert_int_equal(msg_data[0], 0); // message type for borrow is 0
     assert_int_equal(msg_data[1], 0); // message ID least significant byte is 0
     assert_int_equal(msg_data[2], 0); // message ID most significant byte is 0
-    assert_int_equal(msg_data[3], 2); // payload length least significant byte is 2
+    assert_int_equal(msg_data[3], 6); // payload length least significant byte is 6
     assert_int_equal(msg_data[4], 0); // payload length most significant byte is 0
     assert_int_equal(msg_data[5], frame_length); // first payload byte is frame length
     assert_int_equal(msg_data[6], buffer_length); // second payload byte is buffer length
+    assert_int_equal(msg_data[7], pixel_format); // third payload byte is pixel format
+    assert_int_equal(msg_data[8], priority); // fourth payload byte is priority
+    assert_int_equal(msg_data[9], opacity); // fifth payload byte is opacity
+    assert_int_equal(msg_data[10], capabilities); // sixth payload byte is capabilities
 
     msg_builder_free(&builder);
 }
@@ -35,7 +44,7 @@ static void test_lent(void **state)
     MsgBuilder builder;
 
     msg_builder_init(&builder);
-    MemBlock* msg = msg_builder_lent(&builder);
+    MemBlock* msg = msg_builder_lent(&builder, 0);
 
     uint8_t* msg_data = (uint8_t*) msg->data;
     assert_int_equal(msg->size, 5);
@@ -45,6 +54,13 @@ static void test_lent(void **state)
     assert_int_equal(msg_data[3], 0); // payload length least significant byte is 0
     assert_int_equal(msg_data[4], 0); // payload length most significant byte is 0
 
+    // Granted capabilities are appended, so sinks not granting any send the old LENT
+    msg = msg_builder_lent(&builder, MSG_CAPABILITY_ENQUEUE16);
+    msg_data = (uint8_t*) msg->data;
+    assert_int_equal(msg->size, 6);
+    assert_int_equal(msg_data[3], 1); // payload length is 1
+    assert_int_equal(msg_data[5], MSG_CAPABILITY_ENQUEUE16);
+
     msg_builder_free(&builder);
 }
 
@@ -83,6 +99,110 @@ static void test_enqueue(void **state)
     msg_builder_free(&builder);
 }
 
+static void test_enqueue16(void **state)
+{
+    MsgBuilder builder;
+    uint8_t frame[] = { 1, 2, 3 };
+
+    msg_builder_init(&builder);
+    MemBlock* msg_block = msg_builder_enqueue16(&builder, 0xA1A2, frame, sizeof(frame));
+
+    uint8_t* msg = (uint8_t*) msg_block->data;
+    assert_int_equal(msg_block->size, (5 + 2 + 2 + 3)); // 5 bytes header, 7 bytes payload
+    assert_int_equal(msg[0], 5); // message type for enqueue16 is 5
+    assert_int_equal(msg[3], 4 + 3); // payload length for frame_seq, frame_len and the frame itself
+    assert_int_equal(msg[4], 0);
+
+    assert_int_equal(msg[5], 0xA2); // frame sequence number least significant byte
+    assert_int_equal(msg[6], 0xA1); // frame sequence number most significant byte
+    assert_int_equal(msg[7], 3);  // frame length least significant byte is 3
+    assert_int_equal(msg[8], 0);  // frame length most significant byte is 0
+    assert_memory_equal(msg + 9, frame, sizeof(frame));
+
+    msg_builder_free(&builder);
+}
+
+static void test_nack(void **state)
+{
+    MsgBuilder builder;
+    const uint16_t missing[] = { 0x0102, 0xFFFF };
+
+    msg_builder_init(&builder);
+    MemBlock* msg_block = msg_builder_nack(&builder, missing, 2);
+
+    uint8_t* msg = (uint8_t*) msg_block->data;
+    assert_int_equal(msg_block->size, 5 + 4);
+    assert_int_equal(msg[0], 6); // message type for nack is 6
+    assert_int_equal(msg[3], 4); // payload length is two bytes per sequence number
+    assert_int_equal(msg[5], 0x02);
+    assert_int_equal(msg[6], 0x01);
+    assert_int_equal(msg[7], 0xFF);
+    assert_int_equal(msg[8], 0xFF);
+
+    msg_builder_free(&builder);
+}
+
+static void test_presentation_times(void **state)
+{
+    MsgBuilder builder;
+    const uint8_t frame[] = { 255, 0, 0 };
+
+    msg_builder_init(&builder);
+
+    MemBlock* msg_block = msg_builder_lent_clock(&builder, MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_PTS, 0x01020304);
+    uint8_t* msg = (uint8_t*) msg_block->data;
+    assert_int_equal(msg_block->size, 5 + 5);
+    assert_int_equal(msg[0], 1); // message type for lent is 1
+    assert_int_equal(msg[5], MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_PTS);
+    assert_int_equal(msg[6], 0x04);
+    assert_int_equal(msg[9], 0x01);
+
+    msg_block = msg_builder_enqueue_pts(&builder, 0x1234, 0xA1B2C3D4, frame, sizeof(frame));
+    msg = (uint8_t*) msg_block->data;
+    assert_int_equal(msg_block->size, 5 + 8 + 3);
+    assert_int_equal(msg[0], 7); // message type for enqueue_pts is 7
+    assert_int_equal(msg[5], 0x34);
+    assert_int_equal(msg[6], 0x12);
+    assert_int_equal(msg[7], 0xD4);
+    assert_int_equal(msg[10], 0xA1);
+    assert_int_equal(msg[11], 3); // frame length
+    assert_int_equal(msg[13], 255);
+
+    msg_block = msg_builder_clock(&builder, 0x01020304, 0x05060708);
+    msg = (uint8_t*) msg_block->data;
+    assert_int_equal(msg_block->size, 5 + 8);
+    assert_int_equal(msg[0], 8); // message type for clock is 8
+    assert_int_equal(msg[5], 0x04);
+    assert_int_equal(msg[9], 0x08);
+    assert_int_equal(msg[12], 0x05);
+
+    msg_builder_free(&builder);
+}
+
+static void test_effect(void **state)
+{
+    MsgBuilder builder;
+    const uint8_t from[] = { 1, 2, 3 };
+    const uint8_t to[] = { 4, 5, 6 };
+
+    msg_builder_init(&builder);
+    MemBlock* msg_block = msg_builder_effect(&builder, 3, 0x0102, 0x0304, from, to, 3);
+
+    uint8_t* msg = (uint8_t*) msg_block->data;
+    assert_int_equal(msg_block->size, 5 + 5 + 6);
+    assert_int_equal(msg[0], 9); // message type for effect is 9
+    assert_int_equal(msg[3], 11); // effect, wavelength, period and two colors
+    assert_int_equal(msg[5], 3);
+    assert_int_equal(msg[6], 0x02);
+    assert_int_equal(msg[7], 0x01);
+    assert_int_equal(msg[8], 0x04);
+    assert_int_equal(msg[9], 0x03);
+    assert_memory_equal(from, &msg[10], 3);
+    assert_memory_equal(to, &msg[13], 3);
+
+    msg_builder_free(&builder);
+}
+
 static void test_fail(void **state)
 {
     MsgBuilder builder;
@@ -106,6 +226,39 @@ static void test_fail(void **state)
     msg_builder_free(&builder);
 }
 
+static void test_discover_and_announce(void **state)
+{
+    MsgBuilder builder;
+    uint8_t pixel_formats[] = { 0, 3 };
+
+    msg_builder_init(&builder);
+    MemBlock* msg_block = msg_builder_discover(&builder);
+
+    uint8_t* msg = (uint8_t*) msg_block->data;
+    assert_int_equal(msg_block->size, 5);
+    assert_int_equal(msg[0], 3); // message type for discover is 3
+    assert_int_equal(msg[3], 0); // discover has no payload
+
+    msg_block = msg_builder_announce(&builder, 0xA1A2, 300, 10, pixel_formats, sizeof(pixel_formats));
+
+    msg = (uint8_t*) msg_block->data;
+    assert_int_equal(msg_block->size, 13);
+    assert_int_equal(msg[0], 4); // message type for announce is 4
+    assert_int_equal(msg[1], 1); // message ID least significant byte is 1
+    assert_int_equal(msg[3], 8); // payload length least significant byte is 8
+    assert_int_equal(msg[4], 0); // payload length most significant byte is 0
+    assert_int_equal(msg[5], 0xA2); // port lsb
+    assert_int_equal(msg[6], 0xA1); // port msb
+    assert_int_equal(msg[7], 300 & 0xFF); // lights count lsb
+    assert_int_equal(msg[8], 300 >> 8); // lights count msb
+    assert_int_equal(msg[9], 10); // minimum frame length
+    assert_int_equal(msg[10], 2); // two pixel formats follow
+    assert_int_equal(msg[11], 0);
+    assert_int_equal(msg[12], 3);
+
+    msg_builder_free(&builder);
+}
+
 static void test_msg_id_overflow(void **state)
 {
     MsgBuilder builder;
@@ -114,20 +267,20 @@ static void test_msg_id_overflow(void **state)
 
     for(int i = 0; i < 65535; ++i)
     {
-        msg_builder_lent(&builder);
+        msg_builder_lent(&builder, 0);
     }
 
-    MemBlock* msg_block = msg_builder_lent(&builder);
+    MemBlock* msg_block = msg_builder_lent(&builder, 0);
     uint8_t* msg = (uint8_t*) msg_block->data;
     assert_int_equal(msg[1], 255); // message ID least significant byte is 255
     assert_int_equal(msg[2], 255); // message ID most significant byte is 255
 
-    msg_block = msg_builder_lent(&builder);
+    msg_block = msg_builder_lent(&builder, 0);
     msg = (uint8_t*) msg_block->data;
     assert_int_equal(msg[1], 0); // message ID least significant byte is 0
     assert_int_equal(msg[2], 0); // message ID most significant byte is 0
 
-    msg_block = msg_builder_lent(&builder);
+    msg_block = msg_builder_lent(&builder, 0);
     msg = (uint8_t*) msg_block->data;
     assert_int_equal(msg[1], 1); // message ID least significant byte is 1
     assert_int_equal(msg[2], 0); // message ID most significant byte is 0
@@ -140,7 +293,7 @@ static void test_reallocations(void **state)
     MsgBuilder builder;
 
     msg_builder_init(&builder);
-    MemBlock* old_msg = msg_builder_lent(&builder);
+    MemBlock* old_msg = msg_builder_lent(&builder, 0);
     void* old_msg_data = old_msg->data;
 
     void* some_frame = malloc(1024 * 10);
@@ -160,15 +313,38 @@ static void test_reallocations(void **state)
     free(some_frame);
 }
 
+static void test_init_in(void **state)
+{
+    MsgBuilder builder;
+    uint8_t buf[8];
+    msg_builder_init_in(&builder, buf, sizeof(buf));
+
+    // Messages that fit are built in place
+    MemBlock* msg = msg_builder_fail(&builder, 1, 2);
+    assert_ptr_equal(buf, msg->data);
+    assert_int_equal(8, msg->size);
+
+    // The buffer belongs to the caller, so it is never replaced by a larger one
+    const uint16_t frame_seqs[2] = { 1, 2 };
+    expect_assert_failure(msg_builder_nack(&builder, frame_seqs, 2));
+    assert_ptr_equal(buf, builder.msg_buf.data);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_borrow),
         cmocka_unit_test(test_lent),
         cmocka_unit_test(test_enqueue),
+        cmocka_unit_test(test_enqueue16),
+        cmocka_unit_test(test_nack),
+        cmocka_unit_test(test_presentation_times),
+        cmocka_unit_test(test_effect),
         cmocka_unit_test(test_fail),
+        cmocka_unit_test(test_discover_and_announce),
         cmocka_unit_test(test_msg_id_overflow),
-        cmocka_unit_test(test_reallocations)
+        cmocka_unit_test(test_reallocations),
+        cmocka_unit_test(test_init_in)
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
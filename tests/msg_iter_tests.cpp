@@ -143,6 +143,79 @@ static void test_msg_iter_borrow_buffer_length(void **state)
 
 }
 
+static void test_msg_iter_borrow_pixel_format(void **state)
+{
+    uint8_t borrow_with_format[] = {
+        0,   // message type 0 = borrow
+        0, 0, // order number is 0
+        3, 0, // payload length is 3
+        16,  // frame length 16ms
+        200,  // buffer length 200
+        3    // pixel format RGB565
+    };
+
+    MsgIter iter = msg_iter_make(borrow_with_format, sizeof(borrow_with_format));
+    assert_int_equal(msg_iter_borrow_pixel_format(&iter), 3);
+
+    // Borrow messages without pixel format imply RGB8
+    iter = msg_iter_make(borrow_and_enqueue_msg_buf, sizeof(borrow_and_enqueue_msg_buf));
+    assert_int_equal(msg_iter_borrow_pixel_format(&iter), 0);
+}
+
+static void test_msg_iter_borrow_priority_and_opacity(void **state)
+{
+    uint8_t borrow_with_priority[] = {
+        0,   // message type 0 = borrow
+        0, 0, // order number is 0
+        5, 0, // payload length is 5
+        16,  // frame length 16ms
+        200,  // buffer length 200
+        0,   // pixel format RGB8
+        7,   // priority 7
+        128  // half opaque
+    };
+
+    MsgIter iter = msg_iter_make(borrow_with_priority, sizeof(borrow_with_priority));
+    assert_int_equal(msg_iter_borrow_priority(&iter), 7);
+    assert_int_equal(msg_iter_borrow_opacity(&iter), 128);
+
+    // Older borrow messages have the lowest priority and are fully opaque
+    iter = msg_iter_make(borrow_and_enqueue_msg_buf, sizeof(borrow_and_enqueue_msg_buf));
+    assert_int_equal(msg_iter_borrow_priority(&iter), 0);
+    assert_int_equal(msg_iter_borrow_opacity(&iter), 255);
+}
+
+static void test_msg_iter_capabilities(void **state)
+{
+    uint8_t borrow_and_lent_with_capabilities[] = {
+        0,   // message type 0 = borrow
+        0, 0, // order number is 0
+        6, 0, // payload length is 6
+        16,  // frame length 16ms
+        200,  // buffer length 200
+        0,   // pixel format RGB8
+        0,   // priority 0
+        255, // opaque
+        1,   // offers ENQUEUE16
+
+        1,   // message type 1 = lent
+        1, 0, // order number is 1
+        1, 0, // payload length is 1
+        1    // grants ENQUEUE16
+    };
+
+    MsgIter iter = msg_iter_make(borrow_and_lent_with_capabilities, sizeof(borrow_and_lent_with_capabilities));
+    assert_int_equal(msg_iter_borrow_capabilities(&iter), MSG_CAPABILITY_ENQUEUE16);
+    msg_iter_next(&iter);
+    assert_int_equal(msg_iter_lent_capabilities(&iter), MSG_CAPABILITY_ENQUEUE16);
+
+    // Older messages offer and grant nothing
+    iter = msg_iter_make(all_types_msg_buf, sizeof(all_types_msg_buf));
+    assert_int_equal(msg_iter_borrow_capabilities(&iter), 0);
+    msg_iter_next(&iter);
+    assert_int_equal(msg_iter_lent_capabilities(&iter), 0);
+}
+
 static void test_msg_iter_enqueue_frame(void **state)
 {
     MsgIter iter = msg_iter_make(
@@ -170,6 +243,104 @@ static void test_msg_iter_enqueue_frame(void **state)
     assert_int_equal(color2[2], 255);
 }
 
+static void test_msg_iter_enqueue16_frame(void **state)
+{
+    uint8_t enqueue16_msg_buf[] = {
+        5,   // message type 5 = enqueue16
+        0, 0, // order number is 0
+        7, 0, // payload length is 7
+        0x34, 0x12, // frame sequence number is 0x1234
+        3, 0, // frame length is 3
+        255, 0, 0  // red
+    };
+
+    MsgIter iter = msg_iter_make(enqueue16_msg_buf, sizeof(enqueue16_msg_buf));
+    assert_int_equal(msg_iter_type(&iter), MSG_TYPE_ENQUEUE16);
+    assert_true(msg_iter_enqueue16_valid(&iter));
+    assert_int_equal(msg_iter_enqueue16_frame_seq(&iter), 0x1234);
+
+    MemBlock frame = msg_iter_enqueue16_frame(&iter);
+    assert_int_equal(frame.size, 3);
+    assert_int_equal(((uint8_t*) frame.data)[0], 255);
+
+    // Too short for the sequence number and frame length
+    enqueue16_msg_buf[3] = 3;
+    iter = msg_iter_make(enqueue16_msg_buf, 5 + 3);
+    assert_false(msg_iter_enqueue16_valid(&iter));
+}
+
+static void test_msg_iter_nack(void **state)
+{
+    uint8_t nack_msg_buf[] = {
+        6,   // message type 6 = nack
+        0, 0, // order number is 0
+        5, 0, // payload length is 5
+        0x34, 0x12, // frame 0x1234 is missing
+        0x35, 0x12, // and frame 0x1235
+        7    // odd trailing byte
+    };
+
+    MsgIter iter = msg_iter_make(nack_msg_buf, sizeof(nack_msg_buf));
+    assert_int_equal(MSG_TYPE_NACK, msg_iter_type(&iter));
+    assert_int_equal(2, msg_iter_nack_frame_seqs_count(&iter));
+    assert_int_equal(0x1234, msg_iter_nack_frame_seq(&iter, 0));
+    assert_int_equal(0x1235, msg_iter_nack_frame_seq(&iter, 1));
+}
+
+static void test_msg_iter_presentation_times(void **state)
+{
+    uint8_t msg_buf[] = {
+        1,   // message type 1 = lent
+        0, 0, // order number is 0
+        5, 0, // payload length is 5
+        5,   // capabilities are ENQUEUE16 and PTS
+        0x04, 0x03, 0x02, 0x01, // sink time is 0x01020304
+
+        7,   // message type 7 = enqueue_pts
+        1, 0, // order number is 1
+        11, 0, // payload length is 11
+        0x34, 0x12, // frame sequence number is 0x1234
+        0xD4, 0xC3, 0xB2, 0xA1, // presentation time is 0xA1B2C3D4
+        3, 0, // frame length is 3
+        255, 0, 0,  // red
+
+        8,   // message type 8 = clock
+        2, 0, // order number is 2
+        8, 0, // payload length is 8
+        0x04, 0x03, 0x02, 0x01, // sink time is 0x01020304
+        0x08, 0x07, 0x06, 0x05  // source time is 0x05060708
+    };
+
+    MsgIter iter = msg_iter_make(msg_buf, sizeof(msg_buf));
+    assert_int_equal(MSG_TYPE_LENT, msg_iter_type(&iter));
+    assert_int_equal(MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_PTS, msg_iter_lent_capabilities(&iter));
+    assert_true(msg_iter_lent_has_clock(&iter));
+    assert_int_equal(0x01020304, msg_iter_lent_clock(&iter));
+
+    msg_iter_next(&iter);
+    assert_int_equal(MSG_TYPE_ENQUEUE_PTS, msg_iter_type(&iter));
+    assert_true(msg_iter_enqueue_pts_valid(&iter));
+    assert_int_equal(0x1234, msg_iter_enqueue_pts_frame_seq(&iter));
+    assert_int_equal(0xA1B2C3D4, msg_iter_enqueue_pts_time(&iter));
+    MemBlock frame = msg_iter_enqueue_pts_frame(&iter);
+    assert_int_equal(3, frame.size);
+    assert_int_equal(255, ((uint8_t*) frame.data)[0]);
+
+    msg_iter_next(&iter);
+    assert_int_equal(MSG_TYPE_CLOCK, msg_iter_type(&iter));
+    assert_true(msg_iter_clock_valid(&iter));
+    assert_int_equal(0x01020304, msg_iter_clock_sink_time(&iter));
+    assert_int_equal(0x05060708, msg_iter_clock_source_time(&iter));
+
+    msg_iter_next(&iter);
+    assert_false(msg_iter_has_msg(&iter));
+
+    // A LENT message with capabilities only carries no clock
+    msg_buf[3] = 1;
+    iter = msg_iter_make(msg_buf, 5 + 1);
+    assert_false(msg_iter_lent_has_clock(&iter));
+}
+
 static void test_fail(void** state)
 {
     MsgIter iter = msg_iter_make(
@@ -185,6 +356,36 @@ static void test_fail(void** state)
     assert_int_equal(msg_iter_fail_offending_msg_id(&iter), 24);
 }
 
+static void test_msg_iter_announce(void **state)
+{
+    uint8_t announce_msg_buf[] = {
+        4,   // message type 4 = announce
+        0, 0, // order number is 0
+        8, 0, // payload length is 8
+        0x11, 0x27, // port 10001
+        44, 1, // 300 lights
+        10, // frames at least 10ms long
+        2, // two pixel formats
+        0, 3 // RGB8 and RGB565
+    };
+
+    MsgIter iter = msg_iter_make(announce_msg_buf, sizeof(announce_msg_buf));
+    assert_int_equal(MSG_TYPE_ANNOUNCE, msg_iter_type(&iter));
+    assert_true(msg_iter_announce_valid(&iter));
+    assert_int_equal(10001, msg_iter_announce_port(&iter));
+    assert_int_equal(300, msg_iter_announce_lights_count(&iter));
+    assert_int_equal(10, msg_iter_announce_min_frame_length(&iter));
+
+    MemBlock pixel_formats = msg_iter_announce_pixel_formats(&iter);
+    assert_int_equal(2, pixel_formats.size);
+    assert_int_equal(3, ((uint8_t*) pixel_formats.data)[1]);
+
+    // Claims more pixel formats than the payload holds
+    announce_msg_buf[10] = 3;
+    iter = msg_iter_make(announce_msg_buf, sizeof(announce_msg_buf));
+    assert_false(msg_iter_announce_valid(&iter));
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_has_msg),
@@ -193,8 +394,15 @@ int main(void) {
         cmocka_unit_test(test_msg_iter_msg_id),
         cmocka_unit_test(test_msg_iter_borrow_frame_length),
         cmocka_unit_test(test_msg_iter_borrow_buffer_length),
+        cmocka_unit_test(test_msg_iter_borrow_pixel_format),
+        cmocka_unit_test(test_msg_iter_borrow_priority_and_opacity),
+        cmocka_unit_test(test_msg_iter_capabilities),
         cmocka_unit_test(test_msg_iter_enqueue_frame),
-        cmocka_unit_test(test_fail)
+        cmocka_unit_test(test_msg_iter_enqueue16_frame),
+        cmocka_unit_test(test_msg_iter_nack),
+        cmocka_unit_test(test_msg_iter_presentation_times),
+        cmocka_unit_test(test_fail),
+        cmocka_unit_test(test_msg_iter_announce)
 
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
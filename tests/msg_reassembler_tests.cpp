@@ -0,0 +1,154 @@
+#include "msg/reassembler.h"
+#include "msg/iter.h"
+
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include <string.h>
+
+static uint8_t lent_and_enqueue_msg_buf[] = {
+    1,   // message type 1 = lent
+    0, 0, // order number is 0
+    0, 0, // payload length is 0
+
+    2,   // message type 2 = enqueue
+    1, 0, // order number is 1
+    9, 0, // payload length is 9
+    42, // frame index is 42
+    6, 0, // frame length is 6
+    255, 0, 0,  // red
+    0, 0, 255  // blue
+};
+
+static const size_t lent_msg_len = 5;
+
+static void receive(MsgReassembler* reassembler, const uint8_t* data, size_t data_len)
+{
+    size_t space_len;
+    void* space = msg_reassembler_space(reassembler, &space_len);
+    assert_true(data_len <= space_len);
+    memcpy(space, data, data_len);
+    msg_reassembler_commit(reassembler, data_len);
+}
+
+static void test_whole_messages(void** state)
+{
+    MsgReassembler reassembler;
+    msg_reassembler_init(&reassembler, MSG_REASSEMBLER_MAX_MSG_LEN);
+
+    receive(&reassembler, lent_and_enqueue_msg_buf, sizeof(lent_and_enqueue_msg_buf));
+
+    void* msgs;
+    size_t msgs_len = msg_reassembler_complete(&reassembler, &msgs);
+    assert_int_equal(sizeof(lent_and_enqueue_msg_buf), msgs_len);
+    assert_memory_equal(lent_and_enqueue_msg_buf, msgs, msgs_len);
+
+    MsgIter iter = msg_iter_make(msgs, msgs_len);
+    assert_int_equal(MSG_TYPE_LENT, msg_iter_type(&iter));
+    msg_iter_next(&iter);
+    assert_int_equal(MSG_TYPE_ENQUEUE, msg_iter_type(&iter));
+    msg_iter_next(&iter);
+    assert_false(msg_iter_has_msg(&iter));
+
+    msg_reassembler_consume(&reassembler, msgs_len);
+    assert_int_equal(0, msg_reassembler_complete(&reassembler, &msgs));
+
+    msg_reassembler_free(&reassembler);
+}
+
+static void test_split_message(void** state)
+{
+    MsgReassembler reassembler;
+    msg_reassembler_init(&reassembler, MSG_REASSEMBLER_MAX_MSG_LEN);
+
+    // The lent message and half of the enqueue message
+    const size_t first_part_len = lent_msg_len + 8;
+    receive(&reassembler, lent_and_enqueue_msg_buf, first_part_len);
+
+    void* msgs;
+    size_t msgs_len = msg_reassembler_complete(&reassembler, &msgs);
+    assert_int_equal(lent_msg_len, msgs_len);
+    msg_reassembler_consume(&reassembler, msgs_len);
+
+    // The incomplete rest is kept until the second part arrives
+    assert_int_equal(0, msg_reassembler_complete(&reassembler, &msgs));
+
+    receive(&reassembler, lent_and_enqueue_msg_buf + first_part_len, sizeof(lent_and_enqueue_msg_buf) - first_part_len);
+    msgs_len = msg_reassembler_complete(&reassembler, &msgs);
+    assert_int_equal(sizeof(lent_and_enqueue_msg_buf) - lent_msg_len, msgs_len);
+    assert_memory_equal(lent_and_enqueue_msg_buf + lent_msg_len, msgs, msgs_len);
+
+    msg_reassembler_free(&reassembler);
+}
+
+static void test_byte_by_byte(void** state)
+{
+    MsgReassembler reassembler;
+    msg_reassembler_init(&reassembler, 32);
+
+    size_t completed_len = 0;
+    for(int repetition = 0; repetition < 10; ++repetition)
+    {
+        for(size_t i = 0; i < sizeof(lent_and_enqueue_msg_buf); ++i)
+        {
+            receive(&reassembler, lent_and_enqueue_msg_buf + i, 1);
+
+            void* msgs;
+            size_t msgs_len = msg_reassembler_complete(&reassembler, &msgs);
+            completed_len += msgs_len;
+            msg_reassembler_consume(&reassembler, msgs_len);
+
+            // Messages complete exactly with their last byte
+            bool lent_complete = i == lent_msg_len - 1;
+            bool enqueue_complete = i == sizeof(lent_and_enqueue_msg_buf) - 1;
+            assert_int_equal(lent_complete || enqueue_complete, msgs_len > 0);
+        }
+    }
+
+    assert_int_equal(10 * sizeof(lent_and_enqueue_msg_buf), completed_len);
+
+    msg_reassembler_free(&reassembler);
+}
+
+static void test_overflow(void** state)
+{
+    MsgReassembler reassembler;
+    msg_reassembler_init(&reassembler, 16);
+
+    receive(&reassembler, lent_and_enqueue_msg_buf, lent_msg_len);
+    assert_false(msg_reassembler_overflowed(&reassembler));
+
+    // The enqueue message is 14 bytes long, it only fits once the lent message
+    // has been consumed
+    void* msgs;
+    msg_reassembler_consume(&reassembler, msg_reassembler_complete(&reassembler, &msgs));
+    receive(&reassembler, lent_and_enqueue_msg_buf + lent_msg_len, sizeof(lent_and_enqueue_msg_buf) - lent_msg_len);
+    assert_false(msg_reassembler_overflowed(&reassembler));
+    msg_reassembler_consume(&reassembler, msg_reassembler_complete(&reassembler, &msgs));
+
+    const uint8_t too_long_header[] = {
+        2,   // message type 2 = enqueue
+        2, 0, // order number is 2
+        100, 0 // payload length is 100
+    };
+    receive(&reassembler, too_long_header, sizeof(too_long_header));
+    assert_true(msg_reassembler_overflowed(&reassembler));
+    assert_int_equal(0, msg_reassembler_complete(&reassembler, &msgs));
+
+    msg_reassembler_free(&reassembler);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_whole_messages),
+        cmocka_unit_test(test_split_message),
+        cmocka_unit_test(test_byte_by_byte),
+        cmocka_unit_test(test_overflow)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,193 @@
+#include "netem/impair.h"
+
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include <string.h>
+
+static void init_spec(NetemImpairSpec* spec)
+{
+    memset(spec, 0, sizeof(NetemImpairSpec));
+    spec->seed = 42;
+}
+
+static void test_passthrough_in_order(void **state)
+{
+    NetemImpairSpec spec;
+    init_spec(&spec);
+
+    NetemImpair impair;
+    netem_impair_init(&impair, &spec);
+
+    for(uint8_t i = 0; i < 10; ++i)
+    {
+        netem_impair_submit(&impair, &i, 1, 1000);
+    }
+
+    uint8_t received;
+    size_t received_len;
+    for(uint8_t i = 0; i < 10; ++i)
+    {
+        assert_true(netem_impair_poll(&impair, 1000, &received, 1, &received_len));
+        assert_int_equal(1, received_len);
+        assert_int_equal(i, received);
+    }
+    assert_false(netem_impair_poll(&impair, 1000, &received, 1, &received_len));
+    assert_int_equal(-1, netem_impair_next_timeout(&impair, 1000));
+
+    netem_impair_free(&impair);
+}
+
+static void test_delay(void **state)
+{
+    NetemImpairSpec spec;
+    init_spec(&spec);
+    spec.delay_ms = 20;
+
+    NetemImpair impair;
+    netem_impair_init(&impair, &spec);
+
+    uint8_t data = 7;
+    netem_impair_submit(&impair, &data, 1, 1000);
+
+    assert_int_equal(20, netem_impair_next_timeout(&impair, 1000));
+    assert_false(netem_impair_poll(&impair, 1019, &data, 1, NULL));
+    assert_true(netem_impair_poll(&impair, 1020, &data, 1, NULL));
+
+    netem_impair_free(&impair);
+}
+
+static void test_total_loss(void **state)
+{
+    NetemImpairSpec spec;
+    init_spec(&spec);
+    spec.loss = 1.0;
+
+    NetemImpair impair;
+    netem_impair_init(&impair, &spec);
+
+    uint8_t data = 7;
+    for(int i = 0; i < 100; ++i)
+    {
+        netem_impair_submit(&impair, &data, 1, 1000);
+    }
+
+    assert_false(netem_impair_poll(&impair, 100000, &data, 1, NULL));
+    assert_int_equal(100, impair.stats.lost);
+
+    netem_impair_free(&impair);
+}
+
+static void test_same_seed_same_decisions(void **state)
+{
+    NetemImpairSpec spec;
+    init_spec(&spec);
+    spec.loss = 0.2;
+    spec.duplicate = 0.1;
+    spec.reorder = 0.1;
+    spec.reorder_delay_ms = 30;
+    spec.delay_ms = 10;
+    spec.jitter_ms = 5;
+
+    NetemImpair a;
+    NetemImpair b;
+    netem_impair_init(&a, &spec);
+    netem_impair_init(&b, &spec);
+
+    for(uint8_t i = 0; i < 200; ++i)
+    {
+        netem_impair_submit(&a, &i, 1, 1000 + i);
+        netem_impair_submit(&b, &i, 1, 1000 + i);
+    }
+
+    uint8_t from_a;
+    uint8_t from_b;
+    unsigned int now = 1000;
+    while(now < 2000)
+    {
+        bool got_a = netem_impair_poll(&a, now, &from_a, 1, NULL);
+        bool got_b = netem_impair_poll(&b, now, &from_b, 1, NULL);
+        assert_int_equal(got_a, got_b);
+
+        if(got_a)
+        {
+            assert_int_equal(from_a, from_b);
+        }
+        else
+        {
+            ++now;
+        }
+    }
+
+    assert_int_equal(a.stats.lost, b.stats.lost);
+    assert_true(a.stats.lost > 0);
+    assert_true(a.stats.duplicated > 0);
+    assert_true(a.stats.reordered > 0);
+
+    netem_impair_free(&a);
+    netem_impair_free(&b);
+}
+
+static void test_rate_cap_spaces_datagrams(void **state)
+{
+    NetemImpairSpec spec;
+    init_spec(&spec);
+    // 100 bytes per datagram at 10kB/s takes 10ms each
+    spec.rate_bytes_per_sec = 10000;
+
+    NetemImpair impair;
+    netem_impair_init(&impair, &spec);
+
+    uint8_t data[100];
+    memset(data, 0, sizeof(data));
+    for(int i = 0; i < 3; ++i)
+    {
+        netem_impair_submit(&impair, data, sizeof(data), 1000);
+    }
+
+    assert_false(netem_impair_poll(&impair, 1009, data, sizeof(data), NULL));
+    assert_true(netem_impair_poll(&impair, 1010, data, sizeof(data), NULL));
+    assert_false(netem_impair_poll(&impair, 1019, data, sizeof(data), NULL));
+    assert_true(netem_impair_poll(&impair, 1020, data, sizeof(data), NULL));
+    assert_true(netem_impair_poll(&impair, 1030, data, sizeof(data), NULL));
+
+    netem_impair_free(&impair);
+}
+
+static void test_queue_overflow_drops(void **state)
+{
+    NetemImpairSpec spec;
+    init_spec(&spec);
+    spec.delay_ms = 100;
+    spec.queue_capacity = 4;
+
+    NetemImpair impair;
+    netem_impair_init(&impair, &spec);
+
+    uint8_t data = 1;
+    for(int i = 0; i < 6; ++i)
+    {
+        netem_impair_submit(&impair, &data, 1, 1000);
+    }
+
+    assert_int_equal(2, impair.stats.queue_dropped);
+
+    netem_impair_free(&impair);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_passthrough_in_order),
+        cmocka_unit_test(test_delay),
+        cmocka_unit_test(test_total_loss),
+        cmocka_unit_test(test_same_seed_same_decisions),
+        cmocka_unit_test(test_rate_cap_spaces_datagrams),
+        cmocka_unit_test(test_queue_overflow_drops)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,124 @@
+#include "rec/reader.h"
+#include "rec/writer.h"
+
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* recording_path = "rec_tests.atrec";
+
+static RecSender make_sender(uint8_t last_address_byte, uint16_t port)
+{
+    RecSender sender;
+    memset(&sender, 0, sizeof(RecSender));
+    sender.family = 4;
+    sender.address[0] = 127;
+    sender.address[3] = last_address_byte;
+    sender.port = port;
+    return sender;
+}
+
+static void test_roundtrip(void **state)
+{
+    RecSender source = make_sender(1, 4242);
+    RecSender sink = make_sender(2, 10042);
+    uint8_t borrow[] = { 0, 0, 0, 2, 0, 17, 50 };
+    uint8_t lent[] = { 1, 0, 0, 0, 0 };
+
+    RecWriter writer;
+    assert_true(rec_writer_open(&writer, recording_path));
+    assert_true(rec_writer_datagram(&writer, 5000000, REC_DIRECTION_TO_SINK, &source, borrow, sizeof(borrow)));
+    assert_true(rec_writer_datagram(&writer, 5000300, REC_DIRECTION_FROM_SINK, &sink, lent, sizeof(lent)));
+    assert_true(rec_writer_datagram(&writer, 5200000, REC_DIRECTION_TO_SINK, &source, borrow, sizeof(borrow)));
+    rec_writer_close(&writer);
+
+    RecReader reader;
+    RecDatagram datagram;
+    assert_true(rec_reader_open(&reader, recording_path));
+
+    assert_true(rec_reader_next(&reader, &datagram));
+    assert_int_equal(0, datagram.time_us);
+    assert_int_equal(REC_DIRECTION_TO_SINK, datagram.direction);
+    assert_int_equal(sizeof(borrow), datagram.data.size);
+    assert_memory_equal(borrow, datagram.data.data, sizeof(borrow));
+    const RecSender* read_source = rec_reader_sender(&reader, datagram.sender_id);
+    assert_ptr_not_equal(NULL, read_source);
+    assert_int_equal(4242, read_source->port);
+    assert_int_equal(1, read_source->address[3]);
+
+    assert_true(rec_reader_next(&reader, &datagram));
+    assert_int_equal(300, datagram.time_us);
+    assert_int_equal(REC_DIRECTION_FROM_SINK, datagram.direction);
+    assert_memory_equal(lent, datagram.data.data, sizeof(lent));
+    assert_int_equal(10042, rec_reader_sender(&reader, datagram.sender_id)->port);
+
+    assert_true(rec_reader_next(&reader, &datagram));
+    assert_int_equal(200000, datagram.time_us);
+    assert_ptr_equal(read_source, rec_reader_sender(&reader, datagram.sender_id));
+
+    assert_false(rec_reader_next(&reader, &datagram));
+
+    rec_reader_close(&reader);
+    remove(recording_path);
+}
+
+static void test_truncated_tail_is_ignored(void **state)
+{
+    RecSender source = make_sender(1, 4242);
+    uint8_t frame[300];
+    memset(frame, 0xAB, sizeof(frame));
+
+    RecWriter writer;
+    assert_true(rec_writer_open(&writer, recording_path));
+    assert_true(rec_writer_datagram(&writer, 0, REC_DIRECTION_TO_SINK, &source, frame, sizeof(frame)));
+    assert_true(rec_writer_datagram(&writer, 10, REC_DIRECTION_TO_SINK, &source, frame, sizeof(frame)));
+    rec_writer_close(&writer);
+
+    // Cut the second datagram in half, as if the recorder crashed
+    FILE* file = fopen(recording_path, "rb");
+    uint8_t contents[1024];
+    size_t contents_len = fread(contents, 1, sizeof(contents), file);
+    fclose(file);
+
+    file = fopen(recording_path, "wb");
+    fwrite(contents, 1, contents_len - sizeof(frame) / 2, file);
+    fclose(file);
+
+    RecReader reader;
+    RecDatagram datagram;
+    assert_true(rec_reader_open(&reader, recording_path));
+    assert_true(rec_reader_next(&reader, &datagram));
+    assert_int_equal(sizeof(frame), datagram.data.size);
+    assert_false(rec_reader_next(&reader, &datagram));
+    rec_reader_close(&reader);
+
+    remove(recording_path);
+}
+
+static void test_reject_foreign_file(void **state)
+{
+    FILE* file = fopen(recording_path, "wb");
+    fputs("not a recording", file);
+    fclose(file);
+
+    RecReader reader;
+    assert_false(rec_reader_open(&reader, recording_path));
+
+    remove(recording_path);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_roundtrip),
+        cmocka_unit_test(test_truncated_tail_is_ignored),
+        cmocka_unit_test(test_reject_foreign_file)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,179 @@
+#include "shm/channel.h"
+#include "time/now.h"
+
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include <string.h>
+
+static const char* channel_name = "shm_channel_tests";
+
+static void test_attach_without_sink(void** state)
+{
+    ShmChannel source;
+    assert_false(shm_channel_attach(&source, channel_name));
+}
+
+static void test_send_both_ways(void** state)
+{
+    ShmChannel sink;
+    ShmChannel source;
+    assert_true(shm_channel_create(&sink, channel_name));
+    assert_true(shm_channel_attach(&source, channel_name));
+
+    void* data;
+    size_t data_len;
+    assert_false(shm_channel_peek(&sink, &data, &data_len));
+
+    const char request[] = "borrow";
+    assert_true(shm_channel_send(&source, request, sizeof(request)));
+
+    // The source does not receive its own datagrams
+    assert_false(shm_channel_peek(&source, &data, &data_len));
+
+    assert_true(shm_channel_peek(&sink, &data, &data_len));
+    assert_int_equal(sizeof(request), data_len);
+    assert_memory_equal(request, data, data_len);
+
+    // Peeking again without releasing returns the same datagram
+    assert_true(shm_channel_peek(&sink, &data, &data_len));
+    assert_int_equal(sizeof(request), data_len);
+    shm_channel_release(&sink);
+    assert_false(shm_channel_peek(&sink, &data, &data_len));
+
+    const char response[] = "lent";
+    assert_true(shm_channel_send(&sink, response, sizeof(response)));
+    assert_true(shm_channel_peek(&source, &data, &data_len));
+    assert_memory_equal(response, data, sizeof(response));
+    shm_channel_release(&source);
+
+    shm_channel_close(&source);
+    shm_channel_close(&sink);
+}
+
+static void test_wrap_around(void** state)
+{
+    ShmChannel sink;
+    ShmChannel source;
+    assert_true(shm_channel_create(&sink, channel_name));
+    assert_true(shm_channel_attach(&source, channel_name));
+
+    // Odd size, so that datagrams end up at all kinds of offsets before the end
+    uint8_t datagram[1001];
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        memset(datagram, i, sizeof(datagram));
+        assert_true(shm_channel_send(&source, datagram, sizeof(datagram)));
+
+        void* data;
+        size_t data_len;
+        assert_true(shm_channel_peek(&sink, &data, &data_len));
+        assert_int_equal(sizeof(datagram), data_len);
+        assert_memory_equal(datagram, data, data_len);
+        shm_channel_release(&sink);
+    }
+
+    shm_channel_close(&source);
+    shm_channel_close(&sink);
+}
+
+static void test_full(void** state)
+{
+    ShmChannel sink;
+    ShmChannel source;
+    assert_true(shm_channel_create(&sink, channel_name));
+    assert_true(shm_channel_attach(&source, channel_name));
+
+    uint8_t datagram[1020];
+    memset(datagram, 0, sizeof(datagram));
+
+    // With the length in front, each datagram takes up exactly 1024 bytes
+    size_t capacity_datagrams = SHM_CHANNEL_CAPACITY / 1024;
+    for(size_t i = 0; i < capacity_datagrams; ++i)
+    {
+        assert_true(shm_channel_send(&source, datagram, sizeof(datagram)));
+    }
+    assert_false(shm_channel_send(&source, datagram, sizeof(datagram)));
+
+    void* data;
+    size_t data_len;
+    assert_true(shm_channel_peek(&sink, &data, &data_len));
+    shm_channel_release(&sink);
+
+    assert_true(shm_channel_send(&source, datagram, sizeof(datagram)));
+
+    shm_channel_close(&source);
+    shm_channel_close(&sink);
+}
+
+static void test_single_source(void** state)
+{
+    ShmChannel sink;
+    ShmChannel source;
+    ShmChannel other_source;
+    assert_true(shm_channel_create(&sink, channel_name));
+    assert_true(shm_channel_attach(&source, channel_name));
+    assert_false(shm_channel_attach(&other_source, channel_name));
+
+    // After detaching, the next source can attach
+    shm_channel_close(&source);
+    assert_true(shm_channel_attach(&other_source, channel_name));
+
+    shm_channel_close(&other_source);
+    shm_channel_close(&sink);
+}
+
+static void test_single_sink(void** state)
+{
+    ShmChannel sink;
+    ShmChannel other_sink;
+    assert_true(shm_channel_create(&sink, channel_name));
+    assert_false(shm_channel_create(&other_sink, channel_name));
+    shm_channel_close(&sink);
+
+    // Closing the sink removes the segment
+    ShmChannel source;
+    assert_false(shm_channel_attach(&source, channel_name));
+}
+
+static void test_wait(void** state)
+{
+    ShmChannel sink;
+    ShmChannel source;
+    assert_true(shm_channel_create(&sink, channel_name));
+    assert_true(shm_channel_attach(&source, channel_name));
+
+    unsigned long long before = time_now_us();
+    assert_false(shm_channel_wait(&sink, 20));
+    assert_true(time_now_us() - before >= 15000);
+
+    const char request[] = "borrow";
+    assert_true(shm_channel_send(&source, request, sizeof(request)));
+
+    // Returns right away if there is something to receive
+    before = time_now_us();
+    assert_true(shm_channel_wait(&sink, 1000));
+    assert_true(time_now_us() - before < 500000);
+
+    shm_channel_close(&source);
+    shm_channel_close(&sink);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_attach_without_sink),
+        cmocka_unit_test(test_send_both_ways),
+        cmocka_unit_test(test_wrap_around),
+        cmocka_unit_test(test_full),
+        cmocka_unit_test(test_single_source),
+        cmocka_unit_test(test_single_sink),
+        cmocka_unit_test(test_wait)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
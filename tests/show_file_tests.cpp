@@ -0,0 +1,104 @@
+#include "show/file.h"
+
+extern "C" {
+    #include <stdarg.h>
+    #include <stddef.h>
+    #include <setjmp.h>
+    #include <cmocka.h>
+}
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* show_path = "show_file_tests.atsh";
+
+static void write_show(size_t frame_count, size_t frame_stride)
+{
+    FILE* file = fopen(show_path, "wb");
+    assert_true(show_file_write_header(file, frame_stride / 3, 17, frame_count, frame_stride));
+
+    for(size_t i = 0; i < frame_count; ++i)
+    {
+        uint8_t frame[64];
+        assert_true(frame_stride <= sizeof(frame));
+        memset(frame, (int) i, frame_stride);
+        assert_int_equal(frame_stride, fwrite(frame, 1, frame_stride, file));
+    }
+
+    fclose(file);
+}
+
+static void test_open_and_read_frames(void **state)
+{
+    write_show(100, 9);
+
+    ShowFile show;
+    assert_true(show_file_open(&show, show_path));
+    assert_int_equal(3, show.lights_count);
+    assert_int_equal(17, show.frame_duration_ms);
+    assert_int_equal(100, show.frame_count);
+    assert_int_equal(9, show.frame_stride);
+
+    for(size_t i = 0; i < show.frame_count; ++i)
+    {
+        const uint8_t* frame = (const uint8_t*) show_file_frame(&show, i);
+        assert_int_equal(i, frame[0]);
+        assert_int_equal(i, frame[8]);
+    }
+
+    // Advising is only a hint and must not change contents
+    show_file_advise(&show, 50, 10, 50);
+    assert_int_equal(60, ((const uint8_t*) show_file_frame(&show, 60))[0]);
+
+    show_file_close(&show);
+    remove(show_path);
+}
+
+static void test_reject_foreign_file(void **state)
+{
+    FILE* file = fopen(show_path, "wb");
+    fputs("this is definitely not a show file at all", file);
+    fclose(file);
+
+    ShowFile show;
+    assert_false(show_file_open(&show, show_path));
+
+    remove(show_path);
+}
+
+static void test_reject_truncated_file(void **state)
+{
+    write_show(10, 30);
+
+    // Drop the last half frame
+    FILE* file = fopen(show_path, "rb");
+    uint8_t contents[1024];
+    size_t contents_len = fread(contents, 1, sizeof(contents), file);
+    fclose(file);
+
+    file = fopen(show_path, "wb");
+    fwrite(contents, 1, contents_len - 15, file);
+    fclose(file);
+
+    ShowFile show;
+    assert_false(show_file_open(&show, show_path));
+
+    remove(show_path);
+}
+
+static void test_missing_file(void **state)
+{
+    ShowFile show;
+    assert_false(show_file_open(&show, "does_not_exist.atsh"));
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_open_and_read_frames),
+        cmocka_unit_test(test_reject_foreign_file),
+        cmocka_unit_test(test_reject_truncated_file),
+        cmocka_unit_test(test_missing_file)
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -1,10 +1,15 @@
 #include "atolla/sink.h"
+#include "atolla/effect.h"
+#include "atolla/error_codes.h"
 #include "udp_socket/udp_socket.h"
 #include "msg/builder.h"
 #include "msg/iter.h"
 #include "time/sleep.h"
 #include "time/now.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 extern "C" {
     #include <stdarg.h>
     #include <stddef.h>
@@ -28,6 +33,17 @@ static void setup_open_sink(AtollaSink* sink, UdpSocket* source_sock, MsgBuilder
     AtollaSinkSpec spec;
     spec.port = port;
     spec.lights_count = lights_count;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.shm_name = NULL;
+    spec.tcp_port = 0;
+    spec.unix_path = NULL;
+    spec.multicast_group = NULL;
+    spec.max_sources = 0;
+    spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    spec.max_buffer_length = 0;
+    spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    spec.connect_borrowers = false;
+    spec.socket_options = NULL;
 
     *sink = atolla_sink_make(&spec);
     assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(*sink));
@@ -38,12 +54,12 @@ static void setup_open_sink(AtollaSink* sink, UdpSocket* source_sock, MsgBuilder
     msg_builder_init(builder);
 }
 
-static void setup_lent_sink(AtollaSink* sink, UdpSocket* source_sock, MsgBuilder* builder)
+static void setup_lent_sink_with_format(AtollaSink* sink, UdpSocket* source_sock, MsgBuilder* builder, AtollaPixelFormat transfer_format)
 {
     setup_open_sink(sink, source_sock, builder);
 
     // Borrow the sink with a virtual source represented by the socket
-    MemBlock* msg = msg_builder_borrow(builder, frame_length, buffered_frame_count);
+    MemBlock* msg = msg_builder_borrow(builder, frame_length, buffered_frame_count, transfer_format, 0, 255, 0);
     UdpSocketResult res = udp_socket_send(source_sock, msg->data, msg->size);
     assert_int_equal(UDP_SOCKET_OK, res.code);
     time_sleep(loopback_send_time_ms);
@@ -60,6 +76,11 @@ static void setup_lent_sink(AtollaSink* sink, UdpSocket* source_sock, MsgBuilder
     assert_int_equal(1, buf[0]); // Message type byte should be 1 for a LENT message
 }
 
+static void setup_lent_sink(AtollaSink* sink, UdpSocket* source_sock, MsgBuilder* builder)
+{
+    setup_lent_sink_with_format(sink, source_sock, builder, ATOLLA_PIXEL_FORMAT_RGB8);
+}
+
 static void teardown_sink(AtollaSink sink, UdpSocket* source_sock, MsgBuilder* builder)
 {
     atolla_sink_free(sink);
@@ -67,6 +88,21 @@ static void teardown_sink(AtollaSink sink, UdpSocket* source_sock, MsgBuilder* b
     msg_builder_free(builder);
 }
 
+/**
+ * Makes sure that the io_uring rerun of these tests does not silently fall
+ * back to the BSD backend.
+ */
+static void test_selected_backend(void **state)
+{
+    const char* backend_name = getenv("ATOLLA_UDP_BACKEND");
+    bool want_uring = backend_name != NULL && strcmp(backend_name, "io_uring") == 0;
+
+    UdpSocket sock;
+    assert_int_equal(udp_socket_init(&sock).code, UDP_SOCKET_OK);
+    assert_int_equal(udp_socket_backend(&sock), want_uring ? UDP_SOCKET_BACKEND_IO_URING : UDP_SOCKET_BACKEND_BSD);
+    udp_socket_free(&sock);
+}
+
 /**
  * Tests by sending enqueue messages and then dequeuing them.
  */
@@ -202,11 +238,956 @@ static void test_get_repeat_pattern(void **state)
     teardown_sink(sink, &source_sock, &builder);
 }
 
+static void test_expand_rgb565(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+
+    setup_lent_sink_with_format(&sink, &source_sock, &builder, ATOLLA_PIXEL_FORMAT_RGB565);
+
+    // Full red and half-intensity green, little-endian
+    const size_t frame_len = 4;
+    uint8_t frame[frame_len] = { 0x00, 0xF8, 0x00, 0x04 };
+
+    MemBlock* msg = msg_builder_enqueue(&builder, 0, frame, frame_len);
+    UdpSocketResult res = udp_socket_send(&source_sock, msg->data, msg->size);
+    assert_int_equal(UDP_SOCKET_OK, res.code);
+    time_sleep(loopback_send_time_ms);
+    atolla_sink_state(sink);
+
+    const uint8_t expected[6] = { 255, 0, 0, 0, 130, 0 };
+    uint8_t got_frame[lights_count*3];
+    assert_true(atolla_sink_get(sink, got_frame, lights_count*3));
+    for(int i = 0; i < lights_count; i += 2)
+    {
+        assert_memory_equal(got_frame + i*3, expected, sizeof(expected));
+    }
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+static void test_refuse_unsupported_pixel_format(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+
+    setup_open_sink(&sink, &source_sock, &builder);
+
+    // The sink outputs RGB8 and cannot make up a white channel
+    MemBlock* msg = msg_builder_borrow(&builder, frame_length, buffered_frame_count, ATOLLA_PIXEL_FORMAT_RGBW8, 0, 255, 0);
+    UdpSocketResult res = udp_socket_send(&source_sock, msg->data, msg->size);
+    assert_int_equal(UDP_SOCKET_OK, res.code);
+    time_sleep(loopback_send_time_ms);
+
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+    time_sleep(loopback_send_time_ms);
+
+    uint8_t buf[256];
+    size_t received_bytes;
+    res = udp_socket_receive(&source_sock, buf, 256, &received_bytes, false);
+    assert_int_equal(UDP_SOCKET_OK, res.code);
+    assert_int_equal(8, received_bytes);
+    assert_int_equal(255, buf[0]); // FAIL
+    assert_int_equal(ATOLLA_ERROR_CODE_UNSUPPORTED_PIXEL_FORMAT, buf[7]);
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+static AtollaSink make_compositing_sink(AtollaSinkBlendMode blend_mode)
+{
+    AtollaSinkSpec spec;
+    spec.port = port;
+    spec.lights_count = lights_count;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.shm_name = NULL;
+    spec.tcp_port = 0;
+    spec.unix_path = NULL;
+    spec.multicast_group = NULL;
+    spec.max_sources = 2;
+    spec.blend_mode = blend_mode;
+    spec.max_buffer_length = 0;
+    spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    spec.connect_borrowers = false;
+    spec.socket_options = NULL;
+
+    AtollaSink sink = atolla_sink_make(&spec);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+    return sink;
+}
+
+/**
+ * Sends a message from the virtual source and lets the sink process it.
+ */
+static void send_to_sink(AtollaSink sink, UdpSocket* source_sock, MemBlock* msg)
+{
+    UdpSocketResult res = udp_socket_send(source_sock, msg->data, msg->size);
+    assert_int_equal(UDP_SOCKET_OK, res.code);
+    time_sleep(loopback_send_time_ms);
+    atolla_sink_state(sink);
+}
+
+/**
+ * Receives messages sent to the virtual source until one with the given type
+ * arrives and returns the last payload byte, or -1 if there is none.
+ */
+static int receive_from_sink(UdpSocket* source_sock, uint8_t msg_type)
+{
+    uint8_t buf[256];
+    size_t received_bytes;
+    while(udp_socket_receive(source_sock, buf, 256, &received_bytes, false).code == UDP_SOCKET_OK)
+    {
+        if(buf[0] == msg_type)
+        {
+            return buf[received_bytes - 1];
+        }
+    }
+    return -1;
+}
+
+/**
+ * Borrows a sink with two sources that each send a single color.
+ */
+static void borrow_two(AtollaSink sink, UdpSocket* socks, MsgBuilder* builders, const uint8_t (*colors)[3], const uint8_t* priorities, const uint8_t* opacities)
+{
+    for(int i = 0; i < 2; ++i)
+    {
+        udp_socket_init(&socks[i]);
+        udp_socket_set_receiver(&socks[i], "localhost", port);
+        msg_builder_init(&builders[i]);
+
+        send_to_sink(sink, &socks[i], msg_builder_borrow(&builders[i], frame_length, buffered_frame_count, ATOLLA_PIXEL_FORMAT_RGB8, priorities[i], opacities[i], 0));
+        assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+        send_to_sink(sink, &socks[i], msg_builder_enqueue(&builders[i], 0, colors[i], 3));
+    }
+}
+
+static void free_two(UdpSocket* socks, MsgBuilder* builders)
+{
+    for(int i = 0; i < 2; ++i)
+    {
+        udp_socket_free(&socks[i]);
+        msg_builder_free(&builders[i]);
+    }
+}
+
+/**
+ * Tests that two sources with the same priority are merged channel by channel
+ * with HTP, and that a higher priority hides the lower one.
+ */
+static void test_composite_htp(void **state)
+{
+    AtollaSink sink = make_compositing_sink(ATOLLA_SINK_BLEND_HTP);
+    UdpSocket socks[2];
+    MsgBuilder builders[2];
+    const uint8_t colors[2][3] = { { 10, 200, 10 }, { 200, 0, 0 } };
+    const uint8_t priorities[2] = { 0, 0 };
+    const uint8_t opacities[2] = { 255, 255 };
+
+    borrow_two(sink, socks, builders, colors, priorities, opacities);
+
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    const uint8_t expected_merged[3] = { 200, 200, 10 };
+    assert_memory_equal(expected_merged, got_frame, 3);
+
+    // A third source is refused while both places are taken
+    UdpSocket third_sock;
+    MsgBuilder third_builder;
+    udp_socket_init(&third_sock);
+    udp_socket_set_receiver(&third_sock, "localhost", port);
+    msg_builder_init(&third_builder);
+    send_to_sink(sink, &third_sock, msg_builder_borrow(&third_builder, frame_length, buffered_frame_count, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, 0));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE, receive_from_sink(&third_sock, 255));
+    udp_socket_free(&third_sock);
+    msg_builder_free(&third_builder);
+
+    // The second source borrows again with a higher priority and is shown alone
+    send_to_sink(sink, &socks[1], msg_builder_borrow(&builders[1], frame_length, buffered_frame_count, ATOLLA_PIXEL_FORMAT_RGB8, 1, 255, 0));
+    send_to_sink(sink, &socks[1], msg_builder_enqueue(&builders[1], 0, colors[1], 3));
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(colors[1], got_frame, 3);
+
+    atolla_sink_free(sink);
+    free_two(socks, builders);
+}
+
+/**
+ * Tests that with LTP, the source that borrowed last is shown alone.
+ */
+static void test_composite_ltp(void **state)
+{
+    AtollaSink sink = make_compositing_sink(ATOLLA_SINK_BLEND_LTP);
+    UdpSocket socks[2];
+    MsgBuilder builders[2];
+    const uint8_t colors[2][3] = { { 10, 200, 10 }, { 200, 0, 0 } };
+    const uint8_t priorities[2] = { 0, 0 };
+    const uint8_t opacities[2] = { 255, 255 };
+
+    borrow_two(sink, socks, builders, colors, priorities, opacities);
+
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(colors[1], got_frame, 3);
+
+    atolla_sink_free(sink);
+    free_two(socks, builders);
+}
+
+/**
+ * Tests that a half-transparent overlay with a higher priority is blended
+ * over the base, even though it borrowed first.
+ */
+static void test_composite_alpha(void **state)
+{
+    AtollaSink sink = make_compositing_sink(ATOLLA_SINK_BLEND_ALPHA);
+    UdpSocket socks[2];
+    MsgBuilder builders[2];
+    const uint8_t colors[2][3] = { { 200, 0, 100 }, { 0, 0, 200 } };
+    const uint8_t priorities[2] = { 1, 0 };
+    const uint8_t opacities[2] = { 51, 255 };
+
+    borrow_two(sink, socks, builders, colors, priorities, opacities);
+
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    // One fifth of the overlay and four fifths of the base
+    const uint8_t expected_blended[3] = { 40, 0, 180 };
+    assert_memory_equal(expected_blended, got_frame, 3);
+
+    atolla_sink_free(sink);
+    free_two(socks, builders);
+}
+
+/**
+ * Tests that an overlay that stops sending times out on its own, while the
+ * base keeps playing.
+ */
+static void test_composite_overlay_timeout(void **state)
+{
+    AtollaSink sink = make_compositing_sink(ATOLLA_SINK_BLEND_HTP);
+    UdpSocket socks[2];
+    MsgBuilder builders[2];
+    const uint8_t colors[2][3] = { { 10, 200, 10 }, { 200, 0, 0 } };
+    const uint8_t priorities[2] = { 0, 0 };
+    const uint8_t opacities[2] = { 255, 255 };
+
+    borrow_two(sink, socks, builders, colors, priorities, opacities);
+
+    // Only the base keeps sending, for longer than the timeout of 1500ms, and
+    // a frame of it arrives before every update of the sink
+    const unsigned int start_time = time_now();
+    for(int frame_idx = 1; (time_now() - start_time) < 1800; ++frame_idx)
+    {
+        MemBlock* msg = msg_builder_enqueue(&builders[0], (uint8_t) frame_idx, colors[0], 3);
+        assert_int_equal(UDP_SOCKET_OK, udp_socket_send(&socks[0], msg->data, msg->size).code);
+        time_sleep(50);
+        atolla_sink_state(sink);
+    }
+
+    // Dropped while the base kept the sink busy
+    assert_int_equal(ATOLLA_ERROR_CODE_TIMEOUT, receive_from_sink(&socks[1], 255));
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+    assert_int_equal(-1, receive_from_sink(&socks[0], 255));
+
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(colors[0], got_frame, 3);
+
+    atolla_sink_free(sink);
+    free_two(socks, builders);
+}
+
+/**
+ * Tests that sources asking for a longer buffer than the sink allows are
+ * refused, while others get a buffer of their own size.
+ */
+static void test_max_buffer_length(void **state)
+{
+    AtollaSinkSpec spec;
+    spec.port = port;
+    spec.lights_count = lights_count;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.shm_name = NULL;
+    spec.tcp_port = 0;
+    spec.unix_path = NULL;
+    spec.multicast_group = NULL;
+    spec.max_sources = 0;
+    spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    spec.max_buffer_length = 4;
+    spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    spec.connect_borrowers = false;
+    spec.socket_options = NULL;
+
+    AtollaSink sink = atolla_sink_make(&spec);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    udp_socket_init(&source_sock);
+    udp_socket_set_receiver(&source_sock, "localhost", port);
+    msg_builder_init(&builder);
+
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, frame_length, 5, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, 0));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_ERROR_CODE_REQUESTED_BUFFER_TOO_LARGE, receive_from_sink(&source_sock, 255));
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, frame_length, 4, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, 0));
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+
+    // The buffer holds all of the frames that the source may send ahead
+    const uint8_t colors[4][3] = { { 1, 1, 1 }, { 2, 2, 2 }, { 3, 3, 3 }, { 4, 4, 4 } };
+    for(int i = 0; i < 4; ++i)
+    {
+        send_to_sink(sink, &source_sock, msg_builder_enqueue(&builder, i, colors[i], 3));
+    }
+
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(colors[0], got_frame, 3);
+
+    // Borrowing again with a shorter buffer is fine too
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, frame_length, 2, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, 0));
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+
+    atolla_sink_free(sink);
+    udp_socket_free(&source_sock);
+    msg_builder_free(&builder);
+}
+
+/**
+ * Tests that sources offering ENQUEUE16 get it granted and that late or
+ * duplicated frames are ignored by their 16-bit sequence numbers.
+ */
+static void test_enqueue16(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    setup_open_sink(&sink, &source_sock, &builder);
+
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, frame_length, 8, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, MSG_CAPABILITY_ENQUEUE16));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(MSG_CAPABILITY_ENQUEUE16, receive_from_sink(&source_sock, MSG_TYPE_LENT));
+
+    const uint8_t first[3] = { 1, 1, 1 };
+    const uint8_t last[3] = { 3, 3, 3 };
+    const uint8_t stale[3] = { 9, 9, 9 };
+
+    // Frame 1 is lost and filled in with frame 2, then frame 1 arrives late,
+    // and finally frame 3 arrives a second time
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 0, first, 3));
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 2, last, 3));
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 3, last, 3));
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 1, stale, 3));
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 3, stale, 3));
+
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(first, got_frame, 3);
+
+    // Long after all frames were due, the last one that was taken stays
+    time_sleep(6 * frame_length);
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(last, got_frame, 3);
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+/**
+ * Tests that the sink starts over from a frame after a gap larger than the
+ * buffer, instead of filling the buffer with copies and asking for the gap.
+ */
+static void test_enqueue16_resync(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    setup_open_sink(&sink, &source_sock, &builder);
+
+    const uint8_t long_frame_length = 40;
+    const uint8_t capabilities = MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_NACK;
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, long_frame_length, 8, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, capabilities));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(capabilities, receive_from_sink(&source_sock, MSG_TYPE_LENT));
+
+    // The first sequence number is taken as it is, even in the upper half
+    const uint8_t colors[3][3] = { { 1, 1, 1 }, { 2, 2, 2 }, { 3, 3, 3 } };
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 40000, colors[0], 3));
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 41000, colors[1], 3));
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 41001, colors[2], 3));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(-1, receive_from_sink(&source_sock, MSG_TYPE_NACK));
+
+    // Each frame shows once, without copies in between
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(colors[0], got_frame, 3);
+    time_sleep(long_frame_length / 2);
+    for(int i = 1; i < 3; ++i)
+    {
+        time_sleep(long_frame_length);
+        assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+        assert_memory_equal(colors[i], got_frame, 3);
+    }
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+/**
+ * Tests that the first frame after borrowing is taken as it is, even if its
+ * index is far ahead, like when a sink joins a multicast group late.
+ */
+static void test_enqueue_late_join(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    setup_lent_sink(&sink, &source_sock, &builder);
+
+    const uint8_t first[3] = { 1, 1, 1 };
+    const uint8_t second[3] = { 2, 2, 2 };
+    send_to_sink(sink, &source_sock, msg_builder_enqueue(&builder, 200, first, 3));
+    send_to_sink(sink, &source_sock, msg_builder_enqueue(&builder, 201, second, 3));
+
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(first, got_frame, 3);
+    // Nothing filled in before the first frame, the second one follows right after
+    time_sleep(frame_length + frame_length / 2);
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(second, got_frame, 3);
+
+    // Borrowing again starts over from whatever index comes next
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, frame_length, buffered_frame_count, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, 0));
+    time_sleep(loopback_send_time_ms);
+    assert_int_not_equal(-1, receive_from_sink(&source_sock, MSG_TYPE_LENT));
+
+    const uint8_t third[3] = { 3, 3, 3 };
+    send_to_sink(sink, &source_sock, msg_builder_enqueue(&builder, 150, third, 3));
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(third, got_frame, 3);
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+/**
+ * Tests that the sink asks for lost frames with NACK and shows them in their
+ * place if they arrive in time.
+ */
+static void test_nack(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    setup_open_sink(&sink, &source_sock, &builder);
+
+    // Long frames, so the timing of the test has some leeway
+    const uint8_t long_frame_length = 40;
+    const uint8_t capabilities = MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_NACK;
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, long_frame_length, 8, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, capabilities));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(capabilities, receive_from_sink(&source_sock, MSG_TYPE_LENT));
+
+    const uint8_t colors[4][3] = { { 1, 1, 1 }, { 2, 2, 2 }, { 3, 3, 3 }, { 4, 4, 4 } };
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 0, colors[0], 3));
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 3, colors[3], 3));
+    time_sleep(loopback_send_time_ms);
+
+    uint8_t buf[256];
+    size_t received_bytes;
+    assert_int_equal(UDP_SOCKET_OK, udp_socket_receive(&source_sock, buf, sizeof(buf), &received_bytes, false).code);
+    MsgIter iter = msg_iter_make(buf, received_bytes);
+    assert_int_equal(MSG_TYPE_NACK, msg_iter_type(&iter));
+    assert_int_equal(2, msg_iter_nack_frame_seqs_count(&iter));
+    assert_int_equal(1, msg_iter_nack_frame_seq(&iter, 0));
+    assert_int_equal(2, msg_iter_nack_frame_seq(&iter, 1));
+
+    // Only frame 1 is resent in time, frame 2 stays a copy of frame 3
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 1, colors[1], 3));
+
+    const uint8_t* expected[] = { colors[0], colors[1], colors[3], colors[3] };
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(expected[0], got_frame, 3);
+    time_sleep(long_frame_length / 2);
+    for(int i = 1; i < 4; ++i)
+    {
+        time_sleep(long_frame_length);
+        assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+        assert_memory_equal(expected[i], got_frame, 3);
+    }
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+/**
+ * Tests that with presentation times, the sink learns the clock of the source
+ * from CLOCK and holds back frames until they are due on that clock.
+ */
+static void test_presentation_time(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    setup_open_sink(&sink, &source_sock, &builder);
+
+    const uint8_t long_frame_length = 40;
+    const uint8_t capabilities = MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_PTS;
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, long_frame_length, 8, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, capabilities));
+    time_sleep(loopback_send_time_ms);
+
+    uint8_t buf[256];
+    size_t received_bytes;
+    assert_int_equal(UDP_SOCKET_OK, udp_socket_receive(&source_sock, buf, sizeof(buf), &received_bytes, false).code);
+    MsgIter iter = msg_iter_make(buf, received_bytes);
+    assert_int_equal(MSG_TYPE_LENT, msg_iter_type(&iter));
+    assert_int_equal(capabilities, msg_iter_lent_capabilities(&iter));
+    assert_true(msg_iter_lent_has_clock(&iter));
+
+    // The clock of the virtual source runs ten seconds ahead of the sink clock
+    const uint32_t source_ahead_us = 10000000;
+    uint32_t source_now_us = (uint32_t) time_now_us() + source_ahead_us;
+    send_to_sink(sink, &source_sock, msg_builder_clock(&builder, msg_iter_lent_clock(&iter), source_now_us));
+
+    // Due three frames from now on the source clock
+    const uint8_t color[3] = { 7, 7, 7 };
+    source_now_us = (uint32_t) time_now_us() + source_ahead_us;
+    uint32_t presentation_time_us = source_now_us + 3 * long_frame_length * 1000;
+    send_to_sink(sink, &source_sock, msg_builder_enqueue_pts(&builder, 0, presentation_time_us, color, 3));
+
+    uint8_t got_frame[3];
+    assert_false(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    time_sleep(long_frame_length);
+    assert_false(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+
+    time_sleep(3 * long_frame_length);
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(color, got_frame, 3);
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+/**
+ * Tests that event loops learn when the next frame is due.
+ */
+static void test_poll(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    setup_open_sink(&sink, &source_sock, &builder);
+
+    // Without a borrower, the sink only waits for messages
+    assert_true(atolla_sink_poll_fd(sink) >= 0);
+    assert_int_equal(-1, atolla_sink_poll_timeout(sink));
+
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, frame_length, 8, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, MSG_CAPABILITY_ENQUEUE16));
+    time_sleep(loopback_send_time_ms);
+    receive_from_sink(&source_sock, MSG_TYPE_LENT);
+
+    // Lent without frames, the next LENT is the next thing to do
+    int timeout_ms = atolla_sink_poll_timeout(sink);
+    assert_in_range(timeout_ms, 400, 501);
+
+    const uint8_t frame[3] = { 1, 2, 3 };
+    for(uint16_t frame_seq = 0; frame_seq < 2; ++frame_seq)
+    {
+        MemBlock* msg = msg_builder_enqueue16(&builder, frame_seq, frame, 3);
+        udp_socket_send(&source_sock, msg->data, msg->size);
+    }
+    time_sleep(loopback_send_time_ms);
+
+    // The first frame can be shown right away, the second one a frame later
+    assert_int_equal(0, atolla_sink_poll_timeout(sink));
+    uint8_t got_frame[lights_count * 3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_in_range(atolla_sink_poll_timeout(sink), frame_length - 2, frame_length + 1);
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+/**
+ * Tests that a flood of frames from a source that does not borrow the sink is
+ * handled a bit at a time, answered with a few FAILs only and counted, while
+ * the borrower keeps playing.
+ */
+static void test_flood(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    setup_lent_sink(&sink, &source_sock, &builder);
+
+    UdpSocket foreign_sock;
+    MsgBuilder foreign_builder;
+    udp_socket_init(&foreign_sock);
+    udp_socket_set_receiver(&foreign_sock, "localhost", port);
+    msg_builder_init(&foreign_builder);
+
+    const uint8_t foreign_frame[3] = { 255, 0, 0 };
+    const int flood_count = 150;
+    for(int i = 0; i < flood_count; ++i)
+    {
+        MemBlock* msg = msg_builder_enqueue(&foreign_builder, (uint8_t) i, foreign_frame, 3);
+        assert_int_equal(UDP_SOCKET_OK, udp_socket_send(&foreign_sock, msg->data, msg->size).code);
+    }
+    time_sleep(loopback_send_time_ms);
+
+    // Not everything at once, the caller gets to show frames in between
+    AtollaSinkStats stats;
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+    atolla_sink_stats(sink, &stats);
+    assert_in_range(stats.foreign_count, 1, flood_count - 1);
+    assert_int_equal(1, stats.backlog_count);
+
+    // The rest follows with the next calls
+    for(int i = 0; i < 10 && stats.foreign_count < (unsigned int) flood_count; ++i)
+    {
+        atolla_sink_poll_timeout(sink);
+        time_sleep(1);
+        atolla_sink_stats(sink, &stats);
+    }
+    assert_int_equal(flood_count, stats.foreign_count);
+    assert_int_equal(0, stats.bad_count);
+
+    // Only the first few frames were answered, the only layer is taken
+    int fail_count = 0;
+    while(receive_from_sink(&foreign_sock, MSG_TYPE_FAIL) == ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE)
+    {
+        ++fail_count;
+    }
+    assert_in_range(fail_count, 1, 4);
+    assert_int_equal(flood_count - fail_count, stats.fail_suppressed_count);
+
+    // The borrower was not mistaken for the flooding source
+    const uint8_t frame[3] = { 0, 0, 255 };
+    send_to_sink(sink, &source_sock, msg_builder_enqueue(&builder, 1, frame, 3));
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(frame, got_frame, sizeof(frame));
+
+    udp_socket_free(&foreign_sock);
+    msg_builder_free(&foreign_builder);
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+/**
+ * Tests that a burst of DISCOVER messages only gets a few ANNOUNCE replies.
+ */
+static void test_discover_flood(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    setup_open_sink(&sink, &source_sock, &builder);
+
+    const int discover_count = 20;
+    for(int i = 0; i < discover_count; ++i)
+    {
+        MemBlock* msg = msg_builder_discover(&builder);
+        assert_int_equal(UDP_SOCKET_OK, udp_socket_send(&source_sock, msg->data, msg->size).code);
+    }
+    time_sleep(loopback_send_time_ms);
+    atolla_sink_state(sink);
+    time_sleep(loopback_send_time_ms);
+
+    int announce_count = 0;
+    while(receive_from_sink(&source_sock, MSG_TYPE_ANNOUNCE) != -1)
+    {
+        ++announce_count;
+    }
+    assert_in_range(announce_count, 1, 4);
+
+    AtollaSinkStats stats;
+    atolla_sink_stats(sink, &stats);
+    assert_int_equal(discover_count - announce_count, stats.announce_suppressed_count);
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+/**
+ * Tests that the sink renders an effect instead of frames until the next frame
+ * is enqueued.
+ */
+static void test_effect(void **state)
+{
+    AtollaSink sink;
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    setup_open_sink(&sink, &source_sock, &builder);
+
+    const uint8_t capabilities = MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_EFFECT;
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, frame_length, 8, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, capabilities));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(capabilities, receive_from_sink(&source_sock, MSG_TYPE_LENT));
+
+    const uint8_t black[3] = { 0, 0, 0 };
+    const uint8_t red[3] = { 255, 0, 0 };
+    send_to_sink(sink, &source_sock, msg_builder_effect(&builder, ATOLLA_EFFECT_GRADIENT, 0, 0, black, red, 3));
+
+    uint8_t got_frame[lights_count * 3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(black, got_frame, 3);
+    assert_memory_equal(red, &got_frame[(lights_count - 1) * 3], 3);
+    assert_true(got_frame[(lights_count / 2) * 3] > 0 && got_frame[(lights_count / 2) * 3] < 255);
+
+    // Colors that do not fit the pixel format are refused
+    send_to_sink(sink, &source_sock, msg_builder_effect(&builder, ATOLLA_EFFECT_SOLID, 0, 0, black, red, 2));
+    assert_int_equal(ATOLLA_ERROR_CODE_BAD_MSG, receive_from_sink(&source_sock, MSG_TYPE_FAIL));
+
+    // The next frame ends the effect
+    const uint8_t blue[3] = { 0, 0, 255 };
+    send_to_sink(sink, &source_sock, msg_builder_enqueue16(&builder, 0, blue, 3));
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(blue, got_frame, 3);
+    assert_memory_equal(blue, &got_frame[(lights_count - 1) * 3], 3);
+
+    teardown_sink(sink, &source_sock, &builder);
+}
+
+/**
+ * Tests that lost frames fade from the frame before to the frame after with
+ * ATOLLA_SINK_CONCEAL_INTERPOLATE.
+ */
+static void test_conceal_interpolate(void **state)
+{
+    AtollaSinkSpec spec;
+    spec.port = port;
+    spec.lights_count = lights_count;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.shm_name = NULL;
+    spec.tcp_port = 0;
+    spec.unix_path = NULL;
+    spec.multicast_group = NULL;
+    spec.max_sources = 0;
+    spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    spec.max_buffer_length = 0;
+    spec.concealment = ATOLLA_SINK_CONCEAL_INTERPOLATE;
+    spec.connect_borrowers = false;
+    spec.socket_options = NULL;
+
+    AtollaSink sink = atolla_sink_make(&spec);
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    udp_socket_init(&source_sock);
+    udp_socket_set_receiver(&source_sock, "localhost", port);
+    msg_builder_init(&builder);
+
+    // Long frames, so the timing of the test has some leeway
+    const uint8_t long_frame_length = 40;
+    send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, long_frame_length, 8, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, 0));
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+
+    // Frames 1 to 3 are lost
+    const uint8_t dark[3] = { 0, 100, 200 };
+    const uint8_t bright[3] = { 200, 100, 0 };
+    send_to_sink(sink, &source_sock, msg_builder_enqueue(&builder, 0, dark, 3));
+    send_to_sink(sink, &source_sock, msg_builder_enqueue(&builder, 4, bright, 3));
+
+    const uint8_t expected[5][3] = {
+        { 0, 100, 200 }, { 50, 100, 150 }, { 100, 100, 100 }, { 150, 100, 50 }, { 200, 100, 0 }
+    };
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(expected[0], got_frame, 3);
+    time_sleep(long_frame_length / 2);
+    for(int i = 1; i < 5; ++i)
+    {
+        time_sleep(long_frame_length);
+        assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+        assert_memory_equal(expected[i], got_frame, 3);
+    }
+
+    atolla_sink_free(sink);
+    udp_socket_free(&source_sock);
+    msg_builder_free(&builder);
+}
+
+/**
+ * Tests a sink in storage of the caller, which must work just like one on the heap.
+ */
+static void test_init_in_storage(void **state)
+{
+    static uint8_t storage[ATOLLA_SINK_STORAGE_SIZE(lights_count, buffered_frame_count)];
+
+    AtollaSinkSpec spec;
+    spec.port = port;
+    spec.lights_count = lights_count;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.shm_name = NULL;
+    spec.tcp_port = 0;
+    spec.unix_path = NULL;
+    spec.multicast_group = NULL;
+    spec.max_sources = 0;
+    spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    spec.max_buffer_length = buffered_frame_count;
+    spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    spec.connect_borrowers = false;
+    spec.socket_options = NULL;
+
+    assert_true(atolla_sink_storage_size(&spec) <= sizeof(storage));
+
+    AtollaSink sink = atolla_sink_init_in(&spec, storage, sizeof(storage));
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+    assert_true(sink.internal >= (void*) storage && sink.internal < (void*) (storage + sizeof(storage)));
+
+    UdpSocket source_sock;
+    MsgBuilder builder;
+    udp_socket_init(&source_sock);
+    udp_socket_set_receiver(&source_sock, "localhost", port);
+    msg_builder_init(&builder);
+
+    // Borrow twice, the second time after the first source went away
+    for(int borrow = 0; borrow < 2; ++borrow)
+    {
+        send_to_sink(sink, &source_sock, msg_builder_borrow(&builder, frame_length, buffered_frame_count, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, 0));
+        assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+        time_sleep(loopback_send_time_ms);
+        assert_int_not_equal(-1, receive_from_sink(&source_sock, 1)); // LENT
+
+        const uint8_t color[3] = { 9, 8, (uint8_t) borrow };
+        send_to_sink(sink, &source_sock, msg_builder_enqueue(&builder, 0, color, 3));
+
+        uint8_t got_frame[3];
+        assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+        assert_memory_equal(color, got_frame, 3);
+
+        // A malformed frame drops the source
+        send_to_sink(sink, &source_sock, msg_builder_enqueue(&builder, 1, color, 1));
+        assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+        receive_from_sink(&source_sock, 255);
+    }
+
+    atolla_sink_free(sink);
+    udp_socket_free(&source_sock);
+    msg_builder_free(&builder);
+}
+
+/**
+ * Tests that borrowers get a socket of their own, which only receives what
+ * they send, while others are still answered through the socket of the sink.
+ */
+static void test_connect_borrowers(void **state)
+{
+    AtollaSinkSpec spec;
+    spec.port = port;
+    spec.lights_count = lights_count;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.shm_name = NULL;
+    spec.tcp_port = 0;
+    spec.unix_path = NULL;
+    spec.multicast_group = NULL;
+    spec.max_sources = 0;
+    spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    spec.max_buffer_length = 0;
+    spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    spec.connect_borrowers = true;
+    spec.socket_options = NULL;
+
+    AtollaSink sink = atolla_sink_make(&spec);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+    // One descriptor cannot cover the sockets of the borrowers
+    assert_int_equal(-1, atolla_sink_poll_fd(sink));
+
+    UdpSocket socks[2];
+    MsgBuilder builders[2];
+    for(int i = 0; i < 2; ++i)
+    {
+        udp_socket_init(&socks[i]);
+        udp_socket_set_receiver(&socks[i], "localhost", port);
+        msg_builder_init(&builders[i]);
+    }
+
+    send_to_sink(sink, &socks[0], msg_builder_borrow(&builders[0], frame_length, buffered_frame_count, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, MSG_CAPABILITY_ENQUEUE16));
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+    time_sleep(loopback_send_time_ms);
+    assert_int_not_equal(-1, receive_from_sink(&socks[0], MSG_TYPE_LENT));
+
+    // Frames of the borrower arrive on its own socket
+    const uint8_t frame[3] = { 4, 5, 6 };
+    send_to_sink(sink, &socks[0], msg_builder_enqueue16(&builders[0], 0, frame, 3));
+    uint8_t got_frame[3];
+    assert_true(atolla_sink_get(sink, got_frame, sizeof(got_frame)));
+    assert_memory_equal(frame, got_frame, sizeof(frame));
+
+    // Others end up at the socket of the sink and are turned away there
+    const uint8_t foreign_frame[3] = { 255, 0, 0 };
+    send_to_sink(sink, &socks[1], msg_builder_enqueue16(&builders[1], 0, foreign_frame, 3));
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_ERROR_CODE_LENT_TO_OTHER_SOURCE, receive_from_sink(&socks[1], MSG_TYPE_FAIL));
+
+    AtollaSinkStats stats;
+    atolla_sink_stats(sink, &stats);
+    assert_int_equal(1, stats.foreign_count);
+
+    // The borrower is still answered through its own socket
+    send_to_sink(sink, &socks[0], msg_builder_borrow(&builders[0], frame_length, buffered_frame_count, ATOLLA_PIXEL_FORMAT_RGB8, 0, 255, MSG_CAPABILITY_ENQUEUE16));
+    time_sleep(loopback_send_time_ms);
+    assert_int_not_equal(-1, receive_from_sink(&socks[0], MSG_TYPE_LENT));
+
+    atolla_sink_free(sink);
+    free_two(socks, builders);
+}
+
+/**
+ * Tests that requested socket options are applied and reported back.
+ */
+static void test_socket_options(void **state)
+{
+    AtollaSocketOptions options;
+    options.recv_buf_len = 65536;
+    options.send_buf_len = 0;
+    options.busy_poll_us = 0;
+    options.dscp = 46;
+    options.priority = 0;
+
+    AtollaSinkSpec spec;
+    spec.port = port;
+    spec.lights_count = lights_count;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.shm_name = NULL;
+    spec.tcp_port = 0;
+    spec.unix_path = NULL;
+    spec.multicast_group = NULL;
+    spec.max_sources = 0;
+    spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    spec.max_buffer_length = 0;
+    spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    spec.connect_borrowers = false;
+    spec.socket_options = &options;
+
+    AtollaSink sink = atolla_sink_make(&spec);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+
+    AtollaSocketOptions effective;
+    assert_true(atolla_sink_socket_options(sink, &effective));
+    assert_true(effective.recv_buf_len >= options.recv_buf_len);
+    assert_true(effective.send_buf_len > 0);
+    assert_int_equal(46, effective.dscp);
+
+    atolla_sink_free(sink);
+}
+
 static void test_error_if_port_in_use(void **state)
 {
     AtollaSinkSpec spec;
     spec.port = 11110;
     spec.lights_count = lights_count;
+    spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    spec.shm_name = NULL;
+    spec.tcp_port = 0;
+    spec.unix_path = NULL;
+    spec.multicast_group = NULL;
+    spec.max_sources = 0;
+    spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    spec.max_buffer_length = 0;
+    spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    spec.connect_borrowers = false;
+    spec.socket_options = NULL;
 
     AtollaSink sink1 = atolla_sink_make(&spec);
     assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink1));
@@ -228,9 +1209,30 @@ static void test_error_if_port_in_use(void **state)
 int main(void)
 {
     const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_selected_backend),
         cmocka_unit_test(test_fill_sink_buf),
         cmocka_unit_test(test_lend_resend),
         cmocka_unit_test(test_get_repeat_pattern),
+        cmocka_unit_test(test_expand_rgb565),
+        cmocka_unit_test(test_refuse_unsupported_pixel_format),
+        cmocka_unit_test(test_composite_htp),
+        cmocka_unit_test(test_composite_ltp),
+        cmocka_unit_test(test_composite_alpha),
+        cmocka_unit_test(test_composite_overlay_timeout),
+        cmocka_unit_test(test_max_buffer_length),
+        cmocka_unit_test(test_enqueue16),
+        cmocka_unit_test(test_enqueue16_resync),
+        cmocka_unit_test(test_enqueue_late_join),
+        cmocka_unit_test(test_nack),
+        cmocka_unit_test(test_presentation_time),
+        cmocka_unit_test(test_effect),
+        cmocka_unit_test(test_poll),
+        cmocka_unit_test(test_flood),
+        cmocka_unit_test(test_discover_flood),
+        cmocka_unit_test(test_conceal_interpolate),
+        cmocka_unit_test(test_init_in_storage),
+        cmocka_unit_test(test_connect_borrowers),
+        cmocka_unit_test(test_socket_options),
         cmocka_unit_test(test_error_if_port_in_use)
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -6,6 +6,8 @@
 #include "time/now.h"
 #include "test/assert.h"
 
+#include <poll.h>
+
 extern "C" {
     #include <stdarg.h>
     #include <stddef.h>
@@ -68,6 +70,7 @@ static void setup_waiting_source(AtollaSource *source, UdpSocket* sink_socket, M
     assert_int_equal(MSG_TYPE_BORROW, msg_iter_type(&iter));
     assert_int_equal(frame_ms, msg_iter_borrow_frame_length(&iter));
     assert_int_equal(buffered_frame_count, msg_iter_borrow_buffer_length(&iter));
+    assert_int_equal(MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_NACK | MSG_CAPABILITY_PTS | MSG_CAPABILITY_EFFECT, msg_iter_borrow_capabilities(&iter));
 
     mem_block_free(&receive_block);
 }
@@ -77,7 +80,7 @@ static void setup_open_source(AtollaSource *source, UdpSocket* sink_socket, MsgB
     setup_waiting_source(source, sink_socket, builder);
 
     // send back a lent and wait
-    MemBlock* msg = msg_builder_lent(builder);
+    MemBlock* msg = msg_builder_lent(builder, 0);
 
     UdpSocketResult res = udp_socket_send(sink_socket, msg->data, msg->size);
     assert_int_equal(res.code, UDP_SOCKET_OK);
@@ -90,7 +93,7 @@ static void setup_open_source(AtollaSource *source, UdpSocket* sink_socket, MsgB
 
 static void send_relent(UdpSocket* sink_socket, MsgBuilder* builder)
 {
-    MemBlock* msg = msg_builder_lent(builder);
+    MemBlock* msg = msg_builder_lent(builder, 0);
     UdpSocketResult res = udp_socket_send(sink_socket, msg->data, msg->size);
     assert_int_equal(res.code, UDP_SOCKET_OK);
 }
@@ -291,6 +294,49 @@ static void test_blocking(void **state)
     teardown_source(&source, &sink_socket, &builder);
 }
 
+/**
+ * Tests that puts waiting for the sink are counted in the pacing histogram
+ * and are sent close to their deadline.
+ */
+static void test_pacing(void **state)
+{
+    AtollaSource source;
+    UdpSocket sink_socket;
+    MsgBuilder builder;
+
+    setup_open_source(&source, &sink_socket, &builder);
+
+    AtollaSourcePacing pacing;
+    atolla_source_pacing(source, &pacing);
+    assert_int_equal(0, pacing.paced_count);
+
+    const size_t frame_len = 3;
+    uint8_t frame[frame_len] = { 200, 201, 202 };
+    const int paced_frame_count = 10;
+
+    // The first frames fill the buffer of the sink right away, the rest has to wait
+    for(int i = 0; i < (buffered_frame_count + paced_frame_count); ++i)
+    {
+        atolla_source_put(source, frame, frame_len);
+        send_relent(&sink_socket, &builder);
+    }
+
+    atolla_source_pacing(source, &pacing);
+    assert_in_range(pacing.paced_count, paced_frame_count - 1, paced_frame_count);
+
+    unsigned int histogram_count = 0;
+    for(int i = 0; i < ATOLLA_SOURCE_PACING_BUCKETS; ++i)
+    {
+        histogram_count += pacing.histogram[i];
+    }
+    assert_int_equal(pacing.paced_count, histogram_count);
+
+    // Generous, loaded machines may wake up late, but not by a whole frame
+    assert_true(pacing.late_us_max < frame_ms * 1000);
+
+    teardown_source(&source, &sink_socket, &builder);
+}
+
 static void test_frame_lag(void **state)
 {
     AtollaSource source;
@@ -390,6 +436,271 @@ static void test_drop_after_no_relend(void **state)
     teardown_source(&source, &sink_socket, &builder);
 }
 
+/**
+ * Sinks that grant ENQUEUE16 receive frames with 16-bit sequence numbers.
+ */
+static void test_enqueue16_when_granted(void **state)
+{
+    AtollaSource source;
+    UdpSocket sink_socket;
+    MsgBuilder builder;
+
+    setup_waiting_source(&source, &sink_socket, &builder);
+
+    MemBlock* msg = msg_builder_lent(&builder, MSG_CAPABILITY_ENQUEUE16);
+    udp_socket_send(&sink_socket, msg->data, msg->size);
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, atolla_source_state(source));
+
+    MemBlock receive_block = mem_block_alloc(1024);
+    uint8_t frame[3] = { 1, 2, 3 };
+    for(int i = 0; i < 2; ++i)
+    {
+        assert_true(atolla_source_put(source, frame, sizeof(frame)));
+        time_sleep(loopback_send_time_ms);
+
+        UdpSocketResult res = udp_socket_receive(&sink_socket, receive_block.data, receive_block.capacity, &receive_block.size, true);
+        assert_int_equal(UDP_SOCKET_OK, res.code);
+
+        MsgIter iter = msg_iter_make(receive_block.data, receive_block.size);
+        assert_int_equal(MSG_TYPE_ENQUEUE16, msg_iter_type(&iter));
+        assert_int_equal(i, msg_iter_enqueue16_frame_seq(&iter));
+        assert_int_equal(sizeof(frame), msg_iter_enqueue16_frame(&iter).size);
+    }
+
+    mem_block_free(&receive_block);
+    teardown_source(&source, &sink_socket, &builder);
+}
+
+/**
+ * Frames that the sink reports missing are sent again while they are kept and
+ * not yet due.
+ */
+static void test_resend_on_nack(void **state)
+{
+    AtollaSource source;
+    UdpSocket sink_socket;
+    MsgBuilder builder;
+
+    setup_waiting_source(&source, &sink_socket, &builder);
+
+    MemBlock* msg = msg_builder_lent(&builder, MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_NACK);
+    udp_socket_send(&sink_socket, msg->data, msg->size);
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, atolla_source_state(source));
+
+    MemBlock receive_block = mem_block_alloc(1024);
+    for(int i = 0; i < 10; ++i)
+    {
+        uint8_t frame[3] = { (uint8_t) i, (uint8_t) i, (uint8_t) i };
+        assert_true(atolla_source_put(source, frame, sizeof(frame)));
+        time_sleep(loopback_send_time_ms);
+        udp_socket_receive(&sink_socket, receive_block.data, receive_block.capacity, &receive_block.size, true);
+    }
+
+    // The sink shows a frame every frame_ms from the first one on, so frame 1
+    // is due by now, frame 9 is still ahead and frame 40 was never sent
+    const uint16_t missing[] = { 1, 9, 40 };
+    msg = msg_builder_nack(&builder, missing, 3);
+    udp_socket_send(&sink_socket, msg->data, msg->size);
+    time_sleep(loopback_send_time_ms);
+    atolla_source_state(source);
+    time_sleep(loopback_send_time_ms);
+
+    UdpSocketResult res = udp_socket_receive(&sink_socket, receive_block.data, receive_block.capacity, &receive_block.size, true);
+    assert_int_equal(UDP_SOCKET_OK, res.code);
+    MsgIter iter = msg_iter_make(receive_block.data, receive_block.size);
+    assert_int_equal(MSG_TYPE_ENQUEUE16, msg_iter_type(&iter));
+    assert_int_equal(9, msg_iter_enqueue16_frame_seq(&iter));
+    assert_int_equal(9, ((uint8_t*) msg_iter_enqueue16_frame(&iter).data)[0]);
+
+    res = udp_socket_receive(&sink_socket, receive_block.data, receive_block.capacity, &receive_block.size, true);
+    assert_int_not_equal(UDP_SOCKET_OK, res.code);
+
+    mem_block_free(&receive_block);
+    teardown_source(&source, &sink_socket, &builder);
+}
+
+/**
+ * With presentation times granted, the source answers the sink clock in LENT
+ * with CLOCK and stamps each frame with the time it is due on its own clock.
+ */
+static void test_pts_when_granted(void **state)
+{
+    AtollaSource source;
+    UdpSocket sink_socket;
+    MsgBuilder builder;
+
+    setup_waiting_source(&source, &sink_socket, &builder);
+
+    const uint32_t sink_time_us = 12345;
+    MemBlock* msg = msg_builder_lent_clock(&builder, MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_PTS, sink_time_us);
+    udp_socket_send(&sink_socket, msg->data, msg->size);
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, atolla_source_state(source));
+    time_sleep(loopback_send_time_ms);
+
+    MemBlock receive_block = mem_block_alloc(1024);
+    UdpSocketResult res = udp_socket_receive(&sink_socket, receive_block.data, receive_block.capacity, &receive_block.size, true);
+    assert_int_equal(UDP_SOCKET_OK, res.code);
+    MsgIter iter = msg_iter_make(receive_block.data, receive_block.size);
+    assert_int_equal(MSG_TYPE_CLOCK, msg_iter_type(&iter));
+    assert_true(msg_iter_clock_valid(&iter));
+    assert_int_equal(sink_time_us, msg_iter_clock_sink_time(&iter));
+    uint32_t since_clock_us = (uint32_t) time_now_us() - msg_iter_clock_source_time(&iter);
+    assert_true(since_clock_us < 1000000);
+
+    uint32_t first_time_us = 0;
+    uint8_t frame[3] = { 1, 2, 3 };
+    for(int i = 0; i < 2; ++i)
+    {
+        assert_true(atolla_source_put(source, frame, sizeof(frame)));
+        uint32_t put_time_us = (uint32_t) time_now_us();
+        time_sleep(loopback_send_time_ms);
+
+        res = udp_socket_receive(&sink_socket, receive_block.data, receive_block.capacity, &receive_block.size, true);
+        assert_int_equal(UDP_SOCKET_OK, res.code);
+
+        iter = msg_iter_make(receive_block.data, receive_block.size);
+        assert_int_equal(MSG_TYPE_ENQUEUE_PTS, msg_iter_type(&iter));
+        assert_true(msg_iter_enqueue_pts_valid(&iter));
+        assert_int_equal(i, msg_iter_enqueue_pts_frame_seq(&iter));
+        assert_int_equal(sizeof(frame), msg_iter_enqueue_pts_frame(&iter).size);
+
+        uint32_t presentation_time_us = msg_iter_enqueue_pts_time(&iter);
+        if(i == 0)
+        {
+            // Due no earlier than one frame from now, and no later than two
+            int32_t ahead_us = (int32_t) (presentation_time_us - put_time_us);
+            assert_true(ahead_us > 0 && ahead_us <= 2 * frame_ms * 1000);
+            first_time_us = presentation_time_us;
+        }
+        else
+        {
+            assert_int_equal(frame_ms * 1000, presentation_time_us - first_time_us);
+        }
+    }
+
+    mem_block_free(&receive_block);
+    teardown_source(&source, &sink_socket, &builder);
+}
+
+/**
+ * Effects are sent once and then repeated, until a frame is put.
+ */
+static void test_effect(void **state)
+{
+    AtollaSource source;
+    UdpSocket sink_socket;
+    MsgBuilder builder;
+
+    setup_waiting_source(&source, &sink_socket, &builder);
+
+    const uint8_t from[3] = { 1, 2, 3 };
+    const uint8_t to[3] = { 4, 5, 6 };
+
+    MemBlock* msg = msg_builder_lent(&builder, MSG_CAPABILITY_ENQUEUE16);
+    udp_socket_send(&sink_socket, msg->data, msg->size);
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, atolla_source_state(source));
+
+    // The sink did not grant effects
+    assert_false(atolla_source_effect(source, ATOLLA_EFFECT_SINE, from, to, 10, 1000));
+    teardown_source(&source, &sink_socket, &builder);
+
+    setup_waiting_source(&source, &sink_socket, &builder);
+    msg = msg_builder_lent(&builder, MSG_CAPABILITY_ENQUEUE16 | MSG_CAPABILITY_EFFECT);
+    udp_socket_send(&sink_socket, msg->data, msg->size);
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, atolla_source_state(source));
+
+    assert_true(atolla_source_effect(source, ATOLLA_EFFECT_SINE, from, to, 10, 1000));
+
+    MemBlock receive_block = mem_block_alloc(1024);
+    for(int repetition = 0; repetition < 2; ++repetition)
+    {
+        time_sleep(repetition * 300 + loopback_send_time_ms);
+        send_relent(&sink_socket, &builder);
+        atolla_source_state(source);
+        time_sleep(loopback_send_time_ms);
+
+        UdpSocketResult res = udp_socket_receive(&sink_socket, receive_block.data, receive_block.capacity, &receive_block.size, true);
+        assert_int_equal(UDP_SOCKET_OK, res.code);
+        MsgIter iter = msg_iter_make(receive_block.data, receive_block.size);
+        assert_int_equal(MSG_TYPE_EFFECT, msg_iter_type(&iter));
+        assert_true(msg_iter_effect_valid(&iter));
+        assert_int_equal(ATOLLA_EFFECT_SINE, msg_iter_effect(&iter));
+        assert_int_equal(10, msg_iter_effect_wavelength(&iter));
+        assert_int_equal(1000, msg_iter_effect_period(&iter));
+        MemBlock colors = msg_iter_effect_colors(&iter);
+        assert_int_equal(6, colors.size);
+        assert_memory_equal(from, colors.data, 3);
+        assert_memory_equal(to, ((uint8_t*) colors.data) + 3, 3);
+    }
+
+    // After a frame, the effect is no longer repeated
+    assert_true(atolla_source_put(source, from, sizeof(from)));
+    time_sleep(loopback_send_time_ms);
+    udp_socket_receive(&sink_socket, receive_block.data, receive_block.capacity, &receive_block.size, true);
+    time_sleep(300);
+    send_relent(&sink_socket, &builder);
+    atolla_source_state(source);
+    time_sleep(loopback_send_time_ms);
+    UdpSocketResult res = udp_socket_receive(&sink_socket, receive_block.data, receive_block.capacity, &receive_block.size, true);
+    assert_int_not_equal(UDP_SOCKET_OK, res.code);
+
+    mem_block_free(&receive_block);
+    teardown_source(&source, &sink_socket, &builder);
+}
+
+/**
+ * Event loops wait on the descriptor for messages from the sink and wake up in
+ * time for retries, timeouts and frames that are due.
+ */
+static void test_poll(void **state)
+{
+    AtollaSource source;
+    UdpSocket sink_socket;
+    MsgBuilder builder;
+
+    setup_waiting_source(&source, &sink_socket, &builder);
+
+    struct pollfd fd = { atolla_source_poll_fd(source), POLLIN, 0 };
+    assert_true(fd.fd >= 0);
+
+    // Waiting for LENT, the next borrow is due within the retry timeout
+    int timeout_ms = atolla_source_poll_timeout(source);
+    assert_in_range(timeout_ms, 0, retry_timeout_ms + 1);
+
+    send_relent(&sink_socket, &builder);
+    assert_int_equal(1, poll(&fd, 1, 1000));
+    assert_true(fd.revents & POLLIN);
+
+    // Handling the LENT opens the source and leaves nothing to read
+    timeout_ms = atolla_source_poll_timeout(source);
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, atolla_source_state(source));
+    assert_int_equal(0, poll(&fd, 1, 0));
+
+    // Nothing is put yet, so only the disconnect timeout is left
+    assert_in_range(timeout_ms, disconnect_timeout_ms - 50, disconnect_timeout_ms);
+
+    // With a full buffer, the source wakes up for the next frame
+    uint8_t frame[3] = { 0, 0, 0 };
+    while(atolla_source_put_ready_count(source) > 0)
+    {
+        assert_true(atolla_source_put(source, frame, sizeof(frame)));
+    }
+    assert_in_range(atolla_source_poll_timeout(source), 1, frame_ms);
+
+    // Once the sink is gone, there is nothing to wait for
+    time_sleep(disconnect_timeout_ms + loopback_send_time_ms);
+    assert_int_equal(-1, atolla_source_poll_timeout(source));
+    assert_int_equal(ATOLLA_SOURCE_STATE_ERROR, atolla_source_state(source));
+    assert_int_equal(-1, atolla_source_poll_fd(source));
+
+    teardown_source(&source, &sink_socket, &builder);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -397,9 +708,15 @@ int main(void)
         cmocka_unit_test(test_error_transition),
         cmocka_unit_test(test_timing),
         cmocka_unit_test(test_blocking),
+        cmocka_unit_test(test_pacing),
         cmocka_unit_test(test_frame_lag),
         cmocka_unit_test(test_borrow_packet_loss),
-        cmocka_unit_test(test_drop_after_no_relend)
+        cmocka_unit_test(test_drop_after_no_relend),
+        cmocka_unit_test(test_enqueue16_when_granted),
+        cmocka_unit_test(test_resend_on_nack),
+        cmocka_unit_test(test_pts_when_granted),
+        cmocka_unit_test(test_effect),
+        cmocka_unit_test(test_poll)
         // TODO test blocking with mock function for sleep
         // TODO test spec->async_make set to true
     };
@@ -1,6 +1,14 @@
 #include "atolla/source.h"
 #include "atolla/sink.h"
+#include "atolla/discover.h"
 #include "time/sleep.h"
+#include "time/now.h"
+#include "udp_socket/udp_socket.h"
+
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
 
 extern "C" {
     #include <stdarg.h>
@@ -13,6 +21,21 @@ const int port = 10001;
 const int frame_duration_ms = 30;
 static const int loopback_send_time_ms = 5;
 
+/**
+ * Makes sure that the io_uring rerun of these tests does not silently fall
+ * back to the BSD backend.
+ */
+static void test_selected_backend(void **state)
+{
+    const char* backend_name = getenv("ATOLLA_UDP_BACKEND");
+    bool want_uring = backend_name != NULL && strcmp(backend_name, "io_uring") == 0;
+
+    UdpSocket sock;
+    assert_int_equal(udp_socket_init(&sock).code, UDP_SOCKET_OK);
+    assert_int_equal(udp_socket_backend(&sock), want_uring ? UDP_SOCKET_BACKEND_IO_URING : UDP_SOCKET_BACKEND_BSD);
+    udp_socket_free(&sock);
+}
+
 static void test_connect(void **state)
 {
     AtollaSourceSpec source_spec;
@@ -23,10 +46,28 @@ static void test_connect(void **state)
     source_spec.retry_timeout_ms = 0;
     source_spec.disconnect_timeout_ms = 0;
     source_spec.async_make = true;
+    source_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    source_spec.multicast_ttl = 0;
+    source_spec.priority = 0;
+    source_spec.opacity = 0;
+    source_spec.pacing_spin_us = 0;
+    source_spec.retransmit_frames = 0;
+    source_spec.socket_options = NULL;
 
     AtollaSinkSpec sink_spec;
     sink_spec.port = port;
     sink_spec.lights_count = 1;
+    sink_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    sink_spec.shm_name = NULL;
+    sink_spec.tcp_port = 0;
+    sink_spec.unix_path = NULL;
+    sink_spec.multicast_group = NULL;
+    sink_spec.max_sources = 0;
+    sink_spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    sink_spec.max_buffer_length = 0;
+    sink_spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    sink_spec.connect_borrowers = false;
+    sink_spec.socket_options = NULL;
 
     AtollaSink sink = atolla_sink_make(&sink_spec);
     assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
@@ -55,10 +96,28 @@ static void test_stream_rising(void **state)
     source_spec.retry_timeout_ms = 0;
     source_spec.disconnect_timeout_ms = 0;
     source_spec.async_make = true;
+    source_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    source_spec.multicast_ttl = 0;
+    source_spec.priority = 0;
+    source_spec.opacity = 0;
+    source_spec.pacing_spin_us = 0;
+    source_spec.retransmit_frames = 0;
+    source_spec.socket_options = NULL;
 
     AtollaSinkSpec sink_spec;
     sink_spec.port = port;
     sink_spec.lights_count = 1;
+    sink_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    sink_spec.shm_name = NULL;
+    sink_spec.tcp_port = 0;
+    sink_spec.unix_path = NULL;
+    sink_spec.multicast_group = NULL;
+    sink_spec.max_sources = 0;
+    sink_spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    sink_spec.max_buffer_length = 0;
+    sink_spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    sink_spec.connect_borrowers = false;
+    sink_spec.socket_options = NULL;
 
     AtollaSink sink = atolla_sink_make(&sink_spec);
     assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
@@ -103,11 +162,307 @@ static void test_stream_rising(void **state)
     atolla_sink_free(sink);
 }
 
+static void test_stream_local(void **state)
+{
+    AtollaSourceSpec source_spec;
+    source_spec.sink_hostname = "shm://source_to_sink_tests";
+    source_spec.sink_port = 0;
+    source_spec.frame_duration_ms = frame_duration_ms;
+    source_spec.max_buffered_frames = 0;
+    source_spec.retry_timeout_ms = 0;
+    source_spec.disconnect_timeout_ms = 0;
+    source_spec.async_make = true;
+    source_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    source_spec.multicast_ttl = 0;
+    source_spec.priority = 0;
+    source_spec.opacity = 0;
+    source_spec.pacing_spin_us = 0;
+    source_spec.retransmit_frames = 0;
+    source_spec.socket_options = NULL;
+
+    AtollaSinkSpec sink_spec;
+    sink_spec.port = port;
+    sink_spec.lights_count = 1;
+    sink_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    sink_spec.shm_name = "source_to_sink_tests";
+    sink_spec.tcp_port = 0;
+    sink_spec.unix_path = NULL;
+    sink_spec.multicast_group = NULL;
+    sink_spec.max_sources = 0;
+    sink_spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    sink_spec.max_buffer_length = 0;
+    sink_spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    sink_spec.connect_borrowers = false;
+    sink_spec.socket_options = NULL;
+
+    AtollaSink sink = atolla_sink_make(&sink_spec);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+
+    AtollaSource source = atolla_source_make(&source_spec);
+    assert_int_equal(ATOLLA_SOURCE_STATE_WAITING, atolla_source_state(source));
+
+    // Shared memory needs no time to deliver
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, atolla_source_state(source));
+
+    const int buffered_frame_count = atolla_source_put_ready_count(source);
+    for(uint8_t i = 0; i < buffered_frame_count; ++i)
+    {
+        uint8_t frame[3] = { i, i, i };
+        assert_true(atolla_source_put(source, frame, 3));
+    }
+
+    for(uint8_t i = 0; i < buffered_frame_count; ++i)
+    {
+        uint8_t frame[3] = { (uint8_t) ~i, (uint8_t) ~i, (uint8_t) ~i };
+        atolla_sink_state(sink); // update the sink
+        bool ok = atolla_sink_get(sink, frame, 3);
+
+        if(ok) {
+            int diff = ((int) i) - ((int) frame[0]);
+            if(diff < 0) diff = -diff;
+            assert_true(diff <= 1);
+            time_sleep(frame_duration_ms);
+        } else {
+            --i;
+        }
+    }
+
+    atolla_source_free(source);
+    atolla_sink_free(sink);
+}
+
+static void stream_connected(const char* sink_hostname, int tcp_port, const char* unix_path)
+{
+    AtollaSourceSpec source_spec;
+    source_spec.sink_hostname = sink_hostname;
+    source_spec.sink_port = tcp_port;
+    source_spec.frame_duration_ms = frame_duration_ms;
+    source_spec.max_buffered_frames = 0;
+    source_spec.retry_timeout_ms = 0;
+    source_spec.disconnect_timeout_ms = 0;
+    source_spec.async_make = true;
+    source_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    source_spec.multicast_ttl = 0;
+    source_spec.priority = 0;
+    source_spec.opacity = 0;
+    source_spec.pacing_spin_us = 0;
+    source_spec.retransmit_frames = 0;
+    source_spec.socket_options = NULL;
+
+    AtollaSinkSpec sink_spec;
+    sink_spec.port = port;
+    sink_spec.lights_count = 1;
+    sink_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    sink_spec.shm_name = NULL;
+    sink_spec.tcp_port = tcp_port;
+    sink_spec.unix_path = unix_path;
+    sink_spec.multicast_group = NULL;
+    sink_spec.max_sources = 0;
+    sink_spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    sink_spec.max_buffer_length = 0;
+    sink_spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    sink_spec.connect_borrowers = false;
+    sink_spec.socket_options = NULL;
+
+    AtollaSink sink = atolla_sink_make(&sink_spec);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+
+    AtollaSource source = atolla_source_make(&source_spec);
+    assert_int_equal(ATOLLA_SOURCE_STATE_WAITING, atolla_source_state(source));
+
+    unsigned int give_up_time = time_now() + 1000;
+    while(atolla_source_state(source) == ATOLLA_SOURCE_STATE_WAITING && time_now() < give_up_time)
+    {
+        atolla_sink_state(sink);
+        time_sleep(1);
+    }
+
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, atolla_source_state(source));
+
+    const int buffered_frame_count = atolla_source_put_ready_count(source);
+    for(uint8_t i = 0; i < buffered_frame_count; ++i)
+    {
+        uint8_t frame[3] = { i, i, i };
+        assert_true(atolla_source_put(source, frame, 3));
+    }
+
+    time_sleep(loopback_send_time_ms);
+
+    // Stream transports do not lose or reorder frames
+    for(uint8_t i = 0; i < buffered_frame_count; ++i)
+    {
+        uint8_t frame[3] = { (uint8_t) ~i, (uint8_t) ~i, (uint8_t) ~i };
+        atolla_sink_state(sink); // update the sink
+        bool ok = atolla_sink_get(sink, frame, 3);
+
+        if(ok) {
+            int diff = ((int) i) - ((int) frame[0]);
+            if(diff < 0) diff = -diff;
+            assert_true(diff <= 1);
+            time_sleep(frame_duration_ms);
+        } else {
+            --i;
+        }
+    }
+
+    // The sink notices right away when the source hangs up
+    atolla_source_free(source);
+    time_sleep(loopback_send_time_ms);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+
+    atolla_sink_free(sink);
+}
+
+static void test_stream_tcp(void **state)
+{
+    stream_connected("tcp://localhost", port + 1, NULL);
+}
+
+static void test_stream_unix(void **state)
+{
+    stream_connected("unix:///tmp/atolla_source_to_sink_tests.sock", 0, "/tmp/atolla_source_to_sink_tests.sock");
+}
+
+static void test_stream_multicast(void **state)
+{
+    AtollaSourceSpec source_spec;
+    source_spec.sink_hostname = "239.255.42.99";
+    source_spec.sink_port = port;
+    source_spec.frame_duration_ms = frame_duration_ms;
+    source_spec.max_buffered_frames = 0;
+    source_spec.retry_timeout_ms = 0;
+    source_spec.disconnect_timeout_ms = 0;
+    source_spec.async_make = true;
+    source_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    source_spec.multicast_ttl = 0;
+    source_spec.priority = 0;
+    source_spec.opacity = 0;
+    source_spec.pacing_spin_us = 0;
+    source_spec.retransmit_frames = 0;
+    source_spec.socket_options = NULL;
+
+    AtollaSinkSpec sink_spec;
+    sink_spec.port = port;
+    sink_spec.lights_count = 1;
+    sink_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    sink_spec.shm_name = NULL;
+    sink_spec.tcp_port = 0;
+    sink_spec.unix_path = NULL;
+    sink_spec.multicast_group = "239.255.42.99";
+    sink_spec.max_sources = 0;
+    sink_spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    sink_spec.max_buffer_length = 0;
+    sink_spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    sink_spec.connect_borrowers = false;
+    sink_spec.socket_options = NULL;
+
+    AtollaSink sink = atolla_sink_make(&sink_spec);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+
+    AtollaSource source = atolla_source_make(&source_spec);
+    assert_int_equal(ATOLLA_SOURCE_STATE_WAITING, atolla_source_state(source));
+    time_sleep(loopback_send_time_ms);
+
+    atolla_sink_state(sink); // Let sink handle request and wait a bit
+    time_sleep(loopback_send_time_ms);
+
+    // The borrow went to the group, the lent came back by unicast
+    assert_int_equal(ATOLLA_SINK_STATE_LENT, atolla_sink_state(sink));
+    assert_int_equal(ATOLLA_SOURCE_STATE_OPEN, atolla_source_state(source));
+
+    const int buffered_frame_count = atolla_source_put_ready_count(source);
+    for(uint8_t i = 0; i < buffered_frame_count; ++i)
+    {
+        uint8_t frame[3] = { i, i, i };
+        assert_true(atolla_source_put(source, frame, 3));
+    }
+
+    time_sleep(loopback_send_time_ms);
+
+    for(uint8_t i = 0; i < buffered_frame_count; ++i)
+    {
+        uint8_t frame[3] = { (uint8_t) ~i, (uint8_t) ~i, (uint8_t) ~i };
+        atolla_sink_state(sink); // update the sink
+        bool ok = atolla_sink_get(sink, frame, 3);
+
+        if(ok) {
+            int diff = ((int) i) - ((int) frame[0]);
+            if(diff < 0) diff = -diff;
+            assert_true(diff <= 1);
+            time_sleep(frame_duration_ms);
+        } else {
+            --i;
+        }
+    }
+
+    atolla_source_free(source);
+    atolla_sink_free(sink);
+}
+
+static void test_discover(void **state)
+{
+    AtollaSinkSpec sink_spec;
+    sink_spec.port = port;
+    sink_spec.lights_count = 42;
+    sink_spec.pixel_format = ATOLLA_PIXEL_FORMAT_RGB8;
+    sink_spec.shm_name = NULL;
+    sink_spec.tcp_port = 0;
+    sink_spec.unix_path = NULL;
+    sink_spec.multicast_group = NULL;
+    sink_spec.max_sources = 0;
+    sink_spec.blend_mode = ATOLLA_SINK_BLEND_HTP;
+    sink_spec.max_buffer_length = 0;
+    sink_spec.concealment = ATOLLA_SINK_CONCEAL_REPEAT;
+    sink_spec.connect_borrowers = false;
+    sink_spec.socket_options = NULL;
+
+    AtollaSink sink = atolla_sink_make(&sink_spec);
+    assert_int_equal(ATOLLA_SINK_STATE_OPEN, atolla_sink_state(sink));
+
+    // Discovering blocks, so keep the sink answering on another thread
+    std::atomic<bool> discovering(true);
+    std::thread sink_thread([&]() {
+        while(discovering)
+        {
+            atolla_sink_state(sink);
+            time_sleep(1);
+        }
+    });
+
+    AtollaSinkInfo sinks[4];
+    size_t sinks_count = atolla_discover("localhost", port, 250, sinks, 4);
+
+    discovering = false;
+    sink_thread.join();
+
+    // Answers to repeated DISCOVER messages are only reported once
+    assert_int_equal(1, sinks_count);
+    assert_int_equal(port, sinks[0].port);
+    assert_int_equal(42, sinks[0].lights_count);
+    assert_true(sinks[0].min_frame_duration_ms > 0);
+    assert_int_equal(2, sinks[0].pixel_formats_count);
+    assert_int_equal(ATOLLA_PIXEL_FORMAT_RGB8, sinks[0].pixel_formats[0]);
+    assert_int_equal(ATOLLA_PIXEL_FORMAT_RGB565, sinks[0].pixel_formats[1]);
+
+    atolla_sink_free(sink);
+
+    // Nobody answers anymore
+    assert_int_equal(0, atolla_discover("localhost", port, 50, sinks, 4));
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_selected_backend),
         cmocka_unit_test(test_connect),
-        cmocka_unit_test(test_stream_rising)
+        cmocka_unit_test(test_stream_rising),
+        cmocka_unit_test(test_stream_local),
+        cmocka_unit_test(test_stream_tcp),
+        cmocka_unit_test(test_stream_unix),
+        cmocka_unit_test(test_stream_multicast),
+        cmocka_unit_test(test_discover)
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -1,5 +1,6 @@
 #include "time/now.h"
 #include "time/sleep.h"
+#include "time/sleep_until.h"
 
 extern "C" {
     #include <stdarg.h>
@@ -26,10 +27,33 @@ static void test_delta(void **state)
                     chosen_delta + tolerance);
 }
 
+static void test_sleep_until(void **state)
+{
+    const unsigned long long interval_us = 16667;
+    const unsigned long long tolerance_us = 5000;
+    unsigned long long deadline_us = time_now_us();
+
+    // Deadlines are absolute, so being late once does not shift later frames
+    for(int i = 0; i < 10; ++i)
+    {
+        deadline_us += interval_us;
+        unsigned long long late_us = time_sleep_until_us(deadline_us, (i % 2 == 0) ? 0 : 200);
+        unsigned long long now_us = time_now_us();
+
+        assert_true(now_us >= deadline_us);
+        assert_true(late_us <= now_us - deadline_us);
+        assert_true(late_us < tolerance_us);
+    }
+
+    // Deadlines in the past return right away
+    assert_int_equal(0, time_sleep_until_us(deadline_us - interval_us, 0));
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_delta),
+        cmocka_unit_test(test_sleep_until),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
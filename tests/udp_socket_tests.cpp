@@ -4,8 +4,11 @@
 extern "C" {
     #include <cmocka.h>
 }
+#include "udp_socket/udp_resolver.h"
 #include "udp_socket/udp_socket.h"
 #include "time/sleep.h"
+#include <stdlib.h>
+#include <string.h>
 
 static void test_init_null(void** state)
 {
@@ -89,6 +92,199 @@ static void test_connect_invalid_hostname(void** state)
     assert_int_equal(result.code, UDP_SOCKET_OK);
 }
 
+static UdpResolveStatus await_resolve(UdpResolve* resolve, UdpEndpoint* endpoint)
+{
+    UdpResolveStatus status;
+    while((status = udp_resolve_poll(resolve, endpoint)) == UDP_RESOLVE_PENDING)
+    {
+        time_sleep(1);
+    }
+    return status;
+}
+
+static void test_resolve_numeric(void** state)
+{
+    UdpEndpoint expected;
+    assert_int_equal(udp_endpoint_resolve(&expected, "127.0.0.1", 8080).code, UDP_SOCKET_OK);
+
+    // Numeric addresses need no lookup and are done right away
+    UdpResolve resolve;
+    UdpEndpoint endpoint;
+    udp_resolve_start(&resolve, "127.0.0.1", 8080);
+    assert_int_equal(udp_resolve_poll(&resolve, &endpoint), UDP_RESOLVE_DONE);
+    assert_true(udp_endpoint_equal(&expected, &endpoint));
+    udp_resolve_free(&resolve);
+}
+
+static void test_resolve_hostname_and_cache(void** state)
+{
+    udp_resolver_cache_clear();
+
+    UdpResolve resolve;
+    UdpEndpoint endpoint;
+    udp_resolve_start(&resolve, "localhost", 8080);
+    assert_int_equal(await_resolve(&resolve, &endpoint), UDP_RESOLVE_DONE);
+    udp_resolve_free(&resolve);
+
+    UdpEndpoint expected;
+    assert_int_equal(udp_endpoint_resolve(&expected, "localhost", 8080).code, UDP_SOCKET_OK);
+    assert_true(udp_endpoint_equal(&expected, &endpoint));
+
+    // The second lookup is answered from the cache, with its own port
+    udp_resolve_start(&resolve, "localhost", 9090);
+    assert_int_equal(udp_resolve_poll(&resolve, &endpoint), UDP_RESOLVE_DONE);
+    udp_resolve_free(&resolve);
+
+    assert_int_equal(udp_endpoint_resolve(&expected, "localhost", 9090).code, UDP_SOCKET_OK);
+    assert_true(udp_endpoint_equal(&expected, &endpoint));
+}
+
+static void test_resolve_shared_lookup(void** state)
+{
+    udp_resolver_cache_clear();
+
+    // Both lookups complete, no matter whether they shared a helper thread
+    UdpResolve first;
+    UdpResolve second;
+    UdpEndpoint endpoint;
+    udp_resolve_start(&first, "localhost", 8080);
+    udp_resolve_start(&second, "localhost", 8081);
+    assert_int_equal(await_resolve(&second, &endpoint), UDP_RESOLVE_DONE);
+    assert_int_equal(await_resolve(&first, &endpoint), UDP_RESOLVE_DONE);
+    udp_resolve_free(&first);
+    udp_resolve_free(&second);
+
+    // Abandoning a pending lookup is fine too
+    udp_resolver_cache_clear();
+    udp_resolve_start(&first, "localhost", 8080);
+    udp_resolve_free(&first);
+}
+
+static void test_resolve_invalid_hostname(void** state)
+{
+    UdpResolve resolve;
+    UdpEndpoint endpoint;
+    udp_resolve_start(&resolve, "wrdlbrnft12141412414", 8080);
+    assert_int_equal(await_resolve(&resolve, &endpoint), UDP_RESOLVE_FAILED);
+    udp_resolve_free(&resolve);
+}
+
+static void test_share_port(void** state)
+{
+    unsigned short shared_port = 24214;
+
+    UdpSocket listener;
+    UdpSocket connected;
+    UdpSocket exclusive;
+    UdpSocket sender1;
+    UdpSocket sender2;
+    UdpSocketResult result;
+    int msg = 1;
+    int received = 0;
+
+    result = udp_socket_init_shared(&listener, shared_port);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_init_shared(&connected, shared_port);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_init_on_port(&exclusive, shared_port);
+    assert_int_equal(result.code, UDP_SOCKET_ERR_PORT_IN_USE);
+
+    udp_socket_init(&sender1);
+    udp_socket_set_receiver(&sender1, "localhost", shared_port);
+    udp_socket_init(&sender2);
+    udp_socket_set_receiver(&sender2, "localhost", shared_port);
+
+    // Connect to the first sender as the listener sees it
+    UdpEndpoint endpoint;
+    udp_socket_send(&sender1, &msg, sizeof(msg));
+    time_sleep(10);
+    result = udp_socket_receive_from(&listener, &received, sizeof(received), NULL, &endpoint);
+    if(result.code != UDP_SOCKET_OK)
+    {
+        result = udp_socket_receive_from(&connected, &received, sizeof(received), NULL, &endpoint);
+    }
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_set_endpoint(&connected, &endpoint);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    // Now the kernel passes each datagram to the socket it belongs to
+    msg = 2;
+    udp_socket_send(&sender1, &msg, sizeof(msg));
+    msg = 3;
+    udp_socket_send(&sender2, &msg, sizeof(msg));
+    time_sleep(10);
+
+    result = udp_socket_receive(&connected, &received, sizeof(received), NULL, false);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+    assert_int_equal(2, received);
+    result = udp_socket_receive(&connected, &received, sizeof(received), NULL, false);
+    assert_int_equal(result.code, UDP_SOCKET_ERR_NOTHING_RECEIVED);
+
+    result = udp_socket_receive(&listener, &received, sizeof(received), NULL, false);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+    assert_int_equal(3, received);
+
+    udp_socket_free(&sender1);
+    udp_socket_free(&sender2);
+    udp_socket_free(&connected);
+    udp_socket_free(&listener);
+}
+
+static void test_options(void** state)
+{
+    UdpSocket socket;
+    UdpSocketResult result;
+    UdpSocketOptions options;
+    UdpSocketOptions effective;
+
+    result = udp_socket_init(&socket);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    // Zero keeps the defaults
+    memset(&options, 0, sizeof(options));
+    result = udp_socket_set_options(&socket, &options);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    udp_socket_get_options(&socket, &effective);
+    assert_true(effective.recv_buf_len > 0);
+    assert_true(effective.send_buf_len > 0);
+    assert_int_equal(0, effective.dscp);
+
+    // Within the system limits and without privileges
+    options.recv_buf_len = 65536;
+    options.send_buf_len = 32768;
+    options.dscp = 46;
+    options.priority = 5;
+    result = udp_socket_set_options(&socket, &options);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    udp_socket_get_options(&socket, &effective);
+    assert_true(effective.recv_buf_len >= options.recv_buf_len);
+    assert_true(effective.send_buf_len >= options.send_buf_len);
+    assert_int_equal(46, effective.dscp);
+    assert_int_equal(5, effective.priority);
+
+    udp_socket_free(&socket);
+}
+
+static void test_selected_backend(void** state)
+{
+    // The io_uring rerun of these tests must not silently fall back to the BSD backend
+    const char* backend_name = getenv("ATOLLA_UDP_BACKEND");
+    bool want_uring = backend_name != NULL && strcmp(backend_name, "io_uring") == 0;
+
+    UdpSocket socket;
+    UdpSocketResult result = udp_socket_init(&socket);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    assert_int_equal(udp_socket_backend(&socket), want_uring ? UDP_SOCKET_BACKEND_IO_URING : UDP_SOCKET_BACKEND_BSD);
+
+    udp_socket_free(&socket);
+}
+
 static void test_send_and_receive(void** state)
 {
     unsigned short port1 = 24000;
@@ -138,6 +334,162 @@ static void test_send_and_receive(void** state)
     assert_int_equal(result.code, UDP_SOCKET_OK);
 }
 
+static void test_send_and_receive_large(void** state)
+{
+    unsigned short port1 = 24000;
+    unsigned short port2 = 48000;
+    // Larger than a send slot or the receive buffers of many stacks, but no IPv4 fragment limit
+    const size_t large_len = 30000;
+
+    UdpSocket socket1;
+    UdpSocket socket2;
+    UdpSocketResult result;
+    size_t received_bytes = 0;
+
+    uint8_t* data = (uint8_t*) malloc(large_len);
+    uint8_t* received = (uint8_t*) malloc(large_len + 1);
+    for(size_t i = 0; i < large_len; ++i)
+    {
+        data[i] = (uint8_t) (i * 7);
+    }
+
+    result = udp_socket_init_on_port(&socket1, port1);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_init_on_port(&socket2, port2);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_set_receiver(&socket1, "localhost", port2);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_send(&socket1, data, large_len);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    time_sleep(500);
+    result = udp_socket_receive(&socket2, received, large_len + 1, &received_bytes, false);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+    assert_int_equal(received_bytes, large_len);
+    assert_memory_equal(received, data, large_len);
+
+    udp_socket_free(&socket1);
+    udp_socket_free(&socket2);
+    free(received);
+    free(data);
+}
+
+static void test_send_batched(void** state)
+{
+    unsigned short port1 = 24001;
+    unsigned short port2 = 48001;
+
+    UdpSocket socket1;
+    UdpSocket socket2;
+    UdpSocketResult result;
+    size_t received_bytes;
+
+    result = udp_socket_init_on_port(&socket1, port1);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_init_on_port(&socket2, port2);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_set_receiver(&socket1, "localhost", port2);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    udp_socket_set_batching(&socket1, true);
+
+    for(int i = 0; i < 3; ++i)
+    {
+        result = udp_socket_send(&socket1, &i, sizeof(i));
+        assert_int_equal(result.code, UDP_SOCKET_OK);
+    }
+
+    result = udp_socket_flush(&socket1);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    time_sleep(500);
+
+    // Batched packets arrive in the order they were queued
+    for(int i = 0; i < 3; ++i)
+    {
+        int received = -1;
+        result = udp_socket_receive(&socket2, &received, sizeof(received), &received_bytes, false);
+        assert_int_equal(result.code, UDP_SOCKET_OK);
+        assert_int_equal(received_bytes, sizeof(received));
+        assert_int_equal(received, i);
+    }
+
+    result = udp_socket_free(&socket1);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_free(&socket2);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+}
+
+static void test_multicast(void** state)
+{
+    unsigned short group_port = 24300;
+    const char* group = "239.255.42.98";
+
+    UdpSocket member;
+    UdpSocket sender;
+    UdpSocketResult result;
+    UdpEndpoint group_endpoint;
+    unsigned long data = 0xDEADBEEF;
+    unsigned long received = ~data;
+    size_t received_bytes = 42;
+
+    result = udp_socket_init_on_port(&member, group_port);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_join_multicast(&member, "127.0.0.1");
+    assert_int_equal(result.code, UDP_SOCKET_ERR_NOT_MULTICAST);
+
+    result = udp_socket_join_multicast(&member, group);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_init(&sender);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_set_multicast_ttl(&sender, 1);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_set_multicast_loopback(&sender, true);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_endpoint_resolve(&group_endpoint, group, group_port);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+    assert_true(udp_endpoint_is_multicast(&group_endpoint));
+
+    result = udp_socket_send_to(&sender, &data, sizeof(data), &group_endpoint);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    time_sleep(100);
+    result = udp_socket_receive(&member, &received, sizeof(received), &received_bytes, false);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+    assert_int_equal(received_bytes, sizeof(received));
+    assert_int_equal(data, received);
+
+    // After leaving, datagrams to the group no longer arrive
+    result = udp_socket_leave_multicast(&member, group);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    result = udp_socket_send_to(&sender, &data, sizeof(data), &group_endpoint);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+
+    time_sleep(100);
+    result = udp_socket_receive(&member, &received, sizeof(received), &received_bytes, false);
+    assert_int_equal(result.code, UDP_SOCKET_ERR_NOTHING_RECEIVED);
+
+    UdpEndpoint unicast_endpoint;
+    result = udp_endpoint_resolve(&unicast_endpoint, "localhost", group_port);
+    assert_int_equal(result.code, UDP_SOCKET_OK);
+    assert_false(udp_endpoint_is_multicast(&unicast_endpoint));
+
+    udp_socket_free(&sender);
+    udp_socket_free(&member);
+}
+
 static void test_send_with_no_receiver(void** state)
 {
     UdpSocket socket;
@@ -179,12 +531,22 @@ int main(int argc, char* argv[])
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_init_null),
+        cmocka_unit_test(test_selected_backend),
         cmocka_unit_test(test_init_and_free_any_port),
         cmocka_unit_test(test_init_and_free_on_port),
         cmocka_unit_test(test_init_twice_on_same_port),
+        cmocka_unit_test(test_share_port),
+        cmocka_unit_test(test_options),
         cmocka_unit_test(test_connect_valid_hostname),
         cmocka_unit_test(test_connect_invalid_hostname),
+        cmocka_unit_test(test_resolve_numeric),
+        cmocka_unit_test(test_resolve_hostname_and_cache),
+        cmocka_unit_test(test_resolve_shared_lookup),
+        cmocka_unit_test(test_resolve_invalid_hostname),
         cmocka_unit_test(test_send_and_receive),
+        cmocka_unit_test(test_send_and_receive_large),
+        cmocka_unit_test(test_send_batched),
+        cmocka_unit_test(test_multicast),
         cmocka_unit_test(test_send_with_no_receiver),
         cmocka_unit_test(test_disconnect)
     };
@@ -0,0 +1,221 @@
+/**
+ * Measures how many datagrams per second can be sent and received over the
+ * loopback interface with each compiled-in socket backend, to compare the BSD
+ * backend against io_uring on the machine at hand.
+ *
+ * A sender and a receiver socket are opened on localhost for each backend.
+ * The sender sends the given number of datagrams in batches, and after each
+ * batch the receiver drains everything that arrived, so both sides run on a
+ * single thread and the socket buffers do not overflow.
+ *
+ * Usage:
+ *   atolla_bench_udp [--packets N] [--size BYTES] [--batch N] [--port PORT]
+ */
+
+#include "time/now.h"
+#include "udp_socket/udp_socket.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const unsigned int packets_default = 200000;
+static const size_t size_default = 400;
+static const unsigned int batch_default = 16;
+static const unsigned short port_default = 24100;
+static const size_t datagram_buf_len = 65536;
+
+struct BenchArgs
+{
+    unsigned int packets;
+    size_t size;
+    unsigned int batch;
+    unsigned short port;
+};
+typedef struct BenchArgs BenchArgs;
+
+struct BenchStats
+{
+    unsigned int sent;
+    unsigned int send_failed;
+    unsigned int received;
+    unsigned int truncated;
+    unsigned long long duration_us;
+};
+typedef struct BenchStats BenchStats;
+
+static uint8_t send_buf[datagram_buf_len];
+static uint8_t receive_buf[datagram_buf_len];
+
+static bool parse_args(int argc, const char* argv[], BenchArgs* args);
+static bool run_bench(const BenchArgs* args, UdpSocketBackend backend, BenchStats* stats);
+static void bench_drain(UdpSocket* receiver, size_t expected_len, BenchStats* stats);
+static const char* backend_name(UdpSocketBackend backend);
+
+static bool parse_args(int argc, const char* argv[], BenchArgs* args)
+{
+    args->packets = packets_default;
+    args->size = size_default;
+    args->batch = batch_default;
+    args->port = port_default;
+
+    for(int i = 1; i + 1 < argc; i += 2)
+    {
+        const char* flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if(strcmp(flag, "--packets") == 0)    { args->packets = (unsigned int) atoi(value); }
+        else if(strcmp(flag, "--size") == 0)  { args->size = (size_t) atoi(value); }
+        else if(strcmp(flag, "--batch") == 0) { args->batch = (unsigned int) atoi(value); }
+        else if(strcmp(flag, "--port") == 0)  { args->port = (unsigned short) atoi(value); }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", flag);
+            return false;
+        }
+    }
+
+    return (argc % 2) == 1 &&
+           args->packets > 0 &&
+           args->size > 0 && args->size <= datagram_buf_len &&
+           args->batch > 0;
+}
+
+static bool run_bench(const BenchArgs* args, UdpSocketBackend backend, BenchStats* stats)
+{
+    memset(stats, 0, sizeof(BenchStats));
+
+    if(!udp_socket_select_backend(backend))
+    {
+        return false;
+    }
+
+    UdpSocket sender;
+    UdpSocket receiver;
+
+    UdpSocketResult result = udp_socket_init_on_port(&receiver, args->port);
+    if(result.code != UDP_SOCKET_OK)
+    {
+        fprintf(stderr, "Could not open receiver on port %hu: %s\n", args->port, result.msg);
+        return false;
+    }
+
+    result = udp_socket_init(&sender);
+    if(result.code == UDP_SOCKET_OK)
+    {
+        result = udp_socket_set_receiver(&sender, "localhost", args->port);
+    }
+    if(result.code != UDP_SOCKET_OK)
+    {
+        fprintf(stderr, "Could not open sender: %s\n", result.msg);
+        udp_socket_free(&receiver);
+        return false;
+    }
+
+    bool selected = udp_socket_backend(&sender) == backend && udp_socket_backend(&receiver) == backend;
+    if(!selected)
+    {
+        fprintf(stderr, "The %s backend is compiled in but refused by the kernel\n", backend_name(backend));
+    }
+    else
+    {
+        udp_socket_set_batching(&sender, args->batch > 1);
+
+        unsigned long long start_us = time_now_us();
+
+        while(stats->sent + stats->send_failed < args->packets)
+        {
+            for(unsigned int i = 0; i < args->batch && stats->sent + stats->send_failed < args->packets; ++i)
+            {
+                // Vary the payload a little so it is not entirely constant
+                send_buf[0] = (uint8_t) stats->sent;
+
+                if(udp_socket_send(&sender, send_buf, args->size).code == UDP_SOCKET_OK)
+                {
+                    ++stats->sent;
+                }
+                else
+                {
+                    ++stats->send_failed;
+                }
+            }
+
+            udp_socket_flush(&sender);
+            bench_drain(&receiver, args->size, stats);
+        }
+
+        bench_drain(&receiver, args->size, stats);
+        stats->duration_us = time_now_us() - start_us;
+    }
+
+    udp_socket_free(&sender);
+    udp_socket_free(&receiver);
+
+    return selected;
+}
+
+/**
+ * Receives everything that arrived so far. Datagrams shorter than sent count
+ * as truncated rather than received, so a backend that cuts them short does
+ * not look fast.
+ */
+static void bench_drain(UdpSocket* receiver, size_t expected_len, BenchStats* stats)
+{
+    size_t received_len;
+
+    while(udp_socket_receive(receiver, receive_buf, datagram_buf_len, &received_len, false).code == UDP_SOCKET_OK)
+    {
+        if(received_len == expected_len)
+        {
+            ++stats->received;
+        }
+        else
+        {
+            ++stats->truncated;
+        }
+    }
+}
+
+static const char* backend_name(UdpSocketBackend backend)
+{
+    return (backend == UDP_SOCKET_BACKEND_IO_URING) ? "io_uring" : "bsd";
+}
+
+int main(int argc, const char* argv[])
+{
+    BenchArgs args;
+
+    if(!parse_args(argc, argv, &args))
+    {
+        fprintf(stderr, "Usage: %s [--packets N] [--size BYTES] [--batch N] [--port PORT]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("Sending %u datagrams of %zu bytes in batches of %u\n", args.packets, args.size, args.batch);
+
+    const UdpSocketBackend backends[] = { UDP_SOCKET_BACKEND_BSD, UDP_SOCKET_BACKEND_IO_URING };
+    for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i)
+    {
+        BenchStats stats;
+        if(!run_bench(&args, backends[i], &stats))
+        {
+            printf("%-8s  not available\n", backend_name(backends[i]));
+            continue;
+        }
+
+        double seconds = stats.duration_us / 1e6;
+        printf(
+            "%-8s  %.3fs  %.0f sent/s  %.0f received/s  (%u failed, %u truncated, %u lost)\n",
+            backend_name(backends[i]),
+            seconds,
+            stats.sent / seconds,
+            stats.received / seconds,
+            stats.send_failed,
+            stats.truncated,
+            stats.sent - stats.received - stats.truncated
+        );
+    }
+
+    return EXIT_SUCCESS;
+}
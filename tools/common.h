@@ -0,0 +1,72 @@
+/**
+ * Helpers shared by the command line tools.
+ */
+
+#ifndef TOOLS_COMMON_H
+#define TOOLS_COMMON_H
+
+#include "rec/format.h"
+#include "udp_socket/udp_socket.h"
+
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Splits an argument of the form HOST:PORT. The hostname is copied into the
+ * given buffer. Returns false if the argument has a different form.
+ */
+static inline bool tool_parse_host_port(const char* arg, char* hostname, size_t hostname_capacity, unsigned short* port)
+{
+    const char* colon = strrchr(arg, ':');
+    if(colon == NULL || (size_t) (colon - arg) >= hostname_capacity)
+    {
+        return false;
+    }
+
+    memcpy(hostname, arg, colon - arg);
+    hostname[colon - arg] = '\0';
+    *port = (unsigned short) atoi(colon + 1);
+
+    return true;
+}
+
+/**
+ * Converts an endpoint into the platform-independent representation used in
+ * recordings. IPv4 addresses mapped into IPv6 are stored as IPv4.
+ */
+static inline RecSender tool_rec_sender(UdpEndpoint* endpoint)
+{
+    static const uint8_t v4_mapped_prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+
+    RecSender sender;
+    memset(&sender, 0, sizeof(RecSender));
+
+    if(endpoint->addr.ss_family == AF_INET)
+    {
+        struct sockaddr_in* addr = (struct sockaddr_in*) &endpoint->addr;
+        sender.family = 4;
+        memcpy(sender.address, &addr->sin_addr, 4);
+        sender.port = ntohs(addr->sin_port);
+    }
+    else
+    {
+        struct sockaddr_in6* addr = (struct sockaddr_in6*) &endpoint->addr;
+        const uint8_t* bytes = (const uint8_t*) &addr->sin6_addr;
+        if(memcmp(bytes, v4_mapped_prefix, sizeof(v4_mapped_prefix)) == 0)
+        {
+            sender.family = 4;
+            memcpy(sender.address, bytes + 12, 4);
+        }
+        else
+        {
+            sender.family = 6;
+            memcpy(sender.address, bytes, 16);
+        }
+        sender.port = ntohs(addr->sin6_port);
+    }
+
+    return sender;
+}
+
+#endif // TOOLS_COMMON_H
@@ -0,0 +1,258 @@
+/**
+ * A UDP proxy that sits between an atolla source and an atolla sink and
+ * damages the traffic in both directions to emulate a bad network, e.g.
+ * venue WiFi, without root access or netem.
+ *
+ * Point the source to the listen port of the proxy, and the proxy to the
+ * sink. Impairment is driven by a seed, so runs with the same traffic and
+ * the same arguments make the same decisions.
+ *
+ * Usage:
+ *   atolla_netem --sink HOST:PORT [--listen PORT] [--seed N]
+ *                [--loss PERCENT] [--duplicate PERCENT]
+ *                [--reorder PERCENT] [--reorder-delay MS]
+ *                [--delay MS] [--jitter MS] [--rate BYTES_PER_SEC]
+ *                [--queue DATAGRAMS] [--duration MS]
+ */
+
+#include "common.h"
+#include "netem/impair.h"
+#include "time/now.h"
+#include "time/sleep.h"
+#include "udp_socket/udp_socket.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const unsigned short listen_port_default = 10043;
+static const unsigned int stats_interval_ms = 5000;
+static const size_t datagram_buf_len = 65536;
+
+struct NetemArgs
+{
+    const char* sink_hostname;
+    unsigned short sink_port;
+    unsigned short listen_port;
+    unsigned int duration_ms;
+    NetemImpairSpec impair;
+};
+typedef struct NetemArgs NetemArgs;
+
+static uint8_t datagram_buf[datagram_buf_len];
+
+static bool parse_args(int argc, const char* argv[], NetemArgs* args);
+static void print_usage(const char* program);
+static void print_stats(const char* direction, NetemImpair* impair);
+static void run_proxy(const NetemArgs* args);
+
+static bool parse_args(int argc, const char* argv[], NetemArgs* args)
+{
+    memset(args, 0, sizeof(NetemArgs));
+    args->listen_port = listen_port_default;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const char* flag = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if(value == NULL)
+        {
+            fprintf(stderr, "Missing value for %s\n", flag);
+            return false;
+        }
+
+        if(strcmp(flag, "--sink") == 0)
+        {
+            static char hostname[256];
+            if(!tool_parse_host_port(value, hostname, sizeof(hostname), &args->sink_port))
+            {
+                fprintf(stderr, "Expected HOST:PORT for --sink, got %s\n", value);
+                return false;
+            }
+            args->sink_hostname = hostname;
+        }
+        else if(strcmp(flag, "--listen") == 0)        { args->listen_port = (unsigned short) atoi(value); }
+        else if(strcmp(flag, "--seed") == 0)          { args->impair.seed = (uint32_t) strtoul(value, NULL, 10); }
+        else if(strcmp(flag, "--loss") == 0)          { args->impair.loss = atof(value) / 100.0; }
+        else if(strcmp(flag, "--duplicate") == 0)     { args->impair.duplicate = atof(value) / 100.0; }
+        else if(strcmp(flag, "--reorder") == 0)       { args->impair.reorder = atof(value) / 100.0; }
+        else if(strcmp(flag, "--reorder-delay") == 0) { args->impair.reorder_delay_ms = (unsigned int) atoi(value); }
+        else if(strcmp(flag, "--delay") == 0)         { args->impair.delay_ms = (unsigned int) atoi(value); }
+        else if(strcmp(flag, "--jitter") == 0)        { args->impair.jitter_ms = (unsigned int) atoi(value); }
+        else if(strcmp(flag, "--rate") == 0)          { args->impair.rate_bytes_per_sec = (unsigned int) atoi(value); }
+        else if(strcmp(flag, "--queue") == 0)         { args->impair.queue_capacity = (size_t) atoi(value); }
+        else if(strcmp(flag, "--duration") == 0)      { args->duration_ms = (unsigned int) atoi(value); }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", flag);
+            return false;
+        }
+
+        ++i;
+    }
+
+    if(args->sink_hostname == NULL)
+    {
+        fprintf(stderr, "No sink given\n");
+        return false;
+    }
+
+    if(args->impair.loss > 1.0 || args->impair.duplicate > 1.0 || args->impair.reorder > 1.0)
+    {
+        fprintf(stderr, "Percentages must not exceed 100\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void print_usage(const char* program)
+{
+    fprintf(
+        stderr,
+        "Usage: %s --sink HOST:PORT [--listen PORT] [--seed N]\n"
+        "          [--loss PERCENT] [--duplicate PERCENT]\n"
+        "          [--reorder PERCENT] [--reorder-delay MS]\n"
+        "          [--delay MS] [--jitter MS] [--rate BYTES_PER_SEC]\n"
+        "          [--queue DATAGRAMS] [--duration MS]\n",
+        program
+    );
+}
+
+static void print_stats(const char* direction, NetemImpair* impair)
+{
+    NetemImpairStats* stats = &impair->stats;
+    printf(
+        "%s: %u submitted, %u delivered, %u lost, %u queue drops, %u duplicated, %u reordered\n",
+        direction,
+        stats->submitted, stats->delivered, stats->lost,
+        stats->queue_dropped, stats->duplicated, stats->reordered
+    );
+}
+
+static void run_proxy(const NetemArgs* args)
+{
+    UdpSocket source_side;
+    UdpSocket sink_side;
+    UdpSocketResult result;
+
+    result = udp_socket_init_on_port(&source_side, args->listen_port);
+    if(result.code != UDP_SOCKET_OK)
+    {
+        fprintf(stderr, "Could not listen on port %hu: %s\n", args->listen_port, result.msg);
+        return;
+    }
+
+    result = udp_socket_init(&sink_side);
+    if(result.code == UDP_SOCKET_OK)
+    {
+        result = udp_socket_set_receiver(&sink_side, args->sink_hostname, args->sink_port);
+    }
+    if(result.code != UDP_SOCKET_OK)
+    {
+        fprintf(stderr, "Could not reach sink %s:%hu: %s\n", args->sink_hostname, args->sink_port, result.msg);
+        udp_socket_free(&source_side);
+        return;
+    }
+
+    // Directions are impaired independently, but both derive from the same seed
+    NetemImpairSpec downstream_spec = args->impair;
+    downstream_spec.seed = args->impair.seed ^ 0x9E3779B9;
+
+    NetemImpair upstream;
+    NetemImpair downstream;
+    netem_impair_init(&upstream, &args->impair);
+    netem_impair_init(&downstream, &downstream_spec);
+
+    UdpEndpoint source_endpoint;
+    bool has_source = false;
+
+    printf(
+        "Forwarding port %hu to %s:%hu with %.1f%% loss, %.1f%% duplicates, %.1f%% reordering, %ums +/- %ums delay\n",
+        args->listen_port, args->sink_hostname, args->sink_port,
+        args->impair.loss * 100.0, args->impair.duplicate * 100.0, args->impair.reorder * 100.0,
+        args->impair.delay_ms, args->impair.jitter_ms
+    );
+
+    unsigned int start_time = time_now();
+    unsigned int last_stats_time = start_time;
+
+    while(args->duration_ms == 0 || (time_now() - start_time) < args->duration_ms)
+    {
+        bool busy = false;
+        size_t received_len;
+        UdpEndpoint sender;
+
+        // Take everything the kernel has and hand it to the impairments
+        while(udp_socket_receive_from(&source_side, datagram_buf, datagram_buf_len, &received_len, &sender).code == UDP_SOCKET_OK)
+        {
+            if(!has_source || !udp_endpoint_equal(&sender, &source_endpoint))
+            {
+                printf("Now forwarding for a new source\n");
+                source_endpoint = sender;
+                has_source = true;
+            }
+            netem_impair_submit(&upstream, datagram_buf, received_len, time_now());
+            busy = true;
+        }
+
+        while(udp_socket_receive_from(&sink_side, datagram_buf, datagram_buf_len, &received_len, NULL).code == UDP_SOCKET_OK)
+        {
+            netem_impair_submit(&downstream, datagram_buf, received_len, time_now());
+            busy = true;
+        }
+
+        // Then forward whatever is due
+        unsigned int now = time_now();
+        while(netem_impair_poll(&upstream, now, datagram_buf, datagram_buf_len, &received_len))
+        {
+            udp_socket_send(&sink_side, datagram_buf, received_len);
+            busy = true;
+        }
+
+        while(netem_impair_poll(&downstream, now, datagram_buf, datagram_buf_len, &received_len))
+        {
+            if(has_source)
+            {
+                udp_socket_send_to(&source_side, datagram_buf, received_len, &source_endpoint);
+            }
+            busy = true;
+        }
+
+        if((now - last_stats_time) >= stats_interval_ms)
+        {
+            print_stats("source -> sink", &upstream);
+            print_stats("sink -> source", &downstream);
+            last_stats_time = now;
+        }
+
+        if(!busy)
+        {
+            time_sleep(1);
+        }
+    }
+
+    print_stats("source -> sink", &upstream);
+    print_stats("sink -> source", &downstream);
+
+    netem_impair_free(&upstream);
+    netem_impair_free(&downstream);
+    udp_socket_free(&sink_side);
+    udp_socket_free(&source_side);
+}
+
+int main(int argc, const char* argv[])
+{
+    NetemArgs args;
+
+    if(!parse_args(argc, argv, &args))
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    run_proxy(&args);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,244 @@
+/**
+ * Records a live atolla stream to disk by sitting between a source and a
+ * sink as a transparent UDP proxy. Every datagram in both directions is
+ * forwarded unchanged and appended to the recording together with the time
+ * it was received and the address of its sender.
+ *
+ * Each source address is forwarded through an upstream socket of its own, so
+ * the sink tells competing sources apart like without the recorder, and its
+ * replies go back to the source whose socket they arrived on.
+ *
+ * Point the source to the listen port of the recorder, and the recorder to
+ * the sink. Use atolla_replay to play back the recording later.
+ *
+ * Usage:
+ *   atolla_record --sink HOST:PORT --out FILE [--listen PORT] [--duration MS]
+ */
+
+#include "common.h"
+#include "rec/writer.h"
+#include "time/now.h"
+#include "time/sleep.h"
+#include "udp_socket/udp_socket.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const unsigned short listen_port_default = 10043;
+static const unsigned int flush_interval_ms = 1000;
+static const size_t datagram_buf_len = 65536;
+
+struct RecordArgs
+{
+    char sink_hostname[256];
+    unsigned short sink_port;
+    unsigned short listen_port;
+    const char* out_path;
+    unsigned int duration_ms;
+};
+typedef struct RecordArgs RecordArgs;
+
+/** Socket that forwards the traffic of one source to the sink */
+struct RecordUpstream
+{
+    UdpEndpoint source;
+    UdpEndpointKey source_key;
+    UdpSocket socket;
+};
+typedef struct RecordUpstream RecordUpstream;
+
+static uint8_t datagram_buf[datagram_buf_len];
+static RecordUpstream upstreams[REC_MAX_SENDERS];
+static size_t upstreams_len;
+
+static bool parse_args(int argc, const char* argv[], RecordArgs* args);
+static RecordUpstream* record_upstream(const RecordArgs* args, UdpEndpoint* source);
+static void run_recorder(const RecordArgs* args);
+
+static bool parse_args(int argc, const char* argv[], RecordArgs* args)
+{
+    memset(args, 0, sizeof(RecordArgs));
+    args->listen_port = listen_port_default;
+
+    bool has_sink = false;
+
+    for(int i = 1; i + 1 < argc; i += 2)
+    {
+        const char* flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if(strcmp(flag, "--sink") == 0)
+        {
+            has_sink = tool_parse_host_port(value, args->sink_hostname, sizeof(args->sink_hostname), &args->sink_port);
+        }
+        else if(strcmp(flag, "--out") == 0)      { args->out_path = value; }
+        else if(strcmp(flag, "--listen") == 0)   { args->listen_port = (unsigned short) atoi(value); }
+        else if(strcmp(flag, "--duration") == 0) { args->duration_ms = (unsigned int) atoi(value); }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", flag);
+            return false;
+        }
+    }
+
+    return has_sink && args->out_path != NULL;
+}
+
+/**
+ * Gets the upstream socket of the source with the given address, opening it
+ * when the source sends for the first time. Returns NULL if the sink is
+ * unreachable or there are more sources than a recording can tell apart.
+ */
+static RecordUpstream* record_upstream(const RecordArgs* args, UdpEndpoint* source)
+{
+    UdpEndpointKey key;
+    udp_endpoint_key(source, &key);
+
+    for(size_t i = 0; i < upstreams_len; ++i)
+    {
+        if(udp_endpoint_key_equal(&upstreams[i].source_key, &key))
+        {
+            return &upstreams[i];
+        }
+    }
+
+    if(upstreams_len == REC_MAX_SENDERS)
+    {
+        return NULL;
+    }
+
+    RecordUpstream* upstream = &upstreams[upstreams_len];
+
+    UdpSocketResult result = udp_socket_init(&upstream->socket);
+    if(result.code == UDP_SOCKET_OK)
+    {
+        result = udp_socket_set_receiver(&upstream->socket, args->sink_hostname, args->sink_port);
+        if(result.code != UDP_SOCKET_OK)
+        {
+            udp_socket_free(&upstream->socket);
+        }
+    }
+
+    if(result.code != UDP_SOCKET_OK)
+    {
+        fprintf(stderr, "Could not reach sink %s:%hu: %s\n", args->sink_hostname, args->sink_port, result.msg);
+        return NULL;
+    }
+
+    upstream->source = *source;
+    upstream->source_key = key;
+    ++upstreams_len;
+
+    return upstream;
+}
+
+static void run_recorder(const RecordArgs* args)
+{
+    UdpSocket source_side;
+    UdpSocketResult result;
+    RecWriter writer;
+
+    if(!rec_writer_open(&writer, args->out_path))
+    {
+        fprintf(stderr, "Could not open %s for writing\n", args->out_path);
+        return;
+    }
+
+    result = udp_socket_init_on_port(&source_side, args->listen_port);
+    if(result.code != UDP_SOCKET_OK)
+    {
+        fprintf(stderr, "Could not listen on port %hu: %s\n", args->listen_port, result.msg);
+        rec_writer_close(&writer);
+        return;
+    }
+
+    printf("Recording traffic between port %hu and %s:%hu to %s\n", args->listen_port, args->sink_hostname, args->sink_port, args->out_path);
+
+    unsigned int recorded_count = 0;
+    unsigned int dropped_count = 0;
+
+    unsigned int start_time = time_now();
+    unsigned int last_flush_time = start_time;
+
+    while(args->duration_ms == 0 || (time_now() - start_time) < args->duration_ms)
+    {
+        bool busy = false;
+        size_t received_len;
+        UdpEndpoint sender;
+
+        while(udp_socket_receive_from(&source_side, datagram_buf, datagram_buf_len, &received_len, &sender).code == UDP_SOCKET_OK)
+        {
+            unsigned long long received_time = time_now_us();
+            RecSender rec_sender = tool_rec_sender(&sender);
+
+            RecordUpstream* upstream = record_upstream(args, &sender);
+            if(upstream == NULL)
+            {
+                ++dropped_count;
+                continue;
+            }
+
+            udp_socket_send(&upstream->socket, datagram_buf, received_len);
+            rec_writer_datagram(&writer, received_time, REC_DIRECTION_TO_SINK, &rec_sender, datagram_buf, received_len);
+            ++recorded_count;
+            busy = true;
+        }
+
+        for(size_t i = 0; i < upstreams_len; ++i)
+        {
+            RecordUpstream* upstream = &upstreams[i];
+
+            while(udp_socket_receive_from(&upstream->socket, datagram_buf, datagram_buf_len, &received_len, &sender).code == UDP_SOCKET_OK)
+            {
+                unsigned long long received_time = time_now_us();
+                RecSender rec_sender = tool_rec_sender(&sender);
+
+                udp_socket_send_to(&source_side, datagram_buf, received_len, &upstream->source);
+                rec_writer_datagram(&writer, received_time, REC_DIRECTION_FROM_SINK, &rec_sender, datagram_buf, received_len);
+                ++recorded_count;
+                busy = true;
+            }
+        }
+
+        unsigned int now = time_now();
+        if((now - last_flush_time) >= flush_interval_ms)
+        {
+            rec_writer_flush(&writer);
+            last_flush_time = now;
+        }
+
+        if(!busy)
+        {
+            time_sleep(1);
+        }
+    }
+
+    printf("Recorded %u datagrams from %zu sources\n", recorded_count, upstreams_len);
+    if(dropped_count > 0)
+    {
+        printf("Dropped %u datagrams of sources that could not be forwarded\n", dropped_count);
+    }
+
+    rec_writer_close(&writer);
+    for(size_t i = 0; i < upstreams_len; ++i)
+    {
+        udp_socket_free(&upstreams[i].socket);
+    }
+    udp_socket_free(&source_side);
+}
+
+int main(int argc, const char* argv[])
+{
+    RecordArgs args;
+
+    if(!parse_args(argc, argv, &args))
+    {
+        fprintf(stderr, "Usage: %s --sink HOST:PORT --out FILE [--listen PORT] [--duration MS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    run_recorder(&args);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,257 @@
+/**
+ * Replays a recording made with atolla_record against a sink.
+ *
+ * Only the datagrams that sources sent to the sink are replayed. Each
+ * recorded source gets its own socket, so recordings with competing sources
+ * replay faithfully. Replies of the sink are received and counted, but
+ * otherwise ignored.
+ *
+ * By default, datagrams are sent with the original timing. A speed factor
+ * other than one scales the timing, e.g. 2 replays twice as fast. A speed of
+ * zero sends everything as fast as possible, which is useful for benchmarks.
+ *
+ * Usage:
+ *   atolla_replay --in FILE --sink HOST:PORT [--speed FACTOR]
+ */
+
+#include "common.h"
+#include "msg/iter.h"
+#include "msg/type.h"
+#include "rec/reader.h"
+#include "time/now.h"
+#include "time/sleep.h"
+#include "udp_socket/udp_socket.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Remaining waits shorter than this many microseconds are spun instead of slept */
+static const unsigned long long spin_threshold_us = 2000;
+static const size_t reply_buf_len = 1024;
+
+struct ReplayArgs
+{
+    char sink_hostname[256];
+    unsigned short sink_port;
+    const char* in_path;
+    double speed;
+};
+typedef struct ReplayArgs ReplayArgs;
+
+struct ReplayStats
+{
+    unsigned int sent;
+    unsigned int send_failed;
+    unsigned int replies_lent;
+    unsigned int replies_fail;
+    unsigned long long max_lateness_us;
+};
+typedef struct ReplayStats ReplayStats;
+
+static UdpSocket sockets[REC_MAX_SENDERS];
+static bool sockets_open[REC_MAX_SENDERS];
+
+static bool parse_args(int argc, const char* argv[], ReplayArgs* args);
+static UdpSocket* replay_socket(const ReplayArgs* args, uint8_t sender_id);
+static void replay_wait_until(unsigned long long target_us, ReplayStats* stats);
+static void replay_drain_replies(ReplayStats* stats);
+static void run_replay(const ReplayArgs* args);
+
+static bool parse_args(int argc, const char* argv[], ReplayArgs* args)
+{
+    memset(args, 0, sizeof(ReplayArgs));
+    args->speed = 1.0;
+
+    bool has_sink = false;
+
+    for(int i = 1; i + 1 < argc; i += 2)
+    {
+        const char* flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if(strcmp(flag, "--sink") == 0)
+        {
+            has_sink = tool_parse_host_port(value, args->sink_hostname, sizeof(args->sink_hostname), &args->sink_port);
+        }
+        else if(strcmp(flag, "--in") == 0)    { args->in_path = value; }
+        else if(strcmp(flag, "--speed") == 0) { args->speed = atof(value); }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", flag);
+            return false;
+        }
+    }
+
+    return has_sink && args->in_path != NULL && args->speed >= 0.0;
+}
+
+/**
+ * Gets the socket that replays the traffic of the recorded sender with the
+ * given ID, opening it on first use. Returns NULL if the sink is unreachable.
+ */
+static UdpSocket* replay_socket(const ReplayArgs* args, uint8_t sender_id)
+{
+    UdpSocket* socket = &sockets[sender_id];
+
+    if(!sockets_open[sender_id])
+    {
+        UdpSocketResult result = udp_socket_init(socket);
+        if(result.code == UDP_SOCKET_OK)
+        {
+            result = udp_socket_set_receiver(socket, args->sink_hostname, args->sink_port);
+            if(result.code != UDP_SOCKET_OK)
+            {
+                udp_socket_free(socket);
+            }
+        }
+
+        if(result.code != UDP_SOCKET_OK)
+        {
+            fprintf(stderr, "Could not reach sink %s:%hu: %s\n", args->sink_hostname, args->sink_port, result.msg);
+            return NULL;
+        }
+
+        sockets_open[sender_id] = true;
+    }
+
+    return socket;
+}
+
+static void replay_wait_until(unsigned long long target_us, ReplayStats* stats)
+{
+    unsigned long long now = time_now_us();
+
+    while(now < target_us)
+    {
+        unsigned long long remaining = target_us - now;
+        if(remaining > spin_threshold_us)
+        {
+            // Sleep coarsely and leave the last stretch to the spin
+            time_sleep((unsigned int) ((remaining - spin_threshold_us / 2) / 1000));
+            replay_drain_replies(stats);
+        }
+        now = time_now_us();
+    }
+
+    unsigned long long lateness = now - target_us;
+    if(lateness > stats->max_lateness_us)
+    {
+        stats->max_lateness_us = lateness;
+    }
+}
+
+static void replay_drain_replies(ReplayStats* stats)
+{
+    uint8_t reply_buf[reply_buf_len];
+    size_t received_len;
+
+    for(int i = 0; i < REC_MAX_SENDERS; ++i)
+    {
+        if(!sockets_open[i])
+        {
+            continue;
+        }
+
+        while(udp_socket_receive(&sockets[i], reply_buf, reply_buf_len, &received_len, false).code == UDP_SOCKET_OK)
+        {
+            MsgIter iter = msg_iter_make(reply_buf, received_len);
+            for(; msg_iter_has_msg(&iter); msg_iter_next(&iter))
+            {
+                MsgType type = msg_iter_type(&iter);
+                if(type == MSG_TYPE_LENT)
+                {
+                    ++stats->replies_lent;
+                }
+                else if(type == MSG_TYPE_FAIL)
+                {
+                    ++stats->replies_fail;
+                }
+            }
+        }
+    }
+}
+
+static void run_replay(const ReplayArgs* args)
+{
+    RecReader reader;
+    if(!rec_reader_open(&reader, args->in_path))
+    {
+        fprintf(stderr, "Could not open %s as a recording\n", args->in_path);
+        return;
+    }
+
+    ReplayStats stats;
+    memset(&stats, 0, sizeof(ReplayStats));
+
+    unsigned long long start_us = time_now_us();
+    unsigned long long recorded_duration_us = 0;
+
+    RecDatagram datagram;
+    while(rec_reader_next(&reader, &datagram))
+    {
+        if(datagram.direction != REC_DIRECTION_TO_SINK || datagram.data.size == 0)
+        {
+            continue;
+        }
+
+        UdpSocket* socket = replay_socket(args, datagram.sender_id);
+        if(socket == NULL)
+        {
+            break;
+        }
+
+        recorded_duration_us = datagram.time_us;
+        if(args->speed > 0.0)
+        {
+            replay_wait_until(start_us + (unsigned long long) (datagram.time_us / args->speed), &stats);
+        }
+
+        UdpSocketResult result = udp_socket_send(socket, datagram.data.data, datagram.data.size);
+        if(result.code == UDP_SOCKET_OK)
+        {
+            ++stats.sent;
+        }
+        else
+        {
+            ++stats.send_failed;
+        }
+
+        replay_drain_replies(&stats);
+    }
+
+    unsigned long long replay_duration_us = time_now_us() - start_us;
+
+    printf(
+        "Replayed %u datagrams (%u failed to send) of %.3fs in %.3fs, max lateness %.3fms\n",
+        stats.sent, stats.send_failed,
+        recorded_duration_us / 1e6, replay_duration_us / 1e6,
+        stats.max_lateness_us / 1e3
+    );
+    printf("Sink replied with %u LENT and %u FAIL messages\n", stats.replies_lent, stats.replies_fail);
+
+    for(int i = 0; i < REC_MAX_SENDERS; ++i)
+    {
+        if(sockets_open[i])
+        {
+            udp_socket_free(&sockets[i]);
+        }
+    }
+
+    rec_reader_close(&reader);
+}
+
+int main(int argc, const char* argv[])
+{
+    ReplayArgs args;
+
+    if(!parse_args(argc, argv, &args))
+    {
+        fprintf(stderr, "Usage: %s --in FILE --sink HOST:PORT [--speed FACTOR]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    run_replay(&args);
+
+    return EXIT_SUCCESS;
+}